@@ -0,0 +1,13 @@
+//-------------------------------------------------------
+// Instruction sans opérande mal orthographiée : HLAT n'est
+// pas un symbole (il ne commence pas en première colonne),
+// l'assembleur doit refuser le programme
+//-------------------------------------------------------
+
+        TEXT
+        LOAD    R01, #1
+        HLAT
+        END
+
+        DATA
+        END
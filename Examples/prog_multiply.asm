@@ -0,0 +1,35 @@
+//-----------------
+// Instructions
+//-----------------
+        TEXT 30
+
+        // Programme principal : même appel que prog_subroutine.asm,
+        // le produit est calculé par une seule instruction MUL au lieu
+        // d'une boucle d'additions
+main    EQU *
+        PUSH @op1
+        PUSH @op2
+        CALL NC, @subprog
+        ADD R15, #2
+        STORE R00, @result
+        HALT 
+
+        // Sous-programme
+subprog EQU *
+        LOAD R00, 3[R15]
+        MUL R00, 2[R15]
+        RET
+        
+        END
+        
+//-----------------
+// Données et pile
+//-----------------
+        DATA 30
+        
+        WORD 0
+result  WORD 0
+op1     WORD 20
+op2     WORD 5
+        
+        END
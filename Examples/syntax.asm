@@ -58,6 +58,24 @@ instr1  LOAD    R00, @op2  // chargement adresse op2 (2)
         LOAD    R03, #op2 // chargement d'une valeur immédiate
         LOAD    R03, #-2 // ici, équivalent au précédent
 
+        // Les instructions de calcul (LOAD, ADD, SUB, MUL, DIV,
+        // MOD, AND, OR, XOR, SHL, SHR, SAR, CMP) acceptent aussi
+        // un registre comme opérande source (pas de préfixe)
+        ADD     R03, R01 // R03 = R03 + R01
+
+        // Les instructions sur des plages de mots prennent trois
+        // registres : destination, source (valeur pour BFILL,
+        // seconde plage pour BCMP) et nombre de mots
+        BCOPY   R03, R01, R02 // copie de R02 mots de @R01 vers @R03
+
+        // Instructions atomiques (mêmes modes d'adressage que STORE) :
+        // CAS range R04 si le mot contient R03, et R03 reçoit
+        // l'ancien contenu (EQ si l'échange a eu lieu) ; XADD ajoute
+        // le registre au mot et y range son ancien contenu
+        CAS     R03, @op2
+        XADD    R03, n2[R03]
+        FENCE           // barrière mémoire
+
         // Fin de la section de texte
         END
 
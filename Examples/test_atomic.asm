@@ -0,0 +1,52 @@
+//Programme qui teste les instructions atomiques CAS, XADD et FENCE.
+//Il s'exécute sur un ou plusieurs processeurs (test_simul -c n) : au
+//démarrage, R00 contient le numéro du processeur et R01 leur nombre.
+//Chaque processeur additionne les éléments du tableau dont l'indice
+//vaut R00 modulo R01, puis ajoute sa somme partielle au total par XADD ;
+//il compte enfin les processeurs arrivés, sous un verrou pris par CAS.
+
+TEXT
+start   EQU	*
+	CMP	R01, #0		//lancé sans -c : un seul processeur
+	BRANCH	NE, @begin
+	LOAD	R01, #1
+begin	LOAD	R02, #0		//somme partielle
+	LOAD	R03, R00	//indice courant
+next	CMP	R03, #8
+	BRANCH	GE, @sum
+	ADD	R02, array[R03]
+	ADD	R03, R01
+	BRANCH	NC, @next
+sum	XADD	R02, @total	//total += R02 (R02 = ancien total)
+lock	LOAD	R04, #0
+	LOAD	R05, #1
+	CAS	R04, @mutex	//mutex : 0 -> 1 ?
+	BRANCH	NE, @lock	//verrou pris par un autre processeur
+	LOAD	R06, @count	//section critique
+	ADD	R06, #1
+	STORE	R06, @count
+	FENCE			//écritures visibles avant la libération
+	LOAD	R04, #0
+	STORE	R04, @mutex
+	HALT
+
+	END
+
+//-----------------
+// Données et pile
+//-----------------
+DATA	200
+
+array	WORD 1
+	WORD 2
+	WORD 3
+	WORD 4
+	WORD 5
+	WORD 6
+	WORD 7
+	WORD 8
+total	WORD 0		//36 à la fin
+count	WORD 0		//nombre de processeurs à la fin
+mutex	WORD 0
+
+	END
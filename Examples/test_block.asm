@@ -0,0 +1,49 @@
+//Programme qui teste les instructions sur des plages de mots :
+//BCOPY (copie, y compris entre plages qui se recouvrent), BFILL
+//(remplissage) et BCMP (comparaison, qui positionne le code condition)
+
+TEXT
+start   EQU	*
+	LOAD	R01, #src
+	LOAD	R02, #dst
+	LOAD	R03, #4
+	BCOPY	R02, R01, R03	//dst = src
+	BCMP	R02, R01, R03
+	BRANCH	NE, @bad	//ne prend pas ce branchement : plages égales
+	LOAD	R04, #-1
+	LOAD	R05, #buf
+	BFILL	R05, R04, R03	//buf = -1, -1, -1, -1
+	LOAD	R06, #1
+	ADD	R06, R01	//R06 = src + 1
+	BCOPY	R06, R01, R03	//recouvrement : src = 1, 1, 2, 3, 4
+	BCMP	R02, R01, R03
+	BRANCH	LT, @bad	//ne prend pas ce branchement : 2 > 1
+	BCMP	R05, R01, R03
+	BRANCH	HI, @done	//prend ce branchement : 0xffffffff > 1
+bad	HALT
+done	LOAD	R00, #0
+	BFILL	R02, R00, R03	//dst = 0, 0, 0, 0
+	HALT
+
+	END
+
+//-----------------
+// Données et pile
+//-----------------
+DATA
+
+src	WORD 1
+	WORD 2
+	WORD 3
+	WORD 4
+	WORD 5
+dst	WORD 0
+	WORD 0
+	WORD 0
+	WORD 0
+buf	WORD 0
+	WORD 0
+	WORD 0
+	WORD 0
+
+	END
@@ -0,0 +1,165 @@
+//Programme qui parcourt un tableau de 128 mots deux fois, d'abord mot par
+//mot puis de 4 en 4 mots, pour le modèle de cache de test_simul -C. Avec
+//un cache de 256 octets à lignes de 16 octets (4 mots) :
+//	test_simul -q -C 256:16:2:lru:wb:1,50 -b test_cache.bin
+//le premier parcours fait un défaut par ligne (32 sur 128 lectures) ;
+//le tableau (512 octets) ne tient pas dans le cache, et le second
+//parcours, qui lit un mot par ligne, fait 32 défauts sur 32 lectures.
+//Les appels et retours accèdent à la pile.
+
+TEXT
+start   EQU	*
+	LOAD	R03, #0		//somme
+	LOAD	R05, #1		//pas du parcours
+	CALL	NC, @scan
+	LOAD	R05, #4
+	CALL	NC, @scan
+	STORE	R03, @sum	//sum = 128 + 32
+	HALT
+
+scan	LOAD	R02, #0		//indice courant
+loop	CMP	R02, #128
+	BRANCH	GE, @done
+	ADD	R03, table[R02]
+	ADD	R02, R05
+	BRANCH	NC, @loop
+done	RET
+
+	END
+
+//-----------------
+// Données et pile
+//-----------------
+DATA
+
+table	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+	WORD 1
+sum	WORD 0
+
+	END
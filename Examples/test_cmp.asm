@@ -0,0 +1,36 @@
+//Programme qui teste l'instruction CMP et les comparaisons signées
+//et non signées : CMP soustrait sans modifier le registre
+
+TEXT
+start   EQU	*
+	LOAD	R00, @0		//R00 = -1
+	LOAD	R01, @1		//R01 = 1
+	CMP	R00, R01
+	BRANCH	LT, @signed	//prend ce branchement : -1 < 1
+	HALT
+signed	CMP	R00, R01
+	BRANCH	HI, @unsign	//prend ce branchement : 0xffffffff > 1
+	HALT
+unsign	LOAD	R02, @2		//R02 = 0x7fffffff
+	CMP	R02, R00
+	BRANCH	GT, @over	//prend ce branchement malgré le dépassement
+	HALT
+over	ADD	R02, #1
+	BRANCH	VS, @done	//prend ce branchement : dépassement de capacité
+	HALT
+done	STORE	R00, @3		//R00 n'a pas été modifié par CMP
+	HALT
+
+	END
+
+//-----------------
+// Données et pile
+//-----------------
+DATA
+
+	WORD -1
+	WORD 1
+	WORD 0x7fffffff
+	WORD 0
+
+	END
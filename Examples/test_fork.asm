@@ -0,0 +1,24 @@
+//Programme pour simul_batch -s 5 : la boucle initiale (préfixe commun) est
+//exécutée une seule fois, puis chaque ligne du manifeste repart de
+//l'instruction d'adresse 5 avec sa propre valeur de R01, par exemple
+//	Examples/test_fork.bin R01=7
+
+TEXT
+start   EQU	*
+	LOAD	R00, #0
+	LOAD	R02, #1000
+init	ADD	R00, #1
+	SUB	R02, #1
+	BRANCH	NE, @init
+fork	STORE	R01, @param	// point de divergence (adresse 5)
+	ADD	R00, @param
+	STORE	R00, @result
+	HALT
+
+	END
+
+DATA
+param	WORD	0
+result	WORD	0
+
+	END
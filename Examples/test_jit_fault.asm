@@ -0,0 +1,17 @@
+//Programme qui teste une erreur d'accès indexé dans un bloc compilé par le
+//JIT (option -j) : la première instruction du bloc sort du segment de
+//données, l'erreur doit être signalée comme en mode interprété
+
+TEXT
+start   EQU	*
+	LOAD	R01, #0
+loop	ADD	R00, 0[R01]
+	ADD	R01, #1
+	BRANCH	NC, @loop
+	HALT
+
+	END
+
+DATA	100
+
+	END
@@ -0,0 +1,39 @@
+//Programme qui teste les instructions AND, OR, XOR, SHL, SHR et SAR
+//Le nombre de bits d'un décalage est pris modulo 32
+
+TEXT
+start   EQU	*
+	LOAD	R00, @0
+	AND	R00, #0xff	//R00 = 0x34
+	STORE	R00, @2
+	OR	R00, @1		//R00 = 0xf0f4
+	STORE	R00, @3
+	XOR	R00, R00	//R00 = 0, le code condition vaut Z
+	STORE	R00, @4
+	LOAD	R01, #-16
+	SAR	R01, #2		//décalage arithmétique : R01 = -4
+	STORE	R01, @5
+	LOAD	R02, #-16
+	SHR	R02, #28	//décalage logique : R02 = 15
+	STORE	R02, @6
+	SHL	R02, #4		//R02 = 240
+	STORE	R02, @7
+	HALT
+
+	END
+
+//-----------------
+// Données et pile
+//-----------------
+DATA
+
+	WORD 0x1234
+	WORD 0xf0f0
+	WORD 0
+	WORD 0
+	WORD 0
+	WORD 0
+	WORD 0
+	WORD 0
+
+	END
@@ -0,0 +1,17 @@
+//Programme qui ne s'arrête jamais : à exécuter avec un nombre maximal
+//d'instructions ou un délai de garde (simul_batch -B, -q et -w)
+
+TEXT
+start   EQU	*
+	LOAD	R00, #0
+loop	ADD	R00, #1
+	STORE	R00, @count
+	BRANCH	NC, @loop
+	HALT
+
+	END
+
+DATA
+count	WORD	0
+
+	END
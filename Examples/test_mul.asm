@@ -0,0 +1,36 @@
+//Programme qui teste les instructions MUL, DIV et MOD
+//Division signée, le quotient est tronqué vers 0 et le reste a le signe
+//du dividende ; une division par 0 est une erreur d'exécution
+
+TEXT
+start   EQU	*
+	LOAD	R00, @0
+	MUL	R00, #6		//R00 = 42
+	STORE	R00, @2
+	LOAD	R01, @1
+	MUL	R01, R00	//forme registre : R01 = -3 * 42 = -126
+	STORE	R01, @3
+	DIV	R01, #10	//R01 = -12
+	STORE	R01, @4
+	LOAD	R02, @3
+	MOD	R02, #10	//R02 = -6
+	STORE	R02, @5
+	LOAD	R03, #0
+	DIV	R00, R03	//erreur : division par 0
+	HALT
+
+	END
+
+//-----------------
+// Données et pile
+//-----------------
+DATA
+
+	WORD 7
+	WORD -3
+	WORD 0
+	WORD 0
+	WORD 0
+	WORD 0
+
+	END
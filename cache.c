@@ -0,0 +1,475 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "cache.h"
+#include "format.h"
+
+//! Régions de données
+enum
+{
+	REGION_STATIC = 0,	//!< Données statiques (sous \c _dataend)
+	REGION_STACK,		//!< Pile
+	NREGIONS
+};
+
+//! Noms des régions
+static const char *region_names[NREGIONS] = { "static", "stack" };
+
+//! Un niveau de cache
+/*!
+ * Les voies de l'ensemble \c s occupent les indices <tt>s * ways</tt> à
+ * <tt>(s + 1) * ways - 1</tt> de \c _tags, \c _dirty et \c _stamps.
+ */
+typedef struct
+{
+	Cache_Level_Config _config;	//!< Description
+	unsigned _lineshift;		//!< log2 de la taille d'une ligne
+	unsigned _sets;			//!< Nombre d'ensembles
+	uint32_t *_tags;		//!< Numéro de ligne + 1 par voie (0 : voie invalide)
+	uint8_t *_dirty;		//!< Ligne modifiée (écriture différée) ?
+	uint64_t *_stamps;		//!< Date du dernier accès par voie (LRU)
+	uint64_t *_plru;		//!< Bits de l'arbre par ensemble (pseudo-LRU)
+	uint64_t _clock;		//!< Date courante (LRU)
+	uint64_t _hits[NREGIONS];	//!< Succès par région
+	uint64_t _misses[NREGIONS];	//!< Défauts par région
+	uint64_t _evictions;		//!< Lignes valides remplacées
+	uint64_t _writebacks;		//!< Lignes modifiées recopiées au niveau suivant
+} Cache_Level;
+
+//! Modèle de la hiérarchie
+struct Cache
+{
+	unsigned _nlevels;			//!< Nombre de niveaux
+	Cache_Level _levels[CACHE_MAXLEVELS];	//!< Niveaux
+	unsigned _memory_latency;		//!< Latence de la mémoire
+	uint64_t _memreads;			//!< Lectures en mémoire
+	uint64_t _memwrites;			//!< Écritures en mémoire
+	unsigned _dataend;			//!< Limite des données statiques
+	unsigned _textsize;			//!< Taille du segment de texte
+	uint64_t _accesses[NREGIONS];		//!< Accès par région
+	uint64_t _stalls[NREGIONS];		//!< Cycles d'attente par région
+	uint64_t *_pcmisses;			//!< Défauts du premier niveau par instruction
+	uint64_t *_pcstalls;			//!< Cycles d'attente par instruction
+};
+
+//! Est-ce une puissance de 2 ?
+static bool power_of_two(unsigned n) {
+	return n != 0 && (n & (n - 1)) == 0;
+}
+
+//! Logarithme en base 2 d'une puissance de 2
+static unsigned log2_of(unsigned n) {
+	unsigned l = 0;
+	while (n > 1) {
+		n >>= 1;
+		++l;
+	}
+	return l;
+}
+
+//! Lecture d'une taille, avec suffixe k ou m facultatif
+/*!
+ * \param s le texte
+ * \param pn la taille (résultat)
+ * \return vrai si le texte est une taille correcte
+ */
+static bool parse_size(const char *s, unsigned *pn) {
+	char *end;
+	unsigned long n = strtoul(s, &end, 0);
+	if (end == s)
+		return false;
+	if (*end == 'k' || *end == 'K') {
+		n <<= 10;
+		++end;
+	} else if (*end == 'm' || *end == 'M') {
+		n <<= 20;
+		++end;
+	}
+	if (*end != '\0' || n > 1ul << 30)
+		return false;
+	*pn = n;
+	return true;
+}
+
+//! Lecture de la description d'un niveau
+/*!
+ * \param text le texte (modifié)
+ * \param plevel la description (résultat)
+ * \param latency latence par défaut
+ * \return vrai si la description est correcte
+ */
+static bool parse_level(char *text, Cache_Level_Config *plevel, unsigned latency) {
+	char *fields[6];
+	unsigned n = 0;
+	for (char *p = strtok(text, ":"); p != NULL; p = strtok(NULL, ":")) {
+		if (n == 6)
+			return false;
+		fields[n++] = p;
+	}
+	*plevel = (Cache_Level_Config) { 0, 0, 0, CACHE_LRU, true, latency };
+	if (n < 3 || !parse_size(fields[0], &plevel->_size)
+	    || !parse_size(fields[1], &plevel->_line) || !parse_size(fields[2], &plevel->_ways))
+		return false;
+	for (unsigned i = 3; i < n; ++i) {
+		if (strcmp(fields[i], "lru") == 0)
+			plevel->_replacement = CACHE_LRU;
+		else if (strcmp(fields[i], "plru") == 0)
+			plevel->_replacement = CACHE_PLRU;
+		else if (strcmp(fields[i], "wb") == 0)
+			plevel->_writeback = true;
+		else if (strcmp(fields[i], "wt") == 0)
+			plevel->_writeback = false;
+		else if (!parse_size(fields[i], &plevel->_latency))
+			return false;
+	}
+
+	// Contraintes du modèle
+	if (!power_of_two(plevel->_size) || !power_of_two(plevel->_line)
+	    || plevel->_line < sizeof(Word) || plevel->_ways == 0
+	    || plevel->_size % (plevel->_line * plevel->_ways) != 0
+	    || !power_of_two(plevel->_size / (plevel->_line * plevel->_ways)))
+		return false;
+	if (plevel->_replacement == CACHE_PLRU
+	    && (!power_of_two(plevel->_ways) || plevel->_ways > 64))
+		return false;
+	return true;
+}
+
+//! Lecture de la description d'une hiérarchie
+/*!
+ * \param spec la description
+ * \param pconfig la hiérarchie (résultat)
+ * \return vrai si la description est correcte
+ */
+bool cache_parse(const char *spec, Cache_Config *pconfig) {
+	static const unsigned latencies[CACHE_MAXLEVELS] = { 4, 12 };
+
+	if (strcmp(spec, "default") == 0)
+		spec = "32k:64:8:lru:wb:4,256k:64:8:plru:wb:12,100";
+
+	char *text = malloc(strlen(spec) + 1);
+	if (text == NULL) {
+		perror("cache");
+		return false;
+	}
+	strcpy(text, spec);
+	pconfig->_nlevels = 0;
+	pconfig->_memory_latency = 100;
+
+	// Découpage en éléments (strtok sert aussi à lire chaque niveau)
+	char *items[CACHE_MAXLEVELS + 1];
+	unsigned nitems = 0;
+	bool ok = true;
+	for (char *p = text, *comma; ok && p != NULL; p = comma != NULL ? comma + 1 : NULL) {
+		comma = strchr(p, ',');
+		if (comma != NULL)
+			*comma = '\0';
+		if (nitems == CACHE_MAXLEVELS + 1)
+			ok = false;
+		else
+			items[nitems++] = p;
+	}
+
+	for (unsigned i = 0; ok && i < nitems; ++i) {
+		if (strchr(items[i], ':') == NULL && i == nitems - 1 && i > 0)
+			ok = parse_size(items[i], &pconfig->_memory_latency);
+		else if (pconfig->_nlevels < CACHE_MAXLEVELS)
+			ok = parse_level(items[i], &pconfig->_levels[pconfig->_nlevels],
+					 latencies[pconfig->_nlevels]),
+				++pconfig->_nlevels;
+		else
+			ok = false;
+	}
+	free(text);
+
+	if (!ok || pconfig->_nlevels == 0) {
+		fprintf(stderr, "Bad cache description: %s\n", spec);
+		return false;
+	}
+	return true;
+}
+
+//! Création d'un modèle vide
+/*!
+ * \param pconfig la hiérarchie
+ * \param pmach la machine
+ * \return le modèle, ou NULL
+ */
+Cache *cache_new(const Cache_Config *pconfig, const Machine *pmach) {
+	Cache *pcache = calloc(1, sizeof(Cache));
+	if (pcache == NULL) {
+		perror("cache");
+		return NULL;
+	}
+	pcache->_nlevels = pconfig->_nlevels;
+	pcache->_memory_latency = pconfig->_memory_latency;
+	pcache->_dataend = pmach->_dataend;
+	pcache->_textsize = pmach->_textsize;
+	pcache->_pcmisses = calloc(pmach->_textsize + 1, sizeof(uint64_t));
+	pcache->_pcstalls = calloc(pmach->_textsize + 1, sizeof(uint64_t));
+	bool ok = pcache->_pcmisses != NULL && pcache->_pcstalls != NULL;
+
+	for (unsigned l = 0; ok && l < pcache->_nlevels; ++l) {
+		Cache_Level *pl = &pcache->_levels[l];
+		unsigned ways = pconfig->_levels[l]._ways;
+		pl->_config = pconfig->_levels[l];
+		pl->_lineshift = log2_of(pl->_config._line);
+		pl->_sets = pl->_config._size / (pl->_config._line * ways);
+		pl->_tags = calloc((size_t) pl->_sets * ways, sizeof(uint32_t));
+		pl->_dirty = calloc((size_t) pl->_sets * ways, sizeof(uint8_t));
+		if (pl->_config._replacement == CACHE_PLRU)
+			pl->_plru = calloc(pl->_sets, sizeof(uint64_t));
+		else
+			pl->_stamps = calloc((size_t) pl->_sets * ways, sizeof(uint64_t));
+		ok = pl->_tags != NULL && pl->_dirty != NULL
+		    && (pl->_plru != NULL || pl->_stamps != NULL);
+	}
+	if (!ok) {
+		perror("cache");
+		cache_free(pcache);
+		return NULL;
+	}
+	return pcache;
+}
+
+//! Libération d'un modèle
+/*!
+ * \param pcache le modèle
+ */
+void cache_free(Cache *pcache) {
+	for (unsigned l = 0; l < pcache->_nlevels; ++l) {
+		free(pcache->_levels[l]._tags);
+		free(pcache->_levels[l]._dirty);
+		free(pcache->_levels[l]._stamps);
+		free(pcache->_levels[l]._plru);
+	}
+	free(pcache->_pcmisses);
+	free(pcache->_pcstalls);
+	free(pcache);
+}
+
+//! Mise à jour de la politique de remplacement après un accès à une voie
+/*!
+ * En pseudo-LRU, chaque nœud de l'arbre (numérotés à partir de 1, les fils
+ * du nœud \c n étant \c 2n et \c 2n + 1) désigne le côté à remplacer : on
+ * oriente vers l'autre côté les nœuds du chemin de la voie accédée.
+ *
+ * \param pl le niveau
+ * \param set l'ensemble
+ * \param way la voie
+ */
+static void touch(Cache_Level *pl, unsigned set, unsigned way) {
+	unsigned ways = pl->_config._ways;
+	if (pl->_plru == NULL) {
+		pl->_stamps[set * ways + way] = ++pl->_clock;
+		return;
+	}
+	uint64_t bits = pl->_plru[set];
+	unsigned node = 1;
+	for (unsigned half = ways / 2; half > 0; half /= 2) {
+		unsigned right = (way & half) != 0;
+		if (right)
+			bits &= ~((uint64_t) 1 << node);
+		else
+			bits |= (uint64_t) 1 << node;
+		node = 2 * node + right;
+	}
+	pl->_plru[set] = bits;
+}
+
+//! Choix de la voie à remplacer (une voie invalide d'abord)
+/*!
+ * \param pl le niveau
+ * \param set l'ensemble
+ * \return la voie
+ */
+static unsigned victim(const Cache_Level *pl, unsigned set) {
+	unsigned ways = pl->_config._ways;
+	const uint32_t *tags = &pl->_tags[set * ways];
+	for (unsigned w = 0; w < ways; ++w)
+		if (tags[w] == 0)
+			return w;
+
+	if (pl->_plru == NULL) {
+		const uint64_t *stamps = &pl->_stamps[set * ways];
+		unsigned oldest = 0;
+		for (unsigned w = 1; w < ways; ++w)
+			if (stamps[w] < stamps[oldest])
+				oldest = w;
+		return oldest;
+	}
+	uint64_t bits = pl->_plru[set];
+	unsigned node = 1;
+	while (node < ways)
+		node = 2 * node + ((bits >> node) & 1);
+	return node - ways;
+}
+
+//! Accès à une ligne à partir d'un niveau
+/*!
+ * \param pcache le modèle
+ * \param l le niveau (\c _nlevels pour la mémoire)
+ * \param byte l'adresse en octets
+ * \param write écriture (sinon lecture) ?
+ * \return la latence de l'accès : celle du niveau qui contient la ligne
+ */
+static unsigned level_access(Cache *pcache, unsigned l, uint64_t byte, bool write) {
+	if (l == pcache->_nlevels) {
+		if (write)
+			++pcache->_memwrites;
+		else
+			++pcache->_memreads;
+		return pcache->_memory_latency;
+	}
+
+	Cache_Level *pl = &pcache->_levels[l];
+	unsigned region = byte / sizeof(Word) >= pcache->_dataend;
+	unsigned ways = pl->_config._ways;
+	uint64_t line = byte >> pl->_lineshift;
+	unsigned set = line & (pl->_sets - 1);
+	uint32_t tag = line + 1;
+	uint32_t *tags = &pl->_tags[set * ways];
+
+	for (unsigned w = 0; w < ways; ++w)
+		if (tags[w] == tag) {
+			++pl->_hits[region];
+			touch(pl, set, w);
+			if (write && pl->_config._writeback)
+				pl->_dirty[set * ways + w] = 1;
+			else if (write)
+				level_access(pcache, l + 1, byte, true);
+			return pl->_config._latency;
+		}
+
+	++pl->_misses[region];
+	// Écriture immédiate : pas d'allocation
+	if (write && !pl->_config._writeback)
+		return level_access(pcache, l + 1, byte, true);
+
+	unsigned w = victim(pl, set);
+	if (tags[w] != 0) {
+		++pl->_evictions;
+		if (pl->_dirty[set * ways + w]) {
+			++pl->_writebacks;
+			level_access(pcache, l + 1, (uint64_t) (tags[w] - 1) << pl->_lineshift, true);
+		}
+	}
+	unsigned latency = level_access(pcache, l + 1, byte, false);
+	tags[w] = tag;
+	pl->_dirty[set * ways + w] = write;
+	touch(pl, set, w);
+	return latency;
+}
+
+//! Accès à une donnée
+/*!
+ * \param pcache le modèle
+ * \param pc l'adresse de l'instruction
+ * \param addr l'adresse de la donnée
+ * \param write écriture ?
+ * \return les cycles d'attente estimés
+ */
+unsigned cache_access(Cache *pcache, unsigned pc, Word addr, bool write) {
+	unsigned region = addr >= pcache->_dataend;
+	Cache_Level *pl1 = &pcache->_levels[0];
+	uint64_t misses = pl1->_misses[region];
+
+	++pcache->_accesses[region];
+	unsigned latency = level_access(pcache, 0, (uint64_t) addr * sizeof(Word), write);
+	unsigned stall = write ? 0 : latency - pl1->_config._latency;
+	pcache->_stalls[region] += stall;
+	if (pc <= pcache->_textsize) {
+		pcache->_pcmisses[pc] += pl1->_misses[region] - misses;
+		pcache->_pcstalls[pc] += stall;
+	}
+	return stall;
+}
+
+//! Pourcentage
+static double percent(uint64_t n, uint64_t total) {
+	return total == 0 ? 0 : 100.0 * n / total;
+}
+
+//! Instruction et ses défauts, pour le classement
+typedef struct
+{
+	uint64_t _stalls;	//!< Cycles d'attente
+	unsigned _addr;		//!< Adresse
+} Stall_Entry;
+
+//! Comparaison de deux entrées : la plus coûteuse d'abord, puis par adresse
+static int compare_stalls(const void *a, const void *b) {
+	const Stall_Entry *pa = a, *pb = b;
+	if (pa->_stalls != pb->_stalls)
+		return pa->_stalls > pb->_stalls ? -1 : 1;
+	return pa->_addr < pb->_addr ? -1 : pa->_addr > pb->_addr;
+}
+
+//! Affichage des résultats
+/*!
+ * \param out le fichier de sortie
+ * \param pmach la machine
+ * \param pcache le modèle
+ */
+void cache_print(FILE *out, const Machine *pmach, const Cache *pcache) {
+	static const char *replacement_names[] = { "LRU", "pseudo-LRU" };
+
+	fprintf(out, "\n*** CACHE ***\n");
+	for (unsigned l = 0; l < pcache->_nlevels; ++l) {
+		const Cache_Level *pl = &pcache->_levels[l];
+		uint64_t hits = pl->_hits[REGION_STATIC] + pl->_hits[REGION_STACK];
+		uint64_t misses = pl->_misses[REGION_STATIC] + pl->_misses[REGION_STACK];
+		fprintf(out, "\nL%u: %u bytes, %u-byte lines, %u-way, %u sets, %s, %s, %u cycles\n",
+			l + 1, pl->_config._size, pl->_config._line, pl->_config._ways, pl->_sets,
+			replacement_names[pl->_config._replacement],
+			pl->_config._writeback ? "write-back" : "write-through", pl->_config._latency);
+		fprintf(out, "  %14llu hits, %llu misses (%.2f%%), %llu evictions, %llu write-backs\n",
+			(unsigned long long) hits, (unsigned long long) misses,
+			percent(misses, hits + misses), (unsigned long long) pl->_evictions,
+			(unsigned long long) pl->_writebacks);
+	}
+	fprintf(out, "\nMemory: %u cycles, %llu reads, %llu writes\n", pcache->_memory_latency,
+		(unsigned long long) pcache->_memreads, (unsigned long long) pcache->_memwrites);
+
+	fprintf(out, "\nPer region:\n  %-8s %14s", "region", "accesses");
+	for (unsigned l = 0; l < pcache->_nlevels; ++l)
+		fprintf(out, "      L%u misses", l + 1);
+	fprintf(out, " %14s\n", "stall cycles");
+	for (unsigned r = 0; r < NREGIONS; ++r) {
+		fprintf(out, "  %-8s %14llu", region_names[r],
+			(unsigned long long) pcache->_accesses[r]);
+		for (unsigned l = 0; l < pcache->_nlevels; ++l)
+			fprintf(out, " %14llu", (unsigned long long) pcache->_levels[l]._misses[r]);
+		fprintf(out, " %14llu\n", (unsigned long long) pcache->_stalls[r]);
+	}
+
+	// Instructions qui ont causé des défauts, par attente décroissante
+	Stall_Entry *entries = malloc((pcache->_textsize + 1) * sizeof(Stall_Entry));
+	if (entries == NULL) {
+		perror("cache");
+		return;
+	}
+	unsigned n = 0;
+	for (unsigned a = 0; a < pcache->_textsize; ++a)
+		if (pcache->_pcmisses[a] != 0)
+			entries[n++] = (Stall_Entry) { pcache->_pcstalls[a], a };
+	qsort(entries, n, sizeof(Stall_Entry), compare_stalls);
+
+	uint64_t total = pcache->_stalls[REGION_STATIC] + pcache->_stalls[REGION_STACK];
+	fprintf(out, "\nInstructions by stall cycles:\n");
+	fprintf(out, "  %14s %8s %14s  %-6s  %s\n", "stalls", "%", "L1 misses", "addr",
+		"instruction");
+	for (unsigned i = 0; i < n; ++i) {
+		unsigned a = entries[i]._addr;
+		Instruction instr = pmach->_text[a];
+		char text[FORMAT_INSTRUCTION_MAX + 1] = "(invalid)";
+		if (instr.instr_generic._cop <= LAST_COP
+		    && ((instr.instr_generic._cop != BRANCH && instr.instr_generic._cop != CALL)
+			|| instr.instr_generic._regcond <= LAST_CONDITION))
+			*format_instruction(text, instr, a) = '\0';
+		fprintf(out, "  %14llu %7.2f%% %14llu  0x%04x  %s\n",
+			(unsigned long long) entries[i]._stalls, percent(entries[i]._stalls, total),
+			(unsigned long long) pcache->_pcmisses[a], a, text);
+	}
+	free(entries);
+}
@@ -0,0 +1,128 @@
+#ifndef _CACHE_H_
+#define _CACHE_H_
+
+/*!
+ * \file cache.h
+ * \brief Modèle de la hiérarchie de caches de données.
+ *
+ * Le modèle simule un ou deux niveaux de cache devant la mémoire, chacun
+ * décrit par sa taille, la taille de ses lignes, son associativité, sa
+ * politique de remplacement (LRU exact ou pseudo-LRU par arbre) et sa
+ * politique d'écriture : écriture différée (\e write-back, avec allocation
+ * sur écriture) ou écriture immédiate (\e write-through, sans allocation).
+ * Une adresse de donnée désigne un mot de 32 bits ; le modèle travaille sur
+ * les adresses en octets (\c 4 * adresse).
+ *
+ * Chaque niveau est un tableau plat d'étiquettes indexé par ensemble, avec
+ * ses dates d'accès (LRU) ou ses bits d'arbre (pseudo-LRU) : un accès ne fait
+ * aucune allocation et ne parcourt que les voies d'un ensemble.
+ *
+ * Une lecture coûte la latence du niveau qui contient la ligne (celle de la
+ * mémoire si aucun ne la contient) ; les cycles d'attente estimés sont ce
+ * coût moins la latence du premier niveau, supposée masquée par le
+ * pipeline. Les écritures, et les recopies de lignes modifiées, passent par
+ * un tampon d'écriture et ne coûtent aucune attente.
+ *
+ * Le modèle est tenu par les variantes de la boucle d'exécution qui tiennent
+ * le profil (voir profile.h) lorsque son champ \c _cache n'est pas nul : il
+ * voit donc chaque accès aux données, y compris ceux de la pile. Les
+ * résultats sont comptés par niveau, par région de données (données
+ * statiques, sous \c _dataend, ou pile) et par instruction.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+
+//! Nombre maximal de niveaux de cache
+#define CACHE_MAXLEVELS 2
+
+//! Politique de remplacement
+typedef enum
+{
+    CACHE_LRU = 0,	//!< La ligne la moins récemment utilisée
+    CACHE_PLRU,		//!< Pseudo-LRU par arbre binaire (associativité puissance de 2, au plus 64)
+} Cache_Replacement;
+
+//! Description d'un niveau de cache
+typedef struct
+{
+    unsigned _size;		//!< Taille (en octets)
+    unsigned _line;		//!< Taille d'une ligne (en octets)
+    unsigned _ways;		//!< Associativité (nombre de voies par ensemble)
+    uint8_t _replacement;	//!< Politique de remplacement (Cache_Replacement)
+    bool _writeback;		//!< Écriture différée (sinon immédiate)
+    unsigned _latency;		//!< Latence d'une lecture qui y trouve sa ligne (en cycles)
+} Cache_Level_Config;
+
+//! Description de la hiérarchie
+typedef struct
+{
+    unsigned _nlevels;		//!< Nombre de niveaux (1 ou 2)
+    Cache_Level_Config _levels[CACHE_MAXLEVELS];	//!< Niveaux, du plus proche au plus lointain
+    unsigned _memory_latency;	//!< Latence d'une lecture en mémoire (en cycles)
+} Cache_Config;
+
+//! État du modèle (structure opaque, voir cache.c)
+typedef struct Cache Cache;
+
+//! Lecture de la description d'une hiérarchie
+/*!
+ * La description est une liste de niveaux séparés par des virgules,
+ * éventuellement suivie de la latence de la mémoire ; chaque niveau s'écrit
+ * <tt>taille:ligne:voies[:lru|plru][:wb|wt][:latence]</tt>, les tailles
+ * acceptant les suffixes \c k et \c m. Par exemple
+ * <tt>32k:64:8:lru:wb:4,256k:64:8:plru:wb:12,100</tt>, qui est aussi la
+ * description \c default.
+ *
+ * Les tailles et le nombre d'ensembles doivent être des puissances de 2, et
+ * une ligne contenir au moins un mot.
+ *
+ * \param spec la description
+ * \param pconfig la hiérarchie (résultat)
+ * \return vrai si la description est correcte, faux (avec un message) sinon
+ */
+bool cache_parse(const char *spec, Cache_Config *pconfig);
+
+//! Création d'un modèle vide (caches invalides)
+/*!
+ * \param pconfig la hiérarchie
+ * \param pmach la machine (pour la taille du texte et la limite des données
+ * statiques)
+ * \return le modèle, ou NULL (avec un message) en cas d'échec
+ */
+Cache *cache_new(const Cache_Config *pconfig, const Machine *pmach);
+
+//! Libération d'un modèle
+/*!
+ * \param pcache le modèle
+ */
+void cache_free(Cache *pcache);
+
+//! Accès à une donnée
+/*!
+ * \param pcache le modèle
+ * \param pc l'adresse de l'instruction qui accède
+ * \param addr l'adresse de la donnée (en mots)
+ * \param write écriture (sinon lecture) ?
+ * \return les cycles d'attente estimés
+ */
+unsigned cache_access(Cache *pcache, unsigned pc, Word addr, bool write);
+
+//! Affichage des résultats
+/*!
+ * On affiche la description et les compteurs de chaque niveau (succès,
+ * défauts, évictions, recopies), les accès à la mémoire, les accès, défauts
+ * et cycles d'attente par région de données, puis les instructions qui ont
+ * causé des défauts, de celle qui a coûté le plus d'attente à celle qui en a
+ * coûté le moins.
+ *
+ * \param out le fichier de sortie
+ * \param pmach la machine (pour le texte du programme)
+ * \param pcache le modèle
+ */
+void cache_print(FILE *out, const Machine *pmach, const Cache *pcache);
+
+#endif
@@ -1,15 +1,279 @@
 #include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <ctype.h>
+#include <limits.h>
+#include <assert.h>
 #include "debug.h"
+#include "image.h"
 
-#define ANSWSIZE 10
+#define ANSWSIZE 128
+
+//! Cration de l'tat de mise au point d'une machine
+/*!
+ * \param pmach la machine
+ * \return l'tat de mise au point, ou NULL
+ */
+Debugger *debug_new(const Machine *pmach) {
+	size_t words = pmach->_textsize / 64 + 1;
+	Debugger *pdbg = calloc(1, sizeof(Debugger) + words * sizeof(uint64_t));
+	if (pdbg == NULL) {
+		perror("debug");
+		return NULL;
+	}
+	pdbg->_steps = 1;
+	pdbg->_depth = 0;
+	pdbg->_finish = LONG_MIN;
+	pdbg->_watch = NULL;
+	pdbg->_datasize = pmach->_datasize;
+	pdbg->_interval = 64;
+	return pdbg;
+}
+
+//! Pose ou retrait d'un point d'arrt
+/*!
+ * \param pmach la machine
+ * \param addr l'adresse dans le texte
+ * \param set vrai pour poser le point d'arrt, faux pour le retirer
+ * \return faux si l'tat de mise au point ne peut tre cr
+ */
+bool debug_breakpoint(Machine *pmach, unsigned addr, bool set) {
+	assert(addr <= pmach->_textsize);
+	if (pmach->_debugger == NULL && (pmach->_debugger = debug_new(pmach)) == NULL)
+		return false;
+	Debugger *pdbg = pmach->_debugger;
+	uint64_t *pword = &pdbg->_breakpoints[addr / 64];
+	uint64_t bit = (uint64_t) 1 << (addr % 64);
+	if (set && !(*pword & bit)) {
+		*pword |= bit;
+		++pdbg->_nbreakpoints;
+	} else if (!set && (*pword & bit)) {
+		*pword &= ~bit;
+		--pdbg->_nbreakpoints;
+	}
+	return true;
+}
+
+//! Libration de l'tat de mise au point
+/*!
+ * \param pdbg l'tat de mise au point (ou NULL)
+ */
+void debug_free(Debugger *pdbg) {
+	if (pdbg == NULL)
+		return;
+	free(pdbg->_watch);
+	for (unsigned i = 0; i < UNDO_CHUNKS; ++i)
+		free(pdbg->_chunks[i]);
+	for (unsigned i = 0; i < pdbg->_ncheckpoints; ++i)
+		free(pdbg->_checkpoints[i]._data);
+	free(pdbg);
+}
+
+//! Allocation (fin du simulateur en cas d'chec)
+/*!
+ * \param size la taille  allouer
+ */
+static void *xalloc(size_t size) {
+	void *p = malloc(size);
+	if (p == NULL) {
+		perror("debug");
+		exit(1);
+	}
+	return p;
+}
+
+//! Copie complte de l'tat de la machine, si elle n'existe pas dj
+/*!
+ * Lorsque toutes les copies sont utilises, on ne garde qu'une sur deux (la
+ * premire restant toujours) et l'intervalle entre deux copies double.
+ *
+ * \param pmach la machine
+ */
+static void take_checkpoint(Machine *pmach) {
+	Debugger *pdbg = pmach->_debugger;
+	unsigned i = pdbg->_ncheckpoints;
+	while (i > 0 && pdbg->_checkpoints[i - 1]._icount >= pdbg->_icount) {
+		if (pdbg->_checkpoints[i - 1]._icount == pdbg->_icount)
+			return;
+		--i;
+	}
+
+	while (pdbg->_ncheckpoints == CHECKPOINTS) {
+		unsigned n = 0;
+		pdbg->_interval *= 2;
+		for (unsigned j = 0; j < pdbg->_ncheckpoints; ++j) {
+			Checkpoint *pc = &pdbg->_checkpoints[j];
+			if ((pc->_icount / UNDO_CHUNK) % pdbg->_interval == 0)
+				pdbg->_checkpoints[n++] = *pc;
+			else
+				free(pc->_data);
+		}
+		pdbg->_ncheckpoints = n;
+		if ((pdbg->_icount / UNDO_CHUNK) % pdbg->_interval != 0)
+			return;
+		for (i = n; i > 0 && pdbg->_checkpoints[i - 1]._icount > pdbg->_icount; --i)
+			;
+	}
+
+	memmove(&pdbg->_checkpoints[i + 1], &pdbg->_checkpoints[i],
+		(pdbg->_ncheckpoints - i) * sizeof(Checkpoint));
+	++pdbg->_ncheckpoints;
+	Checkpoint *pc = &pdbg->_checkpoints[i];
+	pc->_icount = pdbg->_icount;
+	pc->_pc = pmach->_pc;
+	pc->_cc = pmach->_cc;
+	pc->_depth = pdbg->_depth;
+	memcpy(pc->_registers, pmach->_registers, sizeof(pc->_registers));
+	pc->_data = xalloc(pmach->_datasize * sizeof(Word));
+	memcpy(pc->_data, pmach->_data, pmach->_datasize * sizeof(Word));
+}
+
+//! Dbut d'un bloc du journal d'annulation
+/*!
+ * \param pmach la machine
+ */
+void debug_chunk(Machine *pmach) {
+	Debugger *pdbg = pmach->_debugger;
+	uint64_t chunk = pdbg->_icount / UNDO_CHUNK;
+	Undo_Entry **pslot = &pdbg->_chunks[chunk % UNDO_CHUNKS];
+
+	if (*pslot == NULL)
+		*pslot = xalloc(UNDO_CHUNK * sizeof(Undo_Entry));
+	if (chunk >= UNDO_CHUNKS && pdbg->_oldest < (chunk - UNDO_CHUNKS + 1) * UNDO_CHUNK)
+		pdbg->_oldest = (chunk - UNDO_CHUNKS + 1) * UNDO_CHUNK;
+	pdbg->_chunk = *pslot;
+	if (chunk % pdbg->_interval == 0)
+		take_checkpoint(pmach);
+}
+
+//! Instruction en cours non annulable par le journal
+/*!
+ * \param pdbg l'tat de mise au point
+ */
+void debug_barrier(Debugger *pdbg) {
+	pdbg->_oldest = pdbg->_icount;
+}
+
+//! Annulation de la dernire instruction excute
+/*!
+ * \param pmach la machine
+ */
+static void undo(Machine *pmach) {
+	Debugger *pdbg = pmach->_debugger;
+	uint64_t i = --pdbg->_icount;
+	const Undo_Entry *pe = &pdbg->_chunks[(i / UNDO_CHUNK) % UNDO_CHUNKS][i % UNDO_CHUNK];
+	Code_Op cop = pmach->_text[pe->_pc].instr_generic._cop;
+
+	if (pe->_addr != UNDO_NOADDR)
+		pmach->_data[pe->_addr] = pe->_memold;
+	if (pe->_reg != UNDO_NOREG)
+		pmach->_registers[pe->_reg] = pe->_regold;
+	pmach->_pc = pe->_pc;
+	pmach->_cc = pe->_cc;
+	// Un CALL pris a modifi SP ; un RET l'a toujours fait
+	if (cop == RET)
+		++pdbg->_depth;
+	else if (cop == CALL && pe->_reg != UNDO_NOREG)
+		--pdbg->_depth;
+}
+
+//! Retour  une instruction passe
+/*!
+ * Si le journal couvre encore l'instruction, on annule les suivantes ;
+ * sinon on revient  la copie complte la plus proche qui la prcde, et il
+ * reste  rexcuter le programme jusqu' elle.
+ *
+ * \param pmach la machine
+ * \param target le numro de l'instruction (au plus \c _icount)
+ * \return vrai s'il faut rexcuter le programme jusqu' \c target
+ */
+static bool seek(Machine *pmach, uint64_t target) {
+	Debugger *pdbg = pmach->_debugger;
+	pdbg->_moved = true;
+	if (target >= pdbg->_oldest) {
+		while (pdbg->_icount > target)
+			undo(pmach);
+	} else {
+		unsigned i = pdbg->_ncheckpoints;
+		while (pdbg->_checkpoints[i - 1]._icount > target)
+			--i;
+		const Checkpoint *pc = &pdbg->_checkpoints[i - 1];
+		pmach->_pc = pc->_pc;
+		pmach->_cc = pc->_cc;
+		memcpy(pmach->_registers, pc->_registers, sizeof(pc->_registers));
+		memcpy(pmach->_data, pc->_data, pmach->_datasize * sizeof(Word));
+		pdbg->_depth = pc->_depth;
+		pdbg->_icount = pdbg->_oldest = pc->_icount;
+	}
+	pdbg->_chunk = pdbg->_chunks[(pdbg->_icount / UNDO_CHUNK) % UNDO_CHUNKS];
+	if (pdbg->_icount == target)
+		return false;
+	pdbg->_seeking = true;
+	pdbg->_target = target;
+	pdbg->_steps = target - pdbg->_icount;
+	return true;
+}
+
+//! Nombre entier positif donn en argument d'une commande
+/*!
+ * \param arg l'argument
+ * \param pn la valeur lue
+ * \return vrai si l'argument est valide, faux (avec un message) sinon
+ */
+static bool count(const char *arg, uint64_t *pn) {
+	char *end;
+	*pn = strtoull(arg, &end, 0);
+	if (*arg == '\0' || *end != '\0') {
+		printf("Invalid number: %s\n", arg);
+		return false;
+	}
+	return true;
+}
+
+//! Accs  une adresse de donne observe
+/*!
+ * \param pdbg l'tat de mise au point
+ * \param kind l'accs
+ * \param pc l'adresse de l'instruction
+ * \param addr l'adresse de la donne
+ * \param old la valeur avant l'accs
+ * \param new la valeur aprs l'accs
+ */
+void debug_watch(Debugger *pdbg, Watch_Kind kind, unsigned pc, unsigned addr,
+		 Word old, Word new) {
+	unsigned flags = pdbg->_watch[addr];
+	bool fired = (kind == WATCH_READ && (flags & WATCH_READ))
+	    || (kind == WATCH_WRITE && ((flags & WATCH_WRITE)
+					|| ((flags & WATCH_CHANGE) && old != new)));
+	if (!fired || pdbg->_hit)
+		return;
+	pdbg->_hit = true;
+	pdbg->_hitkind = kind;
+	pdbg->_hitpc = pc;
+	pdbg->_hitaddr = addr;
+	pdbg->_hitold = old;
+	pdbg->_hitnew = new;
+	pdbg->_steps = 1;
+}
 
 //! Affiche la liste des commandes disponibles en Debug
 void help() {
 	puts("Available commands:");
 	puts("\th\thelp");
 	puts("\tc\tcontinue (exit interactive debug mode)");
-	puts("\ts\tstep by step (next instuction)");
+	puts("\ts [n]\tstep by step (next instuction, or next n instructions)");
 	puts("\tRET\tstep by step (next instuction)");
+	puts("\tg\tgo (run until a breakpoint)");
+	puts("\tf\tfinish (run until the current subroutine returns)");
+	puts("\tS [n]\treverse step (previous instruction, or n instructions back)");
+	puts("\tG\treverse go (run backwards until a breakpoint)");
+	puts("\tj n\tjump to instruction #n (backwards or forwards)");
+	puts("\ti\tprint the current instruction number");
+	puts("\tb [x]\tset a breakpoint at address or symbol x (list breakpoints)");
+	puts("\tu x\tremove the breakpoint at address or symbol x");
+	puts("\tw [x[:y] [rwc]]\twatch data x (to y) for reads, writes or changes");
+	puts("\t\t(default: writes; list watchpoints)");
+	puts("\tx x[:y]\tremove the watchpoints on data x (to y)");
 	puts("\tr\tprint registers");
 	puts("\td\tprint data memory");
 	puts("\tt\tprint text (prograrm) memory");
@@ -17,32 +281,348 @@ void help() {
 	puts("\tm\tprint registers and data memory");
 }
 
+//! Nom du symbole du texte associ  une adresse
+/*!
+ * \param pmach la machine
+ * \param addr l'adresse dans le texte
+ * \return le nom du symbole, ou NULL s'il n'y en a pas
+ */
+static const char *symbol_at(const Machine *pmach, unsigned addr) {
+	for (unsigned i = 0; i < pmach->_nsymbols; ++i)
+		if (!pmach->_symbols[i]._data && pmach->_symbols[i]._value == addr)
+			return pmach->_symbols[i]._name;
+	return NULL;
+}
+
+//! Adresse dsigne par un nombre ou un symbole
+/*!
+ * \param pmach la machine
+ * \param arg le nombre (dcimal, ou hexadcimal prfix par 0x) ou le nom
+ * \param data adresse de donne (sinon de texte) ?
+ * \param paddr l'adresse trouve
+ * \return vrai si l'adresse est valide, faux (avec un message) sinon
+ */
+static bool address(const Machine *pmach, const char *arg, bool data, unsigned *paddr) {
+	const char *segment = data ? "data" : "text";
+	unsigned last = data ? pmach->_datasize - 1 : pmach->_textsize;
+	if (*arg == '\0') {
+		puts("Address or symbol expected");
+		return false;
+	}
+	if (isdigit((unsigned char) *arg)) {
+		char *end;
+		unsigned long addr = strtoul(arg, &end, 0);
+		if (*end != '\0' || addr > last) {
+			printf("Invalid %s address: %s\n", segment, arg);
+			return false;
+		}
+		*paddr = addr;
+		return true;
+	}
+	for (unsigned i = 0; i < pmach->_nsymbols; ++i)
+		if (pmach->_symbols[i]._data == data && strcmp(pmach->_symbols[i]._name, arg) == 0) {
+			*paddr = pmach->_symbols[i]._value;
+			return true;
+		}
+	printf("Unknown %s symbol: %s\n", segment, arg);
+	return false;
+}
+
+//! Affichage d'une adresse du texte, avec son symbole ventuel
+/*!
+ * \param pmach la machine
+ * \param addr l'adresse
+ */
+static void print_address(const Machine *pmach, unsigned addr) {
+	const char *name = symbol_at(pmach, addr);
+	if (name != NULL)
+		printf("0x%04x (%s)", addr, name);
+	else
+		printf("0x%04x", addr);
+}
+
+//! Liste des points d'arrt
+/*!
+ * \param pmach la machine
+ */
+static void list_breakpoints(const Machine *pmach) {
+	const Debugger *pdbg = pmach->_debugger;
+	if (pdbg->_nbreakpoints == 0) {
+		puts("No breakpoints");
+		return;
+	}
+	for (unsigned addr = 0; addr <= pmach->_textsize; ++addr)
+		if ((pdbg->_breakpoints[addr / 64] >> (addr % 64)) & 1) {
+			printf("Breakpoint at ");
+			print_address(pmach, addr);
+			putchar('\n');
+		}
+}
+
+//! Pose ou retrait d'un point d'arrt
+/*!
+ * \param pmach la machine
+ * \param arg l'adresse ou le symbole
+ * \param set vrai pour poser le point d'arrt, faux pour le retirer
+ */
+static void set_breakpoint(Machine *pmach, const char *arg, bool set) {
+	unsigned addr;
+	if (address(pmach, arg, false, &addr))
+		debug_breakpoint(pmach, addr, set);
+}
+
+//! Affichage de la position dans l'excution
+/*!
+ * \param pmach la machine
+ */
+static void print_position(const Machine *pmach) {
+	printf("Instruction #%llu, PC ", (unsigned long long) pmach->_debugger->_icount);
+	print_address(pmach, pmach->_pc);
+	putchar('\n');
+}
+
+//! Noms des accs observs, d'aprs les indicateurs
+static const char *watch_names[] = {
+	"", "r", "w", "rw", "c", "rc", "wc", "rwc"
+};
+
+//! Liste des points d'observation
+/*!
+ * Les adresses conscutives observes de la mme faon sont regroupes.
+ *
+ * \param pmach la machine
+ */
+static void list_watchpoints(const Machine *pmach) {
+	const Debugger *pdbg = pmach->_debugger;
+	bool none = true;
+	for (unsigned lo = 0, hi; pdbg->_watch != NULL && lo < pdbg->_datasize; lo = hi + 1) {
+		hi = lo;
+		if (pdbg->_watch[lo] == 0)
+			continue;
+		while (hi + 1 < pdbg->_datasize && pdbg->_watch[hi + 1] == pdbg->_watch[lo])
+			++hi;
+		if (hi == lo)
+			printf("Watchpoint (%s) at 0x%04x\n", watch_names[pdbg->_watch[lo]], lo);
+		else
+			printf("Watchpoint (%s) at 0x%04x:0x%04x\n", watch_names[pdbg->_watch[lo]], lo, hi);
+		none = false;
+	}
+	if (none)
+		puts("No watchpoints");
+}
+
+//! Pose ou retrait de points d'observation
+/*!
+ * \param pmach la machine
+ * \param arg l'adresse ou le symbole, ventuellement suivi de \c :fin, puis
+ * des accs observs (\c r, \c w, \c c ; \c w par dfaut)
+ * \param set vrai pour poser les points d'observation, faux pour les retirer
+ */
+static void set_watchpoint(Machine *pmach, char *arg, bool set) {
+	Debugger *pdbg = pmach->_debugger;
+	unsigned lo, hi, flags = 0;
+
+	char *kinds = arg + strcspn(arg, " \t");
+	if (*kinds != '\0') {
+		*kinds++ = '\0';
+		kinds += strspn(kinds, " \t");
+	}
+	for (const char *k = kinds; *k != '\0'; ++k)
+		switch (*k) {
+		case 'r':
+			flags |= WATCH_READ;
+			break;
+		case 'w':
+			flags |= WATCH_WRITE;
+			break;
+		case 'c':
+			flags |= WATCH_CHANGE;
+			break;
+		default:
+			printf("Invalid access kind: %s\n", kinds);
+			return;
+		}
+	if (flags == 0)
+		flags = WATCH_WRITE;
+
+	char *colon = strchr(arg, ':');
+	if (colon != NULL)
+		*colon = '\0';
+	if (!address(pmach, arg, true, &lo)
+	    || !address(pmach, colon != NULL ? colon + 1 : arg, true, &hi))
+		return;
+	if (hi < lo) {
+		puts("Empty address range");
+		return;
+	}
+
+	if (pdbg->_watch == NULL) {
+		if (!set)
+			return;
+		if ((pdbg->_watch = calloc(pdbg->_datasize, 1)) == NULL) {
+			perror("debug");
+			return;
+		}
+	}
+	for (unsigned a = lo; a <= hi; ++a)
+		pdbg->_watch[a] = set ? flags : 0;
+}
+
+//! Affichage du dclenchement d'un point d'observation
+/*!
+ * \param pmach la machine
+ */
+static void print_hit(const Machine *pmach) {
+	const Debugger *pdbg = pmach->_debugger;
+	if (pdbg->_hitkind == WATCH_READ)
+		printf("Watchpoint: read 0x%04x: 0x%08x\n", pdbg->_hitaddr, pdbg->_hitnew);
+	else
+		printf("Watchpoint: write 0x%04x: 0x%08x -> 0x%08x\n", pdbg->_hitaddr,
+		       pdbg->_hitold, pdbg->_hitnew);
+	printf("by 0x%04x: ", pdbg->_hitpc);
+	print_instruction(pmach->_text[pdbg->_hitpc], pdbg->_hitpc);
+	putchar('\n');
+}
+
 //! Dialogue de mise au point interactive pour l'instruction courante.
 /*!
 * Cette fonction gre le dialogue pour l'option \c -d (debug). Dans ce mode,
-* elle est invoque aprs l'excution de chaque instruction.  Elle affiche le
-* menu de mise au point et on excute le choix de l'utilisateur. Si cette
-* fonction retourne faux, on abandonne le mode de mise au point interactive
-* pour les instructions suivantes et jusqu' la fin du programme.
+* elle est invoque lorsque DEBUG_STOP() le demande, ainsi qu' l'excution de
+* \c HALT. Elle affiche le menu de mise au point et on excute le choix de
+* l'utilisateur. Si cette fonction retourne faux, on abandonne le mode de mise
+* au point interactive pour les instructions suivantes et jusqu' la fin du
+* programme.
 *
 * \param mach la machine/programme en cours de simulation
 * \return vrai si l'on doit continuer en mode debug, faux sinon
 */
 bool debug_ask(Machine *pmach) {
+	Debugger *pdbg = pmach->_debugger;
 	char answer[ANSWSIZE];
+	uint64_t n;
+
+	// Rexcution vers une instruction passe ou future
+	if (pdbg->_seeking) {
+		pdbg->_hit = false;
+		if (pdbg->_icount < pdbg->_target) {
+			pdbg->_steps = pdbg->_target - pdbg->_icount;
+			return true;
+		}
+		pdbg->_seeking = false;
+		print_position(pmach);
+	}
+	if ((pdbg->_breakpoints[pmach->_pc / 64] >> (pmach->_pc % 64)) & 1) {
+		printf("Breakpoint at ");
+		print_address(pmach, pmach->_pc);
+		putchar('\n');
+	}
+	if (pdbg->_hit) {
+		print_hit(pmach);
+		pdbg->_hit = false;
+	}
+	// Le prochain arrt est fix par la commande qui rend la main
+	pdbg->_steps = 0;
+	pdbg->_finish = LONG_MIN;
+
 	while (true) {
 		printf("DEBUG? ");
 		fflush(stdout);
-		fgets(answer, ANSWSIZE, stdin);
-		switch (answer[0]) {
+		if (fgets(answer, ANSWSIZE, stdin) == NULL)
+			return false;
+
+		// Argument ventuel de la commande, sans le saut de ligne
+		char command = answer[0];
+		char *arg = answer + (command != '\0' && command != '\n');
+		while (*arg == ' ' || *arg == '\t')
+			++arg;
+		arg[strcspn(arg, "\n")] = '\0';
+
+		switch (command) {
 		case 'h':
 			help();
 			break;
 		case 'c':
 			return false;
 		case 's':
+			if (*arg != '\0') {
+				char *end;
+				unsigned long long n = strtoull(arg, &end, 0);
+				if (*end != '\0' || n == 0) {
+					printf("Invalid step count: %s\n", arg);
+					break;
+				}
+				pdbg->_steps = n;
+				return true;
+			}
 		case '\n':
+			pdbg->_steps = 1;
 			return true;
+		case 'g':
+			return true;
+		case 'f':
+			pdbg->_finish = pdbg->_depth;
+			return true;
+		case 'S':
+			n = 1;
+			if (*arg != '\0' && !count(arg, &n))
+				break;
+			if (pdbg->_icount == 0) {
+				puts("Start of execution");
+				break;
+			}
+			if (seek(pmach, n < pdbg->_icount ? pdbg->_icount - n : 0))
+				return true;
+			print_position(pmach);
+			break;
+		case 'G':
+			// Dernire instruction du journal excute sur un point d'arrt
+			for (n = pdbg->_icount; n > pdbg->_oldest; --n) {
+				uint64_t i = n - 1;
+				unsigned pc = pdbg->_chunks[(i / UNDO_CHUNK) % UNDO_CHUNKS][i % UNDO_CHUNK]._pc;
+				if ((pdbg->_breakpoints[pc / 64] >> (pc % 64)) & 1)
+					break;
+			}
+			if (n == pdbg->_oldest)
+				puts("Start of recorded history");
+			else
+				--n;
+			seek(pmach, n);
+			print_position(pmach);
+			break;
+		case 'j':
+			if (!count(arg, &n))
+				break;
+			if (n > pdbg->_icount) {
+				pdbg->_seeking = true;
+				pdbg->_target = n;
+				pdbg->_steps = n - pdbg->_icount;
+				return true;
+			}
+			if (seek(pmach, n))
+				return true;
+			print_position(pmach);
+			break;
+		case 'i':
+			print_position(pmach);
+			break;
+		case 'b':
+			if (*arg == '\0')
+				list_breakpoints(pmach);
+			else
+				set_breakpoint(pmach, arg, true);
+			break;
+		case 'u':
+			set_breakpoint(pmach, arg, false);
+			break;
+		case 'w':
+			if (*arg == '\0')
+				list_watchpoints(pmach);
+			else
+				set_watchpoint(pmach, arg, true);
+			break;
+		case 'x':
+			set_watchpoint(pmach, arg, false);
+			break;
 		case 'r':
 			print_cpu(pmach);
 			break;
@@ -57,4 +637,16 @@ bool debug_ask(Machine *pmach) {
 			break;
 		}
 	}
-}
\ No newline at end of file
+}
+
+//! Dialogue de mise au point sur une erreur d'excution
+/*!
+ * \param pmach la machine
+ * \param err l'erreur
+ * \param addr son adresse
+ * \return comme debug_ask()
+ */
+bool debug_fault(Machine *pmach, Error err, unsigned addr) {
+	printf("Fault: %s at address 0x%x\n", error_names[err], addr);
+	return debug_ask(pmach);
+}
@@ -4,22 +4,227 @@
 /*!
  * \file debug.h
  * \brief Fonctions de mise au point interactive.
+ *
+ * L'état de la mise au point (points d'arrêt, nombre de pas restant à
+ * exécuter, exécution jusqu'au retour de la fonction courante) est rangé dans
+ * la machine et consulté par les variantes de la boucle d'exécution dont \c
+ * ENGINE_DEBUG vaut 1 (voir exec_loop.h). Les points d'arrêt forment un
+ * tableau de bits indexé par l'adresse dans le texte : entre deux arrêts, le
+ * test après chaque instruction ne coûte qu'une lecture et une comparaison,
+ * sans appel de fonction ni recopie de l'état de la machine.
+ *
+ * Les points d'observation portent sur des adresses de données : un octet
+ * d'indicateurs (Watch_Kind) par adresse, alloué au premier point posé. Les
+ * accès à la mémoire des variantes de mise au point ne les consultent que si
+ * ce tableau existe, et n'appellent debug_watch() que pour une adresse
+ * observée ; les variantes ordinaires ne les voient pas, non plus que
+ * l'interpréteur de référence (exec_transfer(), exec_branch()) utilisé par la
+ * compilation à la volée, qui n'a pas de mode de mise au point.
+ *
+ * Pour l'exécution à rebours, les variantes de mise au point tiennent un
+ * journal d'annulation : pour chaque instruction exécutée, l'ancienne valeur
+ * du compteur ordinal, du code condition, du registre et du mot de donnée
+ * qu'elle modifie (Undo_Entry). Le journal est découpé en blocs de \c
+ * UNDO_CHUNK entrées, dont on ne garde que les \c UNDO_CHUNKS derniers ;
+ * au début de certains blocs, on prend en plus une copie complète de l'état
+ * de la machine (Checkpoint). Revenir à une instruction encore couverte par
+ * le journal consiste à annuler les instructions suivantes ; pour une
+ * instruction plus ancienne, on repart de la copie la plus proche qui la
+ * précède et on réexécute jusqu'à elle.
  */
 #include <stdbool.h>
+#include <stdint.h>
 
 #include "machine.h"
+#include "error.h"
+
+//! Nombre d'entrées d'un bloc du journal d'annulation (puissance de 2)
+#define UNDO_CHUNK (1 << 14)
+
+//! Nombre maximal de blocs conservés dans le journal d'annulation (le journal
+//! tient alors dans le cache : l'enregistrement en est bien plus rapide)
+#define UNDO_CHUNKS 16
+
+//! Nombre maximal de copies complètes de l'état de la machine
+#define CHECKPOINTS 32
+
+//! Pas de registre modifié (voir Undo_Entry)
+#define UNDO_NOREG 0xff
+
+//! Pas de donnée modifiée (voir Undo_Entry)
+#define UNDO_NOADDR UINT32_MAX
+
+//! Entrée du journal d'annulation : état modifié par une instruction
+typedef struct
+{
+    uint32_t _pc;		//!< Adresse de l'instruction
+    uint32_t _addr;		//!< Adresse de la donnée modifiée (ou \c UNDO_NOADDR)
+    Word _memold;		//!< Ancienne valeur de cette donnée
+    Word _regold;		//!< Ancienne valeur du registre modifié
+    Flags _cc;			//!< Ancien code condition
+    uint8_t _reg;		//!< Registre modifié (ou \c UNDO_NOREG)
+} Undo_Entry;
+
+//! Copie complète de l'état de la machine
+typedef struct
+{
+    uint64_t _icount;		//!< Nombre d'instructions exécutées à la copie
+    unsigned _pc;		//!< Compteur ordinal
+    Flags _cc;			//!< Code condition
+    long _depth;		//!< Profondeur d'appel
+    Word _registers[NREGISTERS];//!< Registres
+    Word *_data;		//!< Segment de données (alloué)
+} Checkpoint;
+
+//! Accès observés (indicateurs combinables)
+typedef enum
+{
+    WATCH_READ = 1,		//!< Lecture
+    WATCH_WRITE = 2,		//!< Écriture
+    WATCH_CHANGE = 4,		//!< Écriture qui modifie la valeur
+} Watch_Kind;
+
+//! État de la mise au point interactive
+typedef struct Debugger
+{
+    uint64_t _steps;		//!< Instructions à exécuter avant le prochain arrêt (0 : aucun arrêt prévu)
+    long _depth;		//!< Profondeur d'appel courante (\c CALL pris moins \c RET)
+    long _finish;		//!< Arrêt dès que la profondeur lui est inférieure (\c LONG_MIN : aucun)
+    unsigned _nbreakpoints;	//!< Nombre de points d'arrêt posés
+    uint8_t *_watch;		//!< Points d'observation par adresse de donnée (Watch_Kind), ou NULL
+    unsigned _datasize;		//!< Nombre d'adresses de \c _watch
+    bool _hit;			//!< Un point d'observation s'est déclenché depuis le dernier arrêt
+    Watch_Kind _hitkind;	//!< Accès qui l'a déclenché
+    unsigned _hitpc;		//!< Adresse de l'instruction responsable
+    unsigned _hitaddr;		//!< Adresse de la donnée
+    Word _hitold;		//!< Valeur avant l'accès
+    Word _hitnew;		//!< Valeur après l'accès
+    uint64_t _icount;		//!< Nombre d'instructions exécutées en mise au point
+    Undo_Entry *_chunk;		//!< Bloc du journal où s'inscrit l'instruction \c _icount
+    uint64_t _oldest;		//!< Première instruction encore couverte par le journal
+    Undo_Entry *_chunks[UNDO_CHUNKS];	//!< Blocs du journal (tampon circulaire)
+    Checkpoint _checkpoints[CHECKPOINTS];	//!< Copies de l'état, par \c _icount croissant
+    unsigned _ncheckpoints;	//!< Nombre de copies
+    unsigned _interval;		//!< Nombre de blocs entre deux copies
+    bool _seeking;		//!< Réexécution en cours vers l'instruction \c _target ?
+    uint64_t _target;		//!< Instruction visée par la réexécution
+    bool _moved;		//!< L'état de la machine a été ramené en arrière par debug_ask()
+    uint64_t _breakpoints[];	//!< Points d'arrêt : un bit par adresse du texte, sentinelle comprise
+} Debugger;
+
+//! Création de l'état de mise au point d'une machine
+/*!
+ * L'état initial est celui du pas à pas : arrêt après la première
+ * instruction, aucun point d'arrêt.
+ *
+ * \param pmach la machine (pour la taille du texte)
+ * \return l'état de mise au point, ou NULL (avec un message) en cas d'échec ;
+ * il est libéré par unload_program()
+ */
+Debugger *debug_new(const Machine *pmach);
+
+//! Libération de l'état de mise au point
+/*!
+ * \param pdbg l'état de mise au point (ou NULL)
+ */
+void debug_free(Debugger *pdbg);
+
+//! Pose ou retrait d'un point d'arrêt
+/*!
+ * L'état de mise au point de la machine est créé s'il n'existe pas encore.
+ * Les points d'arrêt servent à la mise au point interactive (option \c -d)
+ * et arrêtent les exécutions limitées de simul_step().
+ *
+ * \param pmach la machine
+ * \param addr l'adresse dans le texte (au plus la taille du texte)
+ * \param set vrai pour poser le point d'arrêt, faux pour le retirer
+ * \return faux (avec un message) si l'état de mise au point ne peut être
+ * créé
+ */
+bool debug_breakpoint(Machine *pmach, unsigned addr, bool set);
+
+//! Accès à une adresse de donnée observée
+/*!
+ * Appelée par la boucle d'exécution, avant une écriture ou après une
+ * lecture, pour une adresse dont l'indicateur n'est pas nul. Si l'accès
+ * correspond au point d'observation, on le mémorise et on demande un arrêt
+ * après l'instruction en cours ; seul le premier déclenchement entre deux
+ * arrêts est conservé.
+ *
+ * \param pdbg l'état de mise au point
+ * \param kind l'accès (\c WATCH_READ ou \c WATCH_WRITE)
+ * \param pc l'adresse de l'instruction
+ * \param addr l'adresse de la donnée
+ * \param old la valeur avant l'accès
+ * \param new la valeur après l'accès
+ */
+void debug_watch(Debugger *pdbg, Watch_Kind kind, unsigned pc, unsigned addr,
+                 Word old, Word new);
+
+//! Début d'un bloc du journal d'annulation
+/*!
+ * Appelée par la boucle d'exécution lorsque \c _icount est un multiple de
+ * \c UNDO_CHUNK, l'état de la machine étant à jour : on passe au bloc
+ * suivant (en oubliant le plus ancien si nécessaire) et on prend si besoin
+ * une copie complète de l'état.
+ *
+ * \param pmach la machine
+ */
+void debug_chunk(Machine *pmach);
+
+//! Instruction en cours non annulable par le journal
+/*!
+ * Une instruction qui modifie une plage de données (\c BCOPY, \c BFILL) ne
+ * tient pas dans une entrée du journal : le journal ne couvre plus que les
+ * instructions qui la suivent, et revenir avant elle repart de la copie
+ * complète qui la précède.
+ *
+ * \param pdbg l'état de mise au point
+ */
+void debug_barrier(Debugger *pdbg);
+
+//! Faut-il s'arrêter avant d'exécuter l'instruction d'adresse \c pc ?
+/*!
+ * Évaluée par la boucle d'exécution après chaque instruction. C'est une
+ * macro plutôt qu'une fonction, pour que le test reste dans la boucle même
+ * sans optimisation.
+ *
+ * \param pdbg l'état de mise au point
+ * \param pc l'adresse de la prochaine instruction (au plus la taille du texte)
+ * \return vrai s'il faut rendre la main à debug_ask()
+ */
+#define DEBUG_STOP(pdbg, pc)						\
+    (((pdbg)->_breakpoints[(pc) / 64] >> ((pc) % 64) & 1)		\
+     || ((pdbg)->_steps != 0 && --(pdbg)->_steps == 0)			\
+     || (pdbg)->_depth < (pdbg)->_finish)
 
 //! Dialogue de mise au point interactive pour l'instruction courante.
 /*!
  * Cette fonction gère le dialogue pour l'option \c -d (debug). Dans ce mode,
- * elle est invoquée après l'exécution de chaque instruction.  Elle affiche le
- * menu de mise au point et on exécute le choix de l'utilisateur. Si cette
- * fonction retourne faux, on abandonne le mode de mise au point interactive
- * pour les instructions suivantes et jusqu'à la fin du programme.
+ * elle est invoquée lorsque DEBUG_STOP() le demande (après chaque instruction
+ * en pas à pas), ainsi qu'à l'exécution de \c HALT. Elle affiche le menu de
+ * mise au point et on exécute le choix de l'utilisateur, qui fixe le prochain
+ * arrêt : pas à pas, \e n instructions, point d'arrêt, point d'observation,
+ * ou retour de la fonction courante. Si cette fonction retourne faux, on
+ * abandonne le mode de mise au point interactive pour les instructions
+ * suivantes et jusqu'à la fin du programme.
  * 
  * \param mach la machine/programme en cours de simulation
  * \return vrai si l'on doit continuer en mode debug, faux sinon
  */
 bool debug_ask(Machine *pmach);
 
+//! Dialogue de mise au point sur une erreur d'exécution
+/*!
+ * L'erreur est signalée, puis on laisse l'utilisateur examiner la machine et
+ * revenir en arrière. L'erreur n'est effective que s'il ne le fait pas
+ * (champ \c _moved de l'état de mise au point resté faux).
+ *
+ * \param pmach la machine, dans l'état de l'erreur
+ * \param err l'erreur
+ * \param addr son adresse
+ * \return comme debug_ask()
+ */
+bool debug_fault(Machine *pmach, Error err, unsigned addr);
+
 #endif
@@ -0,0 +1,416 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "decode.h"
+#include "error.h"
+
+//! Indicateurs positionnés, vus comme ensembles de valeurs de flags_of()
+#define ST_V	0xaaaa
+#define ST_C	0xcccc
+#define ST_Z	0xf0f0
+#define ST_N	0xff00
+
+//! Valeurs de flags_of() pour lesquelles le code condition est inconnu
+#define ST_U	(ST_Z & ST_N)
+
+//! Restriction d'un ensemble de valeurs aux codes condition connus
+#define KNOWN(m)	((m) & ~ST_U & 0xffff)
+
+//! Masques des codes condition satisfaisant chaque condition
+const uint16_t condition_masks[] = {
+	[NC] = 0xffff,
+	[EQ] = KNOWN(ST_Z),
+	[NE] = (~ST_Z | ST_U) & 0xffff,
+	[GT] = KNOWN(~ST_Z & ~(ST_N ^ ST_V)),
+	[GE] = KNOWN(~(ST_N ^ ST_V)),
+	[LT] = KNOWN(ST_N ^ ST_V),
+	[LE] = KNOWN(ST_Z | (ST_N ^ ST_V)),
+	[LO] = KNOWN(ST_C),
+	[HS] = KNOWN(~ST_C),
+	[HI] = KNOWN(~ST_C & ~ST_Z),
+	[LS] = KNOWN(ST_C | ST_Z),
+	[VS] = KNOWN(ST_V),
+	[VC] = KNOWN(~ST_V),
+};
+
+//! Choix de la nature selon le mode d'adressage
+/*!
+ * \param instr l'instruction à décoder
+ * \param imm nature pour l'adressage immédiat (OP_FAULT si interdit)
+ * \param abs nature pour l'adressage absolu
+ * \param idx nature pour l'adressage indexé
+ * \param reg nature pour un registre source (OP_FAULT si interdit)
+ */
+static Op_Kind select_mode(Instruction instr, Op_Kind imm, Op_Kind abs, Op_Kind idx,
+			   Op_Kind reg) {
+	if (instr.instr_generic._immediate && instr.instr_generic._indexed)
+		return reg;
+	else if (instr.instr_generic._immediate)
+		return imm;
+	else if (instr.instr_generic._indexed)
+		return idx;
+	else
+		return abs;
+}
+
+//! Pré-décodage d'une instruction, sauf la nature de base
+/*!
+ * \param instr l'instruction à décoder
+ * \param pd l'instruction pré-décodée (résultat)
+ */
+static void decode_fields(Instruction instr, Decoded *pd) {
+	Code_Op cop = instr.instr_generic._cop;
+
+	pd->_handler = NULL;
+	pd->_reg = instr.instr_generic._regcond;
+	pd->_rindex = 0;
+	pd->_operand = 0;
+
+	switch (cop) {
+	case ILLOP:
+		pd->_kind = OP_FAULT;
+		pd->_operand = ERR_ILLEGAL;
+		return;
+	case NOP:
+		pd->_kind = OP_NOP;
+		return;
+	case HALT:
+		pd->_kind = OP_HALT;
+		return;
+	case RET:
+		pd->_kind = OP_RET;
+		return;
+	case FENCE:
+		pd->_kind = OP_FENCE;
+		return;
+	case LOAD:
+		pd->_kind = select_mode(instr, OP_LOAD_I, OP_LOAD_A, OP_LOAD_X, OP_LOAD_R);
+		break;
+	case STORE:
+		pd->_kind = select_mode(instr, OP_FAULT, OP_STORE_A, OP_STORE_X, OP_FAULT);
+		break;
+	case ADD:
+		pd->_kind = select_mode(instr, OP_ADD_I, OP_ADD_A, OP_ADD_X, OP_ADD_R);
+		break;
+	case SUB:
+		pd->_kind = select_mode(instr, OP_SUB_I, OP_SUB_A, OP_SUB_X, OP_SUB_R);
+		break;
+	case PUSH:
+		pd->_kind = select_mode(instr, OP_PUSH_I, OP_PUSH_A, OP_PUSH_X, OP_FAULT);
+		break;
+	case POP:
+		pd->_kind = select_mode(instr, OP_FAULT, OP_POP_A, OP_POP_X, OP_FAULT);
+		break;
+	case CAS:
+		pd->_kind = select_mode(instr, OP_FAULT, OP_CAS_A, OP_CAS_X, OP_FAULT);
+		break;
+	case XADD:
+		pd->_kind = select_mode(instr, OP_FAULT, OP_XADD_A, OP_XADD_X, OP_FAULT);
+		break;
+	case BRANCH:
+		pd->_kind = select_mode(instr, OP_FAULT, OP_BRANCH_A, OP_BRANCH_X, OP_FAULT);
+		break;
+	case CALL:
+		pd->_kind = select_mode(instr, OP_FAULT, OP_CALL_A, OP_CALL_X, OP_FAULT);
+		break;
+	case MUL:
+	case DIV:
+	case MOD:
+	case AND:
+	case OR:
+	case XOR:
+	case SHL:
+	case SHR:
+	case SAR:
+	case CMP: {
+		// Quatre natures consécutives par code opération (voir Op_Kind)
+		Op_Kind first = OP_MUL_I + 4 * (cop - MUL);
+		pd->_kind = select_mode(instr, first, first + 1, first + 2, first + 3);
+		break;
+	}
+	case BCOPY:
+	case BFILL:
+	case BCMP:
+		pd->_kind = OP_BCOPY + (cop - BCOPY);
+		pd->_rindex = instr.instr_indexed._rindex;
+		pd->_operand = instr.instr_indexed._offset & (NREGISTERS - 1);
+		return;
+	default:
+		pd->_kind = OP_FAULT;
+		pd->_operand = ERR_UNKNOWN;
+		return;
+	}
+
+	if (pd->_kind == OP_FAULT) {
+		pd->_operand = ERR_IMMEDIATE;
+		return;
+	}
+
+	if (cop == BRANCH || cop == CALL) {
+		if (instr.instr_generic._regcond > LAST_CONDITION) {
+			pd->_kind = OP_FAULT;
+			pd->_operand = ERR_CONDITION;
+			return;
+		}
+	}
+
+	if (instr.instr_generic._immediate && instr.instr_generic._indexed)
+		pd->_rindex = instr.instr_indexed._rindex;
+	else if (instr.instr_generic._immediate)
+		pd->_operand = instr.instr_immediate._value;
+	else if (instr.instr_generic._indexed) {
+		pd->_rindex = instr.instr_indexed._rindex;
+		pd->_operand = instr.instr_indexed._offset;
+	}
+	else
+		pd->_operand = instr.instr_absolute._address;
+}
+
+//! Pré-décodage d'une instruction
+/*!
+ * \param instr l'instruction à décoder
+ * \param pd l'instruction pré-décodée (résultat)
+ */
+void decode_instruction(Instruction instr, Decoded *pd) {
+	decode_fields(instr, pd);
+	pd->_base = pd->_kind;
+}
+
+//! Vérification d'une adresse absolue
+/*!
+ * \param pd l'instruction pré-décodée
+ * \param textsize la taille du segment de texte
+ * \param datasize la taille du segment de données
+ */
+static void check_address(Decoded *pd, unsigned textsize, unsigned datasize) {
+	unsigned size;
+	Error err;
+
+	switch (pd->_kind) {
+	case OP_LOAD_A:
+	case OP_STORE_A:
+	case OP_ADD_A:
+	case OP_SUB_A:
+	case OP_PUSH_A:
+	case OP_POP_A:
+	case OP_MUL_A:
+	case OP_DIV_A:
+	case OP_MOD_A:
+	case OP_AND_A:
+	case OP_OR_A:
+	case OP_XOR_A:
+	case OP_SHL_A:
+	case OP_SHR_A:
+	case OP_SAR_A:
+	case OP_CMP_A:
+	case OP_CAS_A:
+	case OP_XADD_A:
+		size = datasize;
+		err = ERR_SEGDATA;
+		break;
+	case OP_BRANCH_A:
+	case OP_CALL_A:
+		size = textsize;
+		err = ERR_SEGTEXT;
+		break;
+	default:
+		return;
+	}
+	if ((unsigned) pd->_operand >= size) {
+		pd->_kind = pd->_base = OP_FAULT;
+		pd->_operand = err;
+	}
+}
+
+//! Allocation avec arrêt du simulateur en cas d'échec
+/*!
+ * \param size la taille à allouer
+ * \param zero faut-il initialiser la zone à 0 ?
+ */
+static void *xalloc(size_t size, bool zero) {
+	void *p = zero ? calloc(1, size) : malloc(size);
+	if (p == NULL && size != 0) {
+		perror("decode");
+		exit(1);
+	}
+	return p;
+}
+
+//! L'instruction termine-t-elle nécessairement un bloc de base ?
+/*!
+ * \param kind la nature de l'instruction (hors fusion)
+ */
+static bool ends_block(uint8_t kind) {
+	switch (kind) {
+	case OP_BRANCH_A:
+	case OP_BRANCH_X:
+	case OP_CALL_A:
+	case OP_CALL_X:
+	case OP_RET:
+	case OP_HALT:
+	case OP_FAULT:
+		return true;
+	default:
+		return false;
+	}
+}
+
+//! Fusion d'une modification de compteur avec le branchement qui la suit
+/*!
+ * \param pd l'instruction qui précède (éventuellement) le branchement
+ */
+static void fuse_branch(Decoded *pd) {
+	if (pd[1]._base != OP_BRANCH_A)
+		return;
+	if (pd->_base == OP_SUB_I)
+		pd->_kind = OP_SUB_I_BRANCH_A;
+	else if (pd->_base == OP_ADD_I)
+		pd->_kind = OP_ADD_I_BRANCH_A;
+}
+
+//! Traduction d'un bloc de base : fusion des séquences terminales
+/*!
+ * Le test d'une boucle est souvent lui-même un début de bloc (cible du
+ * branchement de retour) atteint aussi en séquence : la dernière instruction
+ * d'un bloc qui ne se termine pas par un branchement peut donc fusionner avec
+ * la première du bloc suivant. L'exécution reste correcte puisque celle-ci
+ * est conservée pour les branchements qui la visent.
+ *
+ * \param decoded le texte pré-décodé (terminé par la sentinelle)
+ * \param pb le bloc à traduire
+ */
+static void translate_block(Decoded *decoded, const Block *pb) {
+	Decoded *last = &decoded[pb->_start + pb->_length - 1];
+
+	if (!ends_block(last->_base))
+		fuse_branch(last);
+	else if (last->_base == OP_BRANCH_A && pb->_length >= 2)
+		fuse_branch(last - 1);
+	else if (last->_base == OP_CALL_A && pb->_length >= 3) {
+		if ((last[-1]._base == OP_PUSH_I || last[-1]._base == OP_PUSH_A)
+		    && (last[-2]._base == OP_PUSH_I || last[-2]._base == OP_PUSH_A))
+			last[-2]._kind = OP_PUSH_PUSH_CALL_A;
+	}
+}
+
+//! Découpage en blocs de base et fusion des super-instructions
+/*!
+ * \param pmach la machine dont le segment de texte vient d'être pré-décodé
+ */
+void translate_blocks(Machine *pmach) {
+	unsigned textsize = pmach->_textsize;
+	Decoded *decoded = pmach->_decoded;
+	bool *leader = xalloc(textsize + 1, true);
+
+	leader[0] = true;
+	for (unsigned i = 0; i < textsize; ++i) {
+		uint8_t kind = decoded[i]._base;
+		if ((kind == OP_BRANCH_A || kind == OP_CALL_A)
+		    && (unsigned) decoded[i]._operand < textsize)
+			leader[decoded[i]._operand] = true;
+		if (ends_block(kind))
+			leader[i + 1] = true;
+	}
+
+	unsigned nblocks = 0;
+	for (unsigned i = 0; i < textsize; ++i)
+		nblocks += leader[i];
+
+	Block *blocks = xalloc(nblocks * sizeof(Block), false);
+	unsigned b = 0;
+	for (unsigned i = 0; i < textsize; ++i) {
+		if (leader[i]) {
+			if (b > 0)
+				blocks[b - 1]._length = i - blocks[b - 1]._start;
+			blocks[b++]._start = i;
+		}
+	}
+	if (b > 0)
+		blocks[b - 1]._length = textsize - blocks[b - 1]._start;
+	free(leader);
+
+	for (b = 0; b < nblocks; ++b)
+		translate_block(decoded, &blocks[b]);
+
+	pmach->_blocks = blocks;
+	pmach->_nblocks = nblocks;
+}
+
+//! Pré-décodage du segment de texte
+/*!
+ * \param pmach la machine dont le segment de texte vient d'être chargé
+ */
+void decode_program(Machine *pmach) {
+	Decoded *decoded = xalloc((pmach->_textsize + 1) * sizeof(Decoded), false);
+
+	for (unsigned i = 0; i < pmach->_textsize; ++i) {
+		decode_instruction(pmach->_text[i], &decoded[i]);
+		check_address(&decoded[i], pmach->_textsize, pmach->_datasize);
+	}
+
+	// Sentinelle : déborder du segment de texte est une erreur
+	decoded[pmach->_textsize] = (Decoded) {
+		._kind = OP_FAULT, ._base = OP_FAULT, ._operand = ERR_SEGTEXT
+	};
+
+	pmach->_decoded = decoded;
+	pmach->_dispatch = NULL;
+
+	translate_blocks(pmach);
+}
+
+//! Vérification statique du programme pré-décodé
+/*!
+ * \param pmach la machine
+ * \param out le fichier du rapport
+ * \return le nombre d'instructions erronées accessibles
+ */
+unsigned verify_program(const Machine *pmach, FILE *out) {
+	unsigned textsize = pmach->_textsize;
+	const Decoded *decoded = pmach->_decoded;
+	bool *seen = xalloc(textsize + 1, true);
+	unsigned *work = xalloc((textsize + 1) * sizeof(unsigned), false);
+	unsigned nwork = 0, nfaults = 0;
+
+	// Parcours des instructions accessibles (la sentinelle comprise)
+	seen[pmach->_pc] = true;
+	work[nwork++] = pmach->_pc;
+	while (nwork > 0) {
+		unsigned pc = work[--nwork];
+		const Decoded *pd = &decoded[pc];
+		unsigned next[2], nnext = 0;
+
+		switch (pd->_base) {
+		case OP_FAULT:
+		case OP_HALT:
+		case OP_RET:
+			break;
+		case OP_BRANCH_A:
+			next[nnext++] = pd->_operand;
+			// Branchement inconditionnel : pas de suite en séquence
+			if (pd->_reg != NC)
+				next[nnext++] = pc + 1;
+			break;
+		case OP_CALL_A:
+			next[nnext++] = pd->_operand;
+			next[nnext++] = pc + 1;
+			break;
+		default:
+			next[nnext++] = pc + 1;
+			break;
+		}
+		for (unsigned i = 0; i < nnext; ++i)
+			if (!seen[next[i]]) {
+				seen[next[i]] = true;
+				work[nwork++] = next[i];
+			}
+	}
+
+	for (unsigned pc = 0; pc <= textsize; ++pc)
+		if (seen[pc] && decoded[pc]._base == OP_FAULT) {
+			fprintf(out, "0x%04x: %s\n", pc, error_names[decoded[pc]._operand]);
+			++nfaults;
+		}
+	free(work);
+	free(seen);
+	return nfaults;
+}
@@ -0,0 +1,226 @@
+#ifndef _DECODE_H_
+#define _DECODE_H_
+
+/*!
+ * \file decode.h
+ * \brief Pré-décodage des instructions au chargement du programme.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Nature d'une instruction pré-décodée
+/*!
+ * Chaque couple (code opération, mode d'adressage) reçoit sa propre nature, de
+ * sorte que la boucle d'exécution n'a plus à examiner les champs de
+ * l'instruction : la nature désigne directement le code de traitement.
+ *
+ * Les instructions erronées (code opération inconnu ou illégal, valeur
+ * immédiate interdite, condition invalide, adresse absolue hors de son
+ * segment) sont pré-décodées en \c OP_FAULT ; l'erreur correspondante n'est
+ * signalée que si l'instruction est exécutée. Les autres natures n'ont donc
+ * plus rien à vérifier à l'exécution, hormis les adresses indexées et celles
+ * de la pile, le diviseur des instructions \c DIV et \c MOD et les plages
+ * des instructions \c BCOPY, \c BFILL et \c BCMP.
+ */
+typedef enum
+{
+    OP_FAULT = 0,	//!< Erreur à l'exécution (code d'erreur dans _operand)
+    OP_NOP,		//!< Instruction sans effet
+    OP_LOAD_I,		//!< LOAD immédiat
+    OP_LOAD_A,		//!< LOAD absolu
+    OP_LOAD_X,		//!< LOAD indexé
+    OP_STORE_A,		//!< STORE absolu
+    OP_STORE_X,		//!< STORE indexé
+    OP_ADD_I,		//!< ADD immédiat
+    OP_ADD_A,		//!< ADD absolu
+    OP_ADD_X,		//!< ADD indexé
+    OP_SUB_I,		//!< SUB immédiat
+    OP_SUB_A,		//!< SUB absolu
+    OP_SUB_X,		//!< SUB indexé
+    OP_PUSH_I,		//!< PUSH immédiat
+    OP_PUSH_A,		//!< PUSH absolu
+    OP_PUSH_X,		//!< PUSH indexé
+    OP_POP_A,		//!< POP absolu
+    OP_POP_X,		//!< POP indexé
+    OP_BRANCH_A,	//!< BRANCH absolu
+    OP_BRANCH_X,	//!< BRANCH indexé
+    OP_CALL_A,		//!< CALL absolu
+    OP_CALL_X,		//!< CALL indexé
+    OP_RET,		//!< Retour de sous-programme
+    OP_HALT,		//!< Arrêt du programme
+
+    // Forme registre et instructions de calcul
+    OP_LOAD_R,		//!< LOAD registre
+    OP_ADD_R,		//!< ADD registre
+    OP_SUB_R,		//!< SUB registre
+    OP_MUL_I,		//!< MUL immédiat
+    OP_MUL_A,		//!< MUL absolu
+    OP_MUL_X,		//!< MUL indexé
+    OP_MUL_R,		//!< MUL registre
+    OP_DIV_I,		//!< DIV immédiat
+    OP_DIV_A,		//!< DIV absolu
+    OP_DIV_X,		//!< DIV indexé
+    OP_DIV_R,		//!< DIV registre
+    OP_MOD_I,		//!< MOD immédiat
+    OP_MOD_A,		//!< MOD absolu
+    OP_MOD_X,		//!< MOD indexé
+    OP_MOD_R,		//!< MOD registre
+    OP_AND_I,		//!< AND immédiat
+    OP_AND_A,		//!< AND absolu
+    OP_AND_X,		//!< AND indexé
+    OP_AND_R,		//!< AND registre
+    OP_OR_I,		//!< OR immédiat
+    OP_OR_A,		//!< OR absolu
+    OP_OR_X,		//!< OR indexé
+    OP_OR_R,		//!< OR registre
+    OP_XOR_I,		//!< XOR immédiat
+    OP_XOR_A,		//!< XOR absolu
+    OP_XOR_X,		//!< XOR indexé
+    OP_XOR_R,		//!< XOR registre
+    OP_SHL_I,		//!< SHL immédiat
+    OP_SHL_A,		//!< SHL absolu
+    OP_SHL_X,		//!< SHL indexé
+    OP_SHL_R,		//!< SHL registre
+    OP_SHR_I,		//!< SHR immédiat
+    OP_SHR_A,		//!< SHR absolu
+    OP_SHR_X,		//!< SHR indexé
+    OP_SHR_R,		//!< SHR registre
+    OP_SAR_I,		//!< SAR immédiat
+    OP_SAR_A,		//!< SAR absolu
+    OP_SAR_X,		//!< SAR indexé
+    OP_SAR_R,		//!< SAR registre
+    OP_CMP_I,		//!< CMP immédiat
+    OP_CMP_A,		//!< CMP absolu
+    OP_CMP_X,		//!< CMP indexé
+    OP_CMP_R,		//!< CMP registre
+    OP_BCOPY,		//!< Copie d'une plage de données
+    OP_BFILL,		//!< Remplissage d'une plage de données
+    OP_BCMP,		//!< Comparaison de deux plages de données
+    OP_CAS_A,		//!< CAS absolu
+    OP_CAS_X,		//!< CAS indexé
+    OP_XADD_A,		//!< XADD absolu
+    OP_XADD_X,		//!< XADD indexé
+    OP_FENCE,		//!< Barrière mémoire
+
+    // Super-instructions (voir translate_blocks())
+    OP_ADD_I_BRANCH_A,	//!< ADD immédiat suivi de BRANCH absolu
+    OP_SUB_I_BRANCH_A,	//!< SUB immédiat suivi de BRANCH absolu
+    OP_PUSH_PUSH_CALL_A,//!< Deux PUSH (immédiat ou absolu) suivis de CALL absolu
+} Op_Kind;
+
+//! Nombre de natures d'instructions pré-décodées
+#define NOPKINDS (OP_PUSH_PUSH_CALL_A + 1)
+
+//! Instruction pré-décodée
+/*!
+ * Les champs de l'instruction sont extraits une fois pour toutes au
+ * chargement : numéro de registre, mode d'adressage (à travers la nature) et
+ * opérande étendu sur 32 bits avec son signe. Le champ \c _handler contient
+ * l'adresse du code de traitement dans la boucle d'exécution (dispatch
+ * direct) ; il est renseigné par la boucle elle-même (voir exec.c).
+ *
+ * Pour les instructions \c BRANCH et \c CALL, \c _reg contient la condition
+ * (voir condition_masks). Pour les instructions sur des plages de données,
+ * \c _operand contient le numéro du troisième registre (voir cop_is_block()).
+ *
+ * Lorsque l'instruction débute une super-instruction, \c _kind désigne la
+ * super-instruction et \c _base la nature de l'instruction elle-même ; les
+ * instructions suivantes de la séquence sont conservées telles quelles, ce qui
+ * permet d'y brancher directement.
+ */
+typedef struct Decoded
+{
+    const void *_handler;	//!< Adresse du code de traitement
+    uint8_t _kind;		//!< Nature de l'instruction (Op_Kind)
+    uint8_t _reg;		//!< Registre destination ou condition
+    uint8_t _rindex;		//!< Registre d'index (adressage indexé)
+    uint8_t _base;		//!< Nature de l'instruction seule (hors fusion)
+    int32_t _operand;		//!< Valeur, adresse, déplacement ou code d'erreur
+} Decoded;
+
+//! Bloc de base
+/*!
+ * Suite d'instructions consécutives exécutées en séquence : on n'entre dans
+ * un bloc (par un branchement statique) que par sa première instruction et on
+ * n'en sort qu'après sa dernière, qui est un \c BRANCH, \c CALL, \c RET ou
+ * \c HALT (ou l'instruction qui précède le début d'un autre bloc).
+ */
+typedef struct Block
+{
+    unsigned _start;		//!< Adresse de la première instruction
+    unsigned _length;		//!< Nombre d'instructions
+} Block;
+
+//! Masques des codes condition satisfaisant chaque condition
+/*!
+ * Le bit \c i du masque associé à une condition est positionné si les
+ * indicateurs de valeur \c i (voir flags_of()) satisfont cette condition :
+ * le test d'une condition se réduit à un décalage. Seule \c NE (avec \c NC)
+ * est satisfaite par un code condition inconnu (\c FLAGS_UNKNOWN).
+ */
+extern const uint16_t condition_masks[];
+
+//! Pré-décodage du segment de texte
+/*!
+ * Le tableau produit contient \c _textsize + 1 éléments : le dernier est une
+ * sentinelle qui signale \c ERR_SEGTEXT si l'exécution déborde de la fin du
+ * segment de texte, ce qui évite de tester le compteur ordinal à chaque
+ * instruction. L'ancien tableau éventuel n'est pas libéré.
+ *
+ * Les adresses absolues sont vérifiées à ce moment, d'après la taille des
+ * segments : une instruction dont l'adresse est hors du segment visé est
+ * pré-décodée en \c OP_FAULT (\c ERR_SEGDATA ou \c ERR_SEGTEXT).
+ *
+ * Les blocs de base sont ensuite identifiés et traduits (voir
+ * translate_blocks()).
+ *
+ * \param pmach la machine dont le segment de texte vient d'être chargé
+ */
+void decode_program(Machine *pmach);
+
+//! Pré-décodage d'une instruction
+/*!
+ * \param instr l'instruction à décoder
+ * \param pd l'instruction pré-décodée (résultat)
+ */
+void decode_instruction(Instruction instr, Decoded *pd);
+
+//! Découpage en blocs de base et fusion des super-instructions
+/*!
+ * Les débuts de blocs sont l'adresse 0, les cibles des \c BRANCH et \c CALL
+ * absolus et les instructions qui suivent un \c BRANCH, \c CALL, \c RET ou
+ * \c HALT. La table des blocs est rangée dans \c _blocks.
+ *
+ * Chaque bloc est traduit une fois pour toutes : les séquences fréquentes qui
+ * le terminent (décrément d'un compteur suivi du branchement de boucle,
+ * empilement des paramètres suivi de l'appel) sont remplacées par une
+ * super-instruction qui s'exécute en un seul dispatch.
+ *
+ * Le moteur à threaded code n'exécute pas les blocs d'un seul tenant : il
+ * continue d'enchaîner les instructions (ou super-instructions) une à une,
+ * et seule la compilation à la volée (voir exec_jit()) utilise \c _blocks.
+ *
+ * \param pmach la machine dont le segment de texte vient d'être pré-décodé
+ */
+void translate_blocks(Machine *pmach);
+
+//! Vérification statique du programme pré-décodé
+/*!
+ * On parcourt les instructions accessibles depuis le compteur ordinal
+ * initial, en suivant l'enchaînement en séquence et les branchements et
+ * appels absolus (les cibles des branchements indexés ne sont pas connues
+ * avant l'exécution). Chaque instruction accessible pré-décodée en \c
+ * OP_FAULT est signalée, avec son adresse et l'erreur qu'elle provoquerait.
+ * Les instructions inaccessibles (remplissage par \c ILLOP après \c HALT,
+ * par exemple) ne sont pas signalées.
+ *
+ * \param pmach la machine dont le programme est pré-décodé
+ * \param out le fichier où écrire le rapport
+ * \return le nombre d'instructions erronées signalées
+ */
+unsigned verify_program(const Machine *pmach, FILE *out);
+
+#endif
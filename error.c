@@ -12,12 +12,64 @@ const char *error_names[] = {
     "Segmentation fault in text",
     "Segmentation fault in data",
     "Segmentation fault in stack",
+    "Bad program file",
+    "Division by zero",
 };
 
 const char *warning_names[] = {
     "HALT reached",
 };
 
+//! Point de récupération courant du processus léger (NULL si aucun)
+static __thread Error_Trap *current_trap = NULL;
+
+//! Installation d'un point de récupération
+/*!
+ * \param ptrap le point de récupération
+ */
+void error_trap(Error_Trap *ptrap){
+    ptrap->_err = ERR_NOERROR;
+    ptrap->_addr = 0;
+    ptrap->_detail = NULL;
+    ptrap->_prev = current_trap;
+    current_trap = ptrap;
+}
+
+//! Désinstallation d'un point de récupération
+/*!
+ * \param ptrap le point de récupération
+ */
+void error_untrap(Error_Trap *ptrap){
+    assert(current_trap == ptrap);
+    current_trap = ptrap->_prev;
+}
+
+//! Une erreur sera-t-elle rattrapée dans ce processus léger ?
+bool error_trapped(void){
+    return current_trap != NULL;
+}
+
+//! Les avertissements sont-ils tus dans ce processus léger ?
+bool error_silent(void){
+    return current_trap != NULL && current_trap->_silent;
+}
+
+//! Transmission d'une erreur au point de récupération courant
+/*!
+ * \param err code de l'erreur
+ * \param addr adresse de l'erreur
+ * \param detail précision sur l'erreur
+ */
+void error_raise(Error err, unsigned addr, const char *detail){
+    Error_Trap *ptrap = current_trap;
+    assert(ptrap != NULL);
+    ptrap->_err = err;
+    ptrap->_addr = addr;
+    ptrap->_detail = detail;
+    current_trap = ptrap->_prev;
+    longjmp(ptrap->_env, 1);
+}
+
 //! Affichage d'une erreur et fin du simulateur
 /*!
  * 
@@ -26,6 +78,8 @@ const char *warning_names[] = {
  */
 void error(Error err, unsigned addr){
     assert(err <= LAST_ERROR);
+    if (current_trap != NULL)
+        error_raise(err, addr, NULL);
     fprintf(stderr, "ERROR: %s at address 0x%x\n", error_names[err], addr);
     exit(1);
 }
@@ -37,5 +91,7 @@ void error(Error err, unsigned addr){
  */
 void warning(Warning warn, unsigned addr){
     assert(warn <= LAST_WARNING);
+    if (current_trap != NULL && current_trap->_silent)
+        return;
     fprintf(stderr, "WARNING: %s at address 0x%x\n", warning_names[warn], addr);
 }
@@ -2,6 +2,8 @@
 #define _ERROR_H_
 
 #include <stdlib.h>
+#include <stdbool.h>
+#include <setjmp.h>
 
 /*!
  * \file error.h
@@ -10,10 +12,10 @@
 
 //! Erreur d'exécution
 /*!
- * Ce sont les différentes sortes d'erreur rencontrées lors du décodage ou de
- * l'exécution des instructions. Elles sont toutes fatales et provoquent la
- * terminaison du programme (du programme simulé comme du simulateur lui-même
- * !).
+ * Ce sont les différentes sortes d'erreur rencontrées lors du chargement, du
+ * décodage ou de l'exécution des instructions. Elles sont toutes fatales et
+ * provoquent la terminaison du programme (du programme simulé comme du
+ * simulateur lui-même !), sauf si elles sont rattrapées (voir Error_Trap).
  */
 typedef enum 
 {
@@ -25,10 +27,15 @@ typedef enum
     ERR_SEGTEXT,	//!< Violation de taille du segment de texte
     ERR_SEGDATA,	//!< Violation de taille du segment de données
     ERR_SEGSTACK,	//!< Violation de taille du segment de pile
+    ERR_PROGFILE,	//!< Fichier de programme incorrect (au chargement)
+    ERR_DIVZERO,	//!< Division par zéro
 } Error; 
 
 //! Dernière valeur possible du code d'erreur
-static const unsigned LAST_ERROR = ERR_SEGSTACK;
+static const unsigned LAST_ERROR = ERR_DIVZERO;
+
+//! Libellés des codes d'erreur
+extern const char *error_names[];
 
 //! Codes d'avertissement
 /*!
@@ -43,11 +50,73 @@ typedef enum
 //! Dernière valeur possible du code d'avertissement
 static const unsigned LAST_WARNING = WARN_HALT;
 
+//! Point de récupération des erreurs
+/*!
+ * Lorsqu'un point de récupération est installé (par error_trap()) dans le
+ * processus léger courant, error() n'affiche rien et ne termine pas le
+ * simulateur : elle range le code et l'adresse de l'erreur dans le point de
+ * récupération et y reprend l'exécution (par \c longjmp). Chaque processus
+ * léger a son propre point de récupération ; plusieurs machines peuvent donc
+ * s'exécuter en parallèle sans qu'une erreur dans l'une arrête les autres.
+ *
+ * L'état de la machine fautive (compteur ordinal, registres) est celui que
+ * voit error() : c'est l'état affiché par le simulateur en mode ordinaire.
+ */
+typedef struct Error_Trap
+{
+    jmp_buf _env;		//!< Contexte de reprise
+    Error _err;			//!< Code de l'erreur rattrapée
+    unsigned _addr;		//!< Adresse de l'erreur
+    const char *_detail;	//!< Précision sur l'erreur (ou NULL)
+    bool _silent;		//!< Faut-il aussi taire les avertissements ?
+    struct Error_Trap *_prev;	//!< Point de récupération englobant
+} Error_Trap;
+
+//! Installation d'un point de récupération
+/*!
+ * Le contexte de reprise doit être établi par \c setjmp juste après
+ * l'installation, dans la fonction qui reste active pendant l'exécution
+ * protégée :
+ * \code
+ * Error_Trap trap = { ._silent = true };
+ * error_trap(&trap);
+ * if (setjmp(trap._env) != 0) {
+ *     // erreur : trap._err, trap._addr ; le point est déjà désinstallé
+ * } else {
+ *     ...
+ *     error_untrap(&trap);
+ * }
+ * \endcode
+ *
+ * \param ptrap le point de récupération
+ */
+void error_trap(Error_Trap *ptrap);
+
+//! Désinstallation d'un point de récupération
+/*!
+ * Le point de récupération englobant, s'il existe, redevient actif.
+ *
+ * \param ptrap le point de récupération (le plus récemment installé)
+ */
+void error_untrap(Error_Trap *ptrap);
+
+//! Une erreur sera-t-elle rattrapée dans ce processus léger ?
+bool error_trapped(void);
+
+//! Les avertissements sont-ils tus dans ce processus léger ?
+/*!
+ * Un point de récupération installé seulement pour libérer des ressources
+ * avant de retransmettre l'erreur doit hériter de cette valeur.
+ */
+bool error_silent(void);
+
 //! Affichage d'une erreur et fin du simulateur
 /*!
- * \note Toutes les erreurs étant fatales on ne revient jamais de cette
- * fonction. L'attribut \a noreturn est une extension (non standard) de GNU C
- * qui indique ce fait.
+ * Si un point de récupération est installé, l'erreur y est transmise au lieu
+ * d'être affichée (voir Error_Trap).
+ *
+ * \note On ne revient jamais de cette fonction. L'attribut \a noreturn est
+ * une extension (non standard) de GNU C qui indique ce fait.
  * 
  * \param err code de l'erreur
  * \param addr adresse de l'erreur
@@ -58,9 +127,26 @@ void error(Error err, unsigned addr) __attribute__((noreturn));
 void error(Error err, unsigned addr);
 #endif
 
+//! Transmission d'une erreur au point de récupération courant
+/*!
+ * Comme error() avec une précision supplémentaire, mais réservée au cas où
+ * error_trapped() est vrai.
+ *
+ * \param err code de l'erreur
+ * \param addr adresse de l'erreur
+ * \param detail précision sur l'erreur (chaîne statique)
+ */
+#ifdef __GNUC__
+void error_raise(Error err, unsigned addr, const char *detail) __attribute__((noreturn));
+#else
+void error_raise(Error err, unsigned addr, const char *detail);
+#endif
+
 
 //! Affichage d'un avertissement
 /*!
+ * Rien n'est affiché si le point de récupération courant le demande.
+ *
  * \param warn code de l'avertissement
  * \param addr adresse de l'erreur
  */
@@ -1,9 +1,20 @@
 #include <stdio.h>
 #include <stdbool.h>
+#include <stdint.h>
 #include <assert.h>
+#include <stdatomic.h>
+#include <string.h>
 #include "machine.h"
 #include "instruction.h"
 #include "error.h"
+#include "decode.h"
+#include "tracebuf.h"
+#include "debug.h"
+#include "exec.h"
+#include "profile.h"
+#include "cache.h"
+#include "timing.h"
+#include "guard.h"
 
 
 //! Recupere l'adresse cible de l'instruction
@@ -23,20 +34,126 @@ unsigned int operand_address(Machine *pmach, Instruction instr) {
 }
 
 
-//! Mets a jour le flag CC de la machine apres un LOAD, ADD ou SUB
+//! Mets a jour le flag CC de la machine avant un LOAD, ADD ou SUB
 /*!
+ * Les indicateurs ne sont pas calculés ici : on conserve les opérandes de
+ * l'opération, et check_condition() les évalue à la demande.
+ *
  * \param pmach la machine/programme en cours d'exécution
- * \param reg le registre modifié par l'instruction
+ * \param source l'opération (un LOAD est une addition à 0)
+ * \param first le premier opérande (la valeur du registre)
+ * \param second le second opérande
  */
-void set_cc(Machine *pmach, unsigned int reg) {
-	if (pmach->_registers[reg] > 0)
-		pmach->_cc = CC_P;
-	else if (pmach->_registers[reg] < 0)
-		pmach->_cc = CC_N;
+void set_cc(Machine *pmach, Flags_Source source, Word first, Word second) {
+	pmach->_cc = (Flags) { first, second, source };
+}
+
+
+//! Quotient de la division signée (diviseur non nul)
+/*!
+ * Le seul cas de débordement, le plus petit entier divisé par -1, donne
+ * (comme la multiplication) le résultat modulo 2^32.
+ *
+ * \param a le dividende
+ * \param b le diviseur
+ */
+static inline Word word_div(Word a, Word b) {
+	if (b == (Word) -1)
+		return -a;
+	return (Word) ((int32_t) a / (int32_t) b);
+}
+
+//! Reste de la division signée (diviseur non nul), du signe du dividende
+/*!
+ * \param a le dividende
+ * \param b le diviseur
+ */
+static inline Word word_mod(Word a, Word b) {
+	if (b == (Word) -1)
+		return 0;
+	return (Word) ((int32_t) a % (int32_t) b);
+}
+
+//! La plage [addr, addr + n[ est-elle dans le segment de données ?
+/*!
+ * \param addr le début de la plage
+ * \param n le nombre de mots
+ * \param datasize la taille du segment
+ */
+static inline bool block_inside(Word addr, Word n, unsigned datasize) {
+	return n <= datasize && addr <= datasize - n;
+}
+
+//! Remplissage d'une plage de mots
+/*!
+ * Une valeur dont les quatre octets sont égaux (0 et -1 notamment) est
+ * rangée par \c memset ; sinon la boucle est vectorisée par le compilateur.
+ *
+ * \param p la plage
+ * \param value la valeur
+ * \param n le nombre de mots
+ */
+static void block_fill(Word *p, Word value, Word n) {
+	if (value == (value & 0xff) * 0x01010101u)
+		memset(p, value & 0xff, n * sizeof(Word));
 	else
-		pmach->_cc = CC_Z;
+		for (Word i = 0; i < n; ++i)
+			p[i] = value;
+}
+
+//! Premier mot différent de deux plages
+/*!
+ * Les plages sont comparées par \c memcmp, par tranches : seule la tranche
+ * qui contient la première différence est parcourue mot à mot.
+ *
+ * \param a la première plage
+ * \param b la seconde
+ * \param n le nombre de mots
+ * \return l'indice du premier mot différent, ou \c n si les plages sont égales
+ */
+static Word block_mismatch(const Word *a, const Word *b, Word n) {
+	const Word slice = 64;
+	Word i = 0;
+	while (i < n) {
+		Word len = n - i < slice ? n - i : slice;
+		if (memcmp(a + i, b + i, len * sizeof(Word)) != 0)
+			break;
+		i += len;
+	}
+	while (i < n && a[i] == b[i])
+		++i;
+	return i;
 }
 
+//! Code condition d'une comparaison de plages
+/*!
+ * Celui de la soustraction des premiers mots différents (nul si les plages
+ * sont égales) : les conditions signées et non signées donnent l'ordre
+ * lexicographique des plages.
+ *
+ * \param a la première plage
+ * \param b la seconde
+ * \param i l'indice du premier mot différent, ou le nombre de mots
+ * \param n le nombre de mots
+ */
+static inline Flags block_flags(const Word *a, const Word *b, Word i, Word n) {
+	if (i == n)
+		return (Flags) { 0, 0, FLAGS_SUB };
+	return (Flags) { a[i], b[i], FLAGS_SUB };
+}
+
+//! Rangement du résultat d'une instruction de calcul
+/*!
+ * Le code condition est celui du chargement du résultat.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param reg le registre destination
+ * \param result le résultat
+ */
+static void set_result(Machine *pmach, unsigned reg, Word result) {
+	set_cc(pmach, FLAGS_ADD, 0, result);
+	pmach->_registers[reg] = result;
+}
 
 //! Test de la condition pour les instructions BRANCH et CALL
 /*!
@@ -44,27 +161,11 @@ void set_cc(Machine *pmach, unsigned int reg) {
  * \param cond Condition a tester
  */
 bool check_condition(Machine *pmach, Condition cond) {
-	switch (cond) {
-	case NC:
-		return true;
-	case EQ:
-		return pmach->_cc == CC_Z;
-	case NE:
-		return pmach->_cc != CC_Z;
-	case GT:
-		return pmach->_cc == CC_P;
-	case GE:
-		return (pmach->_cc == CC_Z || pmach->_cc == CC_P);
-	case LT:
-		return pmach->_cc == CC_N;
-	case LE:
-		return (pmach->_cc == CC_Z || pmach->_cc == CC_N);
-	default:
-		assert(0);
-	}
+	assert(cond <= LAST_CONDITION);
+	return (condition_masks[cond] >> flags_of(pmach->_cc)) & 1;
 }
 
-//! Décodage et exécution des instructions de manipulation de registre et de pile
+//! Décodage et exécution des instructions de calcul, de manipulation de registre et de pile
 /*!
  * \param pmach la machine/programme en cours d'exécution
  * \param instr l'instruction à exécuter
@@ -80,7 +181,12 @@ void exec_transfer(Machine *pmach, Instruction instr) {
 		&& instr.instr_generic._immediate)
 		error(ERR_IMMEDIATE, oldpc);
 	
-	if (instr.instr_generic._immediate) {
+	if (instr.instr_generic._immediate && instr.instr_generic._indexed) {
+		if (!cop_has_register_form(instr.instr_generic._cop))
+			error(ERR_IMMEDIATE, oldpc);
+		value = pmach->_registers[instr.instr_indexed._rindex];
+	}
+	else if (instr.instr_generic._immediate) {
 		value = instr.instr_immediate._value;
 	}
 	else {
@@ -92,24 +198,60 @@ void exec_transfer(Machine *pmach, Instruction instr) {
 	
 	switch (instr.instr_generic._cop) {
 	case LOAD:
+		set_cc(pmach, FLAGS_ADD, 0, value);
 		pmach->_registers[reg] = value;
-		set_cc(pmach, reg);
 		break;
 	case STORE:
 		pmach->_data[op_address] = pmach->_registers[reg];
 		break;
 	case ADD:
+		set_cc(pmach, FLAGS_ADD, pmach->_registers[reg], value);
 		pmach->_registers[reg] += value;
-		set_cc(pmach, reg);
 		break;
 	case SUB:
+		set_cc(pmach, FLAGS_SUB, pmach->_registers[reg], value);
 		pmach->_registers[reg] -= value;
-		set_cc(pmach, reg);
+		break;
+	case MUL:
+		set_result(pmach, reg, pmach->_registers[reg] * (Word) value);
+		break;
+	case DIV:
+	case MOD:
+		if (value == 0)
+			error(ERR_DIVZERO, oldpc);
+		set_result(pmach, reg, instr.instr_generic._cop == DIV
+			   ? word_div(pmach->_registers[reg], value)
+			   : word_mod(pmach->_registers[reg], value));
+		break;
+	case AND:
+		set_result(pmach, reg, pmach->_registers[reg] & value);
+		break;
+	case OR:
+		set_result(pmach, reg, pmach->_registers[reg] | value);
+		break;
+	case XOR:
+		set_result(pmach, reg, pmach->_registers[reg] ^ value);
+		break;
+	case SHL:
+		set_result(pmach, reg, pmach->_registers[reg] << (value & 31));
+		break;
+	case SHR:
+		set_result(pmach, reg, pmach->_registers[reg] >> (value & 31));
+		break;
+	case SAR:
+		set_result(pmach, reg, (Word) ((int32_t) pmach->_registers[reg] >> (value & 31)));
+		break;
+	case CMP:
+		set_cc(pmach, FLAGS_SUB, pmach->_registers[reg], value);
 		break;
 	case PUSH:
+		if (pmach->_sp >= pmach->_datasize)
+			error(ERR_SEGSTACK, oldpc);
 		pmach->_data[pmach->_sp--] = value;
 		break;
 	case POP:
+		if ((Word) (pmach->_sp + 1) >= pmach->_datasize)
+			error(ERR_SEGSTACK, oldpc);
 		pmach->_data[op_address] = pmach->_data[++pmach->_sp];
 		break;
 	default:
@@ -117,6 +259,90 @@ void exec_transfer(Machine *pmach, Instruction instr) {
 	}
 }
 
+//! Exécution des instructions sur des plages de données
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param instr l'instruction à exécuter
+ */
+void exec_block(Machine *pmach, Instruction instr) {
+	unsigned int oldpc = pmach->_pc - 1;
+	Word *data = pmach->_data;
+	Word dst = pmach->_registers[instr.instr_generic._regcond];
+	Word src = pmach->_registers[instr.instr_indexed._rindex];
+	Word n = pmach->_registers[instr.instr_indexed._offset & (NREGISTERS - 1)];
+
+	if (!block_inside(dst, n, pmach->_datasize))
+		error(ERR_SEGDATA, oldpc);
+	switch (instr.instr_generic._cop) {
+	case BCOPY:
+		if (!block_inside(src, n, pmach->_datasize))
+			error(ERR_SEGDATA, oldpc);
+		memmove(&data[dst], &data[src], n * sizeof(Word));
+		break;
+	case BFILL:
+		block_fill(&data[dst], src, n);
+		break;
+	case BCMP:
+		if (!block_inside(src, n, pmach->_datasize))
+			error(ERR_SEGDATA, oldpc);
+		pmach->_cc = block_flags(&data[dst], &data[src],
+					 block_mismatch(&data[dst], &data[src], n), n);
+		break;
+	default:
+		assert(0);
+	}
+}
+
+//! Mot de données vu comme un objet atomique
+/*!
+ * Le segment de données est partagé par les processeurs d'une configuration
+ * multiprocesseur (voir smp.h) : les opérations atomiques y accèdent par les
+ * opérations de \c stdatomic.h, un \c Word ayant la taille et l'alignement
+ * d'un \c atomic_uint.
+ *
+ * \param p l'adresse du mot
+ */
+static inline _Atomic Word *atomic_word(Word *p) {
+	return (_Atomic Word *) p;
+}
+
+//! Exécution des instructions atomiques
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param instr l'instruction à exécuter
+ */
+void exec_atomic(Machine *pmach, Instruction instr) {
+	unsigned int oldpc = pmach->_pc - 1;
+	unsigned reg = instr.instr_generic._regcond;
+	Word *regs = pmach->_registers;
+
+	if (instr.instr_generic._cop == FENCE) {
+		atomic_thread_fence(memory_order_seq_cst);
+		return;
+	}
+	if (instr.instr_generic._immediate)
+		error(ERR_IMMEDIATE, oldpc);
+	unsigned int op_address = operand_address(pmach, instr);
+	if (op_address >= pmach->_datasize)
+		error(ERR_SEGDATA, oldpc);
+
+	Word value = regs[reg], old = value;
+	switch (instr.instr_generic._cop) {
+	case CAS:
+		atomic_compare_exchange_strong(atomic_word(&pmach->_data[op_address]), &old,
+					       regs[(reg + 1) % NREGISTERS]);
+		set_cc(pmach, FLAGS_SUB, old, value);
+		break;
+	case XADD:
+		old = atomic_fetch_add(atomic_word(&pmach->_data[op_address]), value);
+		set_cc(pmach, FLAGS_ADD, old, value);
+		break;
+	default:
+		assert(0);
+	}
+	regs[reg] = old;
+}
+
 //! Décodage et exécution des instructions BRANCH, CALL et RET
 /*!
  * \param pmach la machine/programme en cours d'exécution
@@ -137,11 +363,16 @@ void exec_branch(Machine *pmach, Instruction instr) {
 			error(ERR_CONDITION, oldpc);
 
 		if (check_condition(pmach, cond)) {
-			if (instr.instr_generic._cop == CALL)
+			if (instr.instr_generic._cop == CALL) {
+				if (pmach->_sp >= pmach->_datasize)
+					error(ERR_SEGSTACK, oldpc);
 				pmach->_data[pmach->_sp--] = pmach->_pc;
+			}
 			pmach->_pc = operand_address(pmach, instr);
 		}
 	} else if (instr.instr_generic._cop == RET) {
+		if ((Word) (pmach->_sp + 1) >= pmach->_datasize)
+			error(ERR_SEGSTACK, oldpc);
 		pmach->_pc = pmach->_data[++pmach->_sp];
 	} else {
 		assert(0);
@@ -170,8 +401,28 @@ bool decode_execute(Machine *pmach, Instruction instr) {
 	case SUB:
 	case PUSH:
 	case POP:
+	case MUL:
+	case DIV:
+	case MOD:
+	case AND:
+	case OR:
+	case XOR:
+	case SHL:
+	case SHR:
+	case SAR:
+	case CMP:
 		exec_transfer(pmach, instr);
 		break;
+	case BCOPY:
+	case BFILL:
+	case BCMP:
+		exec_block(pmach, instr);
+		break;
+	case CAS:
+	case XADD:
+	case FENCE:
+		exec_atomic(pmach, instr);
+		break;
 	case BRANCH:
 	case CALL:
 	case RET:
@@ -198,3 +449,198 @@ void trace(const char *msg, Machine *pmach, Instruction instr, unsigned addr){
 	putchar('\n');
 }
 
+//! Accès d'une instruction profilée au modèle de cache
+/*!
+ * Les cycles d'attente sont reportés au modèle de temps, s'il y en a un.
+ *
+ * \param pprof le profil (avec un modèle de cache)
+ * \param pc l'adresse de l'instruction
+ * \param addr l'adresse de la donnée
+ * \param write écriture (sinon lecture) ?
+ */
+static inline void profile_cache(Profile *pprof, unsigned pc, Word addr, bool write) {
+	unsigned stall = cache_access(pprof->_cache, pc, addr, write);
+	if (pprof->_timing != NULL)
+		timing_stall(pprof->_timing, stall);
+}
+
+
+// Variantes de la boucle d'exécution (voir exec_loop.h)
+
+#define ENGINE_NAME run_t0_d0_s0
+#define ENGINE_TRACE TRACE_NONE
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t0_d0_s1
+#define ENGINE_TRACE TRACE_NONE
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t0_d0_s2
+#define ENGINE_TRACE TRACE_NONE
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t0_d1_s0
+#define ENGINE_TRACE TRACE_NONE
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t0_d1_s1
+#define ENGINE_TRACE TRACE_NONE
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t0_d1_s2
+#define ENGINE_TRACE TRACE_NONE
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t1_d0_s0
+#define ENGINE_TRACE TRACE_JUMPS
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t1_d0_s1
+#define ENGINE_TRACE TRACE_JUMPS
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t1_d0_s2
+#define ENGINE_TRACE TRACE_JUMPS
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t1_d1_s0
+#define ENGINE_TRACE TRACE_JUMPS
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t1_d1_s1
+#define ENGINE_TRACE TRACE_JUMPS
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t1_d1_s2
+#define ENGINE_TRACE TRACE_JUMPS
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t2_d0_s0
+#define ENGINE_TRACE TRACE_ALL
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t2_d0_s1
+#define ENGINE_TRACE TRACE_ALL
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t2_d0_s2
+#define ENGINE_TRACE TRACE_ALL
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t2_d1_s0
+#define ENGINE_TRACE TRACE_ALL
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t2_d1_s1
+#define ENGINE_TRACE TRACE_ALL
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t2_d1_s2
+#define ENGINE_TRACE TRACE_ALL
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t3_d0_s0
+#define ENGINE_TRACE TRACE_BINARY
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t3_d0_s1
+#define ENGINE_TRACE TRACE_BINARY
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t3_d0_s2
+#define ENGINE_TRACE TRACE_BINARY
+#define ENGINE_DEBUG 0
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t3_d1_s0
+#define ENGINE_TRACE TRACE_BINARY
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 0
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t3_d1_s1
+#define ENGINE_TRACE TRACE_BINARY
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 1
+#include "exec_loop.h"
+
+#define ENGINE_NAME run_t3_d1_s2
+#define ENGINE_TRACE TRACE_BINARY
+#define ENGINE_DEBUG 1
+#define ENGINE_STATS 2
+#include "exec_loop.h"
+
+//! Table des variantes, indexée par [trace][debug][stats] (stats : 0 aucune,
+//! 1 compteurs, 2 profil)
+static bool (*const engines[][2][3])(Machine *, Stats *) = {
+	[TRACE_NONE] = {
+		{ run_t0_d0_s0, run_t0_d0_s1, run_t0_d0_s2 },
+		{ run_t0_d1_s0, run_t0_d1_s1, run_t0_d1_s2 } },
+	[TRACE_JUMPS] = {
+		{ run_t1_d0_s0, run_t1_d0_s1, run_t1_d0_s2 },
+		{ run_t1_d1_s0, run_t1_d1_s1, run_t1_d1_s2 } },
+	[TRACE_ALL] = {
+		{ run_t2_d0_s0, run_t2_d0_s1, run_t2_d0_s2 },
+		{ run_t2_d1_s0, run_t2_d1_s1, run_t2_d1_s2 } },
+	[TRACE_BINARY] = {
+		{ run_t3_d0_s0, run_t3_d0_s1, run_t3_d0_s2 },
+		{ run_t3_d1_s0, run_t3_d1_s1, run_t3_d1_s2 } },
+};
+
+//! Exécution du programme pré-décodé
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ * \param trace niveau de trace
+ * \param debug mode de mise au point (pas à pas) ?
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ */
+void exec_threaded(Machine *pmach, Trace_Level trace, bool debug, Stats *pstats) {
+	assert(trace <= TRACE_BINARY);
+	unsigned stats = pstats == NULL ? 0 : pstats->_profile == NULL ? 1 : 2;
+	if (debug && pmach->_debugger == NULL)
+		debug = (pmach->_debugger = debug_new(pmach)) != NULL;
+	while (!engines[trace][debug][stats](pmach, pstats))
+		debug = false;
+	guard_leave();
+}
@@ -16,6 +16,26 @@
  */
 bool decode_execute(Machine *pmach, Instruction instr);
 
+//! Exécution du programme pré-décodé
+/*!
+ * Le programme est exécuté à partir de l'instruction pointée par \c _pc
+ * jusqu'à \c HALT, en utilisant le segment de texte pré-décodé par
+ * decode_program() et un dispatch direct (<em>direct threading</em>) entre
+ * les traitements des instructions.
+ *
+ * La boucle d'exécution existe en plusieurs variantes engendrées à la
+ * compilation (voir exec_loop.h), une par combinaison des paramètres : les
+ * fonctionnalités inutilisées ne coûtent rien. Si l'utilisateur quitte le
+ * mode de mise au point, l'exécution se poursuit dans la variante
+ * correspondante sans mise au point.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param trace niveau de trace
+ * \param debug mode de mise au point (pas à pas) ?
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ */
+void exec_threaded(Machine *pmach, Trace_Level trace, bool debug, Stats *pstats);
+
 //! Trace de l'exécution
 /*!
  * On écrit l'adresse et l'instruction sous forme lisible.
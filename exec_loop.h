@@ -0,0 +1,803 @@
+/*!
+ * \file exec_loop.h
+ * \brief Modèle de la boucle d'exécution du programme pré-décodé.
+ *
+ * Ce fichier n'est pas un entête ordinaire : il est inclus plusieurs fois par
+ * exec.c, une fois par variante de la boucle d'exécution. Avant chaque
+ * inclusion on définit
+ *
+ *   - \c ENGINE_NAME : le nom de la fonction produite ;
+ *   - \c ENGINE_TRACE : le niveau de trace (voir Trace_Level) ; la trace
+ *   binaire (\c TRACE_BINARY) est écrite dans le tampon \c _tracebuf de la
+ *   machine ;
+ *   - \c ENGINE_DEBUG : 1 pour le mode de mise au point, 0 sinon ; en mise
+ *   au point, DEBUG_STOP() est évaluée après chaque instruction et
+ *   debug_ask() n'est appelée que s'il le demande ; les accès aux données
+ *   consultent de plus les points d'observation, et chaque instruction est
+ *   inscrite dans le journal d'annulation (voir debug.h) ;
+ *   - \c ENGINE_STATS : 1 pour compter les instructions exécutées, 2 pour
+ *   tenir de plus le profil détaillé de \c pstats->_profile (voir profile.h),
+ *   0 sinon.
+ *
+ * Ces paramètres étant des constantes, les fonctionnalités inutilisées par une
+ * variante disparaissent à la compilation et ne coûtent aucune instruction.
+ *
+ * Chaque traitement se termine par un saut direct (goto calculé) vers le
+ * traitement de l'instruction suivante : il n'y a ni boucle centrale ni
+ * décodage. Le compteur ordinal est représenté par le pointeur \c ip dans le
+ * texte pré-décodé et le code condition par une variable locale ; ils ne sont
+ * recopiés dans la machine qu'en cas de besoin (erreur, mise au point, sortie).
+ *
+ * La fonction produite a pour prototype
+ * \code
+ * static bool ENGINE_NAME(Machine *pmach, Stats *pstats);
+ * \endcode
+ * Elle rend vrai après l'exécution de \c HALT, et faux si l'utilisateur a
+ * quitté le mode de mise au point : l'exécution doit alors se poursuivre avec
+ * la variante sans mise au point. Lorsque debug_ask() a ramené la machine en
+ * arrière, l'exécution reprend à la nouvelle valeur du compteur ordinal, y
+ * compris au milieu d'une super-instruction ou après \c HALT.
+ */
+
+static bool ENGINE_NAME(Machine *pmach, Stats *pstats) {
+	static const void *const handlers[NOPKINDS] = {
+		[OP_FAULT] = &&op_fault,
+		[OP_NOP] = &&op_nop,
+		[OP_LOAD_I] = &&op_load_i,
+		[OP_LOAD_A] = &&op_load_a,
+		[OP_LOAD_X] = &&op_load_x,
+		[OP_STORE_A] = &&op_store_a,
+		[OP_STORE_X] = &&op_store_x,
+		[OP_ADD_I] = &&op_add_i,
+		[OP_ADD_A] = &&op_add_a,
+		[OP_ADD_X] = &&op_add_x,
+		[OP_SUB_I] = &&op_sub_i,
+		[OP_SUB_A] = &&op_sub_a,
+		[OP_SUB_X] = &&op_sub_x,
+		[OP_PUSH_I] = &&op_push_i,
+		[OP_PUSH_A] = &&op_push_a,
+		[OP_PUSH_X] = &&op_push_x,
+		[OP_POP_A] = &&op_pop_a,
+		[OP_POP_X] = &&op_pop_x,
+		[OP_BRANCH_A] = &&op_branch_a,
+		[OP_BRANCH_X] = &&op_branch_x,
+		[OP_CALL_A] = &&op_call_a,
+		[OP_CALL_X] = &&op_call_x,
+		[OP_RET] = &&op_ret,
+		[OP_HALT] = &&op_halt,
+		[OP_LOAD_R] = &&op_load_r,
+		[OP_ADD_R] = &&op_add_r,
+		[OP_SUB_R] = &&op_sub_r,
+		[OP_MUL_I] = &&op_mul_i,
+		[OP_MUL_A] = &&op_mul_a,
+		[OP_MUL_X] = &&op_mul_x,
+		[OP_MUL_R] = &&op_mul_r,
+		[OP_DIV_I] = &&op_div_i,
+		[OP_DIV_A] = &&op_div_a,
+		[OP_DIV_X] = &&op_div_x,
+		[OP_DIV_R] = &&op_div_r,
+		[OP_MOD_I] = &&op_mod_i,
+		[OP_MOD_A] = &&op_mod_a,
+		[OP_MOD_X] = &&op_mod_x,
+		[OP_MOD_R] = &&op_mod_r,
+		[OP_AND_I] = &&op_and_i,
+		[OP_AND_A] = &&op_and_a,
+		[OP_AND_X] = &&op_and_x,
+		[OP_AND_R] = &&op_and_r,
+		[OP_OR_I] = &&op_or_i,
+		[OP_OR_A] = &&op_or_a,
+		[OP_OR_X] = &&op_or_x,
+		[OP_OR_R] = &&op_or_r,
+		[OP_XOR_I] = &&op_xor_i,
+		[OP_XOR_A] = &&op_xor_a,
+		[OP_XOR_X] = &&op_xor_x,
+		[OP_XOR_R] = &&op_xor_r,
+		[OP_SHL_I] = &&op_shl_i,
+		[OP_SHL_A] = &&op_shl_a,
+		[OP_SHL_X] = &&op_shl_x,
+		[OP_SHL_R] = &&op_shl_r,
+		[OP_SHR_I] = &&op_shr_i,
+		[OP_SHR_A] = &&op_shr_a,
+		[OP_SHR_X] = &&op_shr_x,
+		[OP_SHR_R] = &&op_shr_r,
+		[OP_SAR_I] = &&op_sar_i,
+		[OP_SAR_A] = &&op_sar_a,
+		[OP_SAR_X] = &&op_sar_x,
+		[OP_SAR_R] = &&op_sar_r,
+		[OP_CMP_I] = &&op_cmp_i,
+		[OP_CMP_A] = &&op_cmp_a,
+		[OP_CMP_X] = &&op_cmp_x,
+		[OP_CMP_R] = &&op_cmp_r,
+		[OP_BCOPY] = &&op_bcopy,
+		[OP_BFILL] = &&op_bfill,
+		[OP_BCMP] = &&op_bcmp,
+		[OP_CAS_A] = &&op_cas_a,
+		[OP_CAS_X] = &&op_cas_x,
+		[OP_XADD_A] = &&op_xadd_a,
+		[OP_XADD_X] = &&op_xadd_x,
+		[OP_FENCE] = &&op_fence,
+		[OP_ADD_I_BRANCH_A] = &&op_add_i_branch_a,
+		[OP_SUB_I_BRANCH_A] = &&op_sub_i_branch_a,
+		[OP_PUSH_PUSH_CALL_A] = &&op_push_push_call_a,
+	};
+
+	const unsigned textsize = pmach->_textsize;
+	const unsigned datasize = pmach->_datasize;
+	const bool guarded = pmach->_guarded;
+	Decoded *const base = pmach->_decoded;
+	Word *const data = pmach->_data;
+	Word *const regs = pmach->_registers;
+
+	// Le texte pré-décodé référence les traitements de cette fonction
+	if (pmach->_dispatch != handlers) {
+		for (unsigned i = 0; i <= textsize; ++i)
+			base[i]._handler = handlers[base[i]._kind];
+		pmach->_dispatch = handlers;
+	}
+
+	if (pmach->_pc > textsize)
+		error(ERR_SEGTEXT, pmach->_pc);
+
+	Decoded *ip = base + pmach->_pc;
+	Flags cc = pmach->_cc;
+	unsigned addr;
+	uint64_t ninstr = 0;
+	uint64_t njumps = 0;
+	Trace_Buffer *const ptb = pmach->_tracebuf;
+	Trace_Record *prec = NULL;
+	Profile *const pprof = ENGINE_STATS == 2 ? pstats->_profile : NULL;
+	Debugger *const pdbg = ENGINE_DEBUG ? pmach->_debugger : NULL;
+	Undo_Entry *pundo = NULL;
+	// Exécution limitée (voir simul_step()), hors mise au point
+	const bool limited = ENGINE_STATS && !ENGINE_DEBUG && pstats->_limit != 0;
+	const uint64_t limit = limited ? pstats->_limit : UINT64_MAX;
+	const uint64_t *const pbreak = limited && pmach->_debugger != NULL
+		&& pmach->_debugger->_nbreakpoints != 0 ? pmach->_debugger->_breakpoints : NULL;
+
+	(void) pstats;
+	(void) ninstr;
+	(void) njumps;
+	(void) ptb;
+	(void) prec;
+	(void) pprof;
+	(void) pdbg;
+	(void) pundo;
+	(void) limit;
+	(void) pbreak;
+	assert(ENGINE_TRACE != TRACE_BINARY || ptb != NULL);
+	guard_enter(pmach, pstats, ENGINE_STATS ? &ninstr : NULL,
+		    ENGINE_STATS ? &njumps : NULL);
+
+#define SP	regs[NREGISTERS - 1]
+#define PC()	((unsigned) (ip - base))
+#define SYNC()	do { pmach->_pc = PC(); pmach->_cc = cc; } while (0)
+#define LEAVE(halted)							\
+	do {								\
+		SYNC();							\
+		if (ENGINE_STATS) {					\
+			pstats->_instructions += ninstr;		\
+			pstats->_jumps += njumps;			\
+		}							\
+		return (halted);					\
+	} while (0)
+	// Arrêt d'une exécution limitée, avant l'instruction courante
+#define STOP(status)							\
+	do {								\
+		pstats->_stop = (status);				\
+		LEAVE(true);						\
+	} while (0)
+#define FAULT(err, a)							\
+	do {								\
+		SYNC();							\
+		if (ENGINE_DEBUG) {					\
+			bool stay_ = debug_fault(pmach, (err), (a));	\
+			if (pdbg->_moved)				\
+				RESUME(stay_);				\
+		}							\
+		if (ENGINE_STATS) {					\
+			pstats->_instructions += ninstr;		\
+			pstats->_jumps += njumps;			\
+		}							\
+		if (ENGINE_TRACE == TRACE_BINARY)			\
+			tracebuf_flush(ptb);				\
+		error((err), (a));					\
+	} while (0)
+
+	// Reprise après un retour en arrière de la mise au point (stay : faut-il
+	// rester en mode de mise au point ?)
+#define RESUME(stay)							\
+	do {								\
+		pdbg->_moved = false;					\
+		ip = base + pmach->_pc;					\
+		cc = pmach->_cc;					\
+		if (!(stay))						\
+			LEAVE(false);					\
+		BEFORE();						\
+		goto *ip->_handler;					\
+	} while (0)
+	// Point d'observation après chaque instruction
+#define AFTER()								\
+	do {								\
+		if (ENGINE_DEBUG && DEBUG_STOP(pdbg, PC())) {		\
+			SYNC();						\
+			bool stay_ = debug_ask(pmach);			\
+			if (pdbg->_moved)				\
+				RESUME(stay_);				\
+			if (!stay_)					\
+				LEAVE(false);				\
+		}							\
+	} while (0)
+	// Point d'observation avant chaque instruction
+#define BEFORE()							\
+	do {								\
+		if (ENGINE_STATS) {					\
+			if (ninstr == limit)				\
+				STOP(SIMUL_BUDGET);			\
+			if (pbreak != NULL && ninstr != 0		\
+			    && (pbreak[PC() / 64] >> (PC() % 64) & 1))	\
+				STOP(SIMUL_BREAKPOINT);			\
+			++ninstr;					\
+		}							\
+		if (ENGINE_STATS == 2) {				\
+			++pprof->_counts[PC()];				\
+			if (pprof->_timing != NULL)			\
+				timing_step(pprof->_timing, PC());	\
+		}							\
+		if (ENGINE_DEBUG) {					\
+			if (pdbg->_icount % UNDO_CHUNK == 0) {		\
+				SYNC();					\
+				debug_chunk(pmach);			\
+			}						\
+			pundo = &pdbg->_chunk[pdbg->_icount++ % UNDO_CHUNK]; \
+			pundo->_pc = PC();				\
+			pundo->_cc = cc;				\
+			pundo->_reg = UNDO_NOREG;			\
+			pundo->_addr = UNDO_NOADDR;			\
+		}							\
+		if (ENGINE_TRACE == TRACE_ALL && PC() < textsize)	\
+			trace("Executing", pmach, pmach->_text[PC()], PC()); \
+		if (ENGINE_TRACE == TRACE_BINARY && PC() < textsize) {	\
+			prec = tracebuf_reserve(ptb);			\
+			prec->_pc = PC();				\
+			prec->_raw = pmach->_text[PC()]._raw;		\
+			prec->_reg = TRACE_NOREG;			\
+			prec->_address = TRACE_NOADDR;			\
+		}							\
+	} while (0)
+	// Anciennes valeurs dans le journal d'annulation
+#define UNDO_REG(r)							\
+	do {								\
+		if (ENGINE_DEBUG) {					\
+			pundo->_reg = (r);				\
+			pundo->_regold = regs[r];			\
+		}							\
+	} while (0)
+#define UNDO_MEM(a)							\
+	do {								\
+		if (ENGINE_DEBUG) {					\
+			pundo->_addr = (a);				\
+			pundo->_memold = data[a];			\
+		}							\
+	} while (0)
+	// Enregistrement des effets de l'instruction dans la trace binaire
+#define TRACE_REG(r)							\
+	do {								\
+		if (ENGINE_TRACE == TRACE_BINARY) {			\
+			prec->_reg = (r);				\
+			prec->_regvalue = regs[r];			\
+		}							\
+	} while (0)
+#define TRACE_MEM(a)							\
+	do {								\
+		if (ENGINE_TRACE == TRACE_BINARY) {			\
+			prec->_address = (a);				\
+			prec->_memvalue = data[a];			\
+		}							\
+	} while (0)
+	// Points d'observation des données, en mise au point seulement
+#define WATCHED(a)							\
+	(ENGINE_DEBUG && pdbg->_watch != NULL && (a) < datasize && pdbg->_watch[a] != 0)
+#define WATCH(kind, a, old, new)					\
+	debug_watch(pdbg, (kind), PC(), (a), (old), (new))
+	// Profil des accès aux données (les adresses de pile ne sont pas
+	// vérifiées par la boucle d'exécution), et modèle de cache éventuel
+#define CACHE(a, write)							\
+	(pprof->_cache != NULL && (profile_cache(pprof, PC(), (a), (write)), 1))
+#define READ(a)								\
+	((void) (ENGINE_STATS == 2 && (a) < datasize				\
+		 && (++pprof->_reads[a], CACHE((a), false), 1)),		\
+	 (void) (WATCHED(a) && (WATCH(WATCH_READ, (a), data[a], data[a]), 1)),	\
+	 data[a])
+#define PROFILE_WRITE(a)						\
+	do {								\
+		if (ENGINE_STATS == 2 && (a) < datasize) {		\
+			++pprof->_writes[a];				\
+			(void) CACHE((a), true);			\
+		}							\
+	} while (0)
+	// Profondeur d'appel, pour l'arrêt au retour d'une fonction
+#define DEPTH(n)							\
+	do {								\
+		if (ENGINE_DEBUG)					\
+			pdbg->_depth += (n);				\
+	} while (0)
+	// Profil des branchements pris
+#define PROFILE_TAKEN()							\
+	do {								\
+		if (ENGINE_STATS == 2) {				\
+			++pprof->_taken[PC()];				\
+			if (pprof->_timing != NULL)			\
+				timing_taken(pprof->_timing);		\
+		}							\
+	} while (0)
+	// Point d'observation après une rupture de séquence
+#define JUMPED()							\
+	do {								\
+		if (ENGINE_STATS)					\
+			++njumps;					\
+		if (ENGINE_TRACE == TRACE_JUMPS && PC() < textsize)	\
+			trace("Jumping to", pmach, pmach->_text[PC()], PC()); \
+	} while (0)
+#define DISPATCH()	do { JUMPED(); AFTER(); BEFORE(); goto *ip->_handler; } while (0)
+#define STEP()		do { ++ip; AFTER(); BEFORE(); } while (0)
+#define NEXT()		do { STEP(); goto *ip->_handler; } while (0)
+
+	// Les adresses absolues ont été vérifiées au pré-décodage (voir
+	// decode_program()). Les adresses indexées et celles de la pile ne sont
+	// pas comparées à la taille du segment : un accès hors du segment tombe
+	// dans sa zone de garde (voir guard.h), et GUARD() tient la machine à jour
+	// pour le traitant de la faute. En mise au point, où la faute est
+	// présentée à l'utilisateur, et pour un segment sans zone de garde,
+	// l'adresse est vérifiée ici.
+#define GUARD(a, err)							\
+	do {								\
+		if (ENGINE_DEBUG || !guarded) {				\
+			if ((a) >= datasize)				\
+				FAULT((err), PC());			\
+		} else {						\
+			SYNC();						\
+			atomic_signal_fence(memory_order_seq_cst);	\
+		}							\
+	} while (0)
+#define ADDR_A()	(addr = ip->_operand)
+#define ADDR_X()	(addr = regs[ip->_rindex] + ip->_operand)
+#define CHECK_DATA()	GUARD(addr, ERR_SEGDATA)
+#define CHECK_TEXT()	do { if (addr >= textsize) FAULT(ERR_SEGTEXT, PC()); } while (0)
+#define TAKEN()		((condition_masks[ip->_reg] >> flags_of(cc)) & 1)
+#define SET(v)								\
+	do {								\
+		UNDO_REG(ip->_reg);					\
+		regs[ip->_reg] = (v);					\
+		cc = (Flags) { 0, regs[ip->_reg], FLAGS_ADD };		\
+		TRACE_REG(ip->_reg);					\
+	} while (0)
+#define ACC(op, src, v)							\
+	do {								\
+		Word v_ = (v);						\
+		UNDO_REG(ip->_reg);					\
+		cc = (Flags) { regs[ip->_reg], v_, (src) };		\
+		regs[ip->_reg] op v_;					\
+		TRACE_REG(ip->_reg);					\
+	} while (0)
+	// Instructions de calcul : le code condition est celui du chargement du
+	// résultat (CMP ne modifie que le code condition)
+#define ALU_MUL(v)	SET(regs[ip->_reg] * (Word) (v))
+#define ALU_AND(v)	SET(regs[ip->_reg] & (Word) (v))
+#define ALU_OR(v)	SET(regs[ip->_reg] | (Word) (v))
+#define ALU_XOR(v)	SET(regs[ip->_reg] ^ (Word) (v))
+#define ALU_SHL(v)	SET(regs[ip->_reg] << ((v) & 31))
+#define ALU_SHR(v)	SET(regs[ip->_reg] >> ((v) & 31))
+#define ALU_SAR(v)	SET((Word) ((int32_t) regs[ip->_reg] >> ((v) & 31)))
+#define ALU_DIVIDE(v, f)						\
+	do {								\
+		Word d_ = (v);						\
+		if (d_ == 0)						\
+			FAULT(ERR_DIVZERO, PC());			\
+		SET(f(regs[ip->_reg], d_));				\
+	} while (0)
+#define ALU_DIV(v)	ALU_DIVIDE((v), word_div)
+#define ALU_MOD(v)	ALU_DIVIDE((v), word_mod)
+#define ALU_CMP(v)	(cc = (Flags) { regs[ip->_reg], (v), FLAGS_SUB })
+	// Traitements d'une instruction de calcul dans ses quatre modes
+#define ALU(name, operate)						\
+op_##name##_i:								\
+	operate(ip->_operand);						\
+	NEXT();								\
+op_##name##_a:								\
+	ADDR_A();							\
+	operate(READ(addr));						\
+	NEXT();								\
+op_##name##_x:								\
+	ADDR_X();							\
+	CHECK_DATA();							\
+	operate(READ(addr));						\
+	NEXT();								\
+op_##name##_r:								\
+	operate(regs[ip->_rindex]);					\
+	NEXT()
+	// Instructions sur des plages de données : une seule vérification de
+	// chaque plage, puis le noyau de l'hôte ; mot à mot seulement pour le
+	// profil et les points d'observation
+#define BLOCK_CHECK(a, n)						\
+	do {								\
+		if (!block_inside((a), (n), datasize))			\
+			FAULT(ERR_SEGDATA, PC());			\
+	} while (0)
+#define BLOCK_SLOW()	(ENGINE_STATS == 2 || (ENGINE_DEBUG && pdbg->_watch != NULL))
+#define BLOCK_WRITE(a, v)						\
+	do {								\
+		Word new_ = (v);					\
+		if (WATCHED(a))						\
+			WATCH(WATCH_WRITE, (a), data[a], new_);		\
+		data[a] = new_;						\
+		PROFILE_WRITE(a);					\
+	} while (0)
+#define BLOCK_WRITTEN()							\
+	do {								\
+		if (ENGINE_DEBUG)					\
+			debug_barrier(pdbg);				\
+	} while (0)
+	// Opérations atomiques : le mot est lu et écrit par le processeur hôte
+	// en une seule opération (voir atomic_word()) ; les points d'observation,
+	// le profil et les traces le voient comme une lecture suivie, si elle a
+	// lieu, d'une écriture
+#define ATOMIC_BEFORE(a)						\
+	do {								\
+		UNDO_MEM(a);						\
+		UNDO_REG(ip->_reg);					\
+		(void) READ(a);						\
+	} while (0)
+#define ATOMIC_AFTER(a, old, written)					\
+	do {								\
+		if (written) {						\
+			if (WATCHED(a))					\
+				WATCH(WATCH_WRITE, (a), (old), data[a]); \
+			PROFILE_WRITE(a);				\
+		}							\
+		regs[ip->_reg] = (old);					\
+		TRACE_REG(ip->_reg);					\
+		TRACE_MEM(a);						\
+	} while (0)
+#define STORE(a, v)							\
+	do {								\
+		UNDO_MEM(a);						\
+		if (WATCHED(a)) {					\
+			Word new_ = (v);				\
+			WATCH(WATCH_WRITE, (a), data[a], new_);		\
+			data[a] = new_;					\
+		} else							\
+			data[a] = (v);					\
+		PROFILE_WRITE(a);					\
+		TRACE_MEM(a);						\
+	} while (0)
+#define PUSH(v)								\
+	do {								\
+		GUARD(SP, ERR_SEGSTACK);				\
+		STORE(SP, (v));						\
+		UNDO_REG(NREGISTERS - 1);				\
+		SP--;							\
+		TRACE_REG(NREGISTERS - 1);				\
+	} while (0)
+#define POP(a)								\
+	do {								\
+		GUARD((Word) (SP + 1), ERR_SEGSTACK);			\
+		UNDO_REG(NREGISTERS - 1);				\
+		++SP;							\
+		TRACE_REG(NREGISTERS - 1);				\
+		STORE((a), READ(SP));					\
+	} while (0)
+
+	BEFORE();
+	goto *ip->_handler;
+
+op_fault:
+	FAULT(ip->_operand, PC());
+op_nop:
+	NEXT();
+
+op_load_i:
+	SET(ip->_operand);
+	NEXT();
+op_load_a:
+	ADDR_A();
+	SET(READ(addr));
+	NEXT();
+op_load_x:
+	ADDR_X();
+	CHECK_DATA();
+	SET(READ(addr));
+	NEXT();
+
+op_load_r:
+	SET(regs[ip->_rindex]);
+	NEXT();
+
+op_store_a:
+	ADDR_A();
+	STORE(addr, regs[ip->_reg]);
+	NEXT();
+op_store_x:
+	ADDR_X();
+	CHECK_DATA();
+	STORE(addr, regs[ip->_reg]);
+	NEXT();
+
+op_add_i:
+	ACC(+=, FLAGS_ADD, ip->_operand);
+	NEXT();
+op_add_a:
+	ADDR_A();
+	ACC(+=, FLAGS_ADD, READ(addr));
+	NEXT();
+op_add_x:
+	ADDR_X();
+	CHECK_DATA();
+	ACC(+=, FLAGS_ADD, READ(addr));
+	NEXT();
+
+op_add_r:
+	ACC(+=, FLAGS_ADD, regs[ip->_rindex]);
+	NEXT();
+
+op_sub_i:
+	ACC(-=, FLAGS_SUB, ip->_operand);
+	NEXT();
+op_sub_a:
+	ADDR_A();
+	ACC(-=, FLAGS_SUB, READ(addr));
+	NEXT();
+op_sub_x:
+	ADDR_X();
+	CHECK_DATA();
+	ACC(-=, FLAGS_SUB, READ(addr));
+	NEXT();
+
+op_sub_r:
+	ACC(-=, FLAGS_SUB, regs[ip->_rindex]);
+	NEXT();
+
+	ALU(mul, ALU_MUL);
+	ALU(div, ALU_DIV);
+	ALU(mod, ALU_MOD);
+	ALU(and, ALU_AND);
+	ALU(or, ALU_OR);
+	ALU(xor, ALU_XOR);
+	ALU(shl, ALU_SHL);
+	ALU(shr, ALU_SHR);
+	ALU(sar, ALU_SAR);
+	ALU(cmp, ALU_CMP);
+
+op_bcopy: {
+	Word dst = regs[ip->_reg], src = regs[ip->_rindex], n = regs[ip->_operand];
+	BLOCK_CHECK(dst, n);
+	BLOCK_CHECK(src, n);
+	if (!BLOCK_SLOW())
+		memmove(&data[dst], &data[src], n * sizeof(Word));
+	else if (dst <= src)
+		for (Word i = 0; i < n; ++i)
+			BLOCK_WRITE(dst + i, READ(src + i));
+	else
+		for (Word i = n; i-- > 0; )
+			BLOCK_WRITE(dst + i, READ(src + i));
+	BLOCK_WRITTEN();
+	NEXT();
+}
+op_bfill: {
+	Word dst = regs[ip->_reg], value = regs[ip->_rindex], n = regs[ip->_operand];
+	BLOCK_CHECK(dst, n);
+	if (!BLOCK_SLOW())
+		block_fill(&data[dst], value, n);
+	else
+		for (Word i = 0; i < n; ++i)
+			BLOCK_WRITE(dst + i, value);
+	BLOCK_WRITTEN();
+	NEXT();
+}
+op_bcmp: {
+	Word a = regs[ip->_reg], b = regs[ip->_rindex], n = regs[ip->_operand], i;
+	BLOCK_CHECK(a, n);
+	BLOCK_CHECK(b, n);
+	if (!BLOCK_SLOW())
+		i = block_mismatch(&data[a], &data[b], n);
+	else
+		for (i = 0; i < n && READ(a + i) == READ(b + i); ++i)
+			;
+	cc = block_flags(&data[a], &data[b], i, n);
+	NEXT();
+}
+
+op_cas_a:
+	ADDR_A();
+	goto cas;
+op_cas_x:
+	ADDR_X();
+	CHECK_DATA();
+cas: {
+	Word expected = regs[ip->_reg], old = expected;
+	ATOMIC_BEFORE(addr);
+	bool written = atomic_compare_exchange_strong(atomic_word(&data[addr]), &old,
+						      regs[(ip->_reg + 1) % NREGISTERS]);
+	cc = (Flags) { old, expected, FLAGS_SUB };
+	ATOMIC_AFTER(addr, old, written);
+	NEXT();
+}
+
+op_xadd_a:
+	ADDR_A();
+	goto xadd;
+op_xadd_x:
+	ADDR_X();
+	CHECK_DATA();
+xadd: {
+	Word value = regs[ip->_reg];
+	ATOMIC_BEFORE(addr);
+	Word old = atomic_fetch_add(atomic_word(&data[addr]), value);
+	cc = (Flags) { old, value, FLAGS_ADD };
+	ATOMIC_AFTER(addr, old, true);
+	NEXT();
+}
+
+op_fence:
+	atomic_thread_fence(memory_order_seq_cst);
+	NEXT();
+
+op_push_i:
+	PUSH(ip->_operand);
+	NEXT();
+op_push_a:
+	ADDR_A();
+	PUSH(READ(addr));
+	NEXT();
+op_push_x:
+	ADDR_X();
+	CHECK_DATA();
+	PUSH(READ(addr));
+	NEXT();
+
+op_pop_a:
+	ADDR_A();
+	POP(addr);
+	NEXT();
+op_pop_x:
+	ADDR_X();
+	CHECK_DATA();
+	POP(addr);
+	NEXT();
+
+op_branch_a:
+	ADDR_A();
+	goto branch;
+op_branch_x:
+	ADDR_X();
+	CHECK_TEXT();
+branch:
+	if (TAKEN()) {
+		PROFILE_TAKEN();
+		ip = base + addr;
+		DISPATCH();
+	}
+	NEXT();
+
+op_call_a:
+	ADDR_A();
+	goto call;
+op_call_x:
+	ADDR_X();
+	CHECK_TEXT();
+call:
+	if (TAKEN()) {
+		PROFILE_TAKEN();
+		PUSH(PC() + 1);
+		DEPTH(1);
+		ip = base + addr;
+		DISPATCH();
+	}
+	NEXT();
+
+op_ret:
+	GUARD((Word) (SP + 1), ERR_SEGSTACK);
+	UNDO_REG(NREGISTERS - 1);
+	++SP;
+	addr = READ(SP);
+	TRACE_REG(NREGISTERS - 1);
+	if (addr >= textsize)
+		FAULT(ERR_SEGTEXT, addr);
+	DEPTH(-1);
+	ip = base + addr;
+	DISPATCH();
+
+op_halt:
+	warning(WARN_HALT, PC());
+	++ip;
+	if (ENGINE_DEBUG) {
+		SYNC();
+		bool stay = debug_ask(pmach);
+		if (pdbg->_moved)
+			RESUME(stay);
+	}
+	LEAVE(true);
+
+	// Super-instructions : les instructions de la séquence s'enchaînent
+	// sans dispatch (STEP() avance simplement ip)
+op_add_i_branch_a:
+	ACC(+=, FLAGS_ADD, ip->_operand);
+	STEP();
+	ADDR_A();
+	goto branch;
+op_sub_i_branch_a:
+	ACC(-=, FLAGS_SUB, ip->_operand);
+	STEP();
+	ADDR_A();
+	goto branch;
+op_push_push_call_a:
+	for (int i = 0; i < 2; ++i) {
+		if (ip->_base == OP_PUSH_I)
+			PUSH(ip->_operand);
+		else {
+			ADDR_A();
+			PUSH(READ(addr));
+		}
+		STEP();
+	}
+	ADDR_A();
+	goto call;
+
+#undef SP
+#undef PC
+#undef SYNC
+#undef LEAVE
+#undef STOP
+#undef FAULT
+#undef RESUME
+#undef AFTER
+#undef BEFORE
+#undef JUMPED
+#undef UNDO_REG
+#undef UNDO_MEM
+#undef TRACE_REG
+#undef TRACE_MEM
+#undef WATCHED
+#undef WATCH
+#undef READ
+#undef PROFILE_WRITE
+#undef CACHE
+#undef PROFILE_TAKEN
+#undef DEPTH
+#undef DISPATCH
+#undef STEP
+#undef NEXT
+#undef ADDR_A
+#undef ADDR_X
+#undef GUARD
+#undef CHECK_DATA
+#undef CHECK_TEXT
+#undef TAKEN
+#undef SET
+#undef ACC
+#undef ALU_MUL
+#undef ALU_DIV
+#undef ALU_MOD
+#undef ALU_AND
+#undef ALU_OR
+#undef ALU_XOR
+#undef ALU_SHL
+#undef ALU_SHR
+#undef ALU_SAR
+#undef ALU_CMP
+#undef ALU_DIVIDE
+#undef BLOCK_CHECK
+#undef BLOCK_SLOW
+#undef BLOCK_WRITE
+#undef BLOCK_WRITTEN
+#undef ALU
+#undef ATOMIC_BEFORE
+#undef ATOMIC_AFTER
+#undef STORE
+#undef PUSH
+#undef POP
+}
+
+#undef ENGINE_NAME
+#undef ENGINE_TRACE
+#undef ENGINE_DEBUG
+#undef ENGINE_STATS
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include "format.h"
+
+//! Chiffres hexadécimaux
+static const char hex_digits[] = "0123456789abcdef";
+
+//! Écriture du contenu du tampon
+/*!
+ * \param pf le tampon
+ */
+void format_flush(Format_Buffer *pf) {
+	fflush(stdout);
+	for (size_t off = 0; off < pf->_len; ) {
+		ssize_t n = write(pf->_fd, pf->_buf + off, pf->_len - off);
+		if (n <= 0) {
+			perror("write");
+			break;
+		}
+		off += n;
+	}
+	pf->_len = 0;
+}
+
+//! Chaîne de caractères
+/*!
+ * \param p la position où écrire
+ * \param s la chaîne
+ * \return la position qui suit
+ */
+char *format_str(char *p, const char *s) {
+	size_t len = strlen(s);
+	memcpy(p, s, len);
+	return p + len;
+}
+
+//! Nombre hexadécimal, sur au moins \c digits chiffres
+/*!
+ * \param p la position où écrire
+ * \param value le nombre
+ * \param digits le nombre minimal de chiffres
+ * \return la position qui suit
+ */
+char *format_hex(char *p, uint32_t value, unsigned digits) {
+	unsigned n = digits;
+	while (n < 8 && (value >> (4 * n)) != 0)
+		++n;
+	for (unsigned i = n; i > 0; --i) {
+		p[i - 1] = hex_digits[value & 0xf];
+		value >>= 4;
+	}
+	return p + n;
+}
+
+//! Nombre décimal non signé, sur au moins \c digits chiffres
+/*!
+ * \param p la position où écrire
+ * \param value le nombre
+ * \param digits le nombre minimal de chiffres
+ * \return la position qui suit
+ */
+char *format_udec(char *p, uint32_t value, unsigned digits) {
+	char tmp[10];
+	unsigned n = 0;
+	do {
+		tmp[n++] = '0' + value % 10;
+		value /= 10;
+	} while (value != 0);
+	while (n < digits)
+		tmp[n++] = '0';
+	while (n > 0)
+		*p++ = tmp[--n];
+	return p;
+}
+
+//! Nombre décimal signé
+/*!
+ * \param p la position où écrire
+ * \param value le nombre
+ * \return la position qui suit
+ */
+char *format_dec(char *p, int32_t value) {
+	if (value < 0) {
+		*p++ = '-';
+		return format_udec(p, -(uint32_t) value, 1);
+	}
+	return format_udec(p, value, 1);
+}
+
+//! Complément par des espaces jusqu'à une largeur donnée
+/*!
+ * \param p la position courante
+ * \param start le début du champ
+ * \param width la largeur minimale du champ
+ * \return la position qui suit
+ */
+char *format_pad(char *p, const char *start, unsigned width) {
+	while (p < start + width)
+		*p++ = ' ';
+	return p;
+}
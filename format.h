@@ -0,0 +1,120 @@
+#ifndef _FORMAT_H_
+#define _FORMAT_H_
+
+/*!
+ * \file format.h
+ * \brief Mise en forme rapide des affichages volumineux.
+ *
+ * Les affichages de l'état de la machine (programme, données, registres) et
+ * le désassemblage sont rédigés dans un grand tampon, avec des conversions
+ * hexadécimales et décimales écrites à la main plutôt qu'un \c printf par
+ * champ. Le tampon est vidé par un seul appel à \c write lorsqu'il est plein
+ * et à la fin de l'affichage.
+ *
+ * Les fonctions de conversion écrivent à partir d'une position dans un
+ * tableau de caractères et rendent la position qui suit le texte produit ;
+ * elles ne vérifient pas la place disponible : on la réserve d'abord avec
+ * format_reserve().
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+
+//! Taille d'un tampon de mise en forme (en octets)
+#define FORMAT_BUFSIZE (64 * 1024)
+
+//! Taille maximale d'une instruction désassemblée (voir format_instruction())
+#define FORMAT_INSTRUCTION_MAX 40
+
+//! Tampon de mise en forme
+typedef struct
+{
+    int _fd;			//!< Descripteur de la sortie
+    size_t _len;		//!< Nombre d'octets en attente
+    char _buf[FORMAT_BUFSIZE];	//!< Texte en attente
+} Format_Buffer;
+
+//! Écriture du contenu du tampon
+/*!
+ * La sortie standard de la bibliothèque (\c stdout) est d'abord vidée, pour
+ * que le texte du tampon apparaisse à sa place parmi les autres affichages.
+ *
+ * \param pf le tampon
+ */
+void format_flush(Format_Buffer *pf);
+
+//! Réservation de place à la fin du tampon
+/*!
+ * Le tampon est vidé s'il ne reste pas \c n octets libres.
+ *
+ * \param pf le tampon
+ * \param n le nombre d'octets nécessaires (au plus \c FORMAT_BUFSIZE)
+ * \return la position où écrire
+ */
+static inline char *format_reserve(Format_Buffer *pf, size_t n)
+{
+    if (pf->_len + n > FORMAT_BUFSIZE)
+        format_flush(pf);
+    return pf->_buf + pf->_len;
+}
+
+//! Prise en compte du texte écrit depuis format_reserve()
+/*!
+ * \param pf le tampon
+ * \param end la position qui suit le texte écrit
+ */
+static inline void format_commit(Format_Buffer *pf, char *end)
+{
+    pf->_len = end - pf->_buf;
+}
+
+//! Chaîne de caractères
+/*!
+ * \param p la position où écrire
+ * \param s la chaîne
+ * \return la position qui suit
+ */
+char *format_str(char *p, const char *s);
+
+//! Nombre hexadécimal (minuscules), sur au moins \c digits chiffres
+/*!
+ * Équivalent de <tt>%0</tt><i>digits</i><tt>x</tt>.
+ *
+ * \param p la position où écrire
+ * \param value le nombre
+ * \param digits le nombre minimal de chiffres (au plus 8)
+ * \return la position qui suit
+ */
+char *format_hex(char *p, uint32_t value, unsigned digits);
+
+//! Nombre décimal non signé, sur au moins \c digits chiffres
+/*!
+ * Équivalent de <tt>%0</tt><i>digits</i><tt>u</tt>.
+ *
+ * \param p la position où écrire
+ * \param value le nombre
+ * \param digits le nombre minimal de chiffres (au plus 10)
+ * \return la position qui suit
+ */
+char *format_udec(char *p, uint32_t value, unsigned digits);
+
+//! Nombre décimal signé
+/*!
+ * \param p la position où écrire
+ * \param value le nombre
+ * \return la position qui suit
+ */
+char *format_dec(char *p, int32_t value);
+
+//! Complément par des espaces jusqu'à une largeur donnée
+/*!
+ * Avec format_dec(), équivalent de <tt>%-</tt><i>width</i><tt>d</tt>.
+ *
+ * \param p la position courante
+ * \param start le début du champ
+ * \param width la largeur minimale du champ
+ * \return la position qui suit
+ */
+char *format_pad(char *p, const char *start, unsigned width);
+
+#endif
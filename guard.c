@@ -0,0 +1,192 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <signal.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "guard.h"
+#include "error.h"
+#include "tracebuf.h"
+
+__thread Guard_Context guard_context = { NULL, NULL, 0, NULL, NULL, NULL };
+
+//! Installation unique du traitant de SIGSEGV
+static pthread_once_t handler_once = PTHREAD_ONCE_INIT;
+
+//! Traitant de SIGSEGV
+/*!
+ * Le traitant est installé avec \c SA_NODEFER : le signal n'est pas masqué
+ * pendant son exécution, et error() peut en sortir par \c longjmp vers un
+ * point de récupération.
+ *
+ * \param sig le signal
+ * \param si la description de la faute
+ * \param context le contexte interrompu (inutilisé)
+ */
+static void guard_handler(int sig, siginfo_t *si, void *context) {
+	Guard_Context *pg = &guard_context;
+	const char *p = si->si_addr;
+	const char *end = (const char *) (pg->_data + pg->_datasize);
+	(void) context;
+
+	if (pg->_pmach == NULL || p < end || p >= end + GUARD_SIZE) {
+		// Faute de l'hôte : traitement par défaut au retour du traitant
+		signal(sig, SIG_DFL);
+		return;
+	}
+
+	Machine *pmach = pg->_pmach;
+	unsigned addr = (p - (const char *) pg->_data) / sizeof(Word);
+	if (pg->_pstats != NULL) {
+		pg->_pstats->_instructions += *pg->_ninstr;
+		pg->_pstats->_jumps += *pg->_njumps;
+	}
+	pg->_pmach = NULL;
+	if (pmach->_tracebuf != NULL)
+		tracebuf_flush(pmach->_tracebuf);
+	error(addr == pmach->_sp ? ERR_SEGSTACK : ERR_SEGDATA, pmach->_pc);
+}
+
+//! Installation du traitant de SIGSEGV
+static void install_handler(void) {
+	struct sigaction sa;
+	sa.sa_sigaction = guard_handler;
+	sa.sa_flags = SA_SIGINFO | SA_NODEFER;
+	sigemptyset(&sa.sa_mask);
+	if (sigaction(SIGSEGV, &sa, NULL) != 0)
+		perror("sigaction");
+}
+
+//! Taille de la projection du segment de données, arrondie à la page
+/*!
+ * \param datasize la taille du segment (en mots)
+ */
+size_t guard_mapsize(unsigned datasize) {
+	size_t page = sysconf(_SC_PAGESIZE);
+	size_t size = (size_t) datasize * sizeof(Word);
+	return size == 0 ? page : (size + page - 1) / page * page;
+}
+
+//! Position du segment de données dans sa projection
+/*!
+ * \param datasize la taille du segment (en mots)
+ */
+size_t guard_offset(unsigned datasize) {
+	return guard_mapsize(datasize) - (size_t) datasize * sizeof(Word);
+}
+
+//! Taille de la réservation d'un segment
+/*!
+ * \param datasize la taille du segment (en mots)
+ * \param guarded le segment est-il suivi de sa zone de garde ?
+ */
+static size_t region_size(unsigned datasize, bool guarded) {
+	return guard_mapsize(datasize) + (guarded ? GUARD_SIZE : 0);
+}
+
+//! Réservation de la projection, sans droit d'accès
+/*!
+ * On réserve d'abord la projection suivie de sa zone de garde ; si l'espace
+ * d'adressage manque (limite \c RLIMIT_AS, par exemple), la projection seule.
+ *
+ * \param datasize la taille du segment (en mots)
+ * \param pguarded la zone de garde a-t-elle été réservée ? (résultat)
+ * \return le début de la réservation, ou NULL
+ */
+static char *reserve(unsigned datasize, bool *pguarded) {
+	pthread_once(&handler_once, install_handler);
+	void *p = mmap(NULL, region_size(datasize, true), PROT_NONE,
+		       MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	*pguarded = p != MAP_FAILED;
+	if (p == MAP_FAILED)
+		p = mmap(NULL, region_size(datasize, false), PROT_NONE,
+			 MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+	if (p == MAP_FAILED) {
+		perror("guard");
+		return NULL;
+	}
+	return p;
+}
+
+//! Allocation d'un segment de données protégé, initialisé à zéro
+/*!
+ * \param datasize la taille du segment (en mots)
+ * \param pguarded le segment est-il protégé ? (résultat)
+ * \return le segment, ou NULL
+ */
+Word *guard_alloc(unsigned datasize, bool *pguarded) {
+	char *region = reserve(datasize, pguarded);
+	if (region == NULL)
+		return NULL;
+	if (mprotect(region, guard_mapsize(datasize), PROT_READ | PROT_WRITE) != 0) {
+		perror("guard");
+		munmap(region, region_size(datasize, *pguarded));
+		return NULL;
+	}
+	return (Word *) (region + guard_offset(datasize));
+}
+
+//! Projection privée d'un fichier comme segment de données protégé
+/*!
+ * \param datasize la taille du segment (en mots)
+ * \param fd le descripteur du fichier
+ * \param start position du début de la projection dans le fichier
+ * \param at segment à remplacer (ou NULL)
+ * \param pguarded le segment est-il protégé ? (résultat, si \c at est NULL)
+ * \return le segment, ou NULL
+ */
+Word *guard_map(unsigned datasize, int fd, off_t start, Word *at, bool *pguarded) {
+	char *region = at != NULL ? (char *) at - guard_offset(datasize)
+		: reserve(datasize, pguarded);
+	if (region == NULL)
+		return NULL;
+	if (mmap(region, guard_mapsize(datasize), PROT_READ | PROT_WRITE,
+		 MAP_PRIVATE | MAP_FIXED, fd, start) == MAP_FAILED) {
+		perror("guard");
+		if (at == NULL)
+			munmap(region, region_size(datasize, *pguarded));
+		return NULL;
+	}
+	return (Word *) (region + guard_offset(datasize));
+}
+
+//! Libération d'un segment de données protégé
+/*!
+ * \param data le segment
+ * \param datasize sa taille (en mots)
+ * \param guarded le segment est-il suivi de sa zone de garde ?
+ */
+void guard_free(Word *data, unsigned datasize, bool guarded) {
+	if (data == NULL)
+		return;
+	// Une erreur a pu quitter l'exécution sans passer par guard_leave()
+	if (guard_context._data == data)
+		guard_leave();
+	munmap((char *) data - guard_offset(datasize), region_size(datasize, guarded));
+}
+
+//! Entrée dans l'exécution d'une machine
+/*!
+ * \param pmach la machine
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ * \param ninstr compteur d'instructions (NULL si aucun)
+ * \param njumps compteur de ruptures de séquence (NULL si aucun)
+ */
+void guard_enter(Machine *pmach, Stats *pstats,
+		 const uint64_t *ninstr, const uint64_t *njumps) {
+	// Sans zone de garde, une faute n'est jamais celle de la machine
+	if (!pmach->_guarded) {
+		guard_leave();
+		return;
+	}
+	guard_context = (Guard_Context) {
+		pmach, pmach->_data, pmach->_datasize,
+		ninstr != NULL ? pstats : NULL, ninstr, njumps
+	};
+}
+
+//! Sortie de l'exécution d'une machine
+void guard_leave(void) {
+	guard_context = (Guard_Context) { NULL, NULL, 0, NULL, NULL, NULL };
+}
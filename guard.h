@@ -0,0 +1,132 @@
+#ifndef _GUARD_H_
+#define _GUARD_H_
+
+/*!
+ * \file guard.h
+ * \brief Segment de données protégé par une zone de garde.
+ *
+ * Le segment de données est projeté (\c mmap) de sorte qu'il se termine
+ * exactement sur une limite de page ; il est suivi d'une zone réservée sans
+ * aucun droit d'accès (\c PROT_NONE), assez grande pour couvrir toute adresse
+ * de 32 bits. Comme les adresses de données et le pointeur de pile sont des
+ * entiers non signés, tout accès hors du segment, y compris par la pile,
+ * tombe dans la zone de garde : la boucle d'exécution n'a plus à comparer les
+ * adresses à la taille du segment.
+ *
+ * Un tel accès provoque un signal \c SIGSEGV. Son traitant retrouve la
+ * machine en cours d'exécution dans le contexte du processus léger (voir
+ * Guard_Context) et signale \c ERR_SEGSTACK (si l'adresse fautive est celle
+ * du pointeur de pile) ou \c ERR_SEGDATA par error() : l'erreur peut donc être
+ * rattrapée comme les autres (voir Error_Trap). Une faute hors de toute zone
+ * de garde reçoit le traitement par défaut.
+ *
+ * La zone de garde n'occupe que de l'espace d'adressage (16 Gio par
+ * segment) : elle n'est jamais accessible, donc jamais allouée. Lorsque cet
+ * espace manque (limite \c RLIMIT_AS, ou très nombreuses machines), le
+ * segment est alloué sans zone de garde : le champ \c _guarded de la machine
+ * est alors faux, et les boucles d'exécution vérifient explicitement les
+ * adresses indexées et celles de la pile.
+ */
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <sys/types.h>
+
+#include "machine.h"
+
+//! Taille de la zone de garde : tout déplacement de 32 bits, en mots (en octets)
+#define GUARD_SIZE ((size_t) sizeof(Word) << 32)
+
+//! Contexte d'exécution consulté par le traitant de \c SIGSEGV
+/*!
+ * Un contexte par processus léger. Avant chaque accès qui peut sortir du
+ * segment (adresse indexée ou pile), la boucle d'exécution range l'adresse de
+ * l'instruction en cours et le code condition dans la machine ; ses compteurs
+ * d'instructions sont désignés ici. La compilation à la volée ne tient pas la
+ * machine à jour dans un bloc compilé : la faute y est signalée à l'adresse du
+ * début du bloc.
+ */
+typedef struct
+{
+    Machine *_pmach;		//!< Machine en cours d'exécution (NULL si aucune)
+    const Word *_data;		//!< Son segment de données
+    unsigned _datasize;		//!< Sa taille
+    Stats *_pstats;		//!< Statistiques à mettre à jour (NULL si aucune)
+    const uint64_t *_ninstr;	//!< Instructions exécutées, pas encore comptées
+    const uint64_t *_njumps;	//!< Ruptures de séquence, pas encore comptées
+} Guard_Context;
+
+//! Contexte du processus léger courant
+extern __thread Guard_Context guard_context;
+
+//! Taille de la projection du segment de données, arrondie à la page
+/*!
+ * \param datasize la taille du segment (en mots)
+ * \return la taille en octets (au moins une page)
+ */
+size_t guard_mapsize(unsigned datasize);
+
+//! Position du segment de données dans sa projection
+/*!
+ * Le segment occupe la fin de la projection, pour que le mot qui le suit soit
+ * le premier de la zone de garde.
+ *
+ * \param datasize la taille du segment (en mots)
+ * \return le déplacement en octets (c'est aussi celui des données dans un
+ * fichier projeté par guard_map())
+ */
+size_t guard_offset(unsigned datasize);
+
+//! Allocation d'un segment de données protégé, initialisé à zéro
+/*!
+ * Si la zone de garde ne peut être réservée, le segment est alloué sans elle.
+ *
+ * \param datasize la taille du segment (en mots)
+ * \param pguarded le segment est-il suivi de sa zone de garde ? (résultat)
+ * \return le segment, ou NULL (avec un message) en cas d'échec
+ */
+Word *guard_alloc(unsigned datasize, bool *pguarded);
+
+//! Projection privée d'un fichier comme segment de données protégé
+/*!
+ * La projection commence à la position \c start du fichier, multiple de la
+ * taille de page : les données y sont lues à partir de \c start +
+ * guard_offset().
+ *
+ * \param datasize la taille du segment (en mots)
+ * \param fd le descripteur du fichier
+ * \param start position du début de la projection dans le fichier
+ * \param at segment protégé de même taille à remplacer (ou NULL)
+ * \param pguarded le nouveau segment est-il suivi de sa zone de garde ?
+ * (résultat, seulement si \c at est NULL ; un segment remplacé garde la
+ * sienne)
+ * \return le segment, ou NULL (avec un message) en cas d'échec
+ */
+Word *guard_map(unsigned datasize, int fd, off_t start, Word *at, bool *pguarded);
+
+//! Libération d'un segment de données protégé
+/*!
+ * \param data le segment (rendu par guard_alloc() ou guard_map())
+ * \param datasize sa taille (en mots)
+ * \param guarded le segment est-il suivi de sa zone de garde ?
+ */
+void guard_free(Word *data, unsigned datasize, bool guarded);
+
+//! Entrée dans l'exécution d'une machine par le processus léger courant
+/*!
+ * Sans effet (hormis la sortie d'une exécution précédente) si le segment de
+ * la machine n'a pas de zone de garde.
+ *
+ * \param pmach la machine
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ * \param ninstr compteur d'instructions de l'exécution (NULL si aucun)
+ * \param njumps compteur de ruptures de séquence (NULL si aucun)
+ */
+void guard_enter(Machine *pmach, Stats *pstats,
+                 const uint64_t *ninstr, const uint64_t *njumps);
+
+//! Sortie de l'exécution d'une machine
+void guard_leave(void);
+
+#endif
@@ -0,0 +1,335 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "image.h"
+
+//! Bit de poids fort d'un mot de contrôle : suite de mots nuls
+#define RUN_ZERO 0x80000000u
+
+//! Longueur minimale d'une suite de mots nuls codée comme telle
+/*!
+ * Une suite nulle au milieu de mots littéraux coûte deux mots de contrôle.
+ */
+#define MIN_ZERO_RUN 3
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+//! L'hôte est-il petit boutiste ? (les copies se font alors par memcpy)
+#define HOST_LITTLE_ENDIAN 1
+#else
+#define HOST_LITTLE_ENDIAN 0
+#endif
+
+//! Lecture d'un mot de 32 bits petit boutiste
+static uint32_t get32(const uint8_t *p) {
+	return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t) p[3] << 24;
+}
+
+//! Lecture d'un mot de 16 bits petit boutiste
+static uint16_t get16(const uint8_t *p) {
+	return p[0] | p[1] << 8;
+}
+
+//! Copie d'un tableau de mots petit boutistes
+/*!
+ * \param dst destination (mots de l'hôte)
+ * \param src source (octets de l'image)
+ * \param n nombre de mots
+ */
+static void get32_array(uint32_t *dst, const uint8_t *src, size_t n) {
+	if (HOST_LITTLE_ENDIAN)
+		memcpy(dst, src, n * sizeof(uint32_t));
+	else
+		for (size_t i = 0; i < n; ++i)
+			dst[i] = __builtin_bswap32(((const uint32_t *) src)[i]);
+}
+
+//! Écriture d'un mot de 32 bits petit boutiste
+static bool put32(FILE *file, uint32_t v) {
+	uint8_t b[4] = { v, v >> 8, v >> 16, v >> 24 };
+	return fwrite(b, 1, 4, file) == 4;
+}
+
+//! Écriture d'un tableau de mots en petit boutiste
+static bool put32_array(FILE *file, const uint32_t *src, size_t n) {
+	if (HOST_LITTLE_ENDIAN)
+		return fwrite(src, sizeof(uint32_t), n, file) == n;
+	for (size_t i = 0; i < n; ++i)
+		if (!put32(file, src[i]))
+			return false;
+	return true;
+}
+
+//! Le contenu d'un fichier est-il une image version 2 ?
+/*!
+ * \param buf le début du fichier
+ * \param size le nombre d'octets disponibles
+ */
+bool image_is_v2(const void *buf, size_t size) {
+	return size >= 4 && get32(buf) == IMAGE_MAGIC;
+}
+
+//! Décodage des données initialisées
+/*!
+ * \param dst segment de données (au moins \c count mots)
+ * \param count nombre de mots à produire
+ * \param p contenu de la section
+ * \param size sa taille (en octets)
+ * \return NULL en cas de succès, le message d'erreur sinon
+ */
+static const char *decode_data(Word *dst, uint32_t count, const uint8_t *p, size_t size) {
+	const char *bad = "Corrupted data section";
+	size_t nwords = size / 4;
+	size_t in = 0;
+	uint32_t out = 0;
+
+	while (in < nwords) {
+		uint32_t ctl = get32(p + 4 * in++);
+		uint32_t n = ctl & ~RUN_ZERO;
+		if (n > count - out)
+			return bad;
+		if (ctl & RUN_ZERO)
+			memset(dst + out, 0, n * sizeof(Word));
+		else {
+			if (n > nwords - in)
+				return bad;
+			get32_array(dst + out, p + 4 * in, n);
+			in += n;
+		}
+		out += n;
+	}
+	return out == count ? NULL : bad;
+}
+
+//! Décodage de la table des symboles
+/*!
+ * \param pimg le programme (la table y est rangée)
+ * \param count nombre de symboles
+ * \param p contenu de la section
+ * \param size sa taille (en octets)
+ * \return NULL en cas de succès, le message d'erreur sinon
+ */
+static const char *decode_symbols(Image *pimg, uint32_t count, const uint8_t *p, size_t size) {
+	if (count > size / 8)
+		return "Corrupted symbol table";
+	Symbol *symbols = calloc(count + 1, sizeof(Symbol));
+	if (symbols == NULL)
+		return "Not enough memory";
+
+	size_t pos = 0;
+	for (uint32_t i = 0; i < count; ++i) {
+		if (size - pos < 8)
+			goto corrupted;
+		unsigned len = get16(p + pos + 6);
+		if (size - pos - 8 < len)
+			goto corrupted;
+		symbols[i]._value = get32(p + pos);
+		symbols[i]._data = get16(p + pos + 4) != 0;
+		if ((symbols[i]._name = malloc(len + 1)) == NULL)
+			goto corrupted;
+		memcpy(symbols[i]._name, p + pos + 8, len);
+		symbols[i]._name[len] = '\0';
+		pos += 8 + (len + 3) / 4 * 4;
+		if (pos > size)
+			goto corrupted;
+	}
+	pimg->_symbols = symbols;
+	pimg->_nsymbols = count;
+	return NULL;
+
+corrupted:
+	image_free_symbols(symbols, count);
+	return "Corrupted symbol table";
+}
+
+//! Décodage d'une image version 2
+/*!
+ * \param buf le contenu du fichier
+ * \param size sa taille
+ * \param pimg le programme décodé (résultat)
+ * \return NULL en cas de succès, le message d'erreur sinon
+ */
+const char *image_decode(const void *buf, size_t size, Image *pimg) {
+	const uint8_t *p = buf;
+	const uint8_t *sections[SECTION_ENTRY + 1] = { NULL };
+	uint32_t counts[SECTION_ENTRY + 1] = { 0 };
+	uint32_t sizes[SECTION_ENTRY + 1] = { 0 };
+
+	memset(pimg, 0, sizeof(*pimg));
+	if (size < IMAGE_HEADER_SIZE || get32(p) != IMAGE_MAGIC)
+		return "Incorrect image header";
+	if (get16(p + 4) != IMAGE_VERSION)
+		return "Unsupported image version";
+
+	unsigned nsections = get16(p + 6);
+	if ((size - IMAGE_HEADER_SIZE) / IMAGE_SECTION_SIZE < nsections)
+		return "Incorrect section table";
+	for (unsigned i = 0; i < nsections; ++i) {
+		const uint8_t *ps = p + IMAGE_HEADER_SIZE + i * IMAGE_SECTION_SIZE;
+		uint32_t type = get32(ps), count = get32(ps + 4);
+		uint32_t offset = get32(ps + 8), length = get32(ps + 12);
+		if (offset > size || length > size - offset || offset % 4 != 0)
+			return "Section outside of file";
+		if (type < SECTION_TEXT || type > SECTION_ENTRY)
+			continue;		// section inconnue : ignorée
+		if (sections[type] != NULL)
+			return "Duplicate section";
+		sections[type] = p + offset;
+		counts[type] = count;
+		sizes[type] = length;
+	}
+
+	if (sections[SECTION_TEXT] == NULL)
+		return "Missing text section";
+	if (sizes[SECTION_TEXT] / sizeof(Instruction) < counts[SECTION_TEXT])
+		return "Text segment shorter than declared";
+	uint64_t datasize = (uint64_t) counts[SECTION_DATA] + counts[SECTION_BSS];
+	if (datasize > UINT32_MAX)
+		return "Data segment too large";
+
+	pimg->_textsize = counts[SECTION_TEXT];
+	pimg->_datasize = datasize;
+	pimg->_dataend = get32(p + 8);
+	pimg->_entry = counts[SECTION_ENTRY];
+	pimg->_text = malloc(pimg->_textsize * sizeof(Instruction) + 1);
+	pimg->_data = calloc(pimg->_datasize + 1, sizeof(Word));
+
+	const char *problem = NULL;
+	if (pimg->_text == NULL || pimg->_data == NULL)
+		problem = "Not enough memory";
+	else {
+		get32_array(&pimg->_text->_raw, sections[SECTION_TEXT], pimg->_textsize);
+		problem = decode_data(pimg->_data, counts[SECTION_DATA],
+				      sections[SECTION_DATA], sizes[SECTION_DATA]);
+	}
+	if (problem == NULL && sections[SECTION_SYMBOLS] != NULL)
+		problem = decode_symbols(pimg, counts[SECTION_SYMBOLS],
+					 sections[SECTION_SYMBOLS], sizes[SECTION_SYMBOLS]);
+	if (problem != NULL) {
+		free(pimg->_text);
+		free(pimg->_data);
+		memset(pimg, 0, sizeof(*pimg));
+	}
+	return problem;
+}
+
+//! Libération de la table des symboles
+/*!
+ * \param symbols la table
+ * \param nsymbols le nombre de symboles
+ */
+void image_free_symbols(Symbol *symbols, unsigned nsymbols) {
+	if (symbols == NULL)
+		return;
+	for (unsigned i = 0; i < nsymbols; ++i)
+		free(symbols[i]._name);
+	free(symbols);
+}
+
+//! Écriture (ou seulement mesure) des données initialisées codées par plages
+/*!
+ * \param file le fichier, ou NULL pour ne calculer que la taille
+ * \param data les données initialisées
+ * \param n leur nombre
+ * \param psize taille du codage en octets (résultat)
+ * \return vrai en cas de succès
+ */
+static bool encode_data(FILE *file, const Word *data, unsigned n, uint32_t *psize) {
+	uint32_t words = 0;
+	unsigned i = 0;
+
+	while (i < n) {
+		unsigned zeros = 0;
+		while (i + zeros < n && data[i + zeros] == 0)
+			++zeros;
+		if (zeros >= MIN_ZERO_RUN || (zeros > 0 && i + zeros == n)) {
+			if (file != NULL && !put32(file, RUN_ZERO | zeros))
+				return false;
+			words += 1;
+			i += zeros;
+			continue;
+		}
+
+		// Suite littérale jusqu'à la prochaine suite de zéros assez longue
+		unsigned len = 0;
+		while (i + len < n) {
+			unsigned z = 0;
+			while (i + len + z < n && data[i + len + z] == 0 && z < MIN_ZERO_RUN)
+				++z;
+			if (z == MIN_ZERO_RUN)
+				break;
+			len += z > 0 ? z : 1;
+		}
+		if (file != NULL && (!put32(file, len) || !put32_array(file, data + i, len)))
+			return false;
+		words += 1 + len;
+		i += len;
+	}
+	*psize = words * 4;
+	return true;
+}
+
+//! Taille d'un symbole dans l'image (en octets)
+static uint32_t symbol_size(const Symbol *ps) {
+	return 8 + (strlen(ps->_name) + 3) / 4 * 4;
+}
+
+//! Écriture du programme d'une machine au format version 2
+/*!
+ * \param file le fichier
+ * \param pmach la machine
+ * \return vrai en cas de succès
+ */
+bool image_write(FILE *file, const Machine *pmach) {
+	// Les mots nuls en fin de segment forment la section BSS
+	unsigned initialized = pmach->_datasize;
+	while (initialized > 0 && pmach->_data[initialized - 1] == 0)
+		--initialized;
+
+	uint32_t datasize, symsize = 0;
+	encode_data(NULL, pmach->_data, initialized, &datasize);
+	for (unsigned i = 0; i < pmach->_nsymbols; ++i)
+		symsize += symbol_size(&pmach->_symbols[i]);
+
+	uint32_t table[SECTION_ENTRY][4];
+	unsigned nsections = 0;
+	uint32_t offset;
+#define SECTION(type, count, size)					\
+	do {								\
+		table[nsections][0] = (type);				\
+		table[nsections][1] = (count);				\
+		table[nsections][3] = (size);				\
+		++nsections;						\
+	} while (0)
+	SECTION(SECTION_TEXT, pmach->_textsize, pmach->_textsize * sizeof(Instruction));
+	SECTION(SECTION_DATA, initialized, datasize);
+	SECTION(SECTION_BSS, pmach->_datasize - initialized, 0);
+	if (pmach->_nsymbols > 0)
+		SECTION(SECTION_SYMBOLS, pmach->_nsymbols, symsize);
+	if (pmach->_pc != 0)
+		SECTION(SECTION_ENTRY, pmach->_pc, 0);
+#undef SECTION
+	offset = IMAGE_HEADER_SIZE + nsections * IMAGE_SECTION_SIZE;
+	for (unsigned i = 0; i < nsections; ++i) {
+		table[i][2] = offset;
+		offset += table[i][3];
+	}
+
+	bool ok = put32(file, IMAGE_MAGIC)
+	    && put32(file, IMAGE_VERSION | nsections << 16)
+	    && put32(file, pmach->_dataend)
+	    && put32(file, 0)
+	    && put32_array(file, &table[0][0], 4 * nsections)
+	    && put32_array(file, &pmach->_text->_raw, pmach->_textsize)
+	    && encode_data(file, pmach->_data, initialized, &datasize);
+
+	for (unsigned i = 0; ok && i < pmach->_nsymbols; ++i) {
+		const Symbol *ps = &pmach->_symbols[i];
+		size_t len = strlen(ps->_name);
+		static const char pad[4];
+		ok = put32(file, ps->_value)
+		    && put32(file, (ps->_data ? 1 : 0) | (uint32_t) len << 16)
+		    && fwrite(ps->_name, 1, len, file) == len
+		    && fwrite(pad, 1, symbol_size(ps) - 8 - len, file) == symbol_size(ps) - 8 - len;
+	}
+	return ok;
+}
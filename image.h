@@ -0,0 +1,124 @@
+#ifndef _IMAGE_H_
+#define _IMAGE_H_
+
+/*!
+ * \file image.h
+ * \brief Format d'image de programme version 2.
+ *
+ * Le format d'origine (version 1, voir read_program()) est une simple copie
+ * des tailles et des segments dans l'ordre des octets de la machine hôte. Le
+ * format version 2 est indépendant de l'hôte et compact :
+ *
+ *   - tous les entiers sont des mots de 32 bits (ou 16 bits) en petit
+ *   boutiste ;
+ *
+ *   - un entête de 16 octets : \c IMAGE_MAGIC, la version (16 bits), le nombre
+ *   de sections (16 bits), la première adresse libre des données (\c
+ *   dataend), et un mot réservé (0) ;
+ *
+ *   - une table des sections, 4 mots par section : type (Section_Type),
+ *   nombre d'éléments, position (en octets depuis le début du fichier) et
+ *   taille (en octets) du contenu ;
+ *
+ *   - le contenu des sections, chacun aligné sur 4 octets.
+ *
+ * Les données initialisées sont codées par plages : un mot de contrôle dont le
+ * bit de poids fort est à 1 représente une suite de mots nuls (les 31 bits de
+ * poids faible en donnent la longueur) ; sinon il est suivi d'autant de mots
+ * littéraux qu'il l'indique. Les mots nuls qui terminent le segment de
+ * données (en général la pile) ne sont pas stockés du tout : la section \c
+ * SECTION_BSS n'en donne que le nombre.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stddef.h>
+
+#include "machine.h"
+
+//! Marqueur d'une image version 2 ("SIMP" en petit boutiste)
+#define IMAGE_MAGIC 0x504d4953
+
+//! Version du format
+#define IMAGE_VERSION 2
+
+//! Taille de l'entête (en octets)
+#define IMAGE_HEADER_SIZE 16
+
+//! Taille d'une entrée de la table des sections (en octets)
+#define IMAGE_SECTION_SIZE 16
+
+//! Type de section
+typedef enum
+{
+    SECTION_TEXT = 1,	//!< Instructions (nombre : \c textsize)
+    SECTION_DATA,	//!< Données initialisées, codées par plages (nombre : mots décodés)
+    SECTION_BSS,	//!< Mots nuls terminant les données (nombre ; pas de contenu)
+    SECTION_SYMBOLS,	//!< Table des symboles (nombre : symboles), facultative
+    SECTION_ENTRY,	//!< Adresse de la première instruction (nombre), facultative
+} Section_Type;
+
+//! Symbole du programme
+/*!
+ * Dans l'image, un symbole est codé par sa valeur (32 bits), son segment (16
+ * bits : 0 texte, 1 données), la longueur de son nom (16 bits) puis le nom
+ * lui-même, complété par des octets nuls jusqu'à un multiple de 4.
+ */
+typedef struct Symbol
+{
+    char *_name;		//!< Nom (alloué)
+    unsigned _value;		//!< Valeur (adresse)
+    bool _data;			//!< Adresse dans le segment de données (sinon de texte) ?
+} Symbol;
+
+//! Programme décodé d'une image
+typedef struct
+{
+    Instruction *_text;		//!< Segment de texte (alloué)
+    unsigned _textsize;		//!< Taille du segment de texte
+    Word *_data;		//!< Segment de données (alloué)
+    unsigned _datasize;		//!< Taille du segment de données
+    unsigned _dataend;		//!< Première adresse libre après les données statiques
+    unsigned _entry;		//!< Adresse de la première instruction
+    Symbol *_symbols;		//!< Table des symboles (allouée, ou NULL)
+    unsigned _nsymbols;		//!< Nombre de symboles
+} Image;
+
+//! Le contenu d'un fichier est-il une image version 2 ?
+/*!
+ * \param buf le début du fichier
+ * \param size le nombre d'octets disponibles
+ */
+bool image_is_v2(const void *buf, size_t size);
+
+//! Décodage d'une image version 2
+/*!
+ * Toutes les positions et tailles sont vérifiées par rapport à la taille du
+ * tampon. En cas d'erreur, rien n'est alloué.
+ *
+ * \param buf le contenu du fichier
+ * \param size sa taille
+ * \param pimg le programme décodé (résultat)
+ * \return NULL en cas de succès, le message d'erreur sinon
+ */
+const char *image_decode(const void *buf, size_t size, Image *pimg);
+
+//! Libération de la table des symboles
+/*!
+ * \param symbols la table
+ * \param nsymbols le nombre de symboles
+ */
+void image_free_symbols(Symbol *symbols, unsigned nsymbols);
+
+//! Écriture du programme d'une machine au format version 2
+/*!
+ * L'adresse d'entrée (\c _pc) n'est écrite que si elle n'est pas nulle, la
+ * table des symboles que si la machine en a une.
+ *
+ * \param file le fichier (ouvert en écriture binaire)
+ * \param pmach la machine
+ * \return vrai en cas de succès
+ */
+bool image_write(FILE *file, const Machine *pmach);
+
+#endif
@@ -1,6 +1,7 @@
 #include <stdio.h>
 #include "error.h"
 #include "instruction.h"
+#include "format.h"
 
 //! Forme imprimable des codes oprations
 const char *cop_names[] = {
@@ -16,6 +17,22 @@ const char *cop_names[] = {
 	"PUSH",	//!< Empilement sur la pile d'excution 
 	"POP",	//!< Dpilement de la pile d'excution
 	"HALT",	//!< Arrt (normal) du programme
+	"MUL",	//!< Multiplication d'un registre
+	"DIV",	//!< Division (signe) d'un registre
+	"MOD",	//!< Reste de la division (signe) d'un registre
+	"AND",	//!< Et bit  bit
+	"OR",	//!< Ou bit  bit
+	"XOR",	//!< Ou exclusif bit  bit
+	"SHL",	//!< Dcalage  gauche
+	"SHR",	//!< Dcalage logique  droite
+	"SAR",	//!< Dcalage arithmtique  droite
+	"CMP",	//!< Comparaison
+	"BCOPY",	//!< Copie d'une plage de donnes
+	"BFILL",	//!< Remplissage d'une plage de donnes
+	"BCMP",	//!< Comparaison de deux plages de donnes
+	"CAS",	//!< Comparaison-change atomique
+	"XADD",	//!< Addition atomique
+	"FENCE",	//!< Barrire mmoire
 };
 
 //! Forme imprimable des conditions
@@ -27,6 +44,12 @@ const char *condition_names[] = {
 	"GE",	//!< Positif ou nul
 	"LT", //!< Strictement ngatif
 	"LE", //!< Ngatif ou null
+	"LO",	//!< Infrieur, sans signe
+	"HS",	//!< Suprieur ou gal, sans signe
+	"HI",	//!< Strictement suprieur, sans signe
+	"LS",	//!< Infrieur ou gal, sans signe
+	"VS",	//!< Dpassement de capacit sign
+	"VC",	//!< Pas de dpassement de capacit sign
 };
 
 //! Impression d'une instruction sous forme lisible (dsassemblage)
@@ -35,31 +58,65 @@ const char *condition_names[] = {
 * \param addr son adresse
 */
 void print_instruction(Instruction instr, unsigned addr) {
+	char buf[FORMAT_INSTRUCTION_MAX];
+	char *end = format_instruction(buf, instr, addr);
+	fwrite(buf, 1, end - buf, stdout);
+}
+
+//! Mise en forme d'une instruction (dsassemblage)
+/*!
+* \param p la position o crire (au moins \c FORMAT_INSTRUCTION_MAX octets)
+* \param instr l'instruction
+* \param addr son adresse
+* \return la position qui suit le texte produit
+*/
+char *format_instruction(char *p, Instruction instr, unsigned addr) {
 	Code_Op cop = instr.instr_generic._cop;
 
 	if (cop > LAST_COP)
 		error(ERR_UNKNOWN, addr);
 
-	printf("%s ", cop_names[cop]);
+	p = format_str(p, cop_names[cop]);
+	*p++ = ' ';
 
-	if (cop == ILLOP || cop == NOP || cop == RET || cop == HALT)
-		return;
+	if (cop == ILLOP || cop == NOP || cop == RET || cop == HALT || cop == FENCE)
+		return p;
 
 	if (cop == BRANCH || cop == CALL) {
 		if (instr.instr_generic._regcond > LAST_CONDITION)
 			error(ERR_CONDITION, addr);
 
-		printf("%s, ", condition_names[instr.instr_generic._regcond]);
+		p = format_str(p, condition_names[instr.instr_generic._regcond]);
+		p = format_str(p, ", ");
+	} else if (cop_is_block(cop)) {
+		*p++ = 'R';
+		p = format_udec(p, instr.instr_generic._regcond, 2);
+		p = format_str(p, ", R");
+		p = format_udec(p, instr.instr_indexed._rindex, 2);
+		p = format_str(p, ", R");
+		p = format_udec(p, instr.instr_indexed._offset & 0xf, 2);
+		return p;
 	} else if(cop != PUSH && cop != POP) {
-		printf("R%02u, ", instr.instr_generic._regcond);
+		*p++ = 'R';
+		p = format_udec(p, instr.instr_generic._regcond, 2);
+		p = format_str(p, ", ");
 	}
 
-	if (instr.instr_generic._immediate) {
-		printf("#%d", instr.instr_immediate._value);
+	if (instr.instr_generic._immediate && instr.instr_generic._indexed) {
+		*p++ = 'R';
+		p = format_udec(p, instr.instr_indexed._rindex, 2);
+	} else if (instr.instr_generic._immediate) {
+		*p++ = '#';
+		p = format_dec(p, instr.instr_immediate._value);
 	} else if (instr.instr_generic._indexed) {
-		printf("%d[R%02u]", instr.instr_indexed._offset, instr.instr_indexed._rindex);
+		p = format_dec(p, instr.instr_indexed._offset);
+		p = format_str(p, "[R");
+		p = format_udec(p, instr.instr_indexed._rindex, 2);
+		*p++ = ']';
 	}
 	else {
-		printf("@0x%04x", instr.instr_absolute._address);
+		p = format_str(p, "@0x");
+		p = format_hex(p, instr.instr_absolute._address, 4);
 	}
+	return p;
 }
@@ -24,10 +24,71 @@ typedef enum
     PUSH,	//!< Empilement sur la pile d'exécution 
     POP,	//!< Dépilement de la pile d'exécution
     HALT,	//!< Arrêt (normal) du programme
+    MUL,	//!< Multiplication d'un registre
+    DIV,	//!< Division (signée) d'un registre
+    MOD,	//!< Reste de la division (signée) d'un registre
+    AND,	//!< Et bit à bit
+    OR,		//!< Ou bit à bit
+    XOR,	//!< Ou exclusif bit à bit
+    SHL,	//!< Décalage à gauche
+    SHR,	//!< Décalage logique à droite
+    SAR,	//!< Décalage arithmétique à droite
+    CMP,	//!< Comparaison (soustraction qui ne modifie que le code condition)
+    BCOPY,	//!< Copie d'une plage de données
+    BFILL,	//!< Remplissage d'une plage de données
+    BCMP,	//!< Comparaison de deux plages de données
+    CAS,	//!< Comparaison-échange atomique
+    XADD,	//!< Addition atomique à un mot de données
+    FENCE,	//!< Barrière mémoire
 } Code_Op;
 
 //! Dernière valeur possible du code opération
-const static unsigned LAST_COP = HALT;
+const static unsigned LAST_COP = FENCE;
+
+//! L'instruction opère-t-elle sur une plage de données ?
+/*!
+ * Ces instructions n'ont que des registres pour opérandes, rangés au format
+ * indexé : \c _regcond et \c _rindex, puis le numéro du troisième registre
+ * dans les 4 bits de poids faible de \c _offset (les bits de mode sont
+ * ignorés). Le premier registre contient l'adresse de la plage destination,
+ * le second celle de la plage source (la valeur de remplissage pour \c
+ * BFILL) et le troisième le nombre de mots.
+ *
+ * \param cop le code opération
+ */
+static inline bool cop_is_block(unsigned cop)
+{
+    return cop >= BCOPY && cop <= BCMP;
+}
+
+//! L'instruction est-elle une opération atomique sur un mot de données ?
+/*!
+ * \c CAS et \c XADD ont les modes d'adressage de \c STORE (absolu ou
+ * indexé). <tt>CAS Rn, adr</tt> range \c R(n+1) (modulo 16) à l'adresse si
+ * elle contient \c Rn ; dans tous les cas \c Rn reçoit l'ancien contenu du
+ * mot et le code condition est celui de sa comparaison avec \c Rn (\c EQ
+ * si l'échange a eu lieu). <tt>XADD Rn, adr</tt> ajoute \c Rn au mot,
+ * range son ancien contenu dans \c Rn et positionne le code condition comme
+ * l'addition. \c FENCE n'a pas d'opérande.
+ *
+ * \param cop le code opération
+ */
+static inline bool cop_is_atomic(unsigned cop)
+{
+    return cop >= CAS && cop <= FENCE;
+}
+
+//! L'instruction accepte-t-elle un registre comme opérande source ?
+/*!
+ * Ce sont les instructions de calcul, y compris \c LOAD (copie d'un
+ * registre) et \c CMP.
+ *
+ * \param cop le code opération
+ */
+static inline bool cop_has_register_form(unsigned cop)
+{
+    return cop == LOAD || cop == ADD || cop == SUB || (cop >= MUL && cop <= CMP);
+}
 
 
 //! Structure d'une instruction 
@@ -48,6 +109,11 @@ const static unsigned LAST_COP = HALT;
  * qu'à des types de nature entière et pas à des structures ni des unions. Ceci
  * nous oblige donc à avoir une union de structures, chaque structure reprenant
  * les champs communs.
+ *
+ * Une instruction dont les bits \c _immediate et \c _indexed sont tous deux
+ * positionnés a pour opérande source le registre \c _rindex (format indexé,
+ * déplacement nul) : c'est la forme registre à registre des instructions de
+ * calcul (voir cop_has_register_form()).
  */
 typedef union Instruction
 { 
@@ -101,7 +167,12 @@ typedef union Instruction
 /*!
  * Ces valeurs sont associées à l'instruction de branchement (\c BRANCH et \c CALL) et
  * déterminent la condition à tester par référence à la valeur du code
- * condition (\link Condition_Code \endlink).
+ * condition (\link Flags \endlink).
+ *
+ * Les conditions \c GT à \c LE comparent en arithmétique signée : après une
+ * soustraction, elles tiennent compte du dépassement de capacité et
+ * comparent donc correctement les deux opérandes. Les conditions \c LO à
+ * \c LS les comparent en arithmétique non signée (par la retenue).
  * 
  * Une valeur de ce type remplace le numéro de registres dans les isntructions
  * \c BRANCH et \c CALL.
@@ -115,10 +186,16 @@ typedef enum
     GE,	//!< Positif ou nul
     LT, //!< Strictement négatif
     LE, //!< Négatif ou null
+    LO,	//!< Inférieur, sans signe (retenue ou emprunt)
+    HS,	//!< Supérieur ou égal, sans signe (pas de retenue)
+    HI,	//!< Strictement supérieur, sans signe
+    LS,	//!< Inférieur ou égal, sans signe
+    VS,	//!< Dépassement de capacité signé
+    VC,	//!< Pas de dépassement de capacité signé
 } Condition;
 
 //! Dernière valeur possible d'une condition
-static const unsigned LAST_CONDITION = LE;
+static const unsigned LAST_CONDITION = VC;
 
 //! Type d'un mot de donnée
 typedef uint32_t Word;
@@ -136,4 +213,16 @@ extern const char *condition_names[];
  */
 void print_instruction(Instruction instr, unsigned addr);
 
+//! Mise en forme d'une instruction (désassemblage)
+/*!
+ * Produit le même texte que print_instruction(), sans le terminer par un
+ * caractère nul (voir format.h).
+ *
+ * \param p la position où écrire (au moins \c FORMAT_INSTRUCTION_MAX octets)
+ * \param instr l'instruction
+ * \param addr son adresse
+ * \return la position qui suit le texte produit
+ */
+char *format_instruction(char *p, Instruction instr, unsigned addr);
+
 #endif
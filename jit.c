@@ -0,0 +1,677 @@
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <setjmp.h>
+#include "jit.h"
+#include "decode.h"
+#include "error.h"
+#include "exec.h"
+#include "guard.h"
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#define JIT_NATIVE 1
+#else
+#define JIT_NATIVE 0
+#endif
+
+//! Code natif d'un bloc : rend l'adresse de la prochaine instruction
+/*!
+ * Une sortie lente rend l'adresse de l'instruction fautive marquée par \c
+ * JIT_SLOWPATH : cette instruction doit être interprétée.
+ */
+typedef unsigned (*Jit_Code)(Machine *pmach);
+
+//! Marque d'une sortie lente dans l'adresse rendue par le code natif
+#define JIT_SLOWPATH 0x80000000u
+
+//! Point d'entrée dans le texte
+typedef struct
+{
+	Jit_Code _code;		//!< Code natif (NULL si non compilé)
+	unsigned _count;	//!< Nombre d'exécutions interprétées
+} Jit_Entry;
+
+//! État du compilateur pour une exécution
+typedef struct
+{
+	Machine *_pmach;	//!< Machine simulée
+	Jit_Entry *_entries;	//!< Points d'entrée, un par adresse de texte
+	unsigned *_end;		//!< Fin (exclue) du bloc commençant à chaque adresse
+	uint8_t *_buf;		//!< Tampon de code natif
+	size_t _used;		//!< Taille utilisée dans le tampon
+} Jit;
+
+//! Taille maximale du code natif d'une instruction (octets)
+#define JIT_MAXINSTR 128
+
+bool jit_available(void) {
+	return JIT_NATIVE;
+}
+
+//! Allocation avec arrêt du simulateur en cas d'échec
+/*!
+ * \param size la taille à allouer
+ */
+static void *jit_alloc(size_t size) {
+	void *p = calloc(1, size);
+	if (p == NULL) {
+		perror("jit");
+		exit(1);
+	}
+	return p;
+}
+
+//! Interprétation d'un bloc par l'interpréteur de référence
+/*!
+ * On s'arrête aussi dès qu'un branchement est pris, pour que chaque entrée
+ * dans un bloc soit comptée.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ * \param end adresse (exclue) de fin du bloc
+ * \return faux après l'exécution de \c HALT ; vrai sinon
+ */
+static bool interpret_block(Machine *pmach, unsigned end) {
+	unsigned pc;
+	do {
+		pc = pmach->_pc;
+		if (pc >= pmach->_textsize)
+			error(ERR_SEGTEXT, pc);
+		if (!decode_execute(pmach, pmach->_text[pmach->_pc++]))
+			return false;
+	} while (pmach->_pc == pc + 1 && pmach->_pc < end);
+	return true;
+}
+
+#if JIT_NATIVE
+
+//! Registres x86-64 utilisés
+enum { EAX = 0, ECX = 1, EDX = 2 };
+
+//! Tampon d'émission du code d'un bloc
+typedef struct
+{
+	uint8_t *_p;		//!< Position courante
+	uint8_t *_stubs[2048];	//!< Déplacements rel32 à reprendre vers les sorties lentes
+	unsigned _stubpc[2048];	//!< Adresse de l'instruction fautive pour chaque sortie
+	unsigned _nstubs;	//!< Nombre de sorties lentes
+	uint8_t *_exits[2048];	//!< Déplacements rel32 à reprendre vers l'épilogue
+	unsigned _nexits;	//!< Nombre de sauts vers l'épilogue
+} Emitter;
+
+static void emit8(Emitter *pe, uint8_t b) {
+	*pe->_p++ = b;
+}
+
+static void emit32(Emitter *pe, uint32_t v) {
+	memcpy(pe->_p, &v, 4);
+	pe->_p += 4;
+}
+
+//! Déplacement d'un registre invité dans la structure Machine
+static uint32_t guest_reg(unsigned r) {
+	return offsetof(Machine, _registers) + r * sizeof(Word);
+}
+
+//! mov reg, [rbx + disp] ou mov [rbx + disp], reg (opcode 0x8b ou 0x89)
+static void emit_rbx(Emitter *pe, uint8_t opcode, unsigned reg, uint32_t disp) {
+	emit8(pe, opcode);
+	emit8(pe, 0x80 | reg << 3 | 3);
+	emit32(pe, disp);
+}
+
+//! mov reg, [r12 + index*4] ou mov [r12 + index*4], reg
+static void emit_data_idx(Emitter *pe, uint8_t opcode, unsigned reg, unsigned index) {
+	emit8(pe, 0x41);
+	emit8(pe, opcode);
+	emit8(pe, 0x04 | reg << 3);
+	emit8(pe, 0x80 | index << 3 | 4);
+}
+
+//! mov reg, imm32
+static void emit_mov_imm(Emitter *pe, unsigned reg, uint32_t imm) {
+	emit8(pe, 0xb8 + reg);
+	emit32(pe, imm);
+}
+
+//! Saut conditionnel (0x0f xx) ou non (0xe9) vers une sortie lente
+static void emit_stub_jump(Emitter *pe, uint8_t cond, unsigned pc) {
+	if (cond) {
+		emit8(pe, 0x0f);
+		emit8(pe, cond);
+	}
+	else
+		emit8(pe, 0xe9);
+	pe->_stubs[pe->_nstubs] = pe->_p;
+	pe->_stubpc[pe->_nstubs++] = pc;
+	emit32(pe, 0);
+}
+
+//! Saut vers l'épilogue (la prochaine adresse est dans eax)
+static void emit_exit(Emitter *pe) {
+	emit8(pe, 0xe9);
+	pe->_exits[pe->_nexits++] = pe->_p;
+	emit32(pe, 0);
+}
+
+//! Sortie du bloc vers une adresse connue
+static void emit_exit_to(Emitter *pe, unsigned pc) {
+	emit_mov_imm(pe, EAX, pc);
+	emit_exit(pe);
+}
+
+//! Résolution d'un déplacement rel32 vers la position courante
+static void patch_here(Emitter *pe, uint8_t *at) {
+	int32_t rel = pe->_p - (at + 4);
+	memcpy(at, &rel, 4);
+}
+
+//! Saut court (rel8) à reprendre par patch8_here()
+static uint8_t *emit_jump8(Emitter *pe, uint8_t opcode) {
+	emit8(pe, opcode);
+	emit8(pe, 0);
+	return pe->_p - 1;
+}
+
+//! Résolution d'un déplacement rel8 vers la position courante
+static void patch8_here(Emitter *pe, uint8_t *at) {
+	*at = pe->_p - (at + 1);
+}
+
+//! Code condition d'une opération : opérandes dans eax et ecx (voir Flags)
+static void emit_flags(Emitter *pe, Flags_Source source) {
+	emit_rbx(pe, 0x89, EAX, offsetof(Machine, _cc._first));
+	emit_rbx(pe, 0x89, ECX, offsetof(Machine, _cc._second));
+	emit8(pe, 0xc6); emit8(pe, 0x83);			// mov byte [rbx + _source], source
+	emit32(pe, offsetof(Machine, _cc._source));
+	emit8(pe, source);
+}
+
+//! Code condition d'un chargement : addition de ecx à 0
+static void emit_flags_load(Emitter *pe) {
+	emit8(pe, 0x31); emit8(pe, 0xc0);			// xor eax, eax
+	emit_flags(pe, FLAGS_ADD);
+}
+
+//! Adresse de donnée de l'opérande dans eax, vérifiée
+/*!
+ * \param pe le tampon d'émission
+ * \param pd l'instruction (adressage absolu ou indexé)
+ * \param indexed adressage indexé ?
+ * \param pc l'adresse de l'instruction
+ * \param datasize la taille du segment de données
+ * \return faux si l'adresse absolue est hors du segment (l'instruction ne
+ * peut pas être compilée)
+ */
+static bool emit_data_address(Emitter *pe, const Decoded *pd, bool indexed,
+                              unsigned pc, unsigned datasize) {
+	if (!indexed) {
+		if ((unsigned) pd->_operand >= datasize)
+			return false;
+		emit_mov_imm(pe, EAX, pd->_operand);
+		return true;
+	}
+	emit_rbx(pe, 0x8b, EAX, guest_reg(pd->_rindex));	// mov eax, Rx
+	emit8(pe, 0x05);					// add eax, offset
+	emit32(pe, pd->_operand);
+	emit8(pe, 0x3d);					// cmp eax, datasize
+	emit32(pe, datasize);
+	emit_stub_jump(pe, 0x83, pc);				// jae stub
+	return true;
+}
+
+//! Empilement de ecx : data[SP--] = ecx
+static void emit_push_ecx(Emitter *pe) {
+	emit_rbx(pe, 0x8b, EDX, guest_reg(NREGISTERS - 1));	// mov edx, SP
+	emit_data_idx(pe, 0x89, ECX, EDX);			// mov [r12 + rdx*4], ecx
+	emit8(pe, 0xff); emit8(pe, 0xca);			// dec edx
+	emit_rbx(pe, 0x89, EDX, guest_reg(NREGISTERS - 1));	// mov SP, edx
+}
+
+//! Codes des conditions x86 (setcc) équivalentes à chaque condition
+static const uint8_t x86_conditions[] = {
+	[EQ] = 0x4, [NE] = 0x5, [GT] = 0xf, [GE] = 0xd, [LT] = 0xc, [LE] = 0xe,
+	[LO] = 0x2, [HS] = 0x3, [HI] = 0x7, [LS] = 0x6, [VS] = 0x0, [VC] = 0x1,
+};
+
+//! Test de condition : CF = condition satisfaite (eax est préservé)
+/*!
+ * L'opération qui a produit le code condition est refaite par le processeur
+ * hôte, dont les indicateurs ont la même définition que ceux de flags_of().
+ */
+static void emit_test_condition(Emitter *pe, Condition cond) {
+	uint8_t *unknown, *add, *set, *done;
+
+	emit8(pe, 0x0f); emit8(pe, 0xb6); emit8(pe, 0x93);	// movzx edx, byte [rbx + _source]
+	emit32(pe, offsetof(Machine, _cc._source));
+	emit_rbx(pe, 0x8b, ECX, offsetof(Machine, _cc._first));
+	emit_rbx(pe, 0x8b, 6, offsetof(Machine, _cc._second));	// mov esi, [rbx + _second]
+	emit8(pe, 0x85); emit8(pe, 0xd2);			// test edx, edx
+	unknown = emit_jump8(pe, 0x74);				// jz unknown
+	emit8(pe, 0x83); emit8(pe, 0xfa); emit8(pe, FLAGS_SUB);	// cmp edx, FLAGS_SUB
+	add = emit_jump8(pe, 0x75);				// jne add
+	emit8(pe, 0x39); emit8(pe, 0xf1);			// cmp ecx, esi
+	set = emit_jump8(pe, 0xeb);				// jmp set
+	patch8_here(pe, add);
+	emit8(pe, 0x01); emit8(pe, 0xf1);			// add ecx, esi
+	patch8_here(pe, set);
+	emit8(pe, 0x0f); emit8(pe, 0x90 | x86_conditions[cond]); emit8(pe, 0xc2);	// setcc dl
+	done = emit_jump8(pe, 0xeb);				// jmp done
+	patch8_here(pe, unknown);
+	emit_mov_imm(pe, EDX, cond == NE);
+	patch8_here(pe, done);
+	emit8(pe, 0x0f); emit8(pe, 0xba); emit8(pe, 0xe2); emit8(pe, 0);	// bt edx, 0
+}
+
+//! Opérande source d'une instruction de calcul dans ecx
+/*!
+ * \param pe le tampon d'émission
+ * \param pd l'instruction
+ * \param mode le mode d'adressage (0 immédiat, 1 absolu, 2 indexé, 3 registre)
+ * \param pc l'adresse de l'instruction
+ * \param datasize la taille du segment de données
+ * \return faux si l'instruction ne peut pas être compilée
+ */
+static bool emit_source(Emitter *pe, const Decoded *pd, unsigned mode,
+                        unsigned pc, unsigned datasize) {
+	switch (mode) {
+	case 0:
+		emit_mov_imm(pe, ECX, pd->_operand);
+		return true;
+	case 3:
+		emit_rbx(pe, 0x8b, ECX, guest_reg(pd->_rindex));
+		return true;
+	default:
+		if (!emit_data_address(pe, pd, mode == 2, pc, datasize))
+			return false;
+		emit_data_idx(pe, 0x8b, ECX, EAX);
+		return true;
+	}
+}
+
+//! Code x86 de l'opération eax op= ecx, pour chaque instruction de calcul
+static const uint8_t x86_alu[][3] = {
+	[MUL - MUL] = { 0x0f, 0xaf, 0xc1 },	// imul eax, ecx
+	[AND - MUL] = { 0x21, 0xc8 },		// and eax, ecx
+	[OR - MUL] = { 0x09, 0xc8 },		// or eax, ecx
+	[XOR - MUL] = { 0x31, 0xc8 },		// xor eax, ecx
+	[SHL - MUL] = { 0xd3, 0xe0 },		// shl eax, cl
+	[SHR - MUL] = { 0xd3, 0xe8 },		// shr eax, cl
+	[SAR - MUL] = { 0xd3, 0xf8 },		// sar eax, cl
+};
+
+//! Compilation d'une instruction de calcul (MUL à CMP)
+/*!
+ * La division n'est pas compilée : le diviseur nul et le débordement sont
+ * laissés à l'interpréteur.
+ *
+ * \param pe le tampon d'émission
+ * \param pd l'instruction
+ * \param pc l'adresse de l'instruction
+ * \param datasize la taille du segment de données
+ * \return faux si l'instruction ne peut pas être compilée
+ */
+static bool emit_alu(Emitter *pe, const Decoded *pd, unsigned pc, unsigned datasize) {
+	Code_Op cop = MUL + (pd->_base - OP_MUL_I) / 4;
+	uint32_t reg = guest_reg(pd->_reg);
+
+	if (cop == DIV || cop == MOD)
+		return false;
+	if (!emit_source(pe, pd, (pd->_base - OP_MUL_I) % 4, pc, datasize))
+		return false;
+	emit_rbx(pe, 0x8b, EAX, reg);
+	if (cop == CMP) {
+		emit_flags(pe, FLAGS_SUB);
+		return true;
+	}
+	const uint8_t *code = x86_alu[cop - MUL];
+	emit8(pe, code[0]);
+	emit8(pe, code[1]);
+	if (cop == MUL)
+		emit8(pe, code[2]);
+	emit_rbx(pe, 0x89, EAX, reg);
+	emit8(pe, 0x89); emit8(pe, 0xc1);			// mov ecx, eax
+	emit_flags_load(pe);
+	return true;
+}
+
+//! Compilation d'une instruction
+/*!
+ * \param pe le tampon d'émission
+ * \param pmach la machine
+ * \param pc l'adresse de l'instruction
+ * \return faux si l'instruction ne peut pas être compilée
+ */
+static bool emit_instruction(Emitter *pe, Machine *pmach, unsigned pc) {
+	const Decoded *pd = &pmach->_decoded[pc];
+	unsigned datasize = pmach->_datasize;
+	unsigned textsize = pmach->_textsize;
+	uint32_t reg = guest_reg(pd->_reg);
+	uint8_t *skip;
+
+	if (pd->_base >= OP_MUL_I && pd->_base <= OP_CMP_R)
+		return emit_alu(pe, pd, pc, datasize);
+
+	switch (pd->_base) {
+	case OP_NOP:
+		return true;
+
+	case OP_LOAD_I:
+		emit_mov_imm(pe, ECX, pd->_operand);
+		emit_rbx(pe, 0x89, ECX, reg);
+		emit_flags_load(pe);
+		return true;
+	case OP_LOAD_A:
+	case OP_LOAD_X:
+		if (!emit_data_address(pe, pd, pd->_base == OP_LOAD_X, pc, datasize))
+			return false;
+		emit_data_idx(pe, 0x8b, ECX, EAX);
+		emit_rbx(pe, 0x89, ECX, reg);
+		emit_flags_load(pe);
+		return true;
+
+	case OP_LOAD_R:
+		emit_rbx(pe, 0x8b, ECX, guest_reg(pd->_rindex));
+		emit_rbx(pe, 0x89, ECX, reg);
+		emit_flags_load(pe);
+		return true;
+
+	case OP_STORE_A:
+	case OP_STORE_X:
+		if (!emit_data_address(pe, pd, pd->_base == OP_STORE_X, pc, datasize))
+			return false;
+		emit_rbx(pe, 0x8b, ECX, reg);
+		emit_data_idx(pe, 0x89, ECX, EAX);
+		return true;
+
+	case OP_ADD_I:
+	case OP_SUB_I:
+		emit_rbx(pe, 0x8b, EAX, reg);
+		emit_mov_imm(pe, ECX, pd->_operand);
+		emit_flags(pe, pd->_base == OP_ADD_I ? FLAGS_ADD : FLAGS_SUB);
+		emit8(pe, pd->_base == OP_ADD_I ? 0x01 : 0x29);
+		emit8(pe, 0xc8);					// add/sub eax, ecx
+		emit_rbx(pe, 0x89, EAX, reg);
+		return true;
+	case OP_ADD_A:
+	case OP_ADD_X:
+	case OP_SUB_A:
+	case OP_SUB_X:
+		if (!emit_data_address(pe, pd, pd->_base == OP_ADD_X || pd->_base == OP_SUB_X,
+				       pc, datasize))
+			return false;
+		bool add = pd->_base == OP_ADD_A || pd->_base == OP_ADD_X;
+		emit_data_idx(pe, 0x8b, ECX, EAX);
+		emit_rbx(pe, 0x8b, EAX, reg);
+		emit_flags(pe, add ? FLAGS_ADD : FLAGS_SUB);
+		emit8(pe, add ? 0x01 : 0x29);
+		emit8(pe, 0xc8);					// add/sub eax, ecx
+		emit_rbx(pe, 0x89, EAX, reg);
+		return true;
+
+	case OP_ADD_R:
+	case OP_SUB_R:
+		emit_rbx(pe, 0x8b, ECX, guest_reg(pd->_rindex));
+		emit_rbx(pe, 0x8b, EAX, reg);
+		emit_flags(pe, pd->_base == OP_ADD_R ? FLAGS_ADD : FLAGS_SUB);
+		emit8(pe, pd->_base == OP_ADD_R ? 0x01 : 0x29);
+		emit8(pe, 0xc8);					// add/sub eax, ecx
+		emit_rbx(pe, 0x89, EAX, reg);
+		return true;
+
+	case OP_PUSH_I:
+		emit_mov_imm(pe, ECX, pd->_operand);
+		emit_push_ecx(pe);
+		return true;
+	case OP_PUSH_A:
+	case OP_PUSH_X:
+		if (!emit_data_address(pe, pd, pd->_base == OP_PUSH_X, pc, datasize))
+			return false;
+		emit_data_idx(pe, 0x8b, ECX, EAX);
+		emit_push_ecx(pe);
+		return true;
+
+	case OP_POP_A:
+	case OP_POP_X:
+		if (!emit_data_address(pe, pd, pd->_base == OP_POP_X, pc, datasize))
+			return false;
+		emit_rbx(pe, 0x8b, EDX, guest_reg(NREGISTERS - 1));	// mov edx, SP
+		emit8(pe, 0xff); emit8(pe, 0xc2);			// inc edx
+		emit_rbx(pe, 0x89, EDX, guest_reg(NREGISTERS - 1));	// mov SP, edx
+		emit_data_idx(pe, 0x8b, ECX, EDX);			// mov ecx, [r12 + rdx*4]
+		emit_data_idx(pe, 0x89, ECX, EAX);			// mov [r12 + rax*4], ecx
+		return true;
+
+	case OP_BRANCH_A:
+	case OP_CALL_A:
+		if ((unsigned) pd->_operand >= textsize)
+			return false;
+		emit_mov_imm(pe, EAX, pd->_operand);
+		break;
+	case OP_BRANCH_X:
+	case OP_CALL_X:
+		emit_rbx(pe, 0x8b, EAX, guest_reg(pd->_rindex));
+		emit8(pe, 0x05);
+		emit32(pe, pd->_operand);
+		emit8(pe, 0x3d);
+		emit32(pe, textsize);
+		emit_stub_jump(pe, 0x83, pc);
+		break;
+
+	case OP_RET:
+		emit_rbx(pe, 0x8b, EDX, guest_reg(NREGISTERS - 1));	// mov edx, SP
+		emit8(pe, 0xff); emit8(pe, 0xc2);			// inc edx
+		emit_rbx(pe, 0x89, EDX, guest_reg(NREGISTERS - 1));	// mov SP, edx
+		emit_data_idx(pe, 0x8b, EAX, EDX);			// mov eax, [r12 + rdx*4]
+		emit_exit(pe);
+		return true;
+
+	default:
+		return false;
+	}
+
+	// Branchement ou appel : la cible est dans eax
+	bool call = pd->_base == OP_CALL_A || pd->_base == OP_CALL_X;
+
+	if (pd->_reg != NC) {
+		emit_test_condition(pe, pd->_reg);
+		if (!call) {
+			emit_mov_imm(pe, EDX, pc + 1);
+			emit8(pe, 0x0f); emit8(pe, 0x43); emit8(pe, 0xc2);	// cmovnc eax, edx
+			emit_exit(pe);
+			return true;
+		}
+		emit8(pe, 0x0f); emit8(pe, 0x83);			// jnc skip
+		skip = pe->_p;
+		emit32(pe, 0);
+	}
+	else
+		skip = NULL;
+
+	if (call) {
+		emit_mov_imm(pe, ECX, pc + 1);
+		emit_push_ecx(pe);
+	}
+	emit_exit(pe);
+
+	if (skip != NULL) {
+		patch_here(pe, skip);
+		emit_exit_to(pe, pc + 1);
+	}
+	return true;
+}
+
+//! Compilation du bloc commençant à une adresse
+/*!
+ * \param pjit l'état du compilateur
+ * \param start l'adresse de la première instruction
+ * \return le code natif, ou NULL si le bloc ne peut pas être compilé
+ */
+static Jit_Code compile_block(Jit *pjit, unsigned start) {
+	Machine *pmach = pjit->_pmach;
+	unsigned end = pjit->_end[start];
+	size_t need = (end - start) * JIT_MAXINSTR + 64;
+
+	if (pjit->_buf == NULL || pjit->_used + need > JIT_BUFSIZE || end - start > 1024)
+		return NULL;
+	if (mprotect(pjit->_buf, JIT_BUFSIZE, PROT_READ | PROT_WRITE) != 0)
+		return NULL;
+
+	Emitter *pe = jit_alloc(sizeof(Emitter));
+	uint8_t *code = pjit->_buf + pjit->_used;
+	pe->_p = code;
+
+	// Prologue : rbx = machine, r12 = données ; le code condition reste dans
+	// la machine (voir emit_flags())
+	emit8(pe, 0x53);					// push rbx
+	emit8(pe, 0x41); emit8(pe, 0x54);			// push r12
+	emit8(pe, 0x48); emit8(pe, 0x89); emit8(pe, 0xfb);	// mov rbx, rdi
+	emit8(pe, 0x4c); emit8(pe, 0x8b); emit8(pe, 0xa7);	// mov r12, [rdi + _data]
+	emit32(pe, offsetof(Machine, _data));
+
+	unsigned pc;
+	bool terminated = false;
+	for (pc = start; pc < end && !terminated; ++pc) {
+		uint8_t *mark = pe->_p;
+		unsigned nstubs = pe->_nstubs, nexits = pe->_nexits;
+		if (!emit_instruction(pe, pmach, pc)) {
+			// On rend la main à l'interpréteur sur cette instruction
+			pe->_p = mark;
+			pe->_nstubs = nstubs;
+			pe->_nexits = nexits;
+			break;
+		}
+		switch (pmach->_decoded[pc]._base) {
+		case OP_BRANCH_A:
+		case OP_BRANCH_X:
+		case OP_CALL_A:
+		case OP_CALL_X:
+		case OP_RET:
+			terminated = true;
+		}
+	}
+
+	if (pc == start) {
+		free(pe);
+		mprotect(pjit->_buf, JIT_BUFSIZE, PROT_READ | PROT_EXEC);
+		return NULL;
+	}
+	if (!terminated)
+		emit_exit_to(pe, pc);
+
+	// Sorties lentes : retour à l'interpréteur sur l'instruction fautive
+	for (unsigned i = 0; i < pe->_nstubs; ++i) {
+		patch_here(pe, pe->_stubs[i]);
+		emit_exit_to(pe, pe->_stubpc[i] | JIT_SLOWPATH);
+	}
+
+	// Épilogue
+	for (unsigned i = 0; i < pe->_nexits; ++i)
+		patch_here(pe, pe->_exits[i]);
+	emit8(pe, 0x41); emit8(pe, 0x5c);			// pop r12
+	emit8(pe, 0x5b);					// pop rbx
+	emit8(pe, 0xc3);					// ret
+
+	pjit->_used += pe->_p - code;
+	free(pe);
+	mprotect(pjit->_buf, JIT_BUFSIZE, PROT_READ | PROT_EXEC);
+
+	Jit_Code fn;
+	memcpy(&fn, &code, sizeof(fn));
+	return fn;
+}
+
+#endif
+
+//! Libération de l'état du compilateur
+/*!
+ * \param pjit l'état du compilateur
+ */
+static void jit_release(Jit *pjit) {
+#if JIT_NATIVE
+	if (pjit->_buf != NULL)
+		munmap(pjit->_buf, JIT_BUFSIZE);
+#endif
+	free(pjit->_entries);
+	free(pjit->_end);
+}
+
+//! Exécution avec compilation à la volée
+/*!
+ * \param pmach la machine/programme en cours d'exécution
+ */
+void exec_jit(Machine *pmach) {
+	unsigned textsize = pmach->_textsize;
+	Jit jit = {
+		._pmach = pmach,
+		._entries = jit_alloc((textsize + 1) * sizeof(Jit_Entry)),
+		._end = jit_alloc((textsize + 1) * sizeof(unsigned)),
+	};
+
+	// Fin de bloc pour chaque point d'entrée possible
+	bool *leader = jit_alloc(textsize + 1);
+	for (unsigned b = 0; b < pmach->_nblocks; ++b)
+		leader[pmach->_blocks[b]._start] = true;
+	jit._end[textsize] = textsize;
+	for (unsigned i = textsize; i-- > 0; )
+		jit._end[i] = leader[i + 1] ? i + 1 : jit._end[i + 1];
+	free(leader);
+
+#if JIT_NATIVE
+	// Le code natif ne vérifie pas les accès à la pile : sans zone de garde,
+	// tout le programme est interprété
+	if (pmach->_guarded) {
+		jit._buf = mmap(NULL, JIT_BUFSIZE, PROT_READ | PROT_EXEC,
+				MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (jit._buf == MAP_FAILED)
+			jit._buf = NULL;
+	}
+#endif
+
+	// Une erreur quitte exec_jit() par longjmp : l'état du compilateur est
+	// libéré avant de la retransmettre au point de récupération englobant
+	Error_Trap trap = { ._silent = error_silent() };
+	error_trap(&trap);
+	if (setjmp(trap._env) != 0) {
+		guard_leave();
+		jit_release(&jit);
+		if (error_trapped())
+			error_raise(trap._err, trap._addr, trap._detail);
+		error(trap._err, trap._addr);
+	}
+
+	guard_enter(pmach, NULL, NULL, NULL);
+	bool running = true;
+	while (running) {
+		unsigned pc = pmach->_pc;
+		if (pc >= textsize)
+			error(ERR_SEGTEXT, pc);
+
+		Jit_Entry *pe = &jit._entries[pc];
+		if (pe->_code != NULL) {
+			unsigned next = pe->_code(pmach);
+			pmach->_pc = next & ~JIT_SLOWPATH;
+			// L'instruction fautive est exécutée par l'interpréteur, qui
+			// signale l'erreur, avant de revenir au code natif
+			if (next & JIT_SLOWPATH)
+				running = interpret_block(pmach, pmach->_pc + 1);
+			continue;
+		}
+#if JIT_NATIVE
+		if (pe->_count == JIT_THRESHOLD) {
+			pe->_count++;
+			if ((pe->_code = compile_block(&jit, pc)) != NULL)
+				continue;
+		}
+		else
+#endif
+			pe->_count++;
+		running = interpret_block(pmach, jit._end[pc]);
+	}
+	guard_leave();
+	error_untrap(&trap);
+	jit_release(&jit);
+}
@@ -0,0 +1,60 @@
+#ifndef _JIT_H_
+#define _JIT_H_
+
+/*!
+ * \file jit.h
+ * \brief Compilation à la volée (JIT) du code fréquemment exécuté.
+ */
+
+#include <stdbool.h>
+
+#include "machine.h"
+
+//! Nombre d'exécutions d'un bloc avant sa compilation
+#define JIT_THRESHOLD 50
+
+//! Taille du tampon de code natif (en octets)
+#define JIT_BUFSIZE (4 << 20)
+
+//! La compilation en code natif est-elle disponible sur cette plateforme ?
+/*!
+ * Le générateur de code ne produit que du code x86-64. Ailleurs, exec_jit()
+ * se contente d'interpréter le programme.
+ */
+bool jit_available(void);
+
+//! Exécution avec compilation à la volée
+/*!
+ * Le programme est exécuté bloc par bloc à partir de l'instruction pointée par
+ * \c _pc. Chaque point d'entrée de bloc dispose d'un compteur d'exécutions ;
+ * tant qu'il est inférieur à \c JIT_THRESHOLD le bloc est interprété par
+ * decode_execute(), qui reste l'implémentation de référence. Au-delà, le bloc
+ * est compilé en code natif x86-64 dans un tampon exécutable obtenu par \c
+ * mmap.
+ *
+ * Le code natif travaille directement sur les registres de la machine (qui
+ * lui servent d'emplacements de sauvegarde) et y range aussi le code
+ * condition, évalué à la demande comme dans l'interpréteur (opérandes de la
+ * dernière opération, voir Flags). Les adresses indexées sont comparées à la
+ * taille de leur segment ; si la comparaison échoue, le code natif rend la
+ * main à l'interpréteur, qui exécute l'instruction fautive et signale
+ * l'erreur comme en mode interprété. \c HALT, les instructions erronées et
+ * les moins courantes (\c DIV, \c MOD, instructions sur des plages de
+ * données, instructions atomiques) ne sont jamais compilées : elles sont
+ * interprétées.
+ *
+ * Les accès à la pile, eux, ne sont pas vérifiés : un débordement tombe dans
+ * la zone de garde du segment (voir guard.h). Le compteur ordinal de la
+ * machine n'étant pas tenu à jour dans un bloc compilé, l'erreur est alors
+ * signalée à l'adresse de la première instruction du bloc, et non à celle de
+ * l'instruction fautive, et les registres reflètent les instructions du bloc
+ * déjà exécutées. Un programme dont le segment n'a pas de zone de garde n'est
+ * jamais compilé.
+ *
+ * Il n'y a ni trace ni mise au point dans ce mode.
+ *
+ * \param pmach la machine/programme en cours d'exécution
+ */
+void exec_jit(Machine *pmach);
+
+#endif
@@ -1,8 +1,21 @@
+#define _DEFAULT_SOURCE
 #include <stdio.h>
+#include <string.h>
+#include <limits.h>
+#include <setjmp.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "machine.h"
 #include "error.h"
 #include "debug.h"
 #include "exec.h"
+#include "decode.h"
+#include "snapshot.h"
+#include "image.h"
+#include "format.h"
+#include "guard.h"
 
 const char cc_names[] = {
     'U',
@@ -12,38 +25,177 @@ const char cc_names[] = {
 };
 
 void config_error(const char *programfile, const char *error) {
+    if (error_trapped())
+        error_raise(ERR_PROGFILE, 0, error);
     fprintf(stderr, "Bad program file %s: %s\n", programfile, error);
     exit(1);
 }
 
-//! Chargement d'un programme
+//! Erreur de chargement concernant une instruction
 /*!
-* La machine est rinitialise et ses segments de texte et de donnes sont
-* remplacs par ceux fournis en paramtre.
-*
-* \param pmach la machine en cours d'excution
+ * \param programfile le nom du fichier binaire
+ * \param error le message
+ * \param addr l'adresse de l'instruction fautive
+ */
+static void config_error_at(const char *programfile, const char *error, unsigned addr) {
+    if (error_trapped())
+        error_raise(ERR_PROGFILE, addr, error);
+    fprintf(stderr, "Bad program file %s: %s at address 0x%x\n", programfile, error, addr);
+    exit(1);
+}
+
+//! Initialisation d'une machine dont le segment de donnes est en place
+/*!
+* \param pmach la machine, dont \c _data et \c _guarded sont dj remplis
 * \param textsize taille utile du segment de texte
 * \param text le contenu du segment de texte
 * \param datasize taille utile du segment de donnes
-* \param data le contenu initial du segment de texte
+* \param dataend premire adresse libre aprs les donnes statiques
 */
-void load_program(Machine *pmach,
+static void setup_program(Machine *pmach,
     unsigned textsize, Instruction text[textsize],
-    unsigned datasize, Word data[datasize], unsigned dataend) {
+    unsigned datasize, unsigned dataend) {
 
     pmach->_text = text;
     pmach->_textsize = textsize;
-    pmach->_data = data;
     pmach->_datasize = datasize;
     pmach->_dataend = dataend;
 
     pmach->_pc = 0;
-    pmach->_cc = CC_U;
+    pmach->_cc = (Flags) { 0, 0, FLAGS_NONE };
+    pmach->_tracebuf = NULL;
+    pmach->_allocated = false;
+    pmach->_map = NULL;
+    pmach->_mapsize = 0;
+    pmach->_snapshot = NULL;
+    pmach->_symbols = NULL;
+    pmach->_nsymbols = 0;
+    pmach->_debugger = NULL;
+    pmach->_fault = ERR_NOERROR;
+    pmach->_faultaddr = 0;
 
     for (int i = 0; i < (NREGISTERS - 1); ++i) {
         pmach->_registers[i] = 0;
     }
     pmach->_sp = datasize - 1;
+
+    decode_program(pmach);
+}
+
+//! Chargement d'un programme
+/*!
+* La machine est rinitialise et ses segments de texte et de donnes sont
+* remplacs par ceux fournis en paramtre.
+*
+* \param pmach la machine en cours d'excution
+* \param textsize taille utile du segment de texte
+* \param text le contenu du segment de texte
+* \param datasize taille utile du segment de donnes
+* \param data le contenu initial du segment de donnes (recopi)
+* \return faux si le segment de donnes n'a pu tre allou
+*/
+bool load_program(Machine *pmach,
+    unsigned textsize, Instruction text[textsize],
+    unsigned datasize, Word data[datasize], unsigned dataend) {
+
+    if ((pmach->_data = guard_alloc(datasize, &pmach->_guarded)) == NULL)
+        return false;
+    memcpy(pmach->_data, data, datasize * sizeof(Word));
+    setup_program(pmach, textsize, text, datasize, dataend);
+    return true;
+}
+
+//! Vrification des dimensions des segments
+/*!
+ * \param sizes les tailles lues dans l'entte du fichier
+ * \param filesize la taille du fichier (en octets)
+ * \return NULL si les dimensions sont correctes, le message d'erreur sinon
+ */
+static const char *check_sizes(const unsigned sizes[3], uint64_t filesize) {
+    uint64_t textend = 3 * sizeof(unsigned) + (uint64_t) sizes[0] * sizeof(Instruction);
+    uint64_t dataend = textend + (uint64_t) sizes[1] * sizeof(Word);
+
+    if (textend > filesize)
+        return "Text segment shorter than declared";
+    if (dataend > filesize)
+        return "Data segment shorter than declared";
+    if (sizes[2] > sizes[1])
+        return "Data length greater than memory size";
+    if ((sizes[1] - sizes[2]) < MINSTACKSIZE)
+        return "Not enough room for stack";
+    return NULL;
+}
+
+//! Vrification d'une image version 2 dcode
+/*!
+ * En cas d'erreur, le programme dcod est libr.
+ *
+ * \param pimg le programme dcod
+ * \return NULL si le programme est correct, le message d'erreur sinon
+ */
+static const char *check_image(Image *pimg) {
+    const char *problem = NULL;
+
+    if (pimg->_dataend > pimg->_datasize)
+        problem = "Data length greater than memory size";
+    else if ((pimg->_datasize - pimg->_dataend) < MINSTACKSIZE)
+        problem = "Not enough room for stack";
+    else if (pimg->_entry != 0 && pimg->_entry >= pimg->_textsize)
+        problem = "Entry point outside of text segment";
+
+    if (problem != NULL) {
+        free(pimg->_text);
+        free(pimg->_data);
+        image_free_symbols(pimg->_symbols, pimg->_nsymbols);
+    }
+    return problem;
+}
+
+//! Chargement d'une image version 2 dcode et vrifie
+/*!
+ * \param pmach la machine  simuler
+ * \param programfile le nom du fichier binaire
+ * \param pimg le programme dcod (la machine en devient propritaire)
+ */
+static void load_image(Machine *pmach, const char *programfile, Image *pimg) {
+    bool loaded = load_program(pmach, pimg->_textsize, pimg->_text,
+                               pimg->_datasize, pimg->_data, pimg->_dataend);
+    free(pimg->_data);
+    if (!loaded) {
+        free(pimg->_text);
+        image_free_symbols(pimg->_symbols, pimg->_nsymbols);
+        config_error(programfile, "Cannot allocate data segment");
+    }
+    pmach->_allocated = true;
+    pmach->_pc = pimg->_entry;
+    pmach->_symbols = pimg->_symbols;
+    pmach->_nsymbols = pimg->_nsymbols;
+}
+
+//! Lecture d'une image version 2
+/*!
+ * \param pmach la machine  simuler
+ * \param programfile le nom du fichier binaire
+ * \param file le fichier ouvert (il est ferm)
+ * \param size sa taille
+ */
+static void read_image(Machine *pmach, const char *programfile, FILE *file, size_t size) {
+    const char *problem = NULL;
+    Image img;
+    void *buf = malloc(size);
+
+    if (buf == NULL)
+        problem = "Not enough memory";
+    else if (fseek(file, 0, SEEK_SET) != 0 || fread(buf, 1, size, file) < size)
+        problem = "Cannot read program file";
+    fclose(file);
+
+    if (problem == NULL && (problem = image_decode(buf, size, &img)) == NULL)
+        problem = check_image(&img);
+    free(buf);
+    if (problem != NULL)
+        config_error(programfile, problem);
+    load_image(pmach, programfile, &img);
 }
 
 //! Lecture d'un programme depuis un fichier binaire
@@ -63,35 +215,291 @@ void load_program(Machine *pmach,
 * Tous les entiers font 32 bits et les adresses de chaque segment commencent 
 * 0. La fonction initialise compltement la machine.
 *
+* Les images au format version 2 (voir image.h) sont reconnues  leur entte.
+*
 * \param pmach la machine  simuler
 * \param programfile le nom du fichier binaire
 *
 */
 void read_program(Machine *mach, const char *programfile) {
     FILE *file;
-    if (!(file = fopen(programfile, "r")))
+    if (!(file = fopen(programfile, "rb")))
         config_error(programfile, "Cannot open program file");
 
     unsigned sizes[3];
+    struct stat st;
+    const char *problem = NULL;
+    Instruction *text = NULL;
+    Word *data = NULL;
+
     if (fread(sizes, sizeof(unsigned), 3, file) < 3)
+        problem = "Incorrect segment dimensions";
+    else if (fstat(fileno(file), &st) != 0)
+        problem = "Cannot open program file";
+    else if (image_is_v2(sizes, sizeof(sizes))) {
+        read_image(mach, programfile, file, st.st_size);
+        return;
+    }
+    else if ((problem = check_sizes(sizes, st.st_size)) == NULL) {
+        text = malloc(sizes[0] * sizeof(Instruction) + 1);
+        data = malloc(sizes[1] * sizeof(Word) + 1);
+        if (text == NULL || data == NULL)
+            problem = "Not enough memory";
+        else if (fread(text, sizeof(Instruction), sizes[0], file) < sizes[0])
+            problem = "Text segment shorter than declared";
+        else if (fread(data, sizeof(Word), sizes[1], file) < sizes[1])
+            problem = "Data segment shorter than declared";
+    }
+    fclose(file);
+
+    if (problem != NULL) {
+        free(text);
+        free(data);
+        config_error(programfile, problem);
+    }
+
+    bool loaded = load_program(mach, sizes[0], text, sizes[1], data, sizes[2]);
+    free(data);
+    if (!loaded) {
+        free(text);
+        config_error(programfile, "Cannot allocate data segment");
+    }
+    mach->_allocated = true;
+}
+
+//! Vrification des instructions du segment de texte
+/*!
+ * La boucle n'a pas de branchement dpendant des donnes : elle accumule les
+ * anomalies dans un seul mot, ce qui permet au compilateur de la vectoriser.
+ * On ne recherche la premire instruction fautive que si une anomalie a t
+ * dtecte.
+ *
+ * \param text le segment de texte
+ * \param textsize sa taille
+ * \param paddr adresse de la premire instruction incorrecte (rsultat)
+ * \return NULL si le texte est correct, le message d'erreur sinon
+ */
+static const char *check_text(const Instruction *text, unsigned textsize, unsigned *paddr) {
+    unsigned bad = 0;
+    for (unsigned i = 0; i < textsize; ++i) {
+        unsigned cop = text[i].instr_generic._cop;
+        unsigned cond = text[i].instr_generic._regcond;
+        bad |= (cop > LAST_COP)
+            | ((cop == BRANCH || cop == CALL) & (cond > LAST_CONDITION));
+    }
+    if (!bad)
+        return NULL;
+
+    for (unsigned i = 0; i < textsize; ++i) {
+        unsigned cop = text[i].instr_generic._cop;
+        *paddr = i;
+        if (cop > LAST_COP)
+            return "Unknown instruction";
+        if ((cop == BRANCH || cop == CALL)
+            && text[i].instr_generic._regcond > LAST_CONDITION)
+            return "Illegal condition";
+    }
+    return NULL;
+}
+
+//! Chargement d'une image version 2 projete en mmoire
+/*!
+ * Les donnes tant compresses, l'image ne peut tre utilise en place : elle
+ * est dcode puis la projection est libre.
+ *
+ * \param pmach la machine  simuler
+ * \param programfile le nom du fichier binaire
+ * \param map la projection du fichier
+ * \param mapsize sa taille
+ */
+static void map_image(Machine *pmach, const char *programfile, void *map, size_t mapsize) {
+    Image img;
+    const char *problem = image_decode(map, mapsize, &img);
+    munmap(map, mapsize);
+    if (problem == NULL)
+        problem = check_image(&img);
+    if (problem != NULL)
+        config_error(programfile, problem);
+
+    unsigned addr;
+    if ((problem = check_text(img._text, img._textsize, &addr)) != NULL) {
+        free(img._text);
+        free(img._data);
+        image_free_symbols(img._symbols, img._nsymbols);
+        config_error_at(programfile, problem, addr);
+    }
+    load_image(pmach, programfile, &img);
+}
+
+//! Projection d'un programme depuis un fichier binaire
+/*!
+ * \param pmach la machine  simuler
+ * \param programfile le nom du fichier binaire
+ */
+void map_program(Machine *pmach, const char *programfile) {
+    int fd = open(programfile, O_RDONLY);
+    if (fd < 0)
+        config_error(programfile, "Cannot open program file");
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < 3 * sizeof(unsigned)) {
+        close(fd);
         config_error(programfile, "Incorrect segment dimensions");
+    }
 
-    Instruction *text = malloc(sizes[0] * sizeof(Instruction));
-    if (fread(text, sizeof(Instruction), sizes[0], file) < sizes[0])
-        config_error(programfile, "Too many instructions");
+    size_t mapsize = st.st_size;
+    char *map = mmap(NULL, mapsize, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+    if (map == MAP_FAILED) {
+        close(fd);
+        config_error(programfile, "Cannot map program file");
+    }
 
-    Word *data = malloc(sizes[1] * sizeof(Word));
-    if (fread(data, sizeof(Word), sizes[1], file) < sizes[1])
-        config_error(programfile, "Too many data");
+    if (image_is_v2(map, mapsize)) {
+        close(fd);
+        map_image(pmach, programfile, map, mapsize);
+        return;
+    }
 
-    fclose(file);
+    unsigned sizes[3];
+    memcpy(sizes, map, sizeof(sizes));
+    Instruction *text = (Instruction *) (map + sizeof(sizes));
+    Word *data = (Word *) (text + sizes[0]);
+    const char *problem = check_sizes(sizes, mapsize);
+    if (problem != NULL) {
+        close(fd);
+        munmap(map, mapsize);
+        config_error(programfile, problem);
+    }
+    unsigned addr;
+    if ((problem = check_text(text, sizes[0], &addr)) != NULL) {
+        close(fd);
+        munmap(map, mapsize);
+        config_error_at(programfile, problem, addr);
+    }
 
-    if (sizes[2] > sizes[1])
-        config_error(programfile, "Data lenght greater than memory size");
-    if ((sizes[1] - sizes[2]) < MINSTACKSIZE)
-        config_error(programfile, "Not enough room for stack");
+    // Les pages contenant uniquement l'entte et le texte sont protges en
+    // criture
+    size_t page = sysconf(_SC_PAGESIZE);
+    size_t textpages = (char *) data - map;
+    mprotect(map, textpages / page * page, PROT_READ);
+
+    // Les donnes sont projetes en copie sur criture si elles finissent sur
+    // une limite de page du fichier, comme dans le segment protg (voir
+    // guard_offset()) ; sinon elles sont recopies par load_program()
+    size_t offset = guard_offset(sizes[1]);
+    Word *mapped = NULL;
+    if (textpages >= offset && (textpages - offset) % page == 0)
+        mapped = guard_map(sizes[1], fd, textpages - offset, NULL, &pmach->_guarded);
+    close(fd);
+    if (mapped != NULL) {
+        pmach->_data = mapped;
+        setup_program(pmach, sizes[0], text, sizes[1], sizes[2]);
+    }
+    else if (!load_program(pmach, sizes[0], text, sizes[1], data, sizes[2])) {
+        munmap(map, mapsize);
+        config_error(programfile, "Cannot allocate data segment");
+    }
+
+    // Seules les pages du texte restent projetes
+    size_t keep = (textpages + page - 1) / page * page;
+    if (keep < mapsize) {
+        munmap(map + keep, mapsize - keep);
+        mapsize = keep;
+    }
+    pmach->_map = map;
+    pmach->_mapsize = mapsize;
+}
+
+//! Lecture protge d'un programme depuis un fichier binaire
+/*!
+ * \param pmach la machine  simuler
+ * \param programfile le nom du fichier binaire
+ * \param map faut-il utiliser map_program() plutt que read_program() ?
+ * \param pdetail description de l'erreur ventuelle (rsultat, peut tre NULL)
+ * \return ERR_NOERROR, ou ERR_PROGFILE si le programme n'a pu tre charg
+ */
+Error try_read_program(Machine *pmach, const char *programfile, bool map,
+                       const char **pdetail) {
+    Error_Trap trap = { ._silent = true };
+
+    error_trap(&trap);
+    if (setjmp(trap._env) != 0) {
+        if (pdetail != NULL)
+            *pdetail = trap._detail;
+        return trap._err;
+    }
+    if (map)
+        map_program(pmach, programfile);
+    else
+        read_program(pmach, programfile);
+    error_untrap(&trap);
+    return ERR_NOERROR;
+}
+
+//! Libration de la mmoire associe au programme charg
+/*!
+ * \param pmach la machine
+ */
+void unload_program(Machine *pmach) {
+    free(pmach->_decoded);
+    if (pmach->_snapshot != NULL)
+        snapshot_detach(pmach);
+    else {
+        free(pmach->_blocks);
+        image_free_symbols(pmach->_symbols, pmach->_nsymbols);
+        guard_free(pmach->_data, pmach->_datasize, pmach->_guarded);
+        if (pmach->_map != NULL)
+            munmap(pmach->_map, pmach->_mapsize);
+        else if (pmach->_allocated)
+            free(pmach->_text);
+    }
+    pmach->_decoded = NULL;
+    pmach->_blocks = NULL;
+    pmach->_nblocks = 0;
+    pmach->_text = NULL;
+    pmach->_textsize = 0;
+    pmach->_data = NULL;
+    pmach->_datasize = 0;
+    pmach->_allocated = false;
+    pmach->_map = NULL;
+    pmach->_mapsize = 0;
+    pmach->_symbols = NULL;
+    pmach->_nsymbols = 0;
+    debug_free(pmach->_debugger);
+    pmach->_debugger = NULL;
+}
 
-    load_program(mach, sizes[0], text, sizes[1], data, sizes[2]);
+//! Tampon de mise en forme des affichages (voir format.h)
+static __thread Format_Buffer out;
+
+//! Tampon de mise en forme, dirig vers la sortie standard
+static Format_Buffer *output(void) {
+    out._fd = STDOUT_FILENO;
+    return &out;
+}
+
+//! Mise en forme d'un mot tiquet (registre ou donne)
+/*!
+* quivalent de <tt>"R%02u: 0x%08x %-4d   "</tt> pour un registre, de
+* <tt>"0x%04x: 0x%08x %-4d   "</tt> pour une donne.
+*
+* \param p la position o crire
+* \param prefix "R" (numro dcimal) ou "0x" (adresse hexadcimale)
+* \param index le numro ou l'adresse
+* \param digits le nombre minimal de chiffres de l'index
+* \param w le mot
+* \return la position qui suit
+*/
+static char *format_word(char *p, const char *prefix, unsigned index, unsigned digits, Word w) {
+    p = format_str(p, prefix);
+    p = prefix[0] == 'R' ? format_udec(p, index, digits) : format_hex(p, index, digits);
+    p = format_str(p, ": 0x");
+    p = format_hex(p, w, 8);
+    *p++ = ' ';
+    char *start = p;
+    p = format_dec(p, (int32_t) w);
+    p = format_pad(p, start, 4);
+    return format_str(p, "   ");
 }
 
 //! Affichage du programme et des donnes
@@ -100,34 +508,53 @@ void read_program(Machine *mach, const char *programfile) {
 * forme prte  tre coupe-colle dans le simulateur.
 *
 * Pendant qu'on y est, on produit aussi un dump binaire dans le fichier
-* dump.prog. Le format de ce fichier est compatible avec l'option -b de
-* test_simul.
+* dump.bin, au format version 2 (voir image.h). Le format de ce fichier est
+* compatible avec l'option -b de test_simul.
 *
 * \param pmach la machine en cours d'excution
 */
 void dump_memory(Machine *pmach) {
+    Format_Buffer *pf = output();
+    char *p;
+
     // Print on screen
-    printf("Instruction text[] = {");
-    for (int i = 0; i < pmach->_textsize; ++i) {
-        if (i % 4 == 0) printf("\n    ");
-        printf("0x%08x, ", pmach->_text[i]._raw);
+    p = format_reserve(pf, 32);
+    p = format_str(p, "Instruction text[] = {");
+    format_commit(pf, p);
+    for (unsigned i = 0; i < pmach->_textsize; ++i) {
+        p = format_reserve(pf, 32);
+        if (i % 4 == 0) p = format_str(p, "\n    ");
+        p = format_str(p, "0x");
+        p = format_hex(p, pmach->_text[i]._raw, 8);
+        p = format_str(p, ", ");
+        format_commit(pf, p);
     }
-    printf("\n};\nunsigned textsize = %u;\n\n", pmach->_textsize);
-    printf("Word data[] = {");
-    for (int i = 0; i < pmach->_datasize; ++i) {
-        if (i % 4 == 0) printf("\n    ");
-        printf("0x%08x, ", pmach->_data[i]);
+    p = format_reserve(pf, 64);
+    p = format_str(p, "\n};\nunsigned textsize = ");
+    p = format_udec(p, pmach->_textsize, 1);
+    p = format_str(p, ";\n\nWord data[] = {");
+    format_commit(pf, p);
+    for (unsigned i = 0; i < pmach->_datasize; ++i) {
+        p = format_reserve(pf, 32);
+        if (i % 4 == 0) p = format_str(p, "\n    ");
+        p = format_str(p, "0x");
+        p = format_hex(p, pmach->_data[i], 8);
+        p = format_str(p, ", ");
+        format_commit(pf, p);
     }
-    printf("\n};\nunsigned datasize = %u;\nunsigned dataend = %u;\n", pmach->_datasize, pmach->_dataend);
+    p = format_reserve(pf, 80);
+    p = format_str(p, "\n};\nunsigned datasize = ");
+    p = format_udec(p, pmach->_datasize, 1);
+    p = format_str(p, ";\nunsigned dataend = ");
+    p = format_udec(p, pmach->_dataend, 1);
+    p = format_str(p, ";\n");
+    format_commit(pf, p);
+    format_flush(pf);
 
     // Print on file
     FILE *file;
-    if ((file = fopen("dump.bin", "w"))) {
-        fwrite(&pmach->_textsize, sizeof(unsigned), 1, file);
-        fwrite(&pmach->_datasize, sizeof(unsigned), 1, file);
-        fwrite(&pmach->_dataend, sizeof(unsigned), 1, file);
-        fwrite(&pmach->_text->_raw, sizeof(Word), pmach->_textsize, file);
-        fwrite(pmach->_data, sizeof(Word), pmach->_datasize, file);
+    if ((file = fopen("dump.bin", "wb"))) {
+        image_write(file, pmach);
         fclose(file);
     }
 }
@@ -139,13 +566,50 @@ void dump_memory(Machine *pmach) {
 * \param pmach la machine en cours d'excution
 */
 void print_program(Machine *pmach) {
-    printf("\n*** PROGRAM (size: %u) ***\n", pmach->_textsize);
-    for (int i = 0; i < pmach->_textsize; ++i) {
-        printf("0x%04x: 0x%08x \t ", i, pmach->_text[i]._raw);
-        print_instruction(pmach->_text[i], i);
-        putchar('\n');
+    print_program_range(pmach, 0, UINT_MAX);
+}
+
+//! Affichage d'une partie des instructions du programme
+/*!
+* \param pmach la machine en cours d'excution
+* \param from la premire adresse
+* \param to la dernire adresse (incluse)
+*/
+void print_program_range(Machine *pmach, unsigned from, unsigned to) {
+    Format_Buffer *pf = output();
+    unsigned end = to < pmach->_textsize ? to + 1 : pmach->_textsize;
+    char *p;
+
+    p = format_reserve(pf, 64);
+    p = format_str(p, "\n*** PROGRAM (size: ");
+    p = format_udec(p, pmach->_textsize, 1);
+    p = format_str(p, ") ***\n");
+    format_commit(pf, p);
+    for (unsigned i = from; i < end; ++i) {
+        Instruction instr = pmach->_text[i];
+        p = format_reserve(pf, 32 + FORMAT_INSTRUCTION_MAX);
+        p = format_str(p, "0x");
+        p = format_hex(p, i, 4);
+        p = format_str(p, ": 0x");
+        p = format_hex(p, instr._raw, 8);
+        p = format_str(p, " \t ");
+        format_commit(pf, p);
+
+        // Une instruction incorrecte est une erreur fatale : ce qui prcde
+        // doit d'abord tre affich
+        Code_Op cop = instr.instr_generic._cop;
+        if (cop > LAST_COP || ((cop == BRANCH || cop == CALL)
+                               && instr.instr_generic._regcond > LAST_CONDITION))
+            format_flush(pf);
+
+        p = format_instruction(p, instr, i);
+        *p++ = '\n';
+        format_commit(pf, p);
     }
-    putchar('\n');
+    p = format_reserve(pf, 1);
+    *p++ = '\n';
+    format_commit(pf, p);
+    format_flush(pf);
 }
 
 //! Affichage des donnes du programme
@@ -155,12 +619,44 @@ void print_program(Machine *pmach) {
 * \param pmach la machine en cours d'excution
 */
 void print_data(Machine *pmach) {
-    printf("*** DATA (size: %u, end = 0x%08x (%u)) ***", pmach->_datasize, pmach->_dataend, pmach->_dataend);
-    for (int i = 0; i < pmach->_datasize; ++i) {
-        if (i % 3 == 0) printf("\n");
-        printf("0x%04x: 0x%08x %-4d   ", i, pmach->_data[i], pmach->_data[i]);
+    print_data_range(pmach, 0, UINT_MAX, false);
+}
+
+//! Affichage d'une partie des donnes du programme
+/*!
+* \param pmach la machine en cours d'excution
+* \param from la premire adresse
+* \param to la dernire adresse (incluse)
+* \param nonzero n'afficher que les mots non nuls ?
+*/
+void print_data_range(Machine *pmach, unsigned from, unsigned to, bool nonzero) {
+    Format_Buffer *pf = output();
+    unsigned end = to < pmach->_datasize ? to + 1 : pmach->_datasize;
+    unsigned n = 0;
+    char *p;
+
+    p = format_reserve(pf, 80);
+    p = format_str(p, "*** DATA (size: ");
+    p = format_udec(p, pmach->_datasize, 1);
+    p = format_str(p, ", end = 0x");
+    p = format_hex(p, pmach->_dataend, 8);
+    p = format_str(p, " (");
+    p = format_udec(p, pmach->_dataend, 1);
+    p = format_str(p, ")) ***");
+    format_commit(pf, p);
+    for (unsigned i = from; i < end; ++i) {
+        Word w = pmach->_data[i];
+        if (nonzero && w == 0)
+            continue;
+        p = format_reserve(pf, 48);
+        if (n++ % 3 == 0) *p++ = '\n';
+        p = format_word(p, "0x", i, 4, w);
+        format_commit(pf, p);
     }
-    printf("\n\n");
+    p = format_reserve(pf, 2);
+    p = format_str(p, "\n\n");
+    format_commit(pf, p);
+    format_flush(pf);
 }
 
 //! Affichage des registres du CPU
@@ -170,13 +666,21 @@ void print_data(Machine *pmach) {
 * \param pmach la machine en cours d'excution
 */
 void print_cpu(Machine *pmach) {
-    printf("\n*** CPU ***\n");
-    printf("PC:  0x%08x   CC: %c\n", pmach->_pc, cc_names[pmach->_cc]);
-    for (int i = 0; i < NREGISTERS; ++i) {
-        if (i % 3 == 0) printf("\n");
-        printf("R%02u: 0x%08x %-4d   ", i, pmach->_registers[i], pmach->_registers[i]);
+    Format_Buffer *pf = output();
+    char *p = format_reserve(pf, 64 + NREGISTERS * 48);
+
+    p = format_str(p, "\n*** CPU ***\nPC:  0x");
+    p = format_hex(p, pmach->_pc, 8);
+    p = format_str(p, "   CC: ");
+    *p++ = cc_names[cc_sign(pmach->_cc)];
+    *p++ = '\n';
+    for (unsigned i = 0; i < NREGISTERS; ++i) {
+        if (i % 3 == 0) *p++ = '\n';
+        p = format_word(p, "R", i, 2, pmach->_registers[i]);
     }
-    printf("\n\n");
+    p = format_str(p, "\n\n");
+    format_commit(pf, p);
+    format_flush(pf);
 }
 
 //! Simulation
@@ -189,16 +693,59 @@ void print_cpu(Machine *pmach) {
 * \param debug mode de mise au point (pas  apas) ?
 */
 void simul(Machine *pmach, bool debug) {
-    bool running = true;
-    while (running) {
-        if (pmach->_pc >= pmach->_textsize)
-            error(ERR_SEGTEXT, pmach->_pc);
+    simul_mode(pmach, TRACE_ALL, debug, NULL);
+}
+
+//! Simulation avec choix du mode d'excution
+/*!
+ * \param pmach la machine en cours d'excution
+ * \param trace niveau de trace
+ * \param debug mode de mise au point (pas  pas) ?
+ * \param pstats statistiques  mettre  jour (NULL si aucune)
+ */
+void simul_mode(Machine *pmach, Trace_Level trace, bool debug, Stats *pstats) {
+    exec_threaded(pmach, trace, debug, pstats);
+}
+
+//! Simulation protge
+/*!
+ * \param pmach la machine en cours d'excution
+ * \param trace niveau de trace
+ * \param pstats statistiques  mettre  jour (NULL si aucune)
+ * \return le code de l'erreur (ERR_NOERROR aprs \c HALT)
+ */
+Error try_simul(Machine *pmach, Trace_Level trace, Stats *pstats) {
+    Error_Trap trap = { ._silent = true };
 
-        trace("Executing", pmach, pmach->_text[pmach->_pc], pmach->_pc);
+    error_trap(&trap);
+    if (setjmp(trap._env) != 0) {
+        pmach->_fault = trap._err;
+        pmach->_faultaddr = trap._addr;
+        return trap._err;
+    }
+    exec_threaded(pmach, trace, false, pstats);
+    error_untrap(&trap);
+    pmach->_fault = ERR_NOERROR;
+    return ERR_NOERROR;
+}
 
-        running = decode_execute(pmach, pmach->_text[pmach->_pc++]);
+//! Excution d'au plus un nombre donn d'instructions
+/*!
+ * \param pmach la machine en cours d'excution
+ * \param max le nombre maximal d'instructions  excuter
+ * \param pstats statistiques  mettre  jour (NULL si aucune)
+ * \return la raison de l'arrt
+ */
+Simul_Status simul_step(Machine *pmach, uint64_t max, Stats *pstats) {
+    if (max == 0)
+        return SIMUL_BUDGET;
 
-        if (debug)
-            debug = debug_ask(pmach);
+    // Les variantes qui comptent les instructions appliquent la limite
+    Stats stats = { 0, 0, pstats != NULL ? pstats->_profile : NULL, max, SIMUL_HALTED };
+    Error err = try_simul(pmach, TRACE_NONE, &stats);
+    if (pstats != NULL) {
+        pstats->_instructions += stats._instructions;
+        pstats->_jumps += stats._jumps;
     }
-}
\ No newline at end of file
+    return err != ERR_NOERROR ? SIMUL_FAULTED : stats._stop;
+}
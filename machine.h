@@ -7,21 +7,20 @@
  */
 
 #include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
 
 #include "instruction.h"
+#include "error.h"
 
 //! Nombre de resitres généraux
 #define NREGISTERS 16
 
-//! Code condition
+//! Signe du code condition
 /*! 
- * Le code condition donne le signe du résultat de la dernière instruction
- * arithmétique (addition, soustraction) exécutée par le processeur. 
- *
- * \note Dans un processeur réel, le code condition fait partie du mot
- * d'état du processeur. Il contient d'autres indications que le simple
- * signe du résultat : par exemple le fait qu'une retenue ait été générée
- * ou bien qu'un dépassement de capacité (\e overflow) se soit produit.
+ * Le signe du résultat de la dernière instruction arithmétique (chargement,
+ * addition, soustraction) exécutée par le processeur, tel qu'il est affiché
+ * (voir cc_sign()). Le code condition lui-même est décrit par Flags.
  */
 typedef enum 
 {
@@ -31,9 +30,88 @@ typedef enum
     CC_N,	//!< Résultat négatif
 } Condition_Code;
 
-//! Dernière valeur possible du code condition
+//! Dernière valeur possible du signe du code condition
 static const unsigned LAST_CC = CC_N;
 
+//! Lettres représentant les signes du code condition
+extern const char cc_names[];
+
+//! Opération à l'origine du code condition
+typedef enum
+{
+    FLAGS_NONE = 0,	//!< Aucune : code condition inconnu
+    FLAGS_ADD,		//!< Addition (un chargement est l'addition de la valeur à 0)
+    FLAGS_SUB,		//!< Soustraction
+} Flags_Source;
+
+//! Code condition, évalué à la demande
+/*!
+ * Comme dans un processeur réel, le code condition comporte, outre le signe
+ * du résultat, une retenue et un dépassement de capacité (\e overflow). Les
+ * instructions arithmétiques ne les calculent pas : elles conservent leurs
+ * opérandes et la nature de l'opération, et les indicateurs ne sont calculés
+ * (flags_of()) que par les branchements conditionnels.
+ */
+typedef struct
+{
+    Word _first;	//!< Premier opérande (0 pour un chargement)
+    Word _second;	//!< Second opérande (la valeur chargée pour un chargement)
+    uint8_t _source;	//!< Opération (Flags_Source)
+} Flags;
+
+//! Indicateurs calculés par flags_of()
+enum
+{
+    FLAG_V = 1,		//!< Dépassement de capacité en arithmétique signée
+    FLAG_C = 2,		//!< Retenue de l'addition ou emprunt de la soustraction
+    FLAG_Z = 4,		//!< Résultat nul
+    FLAG_N = 8,		//!< Résultat négatif (bit de poids fort positionné)
+};
+
+//! Indicateurs d'un code condition inconnu (Z et N ne sont jamais positionnés ensemble sinon)
+#define FLAGS_UNKNOWN (FLAG_Z | FLAG_N)
+
+//! Calcul des indicateurs du code condition
+/*!
+ * \param cc le code condition
+ * \return les indicateurs (combinaison de FLAG_N, FLAG_Z, FLAG_C, FLAG_V, de 0
+ * à 15), ou \c FLAGS_UNKNOWN
+ */
+static inline unsigned flags_of(Flags cc)
+{
+    Word a = cc._first, b = cc._second;
+    Word r;
+    unsigned carry, overflow;
+
+    switch (cc._source) {
+    case FLAGS_ADD:
+        r = a + b;
+        carry = r < a;
+        overflow = (~(a ^ b) & (a ^ r)) >> 31;
+        break;
+    case FLAGS_SUB:
+        r = a - b;
+        carry = a < b;
+        overflow = ((a ^ b) & (a ^ r)) >> 31;
+        break;
+    default:
+        return FLAGS_UNKNOWN;
+    }
+    return (r >> 31) * FLAG_N | (r == 0) * FLAG_Z | carry * FLAG_C | overflow * FLAG_V;
+}
+
+//! Signe du code condition
+/*!
+ * \param cc le code condition
+ */
+static inline Condition_Code cc_sign(Flags cc)
+{
+    unsigned flags = flags_of(cc);
+    if (flags == FLAGS_UNKNOWN)
+        return CC_U;
+    return flags & FLAG_Z ? CC_Z : flags & FLAG_N ? CC_N : CC_P;
+}
+
 //! Taille minimale de la pile d'exécution
 static const unsigned MINSTACKSIZE = 10;
 
@@ -77,28 +155,89 @@ typedef struct
     unsigned int _datasize;	//!< Taille utilisée pour les données
 
     unsigned int _dataend;      //!< Première adresse libre après les données statiques
+    bool _guarded;		//!< Données suivies de leur zone de garde (voir guard.h) ?
 
     // Registres de l'unité centrale
     unsigned _pc;		//!< Compteur ordinal
-    Condition_Code _cc;		//!< Code condition : signe de la dernière opération
+    Flags _cc;			//!< Code condition (évalué à la demande)
     Word _registers[NREGISTERS];//!< Registres généraux (accumulateurs)
 
+    // Représentation interne pour l'exécution
+    struct Decoded *_decoded;	//!< Segment de texte pré-décodé (voir decode.h)
+    const void *_dispatch;	//!< Table des traitements utilisée pour _decoded
+    struct Block *_blocks;	//!< Blocs de base du segment de texte
+    unsigned _nblocks;		//!< Nombre de blocs de base
+    struct Trace_Buffer *_tracebuf;	//!< Tampon de la trace binaire (voir tracebuf.h), NULL si aucun
+
+    // Gestion du programme chargé
+    bool _allocated;		//!< Texte alloué par read_program() (à libérer) ?
+    void *_map;			//!< Projection du fichier par map_program() (ou NULL)
+    size_t _mapsize;		//!< Taille de cette projection
+    struct Snapshot *_snapshot;	//!< Instantané dont la machine est une copie (voir snapshot.h), ou NULL
+    struct Symbol *_symbols;	//!< Table des symboles de l'image (voir image.h), ou NULL
+    unsigned _nsymbols;		//!< Nombre de symboles
+    struct Debugger *_debugger;	//!< État de la mise au point (voir debug.h), ou NULL
+    Error _fault;		//!< Erreur rattrapée par try_simul() (ou ERR_NOERROR)
+    unsigned _faultaddr;	//!< Adresse de cette erreur
+
 //! Définition de _sp comme synonyme du registre R15    
 #   define _sp _registers[NREGISTERS - 1] 
 } Machine;
 
+//! Niveaux de trace de l'exécution
+typedef enum
+{
+    TRACE_NONE = 0,	//!< Pas de trace
+    TRACE_JUMPS,	//!< Trace des seules ruptures de séquence (branchements pris, appels, retours)
+    TRACE_ALL,		//!< Trace de chaque instruction
+    TRACE_BINARY,	//!< Trace binaire de chaque instruction dans \c _tracebuf
+} Trace_Level;
+
+//! Raison de l'arrêt d'une exécution limitée (voir simul_step())
+typedef enum
+{
+    SIMUL_HALTED = 0,	//!< Instruction \c HALT exécutée
+    SIMUL_FAULTED,	//!< Erreur d'exécution (dans \c _fault et \c _faultaddr)
+    SIMUL_BUDGET,	//!< Nombre maximal d'instructions exécuté
+    SIMUL_BREAKPOINT,	//!< Point d'arrêt atteint (l'instruction n'est pas exécutée)
+} Simul_Status;
+
+//! Statistiques d'exécution
+/*!
+ * Les champs \c _limit et \c _stop servent aux exécutions limitées de
+ * simul_step() : les variantes de la boucle d'exécution qui tiennent des
+ * statistiques s'arrêtent avant l'instruction qui dépasserait la limite, ou
+ * avant un point d'arrêt de la mise au point (sauf la première
+ * instruction), et en rangent la raison dans \c _stop.
+ */
+typedef struct
+{
+    uint64_t _instructions;	//!< Nombre d'instructions exécutées
+    uint64_t _jumps;		//!< Nombre de ruptures de séquence
+    struct Profile *_profile;	//!< Profil détaillé à tenir (NULL si aucun, voir profile.h)
+    uint64_t _limit;		//!< Nombre maximal d'instructions d'une exécution (0 : aucune limite)
+    Simul_Status _stop;		//!< Raison de l'arrêt d'une exécution limitée
+} Stats;
+
 //! Chargement d'un programme
 /*!
  * La machine est réinitialisée et ses segments de texte et de données sont
- * remplacés par ceux fournis en paramètre.
+ * remplacés par ceux fournis en paramètre. Le segment de texte est utilisé
+ * tel quel ; le contenu initial des données est recopié dans un segment
+ * protégé par une zone de garde (voir guard.h) si l'espace d'adressage le
+ * permet, et \c data reste à l'appelant.
  *
  * \param pmach la machine en cours d'exécution
  * \param textsize taille utile du segment de texte
  * \param text le contenu du segment de texte
  * \param datasize taille utile du segment de données
  * \param data le contenu initial du segment de texte
+ * \return faux si le segment de données n'a pu être alloué (la machine n'est
+ * alors pas chargée)
+ *
+ * Le segment de texte est pré-décodé (voir decode_program()).
  */
-void load_program(Machine *pmach,
+bool load_program(Machine *pmach,
                   unsigned textsize, Instruction text[textsize],
                   unsigned datasize, Word data[datasize],  unsigned dataend);
 
@@ -119,11 +258,70 @@ void load_program(Machine *pmach,
  * Tous les entiers font 32 bits et les adresses de chaque segment commencent à
  * 0. La fonction initialise complétement la machine.
  *
+ * Les images au format version 2 (voir image.h) sont reconnues à leur
+ * entête ; leur table des symboles et leur adresse d'entrée éventuelles sont
+ * chargées dans la machine.
+ *
  * \param pmach la machine à simuler
  * \param programfile le nom du fichier binaire
  *
  */
 void read_program(Machine *mach, const char *programfile);  
+
+//! Projection d'un programme depuis un fichier binaire
+/*!
+ * Variante de read_program() pour les gros programmes : le fichier (au même
+ * format) est projeté en mémoire par \c mmap au lieu d'être lu. Le texte est
+ * utilisé en place, dans des pages protégées en écriture (\c MAP_PRIVATE : le
+ * fichier n'est jamais modifié). Si les données se terminent sur une limite
+ * de page du fichier, elles sont projetées en copie sur écriture comme
+ * segment protégé (voir guard_map()) ; sinon elles y sont recopiées (voir
+ * load_program()). Dans les deux cas, seules les pages du texte restent
+ * ensuite projetées.
+ *
+ * Le chargement est validé en une passe : dimensions des segments par rapport
+ * à la taille du fichier, puis codes opération (au plus \c LAST_COP) et
+ * conditions des \c BRANCH et \c CALL (au plus \c LAST_CONDITION). Une
+ * instruction incorrecte est donc une erreur de chargement, et non plus une
+ * erreur d'exécution.
+ *
+ * Une image au format version 2 (voir image.h), dont les données sont
+ * compressées, est décodée depuis la projection puis vérifiée de la même
+ * façon.
+ *
+ * La projection est libérée par unload_program().
+ *
+ * \param pmach la machine à simuler
+ * \param programfile le nom du fichier binaire
+ */
+void map_program(Machine *pmach, const char *programfile);
+
+//! Lecture protégée d'un programme depuis un fichier binaire
+/*!
+ * Comme read_program() (ou map_program()), mais une erreur de chargement ne
+ * termine pas le simulateur : elle est rendue, avec sa description.
+ *
+ * \param pmach la machine à simuler
+ * \param programfile le nom du fichier binaire
+ * \param map faut-il utiliser map_program() plutôt que read_program() ?
+ * \param pdetail description de l'erreur éventuelle (résultat, peut être NULL)
+ * \return ERR_NOERROR, ou ERR_PROGFILE si le programme n'a pu être chargé
+ */
+Error try_read_program(Machine *pmach, const char *programfile, bool map,
+                       const char **pdetail);
+
+//! Libération de la mémoire associée au programme chargé
+/*!
+ * Le texte pré-décodé et les blocs de base sont libérés, ainsi que les
+ * segments de texte et de données s'ils ont été alloués par read_program() ou
+ * projetés par map_program().
+ * Pour une copie d'un instantané, seule la projection des données est libérée
+ * (voir snapshot_fork()).
+ * La machine doit ensuite être rechargée avant toute exécution.
+ *
+ * \param pmach la machine
+ */
+void unload_program(Machine *pmach);
  
 //! Affichage du programme et des données
 /*!
@@ -131,8 +329,8 @@ void read_program(Machine *mach, const char *programfile);
  * forme prête à être coupée-collée dans le simulateur.
  *
  * Pendant qu'on y est, on produit aussi un dump binaire dans le fichier
- * dump.prog. Le format de ce fichier est compatible avec l'option -b de
- * test_simul.
+ * dump.bin, au format version 2 (voir image.h). Le format de ce fichier est
+ * compatible avec l'option -b de test_simul.
  *
  * \param pmach la machine en cours d'exécution
  */
@@ -146,6 +344,16 @@ void dump_memory(Machine *pmach);
  */
 void print_program(Machine *pmach);
 
+//! Affichage d'une partie des instructions du programme
+/*!
+ * Les adresses hors du segment de texte sont ignorées.
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param from la première adresse
+ * \param to la dernière adresse (incluse)
+ */
+void print_program_range(Machine *pmach, unsigned from, unsigned to);
+
 //! Affichage des données du programme
 /*!
  * Les valeurs sont affichées en format hexadécimal et décimal.
@@ -154,6 +362,17 @@ void print_program(Machine *pmach);
  */
 void print_data(Machine *pmach);
 
+//! Affichage d'une partie des données du programme
+/*!
+ * Les adresses hors du segment de données sont ignorées.
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param from la première adresse
+ * \param to la dernière adresse (incluse)
+ * \param nonzero n'afficher que les mots non nuls ?
+ */
+void print_data_range(Machine *pmach, unsigned from, unsigned to, bool nonzero);
+
 //! Affichage des registres du CPU
 /*!
  * Les registres généraux sont affichées en format hexadécimal et décimal.
@@ -168,9 +387,70 @@ void print_cpu(Machine *pmach);
  * suivante (pointée par le compteur ordinal \c _pc) puis décodage et exécution
  * de l'instruction.
  *
+ * En pratique, les instructions ont été pré-décodées au chargement du
+ * programme (voir decode_program()) et l'exécution enchaîne directement les
+ * traitements des instructions successives (voir exec_threaded()).
+ *
  * \param pmach la machine en cours d'exécution
  * \param debug mode de mise au point (pas à apas) ?
  */
 void simul(Machine *pmach, bool debug);
 
+//! Simulation avec choix du mode d'exécution
+/*!
+ * Comme simul(), qui correspond au niveau de trace \c TRACE_ALL sans
+ * statistiques. La boucle d'exécution utilisée est spécialisée à la
+ * compilation pour chaque combinaison de paramètres : une exécution sans
+ * trace, sans mise au point et sans statistiques ne fait aucune entrée-sortie
+ * ni aucun test pour ces fonctionnalités.
+ *
+ * Le niveau \c TRACE_BINARY suppose que le champ \c _tracebuf de la machine
+ * désigne un tampon ouvert par tracebuf_open().
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param trace niveau de trace
+ * \param debug mode de mise au point (pas à pas) ?
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ */
+void simul_mode(Machine *pmach, Trace_Level trace, bool debug, Stats *pstats);
+
+//! Simulation protégée
+/*!
+ * Comme simul_mode() sans mise au point, mais une erreur d'exécution ne
+ * termine pas le simulateur : son code et son adresse sont rangés dans les
+ * champs \c _fault et \c _faultaddr de la machine, dont l'état est celui du
+ * moment de l'erreur. Les avertissements ne sont pas affichés. Plusieurs
+ * machines peuvent ainsi être simulées en parallèle, dans des processus légers
+ * différents.
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param trace niveau de trace
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ * \return le code de l'erreur (ERR_NOERROR après \c HALT)
+ */
+Error try_simul(Machine *pmach, Trace_Level trace, Stats *pstats);
+
+//! Exécution d'au plus un nombre donné d'instructions
+/*!
+ * Comme try_simul() sans trace, mais l'exécution s'arrête aussi après \c
+ * max instructions, ou avant une instruction sur laquelle la mise au point
+ * de la machine a posé un point d'arrêt (voir debug_breakpoint()) ; la
+ * première instruction est toujours exécutée, ce qui permet de reprendre
+ * après un point d'arrêt. L'état de la machine est alors à jour et un nouvel
+ * appel poursuit l'exécution exactement où elle s'était arrêtée : une suite
+ * d'appels produit le même résultat qu'une exécution d'un seul tenant.
+ *
+ * Après \c SIMUL_HALTED, le compteur ordinal désigne l'instruction qui suit
+ * \c HALT ; après \c SIMUL_FAULTED, l'erreur est dans les champs \c _fault
+ * et \c _faultaddr. Dans les deux cas, l'exécution ne doit pas être
+ * poursuivie.
+ *
+ * \param pmach la machine en cours d'exécution
+ * \param max le nombre maximal d'instructions à exécuter (0 : aucune)
+ * \param pstats statistiques à mettre à jour (NULL si aucune ; seuls leurs
+ * compteurs et leur profil servent)
+ * \return la raison de l'arrêt
+ */
+Simul_Status simul_step(Machine *pmach, uint64_t max, Stats *pstats);
+
 #endif
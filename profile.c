@@ -0,0 +1,143 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include "profile.h"
+#include "format.h"
+
+//! Nombre de codes opérations possibles (champ de 6 bits)
+#define NCOPS (1 << 6)
+
+//! Entrée d'un classement par fréquence
+typedef struct
+{
+	uint64_t _count;	//!< Nombre d'événements
+	unsigned _addr;		//!< Adresse
+} Hot_Entry;
+
+//! Comparaison de deux entrées : la plus fréquente d'abord, puis par adresse
+static int compare_hot(const void *a, const void *b) {
+	const Hot_Entry *pa = a, *pb = b;
+	if (pa->_count != pb->_count)
+		return pa->_count > pb->_count ? -1 : 1;
+	return pa->_addr < pb->_addr ? -1 : pa->_addr > pb->_addr;
+}
+
+//! Création d'un profil vide
+/*!
+ * \param pmach la machine
+ * \return le profil, ou NULL
+ */
+Profile *profile_new(const Machine *pmach) {
+	Profile *pprof = malloc(sizeof(Profile));
+	if (pprof == NULL) {
+		perror("profile");
+		return NULL;
+	}
+	pprof->_textsize = pmach->_textsize;
+	pprof->_datasize = pmach->_datasize;
+	pprof->_counts = calloc(pmach->_textsize + 1, sizeof(uint64_t));
+	pprof->_taken = calloc(pmach->_textsize + 1, sizeof(uint64_t));
+	pprof->_reads = calloc(pmach->_datasize + 1, sizeof(uint64_t));
+	pprof->_writes = calloc(pmach->_datasize + 1, sizeof(uint64_t));
+	pprof->_cache = NULL;
+	pprof->_timing = NULL;
+	if (pprof->_counts == NULL || pprof->_taken == NULL
+	    || pprof->_reads == NULL || pprof->_writes == NULL) {
+		perror("profile");
+		profile_free(pprof);
+		return NULL;
+	}
+	return pprof;
+}
+
+//! Libération d'un profil
+/*!
+ * \param pprof le profil
+ */
+void profile_free(Profile *pprof) {
+	free(pprof->_counts);
+	free(pprof->_taken);
+	free(pprof->_reads);
+	free(pprof->_writes);
+	free(pprof);
+}
+
+//! Pourcentage
+static double percent(uint64_t n, uint64_t total) {
+	return total == 0 ? 0 : 100.0 * n / total;
+}
+
+//! Affichage d'un profil
+/*!
+ * \param out le fichier de sortie
+ * \param pmach la machine
+ * \param pprof le profil
+ */
+void profile_print(FILE *out, const Machine *pmach, const Profile *pprof) {
+	unsigned textsize = pprof->_textsize;
+	uint64_t total = 0;
+	uint64_t ops[NCOPS] = { 0 };
+
+	for (unsigned a = 0; a < textsize; ++a) {
+		total += pprof->_counts[a];
+		Code_Op cop = pmach->_text[a].instr_generic._cop;
+		ops[cop] += pprof->_counts[a];
+	}
+
+	fprintf(out, "\n*** PROFILE ***\n\n%llu instructions executed\n",
+		(unsigned long long) total);
+
+	fprintf(out, "\nPer operation:\n");
+	for (unsigned cop = 0; cop <= LAST_COP; ++cop)
+		if (ops[cop] != 0)
+			fprintf(out, "  %-8s %14llu %7.2f%%\n", cop_names[cop],
+				(unsigned long long) ops[cop], percent(ops[cop], total));
+
+	// Instructions exécutées, par fréquence décroissante
+	Hot_Entry *hot = malloc((textsize > pprof->_datasize ? textsize : pprof->_datasize)
+				* sizeof(Hot_Entry) + 1);
+	if (hot == NULL) {
+		perror("profile");
+		return;
+	}
+	unsigned n = 0;
+	for (unsigned a = 0; a < textsize; ++a)
+		if (pprof->_counts[a] != 0)
+			hot[n++] = (Hot_Entry) { pprof->_counts[a], a };
+	qsort(hot, n, sizeof(Hot_Entry), compare_hot);
+
+	fprintf(out, "\nInstructions by executions:\n");
+	fprintf(out, "  %14s %8s  %-6s  %-28s %s\n", "count", "%", "addr", "instruction",
+		"taken / not taken");
+	for (unsigned i = 0; i < n; ++i) {
+		unsigned a = hot[i]._addr;
+		Instruction instr = pmach->_text[a];
+		Code_Op cop = instr.instr_generic._cop;
+		char text[FORMAT_INSTRUCTION_MAX + 1] = "(invalid)";
+		if (cop <= LAST_COP && ((cop != BRANCH && cop != CALL)
+					|| instr.instr_generic._regcond <= LAST_CONDITION))
+			*format_instruction(text, instr, a) = '\0';
+		fprintf(out, "  %14llu %7.2f%%  0x%04x  ", (unsigned long long) hot[i]._count,
+			percent(hot[i]._count, total), a);
+		if (cop == BRANCH || cop == CALL)
+			fprintf(out, "%-28s %llu / %llu\n", text, (unsigned long long) pprof->_taken[a],
+				(unsigned long long) (hot[i]._count - pprof->_taken[a]));
+		else
+			fprintf(out, "%s\n", text);
+	}
+
+	// Adresses de données, par nombre d'accès décroissant
+	n = 0;
+	for (unsigned a = 0; a < pprof->_datasize; ++a)
+		if (pprof->_reads[a] + pprof->_writes[a] != 0)
+			hot[n++] = (Hot_Entry) { pprof->_reads[a] + pprof->_writes[a], a };
+	qsort(hot, n, sizeof(Hot_Entry), compare_hot);
+
+	fprintf(out, "\nData by accesses:\n");
+	fprintf(out, "  %-6s %14s %14s\n", "addr", "reads", "writes");
+	for (unsigned i = 0; i < n; ++i) {
+		unsigned a = hot[i]._addr;
+		fprintf(out, "  0x%04x %14llu %14llu\n", a, (unsigned long long) pprof->_reads[a],
+			(unsigned long long) pprof->_writes[a]);
+	}
+	free(hot);
+}
@@ -0,0 +1,74 @@
+#ifndef _PROFILE_H_
+#define _PROFILE_H_
+
+/*!
+ * \file profile.h
+ * \brief Profil exact de l'exécution d'un programme.
+ *
+ * Le profil compte les exécutions de chaque adresse du texte, les
+ * branchements pris de chaque instruction \c BRANCH ou \c CALL, et les
+ * lectures et écritures de chaque adresse des données. Ce sont des tableaux
+ * plats, indexés par l'adresse : chaque événement coûte une incrémentation.
+ * Les comptes par code opération s'en déduisent à l'affichage.
+ *
+ * Le profil est tenu par les variantes de la boucle d'exécution dont \c
+ * ENGINE_STATS vaut 2 (voir exec_loop.h), choisies par exec_threaded()
+ * lorsque le champ \c _profile des statistiques n'est pas nul. La
+ * compilation à la volée (exec_jit()) ne le tient pas.
+ *
+ * Le profil peut porter un modèle de cache de données (voir cache.h), qui
+ * voit alors les mêmes accès que les compteurs de données, et un modèle du
+ * temps d'exécution sur un pipeline (voir timing.h), qui voit chaque
+ * instruction et reçoit les attentes du cache ; ils appartiennent à
+ * l'appelant, qui les crée, les affiche et les libère.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+
+#include "machine.h"
+
+//! Profil de l'exécution
+typedef struct Profile
+{
+    unsigned _textsize;		//!< Taille du segment de texte profilé
+    unsigned _datasize;		//!< Taille du segment de données profilé
+    uint64_t *_counts;		//!< Exécutions par adresse (\c _textsize + 1 compteurs)
+    uint64_t *_taken;		//!< Branchements pris par adresse (\c _textsize + 1 compteurs)
+    uint64_t *_reads;		//!< Lectures par adresse de donnée
+    uint64_t *_writes;		//!< Écritures par adresse de donnée
+    struct Cache *_cache;	//!< Modèle de cache à tenir (NULL si aucun ; voir cache.h)
+    struct Timing *_timing;	//!< Modèle de temps à tenir (NULL si aucun ; voir timing.h)
+} Profile;
+
+//! Création d'un profil vide
+/*!
+ * Les compteurs sont dimensionnés d'après les segments du programme chargé
+ * dans la machine ; le profil n'a ni modèle de cache ni modèle de temps.
+ *
+ * \param pmach la machine
+ * \return le profil, ou NULL (avec un message) en cas d'échec
+ */
+Profile *profile_new(const Machine *pmach);
+
+//! Libération d'un profil
+/*!
+ * \param pprof le profil
+ */
+void profile_free(Profile *pprof);
+
+//! Affichage d'un profil
+/*!
+ * On affiche le nombre d'exécutions par code opération, puis la liste des
+ * instructions exécutées, de la plus fréquente à la moins fréquente, avec
+ * leur nombre d'exécutions et, pour les branchements, le nombre de fois où
+ * ils ont été pris ou non ; enfin les adresses de données accédées, de la
+ * plus à la moins sollicitée.
+ *
+ * \param out le fichier de sortie
+ * \param pmach la machine (pour le texte du programme)
+ * \param pprof le profil
+ */
+void profile_print(FILE *out, const Machine *pmach, const Profile *pprof);
+
+#endif
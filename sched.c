@@ -0,0 +1,145 @@
+#define _POSIX_C_SOURCE 200809L
+#include <stdlib.h>
+#include <stdio.h>
+#include <assert.h>
+#include <time.h>
+#include "sched.h"
+
+//! Temps écoulé (en secondes, horloge monotone)
+static double now(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//! Initialisation d'un ordonnanceur vide
+/*!
+ * \param ps l'ordonnanceur
+ * \param quantum le nombre maximal d'instructions d'une tranche
+ * \param timeout le délai de garde
+ */
+void sched_init(Scheduler *ps, uint64_t quantum, double timeout) {
+	assert(quantum >= 1);
+	*ps = (Scheduler) { ._quantum = quantum, ._timeout = timeout };
+}
+
+//! Ajout d'une machine
+/*!
+ * \param ps l'ordonnanceur
+ * \param pmach la machine
+ * \param budget le nombre total maximal d'instructions
+ * \return le numéro de la machine, ou -1
+ */
+int sched_add(Scheduler *ps, Machine *pmach, uint64_t budget) {
+	if (ps->_ntasks == ps->_capacity) {
+		unsigned capacity = ps->_capacity == 0 ? 64 : 2 * ps->_capacity;
+		Sched_Task *tasks = realloc(ps->_tasks, capacity * sizeof(Sched_Task));
+		if (tasks != NULL)
+			ps->_tasks = tasks;
+		unsigned *ready = realloc(ps->_ready, capacity * sizeof(unsigned));
+		if (ready != NULL)
+			ps->_ready = ready;
+		if (tasks == NULL || ready == NULL) {
+			perror("sched");
+			return -1;
+		}
+		ps->_capacity = capacity;
+	}
+	unsigned task = ps->_ntasks++;
+	ps->_tasks[task] = (Sched_Task) { pmach, budget, { 0 }, 0, TASK_READY };
+	ps->_ready[ps->_nready++] = task;
+	return task;
+}
+
+//! Reprise d'une machine arrêtée sur un point d'arrêt
+/*!
+ * \param ps l'ordonnanceur
+ * \param task le numéro de la machine
+ */
+void sched_resume(Scheduler *ps, unsigned task) {
+	assert(task < ps->_ntasks && ps->_tasks[task]._state == TASK_BREAKPOINT);
+	ps->_tasks[task]._state = TASK_READY;
+	ps->_ready[ps->_nready++] = task;
+}
+
+//! Exécution d'une tranche
+/*!
+ * \param ps l'ordonnanceur
+ * \param pt la machine
+ */
+static void run_slice(Scheduler *ps, Sched_Task *pt) {
+	uint64_t max = ps->_quantum;
+	if (pt->_budget != 0 && pt->_budget - pt->_stats._instructions < max)
+		max = pt->_budget - pt->_stats._instructions;
+
+	++pt->_slices;
+	switch (simul_step(pt->_pmach, max, &pt->_stats)) {
+	case SIMUL_HALTED:
+		pt->_state = TASK_HALTED;
+		break;
+	case SIMUL_FAULTED:
+		pt->_state = TASK_FAULTED;
+		break;
+	case SIMUL_BREAKPOINT:
+		pt->_state = TASK_BREAKPOINT;
+		break;
+	case SIMUL_BUDGET:
+		if (pt->_budget != 0 && pt->_stats._instructions >= pt->_budget)
+			pt->_state = TASK_EXHAUSTED;
+		break;
+	}
+}
+
+//! Un tour du tourniquet
+/*!
+ * Le tour parcourt la liste des machines prêtes dans l'ordre et la compacte
+ * au passage : les machines qui ne sont plus prêtes en sortent, les autres
+ * gardent leur rang.
+ *
+ * \param ps l'ordonnanceur
+ * \return le nombre de machines encore prêtes
+ */
+unsigned sched_round(Scheduler *ps) {
+	if (ps->_timeout > 0 && ps->_deadline == 0)
+		ps->_deadline = now() + ps->_timeout;
+
+	unsigned kept = 0;
+	for (unsigned i = 0; i < ps->_nready; ++i) {
+		unsigned task = ps->_ready[i];
+		Sched_Task *pt = &ps->_tasks[task];
+		if (ps->_deadline == 0 || now() < ps->_deadline)
+			run_slice(ps, pt);
+		else {
+			pt->_state = TASK_TIMEOUT;
+			++ps->_ntimeouts;
+		}
+		if (pt->_state == TASK_READY)
+			ps->_ready[kept++] = task;
+	}
+	ps->_nready = kept;
+	return kept;
+}
+
+//! Exécution des machines prêtes
+/*!
+ * \param ps l'ordonnanceur
+ * \return le nombre de machines abandonnées sur le délai de garde
+ */
+unsigned sched_run(Scheduler *ps) {
+	unsigned ntimeouts = ps->_ntimeouts;
+	while (sched_round(ps) > 0)
+		;
+	return ps->_ntimeouts - ntimeouts;
+}
+
+//! Libération de l'ordonnanceur
+/*!
+ * \param ps l'ordonnanceur
+ */
+void sched_release(Scheduler *ps) {
+	free(ps->_tasks);
+	free(ps->_ready);
+	ps->_tasks = NULL;
+	ps->_ready = NULL;
+	ps->_ntasks = ps->_capacity = ps->_nready = 0;
+}
@@ -0,0 +1,130 @@
+#ifndef _SCHED_H_
+#define _SCHED_H_
+
+/*!
+ * \file sched.h
+ * \brief Ordonnancement coopératif de nombreuses machines sur un seul
+ * processus léger.
+ *
+ * L'ordonnanceur exécute à tour de rôle (\e round-robin) les machines qui lui
+ * sont confiées, chacune pendant une tranche d'au plus \c _quantum
+ * instructions (voir simul_step()) : aucune machine ne peut monopoliser le
+ * processus léger, et le délai entre deux tranches d'une même machine est
+ * borné par le nombre de machines prêtes. Chaque machine peut en outre
+ * recevoir un nombre total maximal d'instructions, au-delà duquel elle est
+ * abandonnée, et un délai de garde en temps réel, qui court à partir du
+ * premier tour, borne la durée de l'exécution : à son expiration, les
+ * machines qui ne sont pas terminées sont abandonnées.
+ *
+ * Des machines peuvent être ajoutées entre deux tours (sched_round()) : un
+ * appelant qui a beaucoup de programmes à exécuter n'en garde ainsi qu'un
+ * nombre borné en mémoire, et remplace chaque machine terminée par la
+ * suivante.
+ *
+ * Une tranche n'est jamais interrompue : le délai de garde est vérifié entre
+ * deux tranches, et peut donc être dépassé d'au plus la durée d'une tranche.
+ * Les erreurs d'exécution d'une machine sont rattrapées (voir try_simul()) et
+ * n'affectent pas les autres.
+ */
+
+#include <stdint.h>
+
+#include "machine.h"
+
+//! État d'une machine de l'ordonnanceur
+typedef enum
+{
+    TASK_READY = 0,	//!< Prête à recevoir une tranche
+    TASK_HALTED,	//!< Arrêtée sur \c HALT
+    TASK_FAULTED,	//!< Arrêtée sur une erreur (voir \c _fault et \c _faultaddr)
+    TASK_BREAKPOINT,	//!< Arrêtée sur un point d'arrêt (voir sched_resume())
+    TASK_EXHAUSTED,	//!< Abandonnée : nombre total d'instructions épuisé
+    TASK_TIMEOUT,	//!< Abandonnée : délai de garde expiré
+} Task_State;
+
+//! Machine de l'ordonnanceur
+typedef struct
+{
+    Machine *_pmach;		//!< La machine (chargée)
+    uint64_t _budget;		//!< Nombre total maximal d'instructions (0 : aucune limite)
+    Stats _stats;		//!< Instructions exécutées
+    uint64_t _slices;		//!< Nombre de tranches reçues
+    Task_State _state;		//!< État
+} Sched_Task;
+
+//! Ordonnanceur
+typedef struct
+{
+    uint64_t _quantum;		//!< Nombre maximal d'instructions d'une tranche
+    double _timeout;		//!< Délai de garde (en secondes ; 0 : aucun)
+    double _deadline;		//!< Échéance du délai de garde (0 : pas encore fixée)
+    unsigned _ntimeouts;	//!< Nombre de machines abandonnées sur le délai de garde
+    Sched_Task *_tasks;		//!< Les machines, dans l'ordre de sched_add()
+    unsigned _ntasks;		//!< Nombre de machines
+    unsigned _capacity;		//!< Capacité de \c _tasks et \c _ready
+    unsigned *_ready;		//!< Numéros des machines prêtes, dans l'ordre du tourniquet
+    unsigned _nready;		//!< Nombre de machines prêtes
+} Scheduler;
+
+//! Initialisation d'un ordonnanceur vide
+/*!
+ * \param ps l'ordonnanceur
+ * \param quantum le nombre maximal d'instructions d'une tranche (au moins 1)
+ * \param timeout le délai de garde en secondes, à partir du premier tour (0 :
+ * aucun)
+ */
+void sched_init(Scheduler *ps, uint64_t quantum, double timeout);
+
+//! Ajout d'une machine
+/*!
+ * La machine devient prête, en fin de tourniquet ; elle reste à l'appelant,
+ * qui peut la libérer dès qu'elle n'est plus prête (ou après
+ * sched_release()). Le tableau \c _tasks peut être déplacé.
+ *
+ * \param ps l'ordonnanceur
+ * \param pmach la machine, chargée
+ * \param budget le nombre total maximal d'instructions (0 : aucune limite)
+ * \return le numéro de la machine dans \c _tasks, ou -1 (avec un message) en
+ * cas d'échec d'allocation
+ */
+int sched_add(Scheduler *ps, Machine *pmach, uint64_t budget);
+
+//! Reprise d'une machine arrêtée sur un point d'arrêt
+/*!
+ * La machine redevient prête, en fin de tourniquet ; sa prochaine tranche
+ * exécute l'instruction du point d'arrêt.
+ *
+ * \param ps l'ordonnanceur
+ * \param task le numéro de la machine (dans l'état \c TASK_BREAKPOINT)
+ */
+void sched_resume(Scheduler *ps, unsigned task);
+
+//! Un tour du tourniquet
+/*!
+ * Chaque machine prête reçoit une tranche, dans l'ordre du tourniquet ; une
+ * fois le délai de garde expiré, elle est abandonnée à la place.
+ *
+ * \param ps l'ordonnanceur
+ * \return le nombre de machines encore prêtes
+ */
+unsigned sched_round(Scheduler *ps);
+
+//! Exécution des machines prêtes
+/*!
+ * Les tours (voir sched_round()) se succèdent jusqu'à ce qu'aucune machine ne
+ * soit plus prête.
+ *
+ * \param ps l'ordonnanceur
+ * \return le nombre de machines abandonnées sur le délai de garde
+ */
+unsigned sched_run(Scheduler *ps);
+
+//! Libération de l'ordonnanceur
+/*!
+ * Les machines ne sont pas libérées.
+ *
+ * \param ps l'ordonnanceur
+ */
+void sched_release(Scheduler *ps);
+
+#endif
@@ -0,0 +1,918 @@
+/*!
+ * \file simul_asm.c
+ * \brief Assembleur du langage décrit dans Examples/syntax.asm
+ *
+ * L'assemblage se fait en une seule passe sur le source, lu ligne à ligne. Une
+ * référence à un symbole qui n'est pas encore défini est notée dans une liste
+ * de corrections attachée au symbole ; l'instruction (ou le mot de donnée) est
+ * complétée dès que le symbole reçoit sa valeur. Un synonyme (<tt>a EQU
+ * b</tt>) d'un symbole non encore défini est lui-même une correction de \c b.
+ *
+ * Les symboles sont rangés dans une table de hachage à adressage ouvert ; le
+ * coût de l'assemblage est donc proportionnel à la taille du source.
+ *
+ * Le résultat est un fichier binaire accepté par read_program() : au format
+ * d'origine (version 1) par défaut, au format version 2 (voir image.h), avec
+ * la table des symboles, sur demande.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <ctype.h>
+
+#include "machine.h"
+#include "image.h"
+
+//! Taille de la pile lorsque la directive DATA n'indique pas de taille
+#define DEFAULT_STACKSIZE 100
+
+//! Nature d'un symbole
+typedef enum
+{
+    SYM_CONST,			//!< Constante
+    SYM_TEXT,			//!< Adresse dans le segment de texte
+    SYM_DATA,			//!< Adresse dans le segment de données
+} Symbol_Kind;
+
+//! Nature d'une correction, c'est-à-dire du champ à compléter
+typedef enum
+{
+    FIX_ADDRESS,		//!< Adresse absolue d'une instruction (@)
+    FIX_VALUE,			//!< Valeur immédiate d'une instruction (#)
+    FIX_OFFSET,			//!< Déplacement d'une instruction indexée
+    FIX_WORD,			//!< Mot de donnée (WORD)
+    FIX_ALIAS,			//!< Symbole synonyme (EQU)
+} Fixup_Kind;
+
+//! Correction en attente de la définition d'un symbole
+typedef struct
+{
+    Fixup_Kind _kind;		//!< Champ à compléter
+    unsigned _where;		//!< Adresse de l'instruction ou du mot, ou numéro du synonyme
+    unsigned _line;		//!< Ligne de la référence
+    int _next;			//!< Correction suivante du même symbole (ou -1)
+} Fixup;
+
+//! Symbole du source
+typedef struct
+{
+    char *_name;		//!< Nom (alloué)
+    bool _defined;		//!< Valeur connue ?
+    Symbol_Kind _kind;		//!< Nature
+    long long _value;		//!< Valeur
+    unsigned _line;		//!< Ligne de la définition, ou de la première référence
+    int _fixups;		//!< Première correction en attente (ou -1)
+} Asm_Symbol;
+
+//! Position dans le source
+typedef enum
+{
+    BEFORE_TEXT,		//!< Avant la directive TEXT
+    IN_TEXT,			//!< Dans la section de texte
+    AFTER_TEXT,			//!< Entre les deux sections
+    IN_DATA,			//!< Dans la section de données
+    AFTER_DATA,			//!< Après la section de données
+} Asm_Section;
+
+//! État de l'assembleur
+typedef struct
+{
+    const char *_file;		//!< Nom du source
+    unsigned _line;		//!< Ligne courante
+    unsigned _errors;		//!< Nombre d'erreurs
+    Asm_Section _section;	//!< Section courante
+
+    Instruction *_text;		//!< Segment de texte
+    unsigned _textsize;		//!< Nombre d'instructions
+    unsigned _textcap;		//!< Capacité de _text
+    long long _textdecl;	//!< Taille déclarée par TEXT (ou -1)
+
+    Word *_data;		//!< Segment de données
+    unsigned _datasize;		//!< Nombre de mots
+    unsigned _datacap;		//!< Capacité de _data
+    long long _datadecl;	//!< Taille déclarée par DATA (ou -1)
+
+    Asm_Symbol *_symbols;	//!< Symboles, dans l'ordre de première apparition
+    unsigned _nsymbols;		//!< Nombre de symboles
+    unsigned _symcap;		//!< Capacité de _symbols
+    int *_table;		//!< Table de hachage (numéros de symboles, -1 si vide)
+    unsigned _tablesize;	//!< Taille de la table (puissance de 2)
+
+    Fixup *_fixups;		//!< Corrections
+    unsigned _nfixups;		//!< Nombre de corrections
+    unsigned _fixcap;		//!< Capacité de _fixups
+} Assembler;
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul_asm [options] source\n");
+    printf("where options are:\n"
+           "\t-o file\tOutput binary file (default: source with .bin suffix,\n"
+           "\t\tstandard output if the source is \"-\")\n"
+           "\t-2\tWrite a version 2 image, with the symbol table\n"
+           "\t-h\tprint this help message\n"
+           "The source \"-\" is read from the standard input.\n");
+}
+
+//! Agrandissement d'un tableau
+/*!
+ * \param p le tableau
+ * \param pcap sa capacité (mise à jour)
+ * \param elsize la taille d'un élément
+ * \return le tableau agrandi
+ */
+static void *grow(void *p, unsigned *pcap, size_t elsize)
+{
+    *pcap = *pcap == 0 ? 1024 : 2 * *pcap;
+    if ((p = realloc(p, *pcap * elsize)) == NULL) {
+        perror("simul_asm");
+        exit(EXIT_FAILURE);
+    }
+    return p;
+}
+
+//! Message d'erreur
+/*!
+ * \param pa l'assembleur
+ * \param line la ligne concernée
+ * \param fmt le format du message, suivi de ses arguments
+ */
+static void asm_error(Assembler *pa, unsigned line, const char *fmt, ...)
+{
+    va_list ap;
+    va_start(ap, fmt);
+    fprintf(stderr, "%s:%u: ", pa->_file, line);
+    vfprintf(stderr, fmt, ap);
+    fputc('\n', stderr);
+    va_end(ap);
+    ++pa->_errors;
+}
+
+//! Hachage (FNV-1a) d'un nom
+static unsigned hash(const char *name)
+{
+    unsigned h = 2166136261u;
+    for (; *name != '\0'; ++name) {
+        h ^= (unsigned char) *name;
+        h *= 16777619u;
+    }
+    return h;
+}
+
+//! Recherche d'un symbole, créé (non défini) s'il n'existe pas encore
+/*!
+ * \param pa l'assembleur
+ * \param name le nom
+ * \return le numéro du symbole
+ */
+static int lookup(Assembler *pa, const char *name)
+{
+    // La table est gardée à moitié vide au plus
+    if (2 * (pa->_nsymbols + 1) > pa->_tablesize) {
+        unsigned size = pa->_tablesize == 0 ? 1024 : 2 * pa->_tablesize;
+        int *table = malloc(size * sizeof(int));
+        if (table == NULL) {
+            perror("simul_asm");
+            exit(EXIT_FAILURE);
+        }
+        memset(table, -1, size * sizeof(int));
+        for (unsigned s = 0; s < pa->_nsymbols; ++s) {
+            unsigned h = hash(pa->_symbols[s]._name) & (size - 1);
+            while (table[h] >= 0)
+                h = (h + 1) & (size - 1);
+            table[h] = s;
+        }
+        free(pa->_table);
+        pa->_table = table;
+        pa->_tablesize = size;
+    }
+
+    unsigned h = hash(name) & (pa->_tablesize - 1);
+    for (; pa->_table[h] >= 0; h = (h + 1) & (pa->_tablesize - 1))
+        if (strcmp(pa->_symbols[pa->_table[h]]._name, name) == 0)
+            return pa->_table[h];
+
+    if (pa->_nsymbols == pa->_symcap)
+        pa->_symbols = grow(pa->_symbols, &pa->_symcap, sizeof(Asm_Symbol));
+    pa->_symbols[pa->_nsymbols] = (Asm_Symbol) {
+        ._name = strdup(name),
+        ._line = pa->_line,
+        ._fixups = -1,
+    };
+    pa->_table[h] = pa->_nsymbols;
+    return pa->_nsymbols++;
+}
+
+static void define(Assembler *pa, int sym, long long value, Symbol_Kind kind, unsigned line);
+
+//! Rangement d'une valeur dans le champ qu'elle complète
+/*!
+ * \param pa l'assembleur
+ * \param kind le champ
+ * \param where l'adresse de l'instruction ou du mot, ou le numéro du synonyme
+ * \param value la valeur
+ * \param symkind la nature de la valeur
+ * \param line la ligne de la référence
+ */
+static void store(Assembler *pa, Fixup_Kind kind, unsigned where,
+                  long long value, Symbol_Kind symkind, unsigned line)
+{
+    switch (kind)
+    {
+    case FIX_ADDRESS:
+        if (value < 0 || value > 0xfffff)
+            asm_error(pa, line, "Address out of range: %lld", value);
+        pa->_text[where].instr_absolute._address = value;
+        break;
+    case FIX_VALUE:
+        if (value < -0x80000 || value > 0x7ffff)
+            asm_error(pa, line, "Immediate value out of range: %lld", value);
+        pa->_text[where].instr_immediate._value = value;
+        break;
+    case FIX_OFFSET:
+        if (value < -0x8000 || value > 0x7fff)
+            asm_error(pa, line, "Offset out of range: %lld", value);
+        pa->_text[where].instr_indexed._offset = value;
+        break;
+    case FIX_WORD:
+        if (value < -0x80000000LL || value > 0xffffffffLL)
+            asm_error(pa, line, "Word value out of range: %lld", value);
+        pa->_data[where] = (Word) value;
+        break;
+    case FIX_ALIAS:
+        define(pa, where, value, symkind, line);
+        break;
+    }
+}
+
+//! Définition d'un symbole
+/*!
+ * Les corrections en attente du symbole sont appliquées.
+ *
+ * \param pa l'assembleur
+ * \param sym le numéro du symbole
+ * \param value sa valeur
+ * \param kind sa nature
+ * \param line la ligne de la définition
+ */
+static void define(Assembler *pa, int sym, long long value, Symbol_Kind kind, unsigned line)
+{
+    Asm_Symbol *ps = &pa->_symbols[sym];
+    if (ps->_defined) {
+        asm_error(pa, line, "Symbol %s already defined at line %u", ps->_name, ps->_line);
+        return;
+    }
+    ps->_defined = true;
+    ps->_value = value;
+    ps->_kind = kind;
+    ps->_line = line;
+
+    int f = ps->_fixups;
+    ps->_fixups = -1;
+    for (; f >= 0; f = pa->_fixups[f]._next) {
+        Fixup *pf = &pa->_fixups[f];
+        store(pa, pf->_kind, pf->_where, value, kind, pf->_line);
+    }
+}
+
+//! Nombre décimal ou hexadécimal, éventuellement signé
+/*!
+ * \param s le texte
+ * \param pvalue la valeur (résultat)
+ * \return vrai si tout le texte est un nombre
+ */
+static bool parse_number(const char *s, long long *pvalue)
+{
+    const char *digits = s + (*s == '+' || *s == '-');
+    bool hex = digits[0] == '0' && (digits[1] == 'x' || digits[1] == 'X');
+    if (!isxdigit((unsigned char) digits[hex ? 2 : 0]))
+        return false;
+    char *end;
+    *pvalue = strtoll(s, &end, hex ? 16 : 10);
+    return *end == '\0';
+}
+
+//! Est-ce un nom de symbole ?
+static bool is_name(const char *s)
+{
+    if (!isalpha((unsigned char) *s) && *s != '_')
+        return false;
+    while (isalnum((unsigned char) *s) || *s == '_')
+        ++s;
+    return *s == '\0';
+}
+
+//! Valeur d'un opérande : nombre, symbole ou compteur d'assemblage (*)
+/*!
+ * La valeur est rangée tout de suite dans le champ qu'elle complète si elle
+ * est connue, sinon une correction est attachée au symbole.
+ *
+ * \param pa l'assembleur
+ * \param s le texte de la valeur
+ * \param kind le champ à compléter
+ * \param where l'adresse de l'instruction ou du mot, ou le numéro du synonyme
+ */
+static void parse_value(Assembler *pa, const char *s, Fixup_Kind kind, unsigned where)
+{
+    long long value;
+
+    if (parse_number(s, &value))
+        store(pa, kind, where, value, SYM_CONST, pa->_line);
+    else if (strcmp(s, "*") == 0) {
+        if (pa->_section == IN_TEXT)
+            store(pa, kind, where, pa->_textsize, SYM_TEXT, pa->_line);
+        else if (pa->_section == IN_DATA)
+            store(pa, kind, where, pa->_datasize, SYM_DATA, pa->_line);
+        else
+            asm_error(pa, pa->_line, "Location counter outside of a section");
+    }
+    else if (is_name(s)) {
+        int sym = lookup(pa, s);
+        Asm_Symbol *ps = &pa->_symbols[sym];
+        if (ps->_defined)
+            store(pa, kind, where, ps->_value, ps->_kind, pa->_line);
+        else {
+            if (pa->_nfixups == pa->_fixcap)
+                pa->_fixups = grow(pa->_fixups, &pa->_fixcap, sizeof(Fixup));
+            pa->_fixups[pa->_nfixups] = (Fixup) { kind, where, pa->_line, ps->_fixups };
+            ps->_fixups = pa->_nfixups++;
+        }
+    }
+    else
+        asm_error(pa, pa->_line, "Bad value: %s", s);
+}
+
+//! Numéro de registre (R0 à R15)
+/*!
+ * \return le numéro, ou -1
+ */
+static int parse_register(const char *s)
+{
+    if (s[0] != 'R' || !isdigit((unsigned char) s[1]))
+        return -1;
+    char *end;
+    long r = strtol(s + 1, &end, 10);
+    return *end == '\0' && r < NREGISTERS ? r : -1;
+}
+
+//! Opérande source ou destination d'une instruction : #imm, @addr, off[Rn] ou Rn
+/*!
+ * \param pa l'assembleur
+ * \param s le texte de l'opérande
+ * \param immediate l'adressage immédiat est-il permis ?
+ * \param reg un registre source est-il permis ?
+ */
+static void parse_operand(Assembler *pa, char *s, bool immediate, bool reg)
+{
+    unsigned where = pa->_textsize - 1;
+    Instruction *pi = &pa->_text[where];
+    char *bracket = strchr(s, '[');
+    size_t len = strlen(s);
+    int r = parse_register(s);
+
+    if (r >= 0) {
+        if (!reg)
+            asm_error(pa, pa->_line, "Register operand not allowed");
+        pi->instr_generic._immediate = true;
+        pi->instr_generic._indexed = true;
+        pi->instr_indexed._rindex = r;
+    }
+    else if (s[0] == '#') {
+        if (!immediate)
+            asm_error(pa, pa->_line, "Immediate operand not allowed");
+        pi->instr_generic._immediate = true;
+        parse_value(pa, s + 1, FIX_VALUE, where);
+    }
+    else if (s[0] == '@')
+        parse_value(pa, s + 1, FIX_ADDRESS, where);
+    else if (bracket != NULL && s[len - 1] == ']') {
+        s[len - 1] = '\0';
+        *bracket = '\0';
+        r = parse_register(bracket + 1);
+        if (r < 0)
+            asm_error(pa, pa->_line, "Bad index register: %s", bracket + 1);
+        pi->instr_generic._indexed = true;
+        pi->instr_indexed._rindex = r;
+        if (s[0] != '\0')
+            parse_value(pa, s, FIX_OFFSET, where);
+    }
+    else
+        asm_error(pa, pa->_line, "Bad operand: %s", s);
+}
+
+//! Suppression des blancs en début et fin de texte
+static char *trim(char *s)
+{
+    while (isspace((unsigned char) *s))
+        ++s;
+    size_t len = strlen(s);
+    while (len > 0 && isspace((unsigned char) s[len - 1]))
+        s[--len] = '\0';
+    return s;
+}
+
+//! Découpage des opérandes, séparés par des virgules
+/*!
+ * \param s le texte des opérandes
+ * \param operands les opérandes (résultat)
+ * \param max le nombre maximal d'opérandes
+ * \return le nombre d'opérandes, ou max + 1 s'il y en a trop
+ */
+static unsigned split_operands(char *s, char *operands[], unsigned max)
+{
+    unsigned n = 0;
+    s = trim(s);
+    if (*s == '\0')
+        return 0;
+    for (char *comma; n <= max; s = comma + 1) {
+        comma = strchr(s, ',');
+        if (comma != NULL)
+            *comma = '\0';
+        if (n < max)
+            operands[n] = trim(s);
+        ++n;
+        if (comma == NULL)
+            break;
+    }
+    return n;
+}
+
+//! Code opération d'un mnémonique
+/*!
+ * \return le code, ou -1
+ */
+static int find_cop(const char *s)
+{
+    for (unsigned cop = 0; cop <= LAST_COP; ++cop)
+        if (strcmp(s, cop_names[cop]) == 0)
+            return cop;
+    return -1;
+}
+
+//! Condition d'un branchement
+/*!
+ * \return la condition, ou -1
+ */
+static int find_condition(const char *s)
+{
+    for (unsigned cond = 0; cond <= LAST_CONDITION; ++cond)
+        if (strcmp(s, condition_names[cond]) == 0)
+            return cond;
+    return -1;
+}
+
+//! Est-ce un mot réservé (directive ou mnémonique) ?
+static bool is_keyword(const char *s)
+{
+    return strcmp(s, "TEXT") == 0 || strcmp(s, "DATA") == 0 || strcmp(s, "END") == 0
+        || strcmp(s, "EQU") == 0 || strcmp(s, "WORD") == 0 || find_cop(s) >= 0;
+}
+
+//! Assemblage d'une instruction
+/*!
+ * \param pa l'assembleur
+ * \param cop le code opération
+ * \param args le texte des opérandes
+ */
+static void assemble_instruction(Assembler *pa, Code_Op cop, char *args)
+{
+    if (pa->_section != IN_TEXT) {
+        asm_error(pa, pa->_line, "Instruction outside of text section");
+        return;
+    }
+    if (pa->_textsize == pa->_textcap)
+        pa->_text = grow(pa->_text, &pa->_textcap, sizeof(Instruction));
+    Instruction *pi = &pa->_text[pa->_textsize++];
+    pi->_raw = 0;
+    pi->instr_generic._cop = cop;
+
+    char *operands[3];
+    unsigned n = split_operands(args, operands, 3);
+    unsigned expected;
+    switch (cop)
+    {
+    case ILLOP: case NOP: case RET: case HALT: case FENCE:
+        expected = 0;
+        break;
+    case PUSH: case POP:
+        expected = 1;
+        break;
+    case BRANCH: case CALL:
+        expected = n == 1 ? 1 : 2;
+        break;
+    case BCOPY: case BFILL: case BCMP:
+        expected = 3;
+        break;
+    default:
+        expected = 2;
+        break;
+    }
+    if (n != expected) {
+        asm_error(pa, pa->_line, "%s expects %u operand(s)", cop_names[cop], expected);
+        return;
+    }
+
+    switch (cop)
+    {
+    case BRANCH: case CALL:
+        if (n == 2) {
+            int cond = find_condition(operands[0]);
+            if (cond < 0)
+                asm_error(pa, pa->_line, "Bad condition: %s", operands[0]);
+            pi->instr_generic._regcond = cond < 0 ? 0 : cond;
+        }
+        parse_operand(pa, operands[n - 1], false, false);
+        break;
+    case PUSH:
+        parse_operand(pa, operands[0], true, false);
+        break;
+    case POP:
+        parse_operand(pa, operands[0], false, false);
+        break;
+    case LOAD: case STORE: case ADD: case SUB:
+    case MUL: case DIV: case MOD: case AND: case OR: case XOR:
+    case SHL: case SHR: case SAR: case CMP: case CAS: case XADD: {
+        int r = parse_register(operands[0]);
+        if (r < 0)
+            asm_error(pa, pa->_line, "Bad register: %s", operands[0]);
+        pi->instr_generic._regcond = r < 0 ? 0 : r;
+        parse_operand(pa, operands[1], cop != STORE && !cop_is_atomic(cop),
+                      cop_has_register_form(cop));
+        break;
+    }
+    case BCOPY: case BFILL: case BCMP: {
+        int r[3];
+        for (unsigned i = 0; i < 3; ++i) {
+            r[i] = parse_register(operands[i]);
+            if (r[i] < 0) {
+                asm_error(pa, pa->_line, "Bad register: %s", operands[i]);
+                r[i] = 0;
+            }
+        }
+        pi->instr_generic._immediate = true;
+        pi->instr_generic._indexed = true;
+        pi->instr_generic._regcond = r[0];
+        pi->instr_indexed._rindex = r[1];
+        pi->instr_indexed._offset = r[2];
+        break;
+    }
+    default:
+        break;
+    }
+}
+
+//! Taille facultative d'une section (directives TEXT et DATA)
+/*!
+ * \return la taille, ou -1 si elle est absente ou incorrecte
+ */
+static long long parse_size(Assembler *pa, char *args)
+{
+    long long size;
+    args = trim(args);
+    if (*args == '\0')
+        return -1;
+    if (!parse_number(args, &size) || size < 0 || size > 0xfffff) {
+        asm_error(pa, pa->_line, "Bad section size: %s", args);
+        return -1;
+    }
+    return size;
+}
+
+//! Mot suivant d'une ligne
+/*!
+ * \param pp la position dans la ligne (avancée après le mot)
+ * \return le mot (terminé par un caractère nul), ou NULL en fin de ligne
+ */
+static char *next_word(char **pp)
+{
+    char *p = *pp;
+    while (isspace((unsigned char) *p))
+        ++p;
+    if (*p == '\0')
+        return NULL;
+    char *word = p;
+    while (*p != '\0' && !isspace((unsigned char) *p))
+        ++p;
+    if (*p != '\0')
+        *p++ = '\0';
+    *pp = p;
+    return word;
+}
+
+//! Assemblage d'une ligne
+/*!
+ * Une ligne comporte un symbole facultatif, puis une directive ou une
+ * instruction et ses opérandes. Tout ce qui suit \c // est un commentaire.
+ * Un premier mot qui n'est pas un mot réservé est un symbole, quelle que soit
+ * sa colonne s'il est suivi d'une instruction ou d'une directive ; seul sur
+ * sa ligne, il doit commencer en première colonne, sans quoi c'est une
+ * instruction sans opérande mal orthographiée.
+ *
+ * \param pa l'assembleur
+ * \param line la ligne (modifiée)
+ */
+static void assemble_line(Assembler *pa, char *line)
+{
+    char *comment = strstr(line, "//");
+    if (comment != NULL)
+        *comment = '\0';
+
+    char *args = line;
+    char *label = NULL, *op = next_word(&args);
+    if (op == NULL)
+        return;
+    if (!is_keyword(op)) {
+        label = op;
+        op = next_word(&args);
+        if (!is_name(label)) {
+            asm_error(pa, pa->_line, "Bad symbol or unknown instruction: %s", label);
+            return;
+        }
+        if (op == NULL && label != line) {
+            asm_error(pa, pa->_line, "Unknown instruction: %s", label);
+            return;
+        }
+    }
+    if (op != NULL && !is_keyword(op)) {
+        asm_error(pa, pa->_line, "Unknown instruction or directive: %s", op);
+        return;
+    }
+
+    if (op != NULL && strcmp(op, "EQU") == 0) {
+        // Sans symbole, la directive est sans effet
+        if (label != NULL)
+            parse_value(pa, trim(args), FIX_ALIAS, lookup(pa, label));
+        return;
+    }
+    if (label != NULL) {
+        if (pa->_section == IN_TEXT)
+            define(pa, lookup(pa, label), pa->_textsize, SYM_TEXT, pa->_line);
+        else if (pa->_section == IN_DATA)
+            define(pa, lookup(pa, label), pa->_datasize, SYM_DATA, pa->_line);
+        else
+            asm_error(pa, pa->_line, "Symbol outside of a section: %s", label);
+    }
+    if (op == NULL)
+        return;
+
+    if (strcmp(op, "TEXT") == 0) {
+        if (pa->_section != BEFORE_TEXT)
+            asm_error(pa, pa->_line, "TEXT must be the first section");
+        pa->_section = IN_TEXT;
+        pa->_textdecl = parse_size(pa, args);
+    }
+    else if (strcmp(op, "DATA") == 0) {
+        if (pa->_section != AFTER_TEXT)
+            asm_error(pa, pa->_line, "DATA must follow the text section");
+        pa->_section = IN_DATA;
+        pa->_datadecl = parse_size(pa, args);
+    }
+    else if (strcmp(op, "END") == 0) {
+        if (pa->_section == IN_TEXT)
+            pa->_section = AFTER_TEXT;
+        else if (pa->_section == IN_DATA)
+            pa->_section = AFTER_DATA;
+        else
+            asm_error(pa, pa->_line, "END outside of a section");
+    }
+    else if (strcmp(op, "WORD") == 0) {
+        if (pa->_section != IN_DATA) {
+            asm_error(pa, pa->_line, "WORD outside of data section");
+            return;
+        }
+        if (pa->_datasize == pa->_datacap)
+            pa->_data = grow(pa->_data, &pa->_datacap, sizeof(Word));
+        pa->_data[pa->_datasize++] = 0;
+        parse_value(pa, trim(args), FIX_WORD, pa->_datasize - 1);
+    }
+    else
+        assemble_instruction(pa, find_cop(op), args);
+}
+
+//! Fin de l'assemblage : vérifications et tailles des segments
+/*!
+ * \param pa l'assembleur
+ * \param pdataend première adresse libre après les données (résultat)
+ */
+static void finish(Assembler *pa, unsigned *pdataend)
+{
+    if (pa->_section == BEFORE_TEXT)
+        asm_error(pa, pa->_line, "Missing text section");
+    else if (pa->_section == IN_TEXT || pa->_section == IN_DATA)
+        asm_error(pa, pa->_line, "Missing END");
+
+    // Un synonyme non défini sans référence propre n'est pas signalé : son
+    // origine l'est
+    for (unsigned s = 0; s < pa->_nsymbols; ++s)
+        if (!pa->_symbols[s]._defined && pa->_symbols[s]._fixups >= 0)
+            asm_error(pa, pa->_symbols[s]._line, "Undefined symbol %s", pa->_symbols[s]._name);
+
+    // La taille déclarée du texte est complétée par des instructions nulles
+    // (ILLOP) ; celle des données, par des mots nuls
+    if (pa->_textdecl >= 0 && pa->_textsize > pa->_textdecl)
+        asm_error(pa, pa->_line, "Text section larger than declared (%u > %lld)",
+                  pa->_textsize, pa->_textdecl);
+    *pdataend = pa->_datasize;
+    unsigned datasize = pa->_datadecl >= 0 ? pa->_datadecl : *pdataend + DEFAULT_STACKSIZE;
+    if (datasize < *pdataend + MINSTACKSIZE)
+        asm_error(pa, pa->_line, "Not enough room for stack in data section (%u < %u)",
+                  datasize, *pdataend + MINSTACKSIZE);
+    if (pa->_errors > 0)
+        return;
+
+    while (pa->_textdecl > pa->_textsize) {
+        if (pa->_textsize == pa->_textcap)
+            pa->_text = grow(pa->_text, &pa->_textcap, sizeof(Instruction));
+        pa->_text[pa->_textsize++]._raw = 0;
+    }
+    while (pa->_datasize < datasize) {
+        if (pa->_datasize == pa->_datacap)
+            pa->_data = grow(pa->_data, &pa->_datacap, sizeof(Word));
+        pa->_data[pa->_datasize++] = 0;
+    }
+}
+
+//! Écriture du programme au format d'origine (voir read_program())
+/*!
+ * \param file le fichier
+ * \param pa l'assembleur
+ * \param dataend première adresse libre après les données
+ * \return vrai en cas de succès
+ */
+static bool write_v1(FILE *file, const Assembler *pa, unsigned dataend)
+{
+    unsigned sizes[3] = { pa->_textsize, pa->_datasize, dataend };
+    return fwrite(sizes, sizeof(unsigned), 3, file) == 3
+        && fwrite(pa->_text, sizeof(Instruction), pa->_textsize, file) == pa->_textsize
+        && fwrite(pa->_data, sizeof(Word), pa->_datasize, file) == pa->_datasize;
+}
+
+//! Écriture du programme au format version 2, avec les symboles d'adresses
+/*!
+ * Les constantes (définies par EQU d'une valeur numérique) ne sont pas
+ * écrites : la table des symboles de l'image ne contient que des adresses.
+ *
+ * \param file le fichier
+ * \param pa l'assembleur
+ * \param dataend première adresse libre après les données
+ * \return vrai en cas de succès
+ */
+static bool write_v2(FILE *file, const Assembler *pa, unsigned dataend)
+{
+    Machine mach;
+    memset(&mach, 0, sizeof(mach));
+    mach._text = pa->_text;
+    mach._textsize = pa->_textsize;
+    mach._data = pa->_data;
+    mach._datasize = pa->_datasize;
+    mach._dataend = dataend;
+    mach._symbols = malloc((pa->_nsymbols + 1) * sizeof(Symbol));
+    if (mach._symbols == NULL)
+        return false;
+    for (unsigned s = 0; s < pa->_nsymbols; ++s) {
+        const Asm_Symbol *ps = &pa->_symbols[s];
+        if (ps->_kind != SYM_CONST)
+            mach._symbols[mach._nsymbols++] = (Symbol) {
+                ps->_name, (unsigned) ps->_value, ps->_kind == SYM_DATA
+            };
+    }
+    bool ok = image_write(file, &mach);
+    free(mach._symbols);
+    return ok;
+}
+
+//! Nom par défaut du fichier binaire : le source avec le suffixe .bin
+static char *default_output(const char *source)
+{
+    size_t len = strlen(source);
+    if (len > 4 && strcmp(source + len - 4, ".asm") == 0)
+        len -= 4;
+    char *output = malloc(len + 5);
+    if (output == NULL) {
+        perror("simul_asm");
+        exit(EXIT_FAILURE);
+    }
+    memcpy(output, source, len);
+    strcpy(output + len, ".bin");
+    return output;
+}
+
+//! Programme d'assemblage
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-o <i>fichier</i></dt><dd>fichier binaire produit (par défaut, le
+ *   source avec le suffixe <tt>.bin</tt>, ou la sortie standard si le source
+ *   est l'entrée standard)</dd>
+ *
+ *   <dt>-2</dt><dd>format version 2, avec la table des symboles (voir
+ *   image.h)</dd>
+ * </dl>
+ *
+ * Toutes les erreurs du source sont signalées (avec leur numéro de ligne) ;
+ * le fichier binaire n'est produit que s'il n'y en a aucune.
+ *
+ * Lorsque la directive \c DATA n'indique pas de taille, le segment de données
+ * reçoit une pile de \c DEFAULT_STACKSIZE mots après les données statiques.
+ */
+int main(int argc, char *argv[])
+{
+    char *source = NULL;
+    char *output = NULL;
+    bool v2 = false;
+
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] != '-' || argv[iarg][1] == '\0') {
+            source = argv[iarg];
+            continue;
+        }
+        switch (argv[iarg][1])
+        {
+        case 'o':
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            output = argv[++iarg];
+            break;
+        case '2':
+            v2 = true;
+            break;
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+        default:
+        bad_option:
+            fprintf(stderr, "Bad option: %s\n", argv[iarg]);
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (source == NULL) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    bool from_stdin = strcmp(source, "-") == 0;
+    FILE *in = from_stdin ? stdin : fopen(source, "r");
+    if (in == NULL) {
+        perror(source);
+        exit(EXIT_FAILURE);
+    }
+
+    Assembler as = {
+        ._file = from_stdin ? "<stdin>" : source,
+        ._section = BEFORE_TEXT,
+        ._textdecl = -1,
+        ._datadecl = -1,
+    };
+    char *line = NULL;
+    size_t linesize = 0;
+    while (getline(&line, &linesize, in) != -1) {
+        ++as._line;
+        assemble_line(&as, line);
+    }
+    free(line);
+    if (in != stdin)
+        fclose(in);
+
+    unsigned dataend;
+    finish(&as, &dataend);
+    if (as._errors > 0) {
+        fprintf(stderr, "%s: %u error(s), no output written\n", as._file, as._errors);
+        exit(EXIT_FAILURE);
+    }
+
+    char *name = output != NULL ? output : from_stdin ? "-" : default_output(source);
+    bool to_stdout = strcmp(name, "-") == 0;
+    FILE *out = to_stdout ? stdout : fopen(name, "wb");
+    if (out == NULL) {
+        perror(name);
+        exit(EXIT_FAILURE);
+    }
+    bool ok = v2 ? write_v2(out, &as, dataend) : write_v1(out, &as, dataend);
+    if (fflush(out) != 0 || !ok) {
+        perror(name);
+        exit(EXIT_FAILURE);
+    }
+    if (!to_stdout)
+        fclose(out);
+    if (name != output && !to_stdout)
+        free(name);
+
+    for (unsigned s = 0; s < as._nsymbols; ++s)
+        free(as._symbols[s]._name);
+    free(as._symbols);
+    free(as._table);
+    free(as._fixups);
+    free(as._text);
+    free(as._data);
+    return 0;
+}
@@ -0,0 +1,704 @@
+/*!
+ * \file simul_batch.c
+ * \brief Exécution parallèle d'un lot de programmes
+ *
+ * Les programmes d'un lot sont simulés dans un seul processus par un ensemble
+ * de processus légers, chacun avec sa propre machine. Une erreur dans un
+ * programme (de chargement ou d'exécution) est rattrapée et rapportée dans le
+ * résultat de ce programme, sans interrompre les autres (voir try_simul()).
+ *
+ * Les programmes sont chargés par map_program() : une instruction incorrecte
+ * y est une erreur de chargement.
+ *
+ * Avec l'option \c -q, les programmes sont au contraire exécutés à tour de
+ * rôle, par tranches, sur le seul processus principal (voir sched.h) : un
+ * programme qui boucle ne retarde les autres que d'une tranche par tour, et
+ * un délai de garde (\c -w) borne la durée du lot. Au plus \c MAXRESIDENT
+ * programmes sont chargés à la fois.
+ *
+ * Avec l'option \c -s, les travaux d'un même programme partagent le début de
+ * son exécution : le programme est exécuté une fois jusqu'à l'adresse donnée,
+ * un instantané est pris (voir snapshot.h) et chaque travail en poursuit une
+ * copie, après y avoir appliqué ses propres modifications des données et des
+ * registres.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <limits.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include "machine.h"
+#include "error.h"
+#include "sched.h"
+#include "debug.h"
+#include "snapshot.h"
+
+//! Longueur maximale d'une ligne du manifeste
+#define LINESIZE 4096
+
+//! Nombre maximal de processus légers
+#define MAXWORKERS 256
+
+//! Nombre maximal de programmes chargés à la fois en exécution coopérative
+#define MAXRESIDENT 1024
+
+//! Un programme du lot et son résultat
+typedef struct
+{
+    char *_program;		//!< Fichier binaire du programme
+    char *_variant;		//!< Contenu initial de remplacement des données (ou NULL)
+    uint16_t _setregs;		//!< Registres modifiés avant l'exécution (un bit par registre)
+    Word _regvalues[NREGISTERS];//!< Valeurs de ces registres
+    Snapshot *_fork;		//!< Instantané dont le travail poursuit une copie (ou NULL)
+    uint64_t _forked;		//!< Instructions exécutées avant l'instantané
+
+    Error _err;			//!< Erreur de chargement ou d'exécution (ou ERR_NOERROR)
+    unsigned _addr;		//!< Adresse de l'erreur d'exécution
+    const char *_detail;	//!< Description de l'erreur de chargement
+    unsigned _pc;		//!< Compteur ordinal final
+    Condition_Code _cc;		//!< Signe du code condition final
+    Word _registers[NREGISTERS];//!< Registres finaux
+    uint64_t _digest;		//!< Empreinte du segment de données final
+    uint64_t _instructions;	//!< Nombre d'instructions exécutées
+    Task_State _state;		//!< Abandon éventuel (TASK_EXHAUSTED, TASK_TIMEOUT)
+} Job;
+
+//! File de travaux d'un processus léger
+/*!
+ * Chaque processus léger reçoit un intervalle [next, end[ de numéros de
+ * travaux, rangé dans un seul mot atomique (\c next dans les 32 bits de poids
+ * faible, \c end dans les 32 bits de poids fort). Le propriétaire prend ses
+ * travaux par le début ; un processus léger inoccupé vole ceux des autres par
+ * la fin. Chaque prise est une comparaison-échange du mot entier : elle ne
+ * peut réussir que si l'intervalle n'a pas changé entre-temps, ce qui
+ * garantit qu'un travail n'est pris qu'une fois, sans verrou.
+ */
+typedef struct
+{
+    atomic_uint_fast64_t _range;	//!< Intervalle des travaux restants
+    char _pad[64 - sizeof(atomic_uint_fast64_t)];	//!< Une ligne de cache par file
+} Work_Queue;
+
+//! Contexte partagé par les processus légers
+typedef struct
+{
+    Job *_jobs;			//!< Les travaux
+    Work_Queue *_queues;	//!< Une file par processus léger
+    unsigned _nworkers;		//!< Nombre de processus légers
+    uint64_t _budget;		//!< Nombre maximal d'instructions par programme (0 : aucun)
+} Batch;
+
+//! Argument d'un processus léger
+typedef struct
+{
+    Batch *_batch;		//!< Le lot
+    unsigned _self;		//!< Numéro du processus léger
+} Worker;
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul_batch [options] manifest\n");
+    printf("where options are:\n"
+           "\t-j n\tNumber of worker threads (default: number of processors)\n"
+           "\t-o file\tWrite the results into file (default: standard output)\n"
+           "\t-B n\tStop each program after n instructions\n"
+           "\t-q n\tRun all the programs on the main thread, in turn, n instructions\n"
+           "\t\tat a time (no worker threads)\n"
+           "\t-w sec\tWith -q, stop the programs not finished after sec seconds\n"
+           "\t-s addr\tRun each program once up to the instruction at addr, then\n"
+           "\t\tstart each of its lines from a copy of that state\n"
+           "\t-h\tprint this help message\n"
+           "Each line of the manifest names a binary program file, optionally\n"
+           "followed by a file of raw words replacing the beginning of its\n"
+           "data segment and by register settings such as R01=5. Empty lines\n"
+           "and lines starting with # are ignored.\n"
+           "The manifest \"-\" is read from the standard input.\n");
+}
+
+//! Intervalle de travaux rangé dans un mot
+static uint64_t make_range(uint32_t next, uint32_t end)
+{
+    return (uint64_t) end << 32 | next;
+}
+
+//! Prise d'un travail dans une file
+/*!
+ * \param pq la file
+ * \param steal par la fin (vol) plutôt que par le début ?
+ * \return le numéro du travail, ou -1 si la file est vide
+ */
+static long take_job(Work_Queue *pq, bool steal)
+{
+    uint_fast64_t range = atomic_load(&pq->_range);
+
+    while (true) {
+        uint32_t next = (uint32_t) range;
+        uint32_t end = (uint32_t) (range >> 32);
+        if (next >= end)
+            return -1;
+        uint64_t taken = steal ? make_range(next, end - 1) : make_range(next + 1, end);
+        if (atomic_compare_exchange_weak(&pq->_range, &range, taken))
+            return steal ? end - 1 : next;
+    }
+}
+
+//! Empreinte (FNV-1a sur 64 bits) d'une zone de mots
+static uint64_t digest(const Word *words, unsigned n)
+{
+    uint64_t h = 0xcbf29ce484222325ULL;
+    for (unsigned i = 0; i < n; ++i)
+        for (unsigned b = 0; b < sizeof(Word); ++b) {
+            h ^= (words[i] >> (8 * b)) & 0xff;
+            h *= 0x100000001b3ULL;
+        }
+    return h;
+}
+
+//! Remplacement du début du segment de données
+/*!
+ * \param pmach la machine chargée
+ * \param variant le fichier de mots bruts
+ * \return NULL, ou la description de l'erreur
+ */
+static const char *load_variant(Machine *pmach, const char *variant)
+{
+    FILE *file = fopen(variant, "rb");
+    if (file == NULL)
+        return "Cannot open data variant file";
+
+    size_t n = fread(pmach->_data, sizeof(Word), pmach->_datasize, file);
+    bool toolong = n == pmach->_datasize && fgetc(file) != EOF;
+    fclose(file);
+    if (toolong)
+        return "Data variant larger than data segment";
+    return NULL;
+}
+
+//! Chargement du programme d'un travail
+/*!
+ * Le programme est chargé depuis son fichier, ou copié depuis l'instantané
+ * du travail ; les données et les registres sont ensuite modifiés.
+ *
+ * \param pjob le travail (l'erreur de chargement y est rangée)
+ * \param pmach la machine à charger
+ * \return vrai si le programme est chargé
+ */
+static bool load_job(Job *pjob, Machine *pmach)
+{
+    if (pjob->_fork == NULL)
+        pjob->_err = try_read_program(pmach, pjob->_program, true, &pjob->_detail);
+    else if (!snapshot_fork(pjob->_fork, pmach)) {
+        pjob->_err = ERR_PROGFILE;
+        pjob->_detail = "Cannot fork the snapshot";
+    }
+    if (pjob->_err != ERR_NOERROR)
+        return false;
+    if (pjob->_variant != NULL
+        && (pjob->_detail = load_variant(pmach, pjob->_variant)) != NULL) {
+        pjob->_err = ERR_PROGFILE;
+        unload_program(pmach);
+        return false;
+    }
+    for (int r = 0; r < NREGISTERS; ++r)
+        if (pjob->_setregs >> r & 1)
+            pmach->_registers[r] = pjob->_regvalues[r];
+    return true;
+}
+
+//! Budget restant d'un travail
+/*!
+ * \param pjob le travail
+ * \param budget nombre maximal d'instructions par programme (0 : aucun)
+ * \return le budget diminué des instructions exécutées avant l'instantané
+ */
+static uint64_t job_budget(const Job *pjob, uint64_t budget)
+{
+    return budget == 0 ? 0 : budget - pjob->_forked;
+}
+
+//! Exécution commune aux travaux d'un programme, jusqu'à une adresse
+/*!
+ * \param program le fichier binaire du programme
+ * \param addr l'adresse de l'instruction avant laquelle l'instantané est pris
+ * \param budget nombre maximal d'instructions par programme (0 : aucun)
+ * \param pcount nombre d'instructions exécutées (résultat)
+ * \return l'instantané, ou NULL si le programme n'atteint pas \c addr (il ne
+ * se charge pas, s'arrête ou épuise son budget avant)
+ */
+static Snapshot *run_prefix(const char *program, unsigned addr, uint64_t budget,
+                            uint64_t *pcount)
+{
+    Machine mach;
+    Stats stats = { 0 };
+
+    *pcount = 0;
+    if (try_read_program(&mach, program, true, NULL) != ERR_NOERROR)
+        return NULL;
+    bool reached = mach._pc == addr;
+    if (!reached && addr < mach._textsize && debug_breakpoint(&mach, addr, true))
+        reached = simul_step(&mach, budget != 0 ? budget : UINT64_MAX, &stats)
+            == SIMUL_BREAKPOINT && (budget == 0 || stats._instructions < budget);
+
+    Snapshot *ps = reached ? snapshot_take(&mach) : NULL;
+    *pcount = stats._instructions;
+    unload_program(&mach);
+    return ps;
+}
+
+//! Relevé du résultat d'un travail exécuté
+/*!
+ * \param pjob le travail (le résultat y est rangé)
+ * \param pmach sa machine (déchargée)
+ * \param pstats ses statistiques
+ */
+static void finish_job(Job *pjob, Machine *pmach, const Stats *pstats)
+{
+    pjob->_addr = pmach->_faultaddr;
+    pjob->_pc = pmach->_pc;
+    pjob->_cc = cc_sign(pmach->_cc);
+    memcpy(pjob->_registers, pmach->_registers, sizeof(pmach->_registers));
+    pjob->_digest = digest(pmach->_data, pmach->_datasize);
+    pjob->_instructions = pjob->_forked + pstats->_instructions;
+
+    unload_program(pmach);
+}
+
+//! Exécution d'un travail
+/*!
+ * \param pjob le travail (le résultat y est rangé)
+ * \param budget nombre maximal d'instructions (0 : aucun)
+ */
+static void run_job(Job *pjob, uint64_t budget)
+{
+    Machine mach;
+    Stats stats = { 0 };
+
+    if (!load_job(pjob, &mach))
+        return;
+    budget = job_budget(pjob, budget);
+    if (budget == 0)
+        pjob->_err = try_simul(&mach, TRACE_NONE, &stats);
+    else {
+        if (simul_step(&mach, budget, &stats) == SIMUL_BUDGET)
+            pjob->_state = TASK_EXHAUSTED;
+        pjob->_err = mach._fault;
+    }
+    finish_job(pjob, &mach, &stats);
+}
+
+//! Programme chargé en exécution coopérative
+typedef struct
+{
+    Machine _mach;		//!< Sa machine
+    unsigned _job;		//!< Numéro du travail
+    int _task;			//!< Numéro dans l'ordonnanceur (-1 : emplacement libre)
+} Slot;
+
+//! Chargement du prochain travail dans un emplacement libre
+/*!
+ * Les travaux qui ne peuvent pas être chargés sont passés (leur erreur de
+ * chargement est leur résultat).
+ *
+ * \param pslot l'emplacement
+ * \param psched l'ordonnanceur
+ * \param jobs les travaux
+ * \param njobs leur nombre
+ * \param pnext numéro du prochain travail à charger (mis à jour)
+ * \param budget nombre maximal d'instructions par programme (0 : aucun)
+ * \return vrai si un travail a été chargé et confié à l'ordonnanceur
+ */
+static bool fill_slot(Slot *pslot, Scheduler *psched, Job *jobs, unsigned njobs,
+                      unsigned *pnext, uint64_t budget)
+{
+    pslot->_task = -1;
+    while (*pnext < njobs) {
+        pslot->_job = (*pnext)++;
+        Job *pjob = &jobs[pslot->_job];
+        if (load_job(pjob, &pslot->_mach)) {
+            pslot->_task = sched_add(psched, &pslot->_mach, job_budget(pjob, budget));
+            if (pslot->_task < 0)
+                exit(EXIT_FAILURE);
+            return true;
+        }
+    }
+    return false;
+}
+
+//! Exécution coopérative de tous les travaux sur le processus courant
+/*!
+ * Au plus \c MAXRESIDENT programmes sont chargés à la fois : après chaque
+ * tour de l'ordonnanceur, les programmes terminés sont relevés et déchargés,
+ * et remplacés par les suivants.
+ *
+ * \param jobs les travaux
+ * \param njobs leur nombre
+ * \param quantum nombre maximal d'instructions d'une tranche
+ * \param budget nombre maximal d'instructions par programme (0 : aucun)
+ * \param timeout délai de garde en secondes (0 : aucun)
+ */
+static void run_scheduled(Job *jobs, unsigned njobs, uint64_t quantum, uint64_t budget,
+                          double timeout)
+{
+    unsigned nslots = njobs < MAXRESIDENT ? njobs : MAXRESIDENT;
+    Slot *slots = malloc(nslots * sizeof(Slot));
+    if (nslots > 0 && slots == NULL) {
+        perror("simul_batch");
+        exit(EXIT_FAILURE);
+    }
+
+    Scheduler sched;
+    sched_init(&sched, quantum, timeout);
+    unsigned next = 0, nresident = 0;
+    for (unsigned s = 0; s < nslots; ++s)
+        if (fill_slot(&slots[s], &sched, jobs, njobs, &next, budget))
+            ++nresident;
+
+    while (nresident > 0) {
+        sched_round(&sched);
+        for (unsigned s = 0; s < nslots; ++s) {
+            Slot *pslot = &slots[s];
+            if (pslot->_task < 0 || sched._tasks[pslot->_task]._state == TASK_READY)
+                continue;
+            Sched_Task *pt = &sched._tasks[pslot->_task];
+            Job *pjob = &jobs[pslot->_job];
+            if (pt->_state == TASK_EXHAUSTED || pt->_state == TASK_TIMEOUT)
+                pjob->_state = pt->_state;
+            pjob->_err = pt->_state == TASK_FAULTED ? pslot->_mach._fault : ERR_NOERROR;
+            finish_job(pjob, &pslot->_mach, &pt->_stats);
+            if (!fill_slot(pslot, &sched, jobs, njobs, &next, budget))
+                --nresident;
+        }
+    }
+    sched_release(&sched);
+    free(slots);
+}
+
+//! Processus léger d'exécution des travaux
+/*!
+ * Il épuise sa propre file, puis vole les travaux des autres jusqu'à ce
+ * que toutes les files soient vides.
+ *
+ * \param arg le Worker
+ */
+static void *work(void *arg)
+{
+    Worker *pw = arg;
+    Batch *pb = pw->_batch;
+    long j;
+
+    while ((j = take_job(&pb->_queues[pw->_self], false)) >= 0)
+        run_job(&pb->_jobs[j], pb->_budget);
+
+    bool found;
+    do {
+        found = false;
+        for (unsigned k = 1; k < pb->_nworkers; ++k) {
+            Work_Queue *victim = &pb->_queues[(pw->_self + k) % pb->_nworkers];
+            while ((j = take_job(victim, true)) >= 0) {
+                run_job(&pb->_jobs[j], pb->_budget);
+                found = true;
+            }
+        }
+    } while (found);
+    return NULL;
+}
+
+//! Lecture du manifeste
+/*!
+ * \param manifest le nom du fichier ("-" pour l'entrée standard)
+ * \param pnjobs nombre de travaux (résultat)
+ * \return le tableau des travaux
+ */
+static Job *read_manifest(const char *manifest, unsigned *pnjobs)
+{
+    FILE *file = strcmp(manifest, "-") == 0 ? stdin : fopen(manifest, "r");
+    if (file == NULL) {
+        perror(manifest);
+        exit(EXIT_FAILURE);
+    }
+
+    Job *jobs = NULL;
+    unsigned njobs = 0, capacity = 0;
+    char line[LINESIZE];
+    while (fgets(line, sizeof(line), file) != NULL) {
+        char *program = strtok(line, " \t\r\n");
+        if (program == NULL || program[0] == '#')
+            continue;
+        char *variant = NULL;
+        uint16_t setregs = 0;
+        Word regvalues[NREGISTERS] = { 0 };
+        for (char *field; (field = strtok(NULL, " \t\r\n")) != NULL; ) {
+            if (field[0] != 'R' || strchr(field, '=') == NULL) {
+                variant = field;
+                continue;
+            }
+            char *end;
+            unsigned long r = strtoul(field + 1, &end, 10);
+            if (end == field + 1 || *end != '=' || r >= NREGISTERS) {
+                fprintf(stderr, "%s: bad register setting: %s\n", manifest, field);
+                exit(EXIT_FAILURE);
+            }
+            regvalues[r] = strtoul(end + 1, &end, 0);
+            setregs |= 1u << r;
+        }
+
+        if (njobs == capacity) {
+            capacity = capacity == 0 ? 64 : 2 * capacity;
+            if ((jobs = realloc(jobs, capacity * sizeof(Job))) == NULL) {
+                perror("simul_batch");
+                exit(EXIT_FAILURE);
+            }
+        }
+        jobs[njobs] = (Job) {
+            ._program = strdup(program),
+            ._variant = variant != NULL ? strdup(variant) : NULL,
+            ._setregs = setregs,
+        };
+        memcpy(jobs[njobs]._regvalues, regvalues, sizeof(regvalues));
+        ++njobs;
+    }
+    if (file != stdin)
+        fclose(file);
+
+    *pnjobs = njobs;
+    return jobs;
+}
+
+//! Écriture du résultat d'un travail
+/*!
+ * Une ligne par travail, champs séparés par des tabulations : programme
+ * (suivi de \c +variante et des registres modifiés), puis \c HALT et l'état final, ou \c FAULT, l'erreur
+ * et son adresse, puis l'état au moment de l'erreur, ou \c BUDGET ou \c
+ * TIMEOUT et l'état au moment de l'abandon, ou encore \c LOAD et l'erreur de
+ * chargement.
+ *
+ * \param out le fichier de résultats
+ * \param pjob le travail
+ */
+static void print_job(FILE *out, const Job *pjob)
+{
+    fputs(pjob->_program, out);
+    if (pjob->_variant != NULL)
+        fprintf(out, "+%s", pjob->_variant);
+    for (int r = 0; r < NREGISTERS; ++r)
+        if (pjob->_setregs >> r & 1)
+            fprintf(out, "+R%02d=0x%x", r, pjob->_regvalues[r]);
+
+    if (pjob->_err == ERR_PROGFILE) {
+        fprintf(out, "\tLOAD\t%s: %s\n", error_names[ERR_PROGFILE], pjob->_detail);
+        return;
+    }
+    if (pjob->_state == TASK_EXHAUSTED)
+        fputs("\tBUDGET", out);
+    else if (pjob->_state == TASK_TIMEOUT)
+        fputs("\tTIMEOUT", out);
+    else if (pjob->_err == ERR_NOERROR)
+        fputs("\tHALT", out);
+    else
+        fprintf(out, "\tFAULT\t%s at 0x%x", error_names[pjob->_err], pjob->_addr);
+
+    fprintf(out, "\tpc=0x%04x\tcc=%c\tregs=", pjob->_pc, cc_names[pjob->_cc]);
+    for (int i = 0; i < NREGISTERS; ++i)
+        fprintf(out, i == 0 ? "%08x" : ",%08x", pjob->_registers[i]);
+    fprintf(out, "\tdata=%016llx\tinstructions=%llu\n",
+            (unsigned long long) pjob->_digest,
+            (unsigned long long) pjob->_instructions);
+}
+
+//! Programme d'exécution d'un lot
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-j <i>n</i></dt><dd>nombre de processus légers (par défaut, le
+ *   nombre de processeurs)</dd>
+ *
+ *   <dt>-o <i>fichier</i></dt><dd>fichier des résultats (par défaut, la
+ *   sortie standard)</dd>
+ *
+ *   <dt>-B <i>n</i></dt><dd>nombre maximal d'instructions de chaque
+ *   programme, au-delà duquel il est abandonné (voir simul_step())</dd>
+ *
+ *   <dt>-q <i>n</i></dt><dd>exécution coopérative : les programmes sont
+ *   exécutés à tour de rôle par tranches d'au plus \c n instructions sur le
+ *   processus principal (voir sched.h) ; \c -j est ignoré</dd>
+ *
+ *   <dt>-w <i>secondes</i></dt><dd>avec \c -q, délai de garde : les
+ *   programmes qui ne sont pas terminés à son expiration sont
+ *   abandonnés</dd>
+ *
+ *   <dt>-s <i>adresse</i></dt><dd>chaque programme du manifeste est exécuté
+ *   une fois jusqu'à l'instruction d'adresse donnée, puis chacun de ses
+ *   travaux repart d'une copie de cet état (voir run_prefix()) ; les
+ *   modifications des données et des registres s'appliquent à la copie. Un
+ *   programme qui n'atteint pas l'adresse est exécuté depuis le début par
+ *   chacun de ses travaux</dd>
+ * </dl>
+ *
+ * Les résultats sont écrits dans l'ordre du manifeste, quel que soit l'ordre
+ * d'exécution.
+ */
+int main(int argc, char *argv[])
+{
+    long nworkers = sysconf(_SC_NPROCESSORS_ONLN);
+    char *outfile = NULL;
+    char *manifest = NULL;
+    uint64_t budget = 0;
+    uint64_t quantum = 0;
+    double timeout = 0;
+    bool forking = false;
+    unsigned long forkaddr = 0;
+    char *end;
+
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] != '-' || argv[iarg][1] == '\0') {
+            manifest = argv[iarg];
+            continue;
+        }
+        // Les options à valeur avancent iarg : l'option fautive est en opt
+        const int opt = iarg;
+        switch (argv[iarg][1])
+        {
+        case 'j':
+            if (iarg + 1 >= argc || (nworkers = strtol(argv[++iarg], NULL, 10)) <= 0
+                || nworkers > MAXWORKERS)
+                goto bad_option;
+            break;
+        case 'o':
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            outfile = argv[++iarg];
+            break;
+        case 'B':
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            budget = strtoull(argv[++iarg], &end, 0);
+            if (*end != '\0')
+                goto bad_option;
+            break;
+        case 'q':
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            quantum = strtoull(argv[++iarg], &end, 0);
+            if (*end != '\0' || quantum == 0)
+                goto bad_option;
+            break;
+        case 'w':
+            if (iarg + 1 >= argc || (timeout = strtod(argv[++iarg], &end)) <= 0
+                || *end != '\0')
+                goto bad_option;
+            break;
+        case 's':
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            forkaddr = strtoul(argv[++iarg], &end, 0);
+            if (*end != '\0' || forkaddr > UINT_MAX)
+                goto bad_option;
+            forking = true;
+            break;
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+        default:
+        bad_option:
+            fprintf(stderr, "Bad option: %s\n", argv[opt]);
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (manifest == NULL || (timeout > 0 && quantum == 0)) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+    if (nworkers <= 0)
+        nworkers = 1;
+
+    unsigned njobs;
+    Job *jobs = read_manifest(manifest, &njobs);
+
+    // Un instantané par programme, partagé par tous ses travaux
+    Snapshot **forks = forking ? calloc(njobs, sizeof(Snapshot *)) : NULL;
+    unsigned nforks = 0;
+    for (unsigned j = 0; forking && j < njobs; ++j) {
+        unsigned k = 0;
+        while (k < j && strcmp(jobs[k]._program, jobs[j]._program) != 0)
+            ++k;
+        if (k < j) {
+            jobs[j]._fork = jobs[k]._fork;
+            jobs[j]._forked = jobs[k]._forked;
+        }
+        else if ((jobs[j]._fork = run_prefix(jobs[j]._program, forkaddr, budget,
+                                             &jobs[j]._forked)) != NULL)
+            forks[nforks++] = jobs[j]._fork;
+        if (jobs[j]._fork == NULL)
+            jobs[j]._forked = 0;
+    }
+    if ((unsigned long) nworkers > njobs || quantum != 0)
+        nworkers = njobs > 0 && quantum == 0 ? njobs : 1;
+
+    // Répartition initiale des travaux en intervalles consécutifs
+    Batch batch = { jobs, calloc(nworkers, sizeof(Work_Queue)), nworkers, budget };
+    Worker workers[MAXWORKERS];
+    pthread_t threads[MAXWORKERS];
+    if (quantum != 0)
+        run_scheduled(jobs, njobs, quantum, budget, timeout);
+    else {
+        for (unsigned w = 0; w < nworkers; ++w) {
+            uint32_t first = (uint64_t) njobs * w / nworkers;
+            uint32_t last = (uint64_t) njobs * (w + 1) / nworkers;
+            atomic_init(&batch._queues[w]._range, make_range(first, last));
+            workers[w] = (Worker) { &batch, w };
+        }
+        for (unsigned w = 1; w < nworkers; ++w)
+            if (pthread_create(&threads[w], NULL, work, &workers[w]) != 0) {
+                perror("simul_batch");
+                exit(EXIT_FAILURE);
+            }
+        work(&workers[0]);
+        for (unsigned w = 1; w < nworkers; ++w)
+            pthread_join(threads[w], NULL);
+    }
+
+    FILE *out = outfile != NULL ? fopen(outfile, "w") : stdout;
+    if (out == NULL) {
+        perror(outfile);
+        exit(EXIT_FAILURE);
+    }
+    unsigned nhalted = 0, nfaulted = 0, nload = 0, nstopped = 0;
+    for (unsigned j = 0; j < njobs; ++j) {
+        print_job(out, &jobs[j]);
+        if (jobs[j]._state == TASK_EXHAUSTED || jobs[j]._state == TASK_TIMEOUT)
+            ++nstopped;
+        else if (jobs[j]._err == ERR_NOERROR)
+            ++nhalted;
+        else if (jobs[j]._err == ERR_PROGFILE)
+            ++nload;
+        else
+            ++nfaulted;
+        free(jobs[j]._program);
+        free(jobs[j]._variant);
+    }
+    if (out != stdout)
+        fclose(out);
+    fprintf(stderr, "%u programs: %u halted, %u faulted, %u stopped, %u not loaded (%ld threads)\n",
+            njobs, nhalted, nfaulted, nstopped, nload, nworkers);
+
+    for (unsigned f = 0; f < nforks; ++f)
+        snapshot_release(forks[f]);
+    free(forks);
+    free(batch._queues);
+    free(jobs);
+    return 0;
+}
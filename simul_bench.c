@@ -0,0 +1,512 @@
+/*!
+ * \file simul_bench.c
+ * \brief Mesure des performances du simulateur
+ *
+ * Un ensemble de programmes synthétiques, engendrés en mémoire, exerce
+ * chacun une partie du jeu d'instructions : calcul en registres, appels
+ * récursifs, pile, parcours d'un grand segment de données, branchements
+ * conditionnels imprévisibles. Chaque programme est exécuté plusieurs fois
+ * sans trace ni affichage ; on retient la meilleure durée.
+ *
+ * Les résultats (millions d'instructions par seconde et nanosecondes par
+ * instruction) peuvent être enregistrés dans un fichier de référence, puis
+ * comparés à ceux d'une exécution ultérieure (cible \c bench de la Makefile).
+ */
+
+#define _POSIX_C_SOURCE 200809L
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <setjmp.h>
+#include <time.h>
+
+#include "machine.h"
+#include "error.h"
+#include "jit.h"
+
+//! Longueur maximale d'un nom de programme
+#define NAMESIZE 32
+
+//! Nombre maximal d'instructions d'un programme engendré
+#define MAXTEXT 64
+
+//! Début de la zone de travail dans les données (les premiers mots sont des paramètres)
+#define WORK 16
+
+//! Programme engendré
+typedef struct
+{
+    Instruction _text[MAXTEXT];	//!< Segment de texte
+    unsigned _textsize;		//!< Nombre d'instructions
+    Word *_data;		//!< Contenu initial du segment de données (alloué)
+    unsigned _datasize;		//!< Taille du segment de données
+} Program;
+
+//! Programme de mesure
+typedef struct
+{
+    const char *_name;		//!< Nom
+    const char *_description;	//!< Description
+    void (*_build)(Program *, unsigned); //!< Construction (programme, facteur d'échelle)
+} Workload;
+
+//! Résultat de référence
+typedef struct
+{
+    char _name[NAMESIZE];	//!< Nom du programme
+    double _mips;		//!< Millions d'instructions par seconde
+} Baseline;
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul_bench [options] [workload...]\n");
+    printf("where options are:\n"
+           "\t-n reps\tNumber of timed runs of each workload; the best one is kept\n"
+           "\t\t(default: 5)\n"
+           "\t-s scale\tMultiply the length of every workload (default: 1)\n"
+           "\t-j\tTime the JIT engine instead of the threaded interpreter\n"
+           "\t-b file\tCompare with the baseline results in file\n"
+           "\t-w file\tSave the results as a baseline into file\n"
+           "\t-l\tList the workloads and exit\n"
+           "\t-h\tprint this help message\n"
+           "Without workload names, all the workloads are run.\n");
+}
+
+//! Ajout d'une instruction
+/*!
+ * \param pp le programme
+ * \param cop le code opération
+ * \param regcond le registre ou la condition
+ * \return l'instruction, à compléter
+ */
+static Instruction *emit(Program *pp, Code_Op cop, unsigned regcond)
+{
+    Instruction *pi = &pp->_text[pp->_textsize++];
+    pi->_raw = 0;
+    pi->instr_generic._cop = cop;
+    pi->instr_generic._regcond = regcond;
+    return pi;
+}
+
+//! Ajout d'une instruction sans opérande
+static void emit_op(Program *pp, Code_Op cop)
+{
+    emit(pp, cop, 0);
+}
+
+//! Ajout d'une instruction en adressage immédiat
+static void emit_imm(Program *pp, Code_Op cop, unsigned regcond, int value)
+{
+    Instruction *pi = emit(pp, cop, regcond);
+    pi->instr_generic._immediate = true;
+    pi->instr_immediate._value = value;
+}
+
+//! Ajout d'une instruction en adressage absolu
+static void emit_abs(Program *pp, Code_Op cop, unsigned regcond, unsigned address)
+{
+    emit(pp, cop, regcond)->instr_absolute._address = address;
+}
+
+//! Ajout d'une instruction en adressage indexé
+static void emit_idx(Program *pp, Code_Op cop, unsigned regcond, unsigned rindex, int offset)
+{
+    Instruction *pi = emit(pp, cop, regcond);
+    pi->instr_generic._indexed = true;
+    pi->instr_indexed._rindex = rindex;
+    pi->instr_indexed._offset = offset;
+}
+
+//! Allocation du segment de données
+/*!
+ * \param pp le programme
+ * \param datasize la taille du segment (pile comprise)
+ */
+static void alloc_data(Program *pp, unsigned datasize)
+{
+    pp->_datasize = datasize;
+    if ((pp->_data = calloc(datasize, sizeof(Word))) == NULL) {
+        perror("simul_bench");
+        exit(EXIT_FAILURE);
+    }
+}
+
+//! Calcul en registres : boucle serrée d'ADD et de SUB
+static void build_alu(Program *pp, unsigned scale)
+{
+    alloc_data(pp, WORK + MINSTACKSIZE);
+    pp->_data[0] = 10000000 * scale;
+
+    emit_abs(pp, LOAD, 1, 0);
+    unsigned loop = pp->_textsize;
+    emit_imm(pp, ADD, 0, 3);
+    emit_imm(pp, SUB, 2, 1);
+    emit_imm(pp, ADD, 3, 7);
+    emit_imm(pp, SUB, 4, 5);
+    emit_imm(pp, SUB, 1, 1);
+    emit_abs(pp, BRANCH, GT, loop);
+    emit_op(pp, HALT);
+}
+
+//! Appels récursifs avec passage de paramètre sur la pile (voir prog_subroutine)
+static void build_call(Program *pp, unsigned scale)
+{
+    const unsigned depth = 1000;
+    alloc_data(pp, WORK + 2 * depth + MINSTACKSIZE);
+    pp->_data[0] = 5000 * scale;
+    pp->_data[1] = depth;
+
+    emit_abs(pp, LOAD, 2, 0);
+    unsigned outer = pp->_textsize;
+    emit_abs(pp, PUSH, 0, 1);
+    unsigned call = pp->_textsize;
+    emit_abs(pp, CALL, NC, 0);			// Complété plus bas
+    emit_imm(pp, ADD, 15, 1);
+    emit_imm(pp, SUB, 2, 1);
+    emit_abs(pp, BRANCH, GT, outer);
+    emit_op(pp, HALT);
+
+    // f(n) : si n > 1, f(n - 1)
+    unsigned f = pp->_textsize;
+    pp->_text[call].instr_absolute._address = f;
+    emit_idx(pp, LOAD, 0, 15, 2);
+    emit_imm(pp, SUB, 0, 1);
+    unsigned test = pp->_textsize;
+    emit_abs(pp, BRANCH, LE, 0);		// Complété plus bas
+    emit_abs(pp, STORE, 0, 2);
+    emit_abs(pp, PUSH, 0, 2);
+    emit_abs(pp, CALL, NC, f);
+    emit_imm(pp, ADD, 15, 1);
+    emit_imm(pp, ADD, 3, 1);
+    pp->_text[test].instr_absolute._address = pp->_textsize;
+    emit_op(pp, RET);
+}
+
+//! Empilements et dépilements
+static void build_stack(Program *pp, unsigned scale)
+{
+    alloc_data(pp, WORK + MINSTACKSIZE);
+    pp->_data[0] = 6000000 * scale;
+    pp->_data[1] = 42;
+
+    emit_abs(pp, LOAD, 1, 0);
+    unsigned loop = pp->_textsize;
+    emit_abs(pp, PUSH, 0, 1);
+    emit_imm(pp, PUSH, 0, 5);
+    emit_idx(pp, PUSH, 0, 0, 1);
+    emit_abs(pp, POP, 0, 2);
+    emit_abs(pp, POP, 0, 3);
+    emit_idx(pp, POP, 0, 0, 4);
+    emit_imm(pp, SUB, 1, 1);
+    emit_abs(pp, BRANCH, GT, loop);
+    emit_op(pp, HALT);
+}
+
+//! Parcours d'un grand segment de données : lecture, modification, écriture
+static void build_memory(Program *pp, unsigned scale)
+{
+    const unsigned words = 1 << 20;
+    alloc_data(pp, WORK + words + MINSTACKSIZE);
+    pp->_data[0] = 8 * scale;
+    pp->_data[1] = words;
+
+    emit_abs(pp, LOAD, 2, 0);
+    unsigned sweep = pp->_textsize;
+    emit_imm(pp, LOAD, 1, 0);
+    emit_abs(pp, LOAD, 4, 1);
+    unsigned loop = pp->_textsize;
+    emit_idx(pp, LOAD, 0, 1, WORK);
+    emit_imm(pp, ADD, 0, 1);
+    emit_idx(pp, STORE, 0, 1, WORK);
+    emit_idx(pp, ADD, 3, 1, WORK);
+    emit_imm(pp, ADD, 1, 1);
+    emit_imm(pp, SUB, 4, 1);
+    emit_abs(pp, BRANCH, GT, loop);
+    emit_imm(pp, SUB, 2, 1);
+    emit_abs(pp, BRANCH, GT, sweep);
+    emit_op(pp, HALT);
+}
+
+//! Branchements conditionnels sur des données pseudo-aléatoires
+static void build_branch(Program *pp, unsigned scale)
+{
+    const unsigned words = 1 << 16;
+    alloc_data(pp, WORK + words + MINSTACKSIZE);
+    pp->_data[0] = 100 * scale;
+    pp->_data[1] = words;
+    uint32_t seed = 12345;
+    for (unsigned i = 0; i < words; ++i) {
+        seed = seed * 1103515245 + 12345;
+        pp->_data[WORK + i] = (seed >> 16) - 0x8000;
+    }
+
+    emit_abs(pp, LOAD, 2, 0);
+    unsigned sweep = pp->_textsize;
+    emit_imm(pp, LOAD, 1, 0);
+    emit_abs(pp, LOAD, 4, 1);
+    unsigned loop = pp->_textsize;
+    emit_idx(pp, LOAD, 0, 1, WORK);
+    emit_abs(pp, BRANCH, LT, loop + 4);
+    emit_imm(pp, ADD, 3, 1);
+    emit_abs(pp, BRANCH, NC, loop + 5);
+    emit_imm(pp, SUB, 3, 1);
+    emit_imm(pp, ADD, 1, 1);
+    emit_imm(pp, SUB, 4, 1);
+    emit_abs(pp, BRANCH, GT, loop);
+    emit_imm(pp, SUB, 2, 1);
+    emit_abs(pp, BRANCH, GT, sweep);
+    emit_op(pp, HALT);
+}
+
+//! Les programmes de mesure
+static const Workload workloads[] = {
+    { "alu", "tight ADD/SUB loop", build_alu },
+    { "call", "recursive CALL/RET with a stack argument", build_call },
+    { "stack", "PUSH/POP churn", build_stack },
+    { "memory", "LOAD/STORE sweeps over a 1M-word data segment", build_memory },
+    { "branch", "data-dependent conditional branches", build_branch },
+};
+
+//! Nombre de programmes de mesure
+#define NWORKLOADS (sizeof(workloads) / sizeof(workloads[0]))
+
+//! Heure courante (en secondes)
+static double now(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+//! Une exécution d'un programme
+/*!
+ * L'exécution est protégée (voir Error_Trap) : l'avertissement de \c HALT
+ * n'est pas affiché, et une erreur d'exécution est rendue au lieu de terminer
+ * le processus.
+ *
+ * \param pp le programme (son contenu initial des données est recopié par
+ * load_program())
+ * \param jit avec compilation à la volée ?
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ * \param pseconds durée de l'exécution (résultat)
+ * \return le code de l'erreur (ERR_NOERROR après \c HALT)
+ */
+static Error run(Program *pp, bool jit, Stats *pstats, double *pseconds)
+{
+    Machine mach;
+    if (!load_program(&mach, pp->_textsize, pp->_text, pp->_datasize, pp->_data, 0)) {
+        fprintf(stderr, "Cannot allocate data segment\n");
+        exit(EXIT_FAILURE);
+    }
+
+    double start = now();
+    Error err;
+    if (jit) {
+        Error_Trap trap = { ._silent = true };
+        error_trap(&trap);
+        if (setjmp(trap._env) != 0)
+            err = trap._err;
+        else {
+            exec_jit(&mach);
+            error_untrap(&trap);
+            err = ERR_NOERROR;
+        }
+    }
+    else
+        err = try_simul(&mach, TRACE_NONE, pstats);
+    *pseconds = now() - start;
+
+    unload_program(&mach);
+    return err;
+}
+
+//! Lecture du fichier de référence
+/*!
+ * Une ligne par programme : son nom et son débit (millions d'instructions
+ * par seconde).
+ *
+ * \param file le nom du fichier
+ * \param pn le nombre de résultats (résultat)
+ * \return les résultats (alloués), ou NULL si le fichier est illisible
+ */
+static Baseline *read_baseline(const char *file, unsigned *pn)
+{
+    FILE *in = fopen(file, "r");
+    if (in == NULL)
+        return NULL;
+
+    Baseline *base = calloc(NWORKLOADS, sizeof(Baseline));
+    unsigned n = 0;
+    char line[256];
+    while (n < NWORKLOADS && fgets(line, sizeof(line), in) != NULL)
+        if (line[0] != '#'
+            && sscanf(line, "%31s %lf", base[n]._name, &base[n]._mips) == 2)
+            ++n;
+    fclose(in);
+    *pn = n;
+    return base;
+}
+
+//! Programme de mesure
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-n <i>reps</i></dt><dd>nombre d'exécutions mesurées de chaque
+ *   programme, dont on garde la plus rapide (5 par défaut)</dd>
+ *
+ *   <dt>-s <i>facteur</i></dt><dd>multiplie la durée de chaque programme
+ *   (1 par défaut)</dd>
+ *
+ *   <dt>-j</dt><dd>mesure l'exécution avec compilation à la volée (voir
+ *   exec_jit()) au lieu de l'interpréteur</dd>
+ *
+ *   <dt>-b <i>fichier</i></dt><dd>comparaison avec les résultats de
+ *   référence du fichier</dd>
+ *
+ *   <dt>-w <i>fichier</i></dt><dd>enregistrement des résultats comme
+ *   référence dans le fichier</dd>
+ *
+ *   <dt>-l</dt><dd>liste des programmes</dd>
+ * </dl>
+ *
+ * Les arguments restants choisissent les programmes à exécuter (tous par
+ * défaut).
+ */
+int main(int argc, char *argv[])
+{
+    long reps = 5;
+    long scale = 1;
+    bool jit = false;
+    char *basefile = NULL;
+    char *savefile = NULL;
+    bool selected[NWORKLOADS] = { false };
+    bool any = false;
+
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] != '-') {
+            unsigned w;
+            for (w = 0; w < NWORKLOADS && strcmp(argv[iarg], workloads[w]._name) != 0; ++w)
+                ;
+            if (w == NWORKLOADS) {
+                fprintf(stderr, "Unknown workload: %s\n", argv[iarg]);
+                exit(EXIT_FAILURE);
+            }
+            selected[w] = any = true;
+            continue;
+        }
+        // Les options à valeur avancent iarg : l'option fautive est en opt
+        const int opt = iarg;
+        switch (argv[iarg][1])
+        {
+        case 'n':
+            if (iarg + 1 >= argc || (reps = strtol(argv[++iarg], NULL, 10)) <= 0)
+                goto bad_option;
+            break;
+        case 's':
+            if (iarg + 1 >= argc || (scale = strtol(argv[++iarg], NULL, 10)) <= 0
+                || scale > 1000)
+                goto bad_option;
+            break;
+        case 'j':
+            jit = true;
+            break;
+        case 'b':
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            basefile = argv[++iarg];
+            break;
+        case 'w':
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            savefile = argv[++iarg];
+            break;
+        case 'l':
+            for (unsigned w = 0; w < NWORKLOADS; ++w)
+                printf("%-8s %s\n", workloads[w]._name, workloads[w]._description);
+            exit(EXIT_SUCCESS);
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+        default:
+        bad_option:
+            fprintf(stderr, "Bad option: %s\n", argv[opt]);
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    unsigned nbase = 0;
+    Baseline *base = NULL;
+    if (basefile != NULL && (base = read_baseline(basefile, &nbase)) == NULL)
+        fprintf(stderr, "No baseline file %s: no comparison\n", basefile);
+
+    FILE *save = NULL;
+    if (savefile != NULL) {
+        if ((save = fopen(savefile, "w")) == NULL) {
+            perror(savefile);
+            exit(EXIT_FAILURE);
+        }
+        fprintf(save, "# simul_bench baseline: workload MIPS (%s, scale %ld)\n",
+                jit ? "jit" : "interpreter", scale);
+    }
+
+    printf("%-8s %14s %10s %10s %10s %10s %8s\n", "workload", "instructions",
+           "best (ms)", "ns/instr", "MIPS", "baseline", "change");
+    double total_instr = 0, total_seconds = 0;
+    for (unsigned w = 0; w < NWORKLOADS; ++w) {
+        if (any && !selected[w])
+            continue;
+
+        Program prog = { ._textsize = 0 };
+        workloads[w]._build(&prog, scale);
+
+        // Une première exécution, non mesurée, compte les instructions
+        Stats stats = { 0 };
+        double seconds, best = 0;
+        Error err = run(&prog, false, &stats, &seconds);
+        for (long r = 0; err == ERR_NOERROR && r < reps; ++r) {
+            err = run(&prog, jit, NULL, &seconds);
+            if (r == 0 || seconds < best)
+                best = seconds;
+        }
+        free(prog._data);
+        if (err != ERR_NOERROR) {
+            printf("%-8s FAULT: %s\n", workloads[w]._name, error_names[err]);
+            continue;
+        }
+
+        double mips = stats._instructions / best * 1e-6;
+        printf("%-8s %14llu %10.1f %10.3f %10.1f", workloads[w]._name,
+               (unsigned long long) stats._instructions, best * 1e3,
+               best * 1e9 / stats._instructions, mips);
+        total_instr += stats._instructions;
+        total_seconds += best;
+
+        unsigned b;
+        for (b = 0; b < nbase && strcmp(base[b]._name, workloads[w]._name) != 0; ++b)
+            ;
+        if (b < nbase)
+            printf(" %10.1f %+7.1f%%\n", base[b]._mips, (mips / base[b]._mips - 1) * 100);
+        else
+            printf(" %10s %8s\n", "-", "-");
+        fflush(stdout);
+
+        if (save != NULL)
+            fprintf(save, "%s %.1f\n", workloads[w]._name, mips);
+    }
+    if (total_seconds > 0)
+        printf("%-8s %14.0f %10.1f %10.3f %10.1f\n", "total", total_instr,
+               total_seconds * 1e3, total_seconds * 1e9 / total_instr,
+               total_instr / total_seconds * 1e-6);
+
+    if (save != NULL)
+        fclose(save);
+    free(base);
+    return 0;
+}
@@ -0,0 +1,185 @@
+/*!
+ * \file simul_tracedump.c
+ * \brief Restitution lisible d'une trace binaire d'exécution
+ *
+ * Le fichier est produit par <tt>test_simul -T fichier</tt> (voir
+ * tracebuf.h). Chaque enregistrement est affiché comme une ligne de la trace
+ * ordinaire ; on peut restreindre l'affichage à un intervalle d'adresses ou à
+ * certains codes opération.
+ */
+
+#define _DEFAULT_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <strings.h>
+#include <stdbool.h>
+
+#include "instruction.h"
+#include "tracebuf.h"
+
+//! Nombre d'enregistrements lus à la fois
+#define READ_BLOCK 4096
+
+//! Nombre de codes opération représentables (champ \c _cop de 6 bits)
+#define NCOPS (1 << 6)
+
+//! Help message.
+/*!
+ * Printed with option \c -h.
+ */
+static void usage()
+{
+    printf("Usage: simul_tracedump [options] tracefile\n");
+    printf("where options are:\n"
+           "\t-r lo:hi\tOnly show instructions whose address is in [lo, hi]\n"
+           "\t-o NAME\tOnly show instructions with this opcode (may be repeated)\n"
+           "\t-v\tAlso show the register and memory word written\n"
+           "\t-h\tprint this help message\n"
+           "Addresses may be given in decimal or in hexadecimal (0x...).\n");
+}
+
+//! Recherche d'un code opération par son nom
+/*!
+ * \param name le nom (en majuscules ou minuscules)
+ * \return le code opération, ou -1 s'il est inconnu
+ */
+static int find_cop(const char *name)
+{
+    for (int cop = 0; cop <= LAST_COP; ++cop)
+        if (strcasecmp(cop_names[cop], name) == 0)
+            return cop;
+    return -1;
+}
+
+//! Affichage d'un enregistrement
+/*!
+ * \param prec l'enregistrement
+ * \param verbose faut-il afficher les effets de l'instruction ?
+ */
+static void print_record(const Trace_Record *prec, bool verbose)
+{
+    Instruction instr = { ._raw = prec->_raw };
+
+    printf("TRACE: Executing: 0x%04x: ", prec->_pc);
+    print_instruction(instr, prec->_pc);
+    if (verbose) {
+        if (prec->_reg != TRACE_NOREG)
+            printf("\t\tR%02u = 0x%08x", prec->_reg, prec->_regvalue);
+        if (prec->_address != TRACE_NOADDR)
+            printf("\t\t[0x%04x] = 0x%08x", prec->_address, prec->_memvalue);
+    }
+    putchar('\n');
+}
+
+//! Programme de restitution de la trace binaire
+/*!
+ * Options de la ligne de commande :
+ *
+ * <dl>
+ *   <dt>-r <i>lo</i>:<i>hi</i></dt><dd>n'afficher que les instructions
+ *   dont l'adresse est dans l'intervalle [lo, hi]</dd>
+ *
+ *   <dt>-o <i>NOM</i></dt><dd>n'afficher que les instructions de ce code
+ *   opération (option répétable)</dd>
+ *
+ *   <dt>-v</dt><dd>afficher aussi le registre et le mot de donnée
+ *   modifiés</dd>
+ * </dl>
+ */
+int main(int argc, char *argv[])
+{
+    unsigned long lo = 0;
+    unsigned long hi = ~0UL;
+    bool copfilter = false;
+    bool cops[NCOPS] = { false };
+    bool verbose = false;
+    char *tracefile = NULL;
+
+    for (int iarg = 1; iarg < argc; ++iarg)
+    {
+        if (argv[iarg][0] != '-') {
+            tracefile = argv[iarg];
+            continue;
+        }
+        // Les options à valeur avancent iarg : l'option fautive est en opt
+        const int opt = iarg;
+        switch (argv[iarg][1])
+        {
+        case 'r': {
+            char *end;
+            if (iarg + 1 >= argc)
+                goto bad_option;
+            lo = strtoul(argv[++iarg], &end, 0);
+            if (*end != ':')
+                goto bad_option;
+            hi = strtoul(end + 1, &end, 0);
+            if (*end != '\0' || hi < lo)
+                goto bad_option;
+            break;
+        }
+        case 'o': {
+            int cop;
+            if (iarg + 1 >= argc || (cop = find_cop(argv[++iarg])) < 0)
+                goto bad_option;
+            cops[cop] = true;
+            copfilter = true;
+            break;
+        }
+        case 'v':
+            verbose = true;
+            break;
+        case 'h':
+            usage();
+            exit(EXIT_SUCCESS);
+        default:
+        bad_option:
+            fprintf(stderr, "Bad option: %s\n", argv[opt]);
+            usage();
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (tracefile == NULL) {
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    FILE *f = fopen(tracefile, "rb");
+    if (f == NULL) {
+        perror(tracefile);
+        exit(EXIT_FAILURE);
+    }
+
+    Trace_Header header;
+    if (fread(&header, sizeof(header), 1, f) != 1
+        || header._magic != TRACE_MAGIC || header._version != TRACE_VERSION
+        || header._recsize != sizeof(Trace_Record)) {
+        fprintf(stderr, "%s: not a binary trace file (or unsupported version)\n",
+                tracefile);
+        exit(EXIT_FAILURE);
+    }
+
+    static Trace_Record records[READ_BLOCK];
+    unsigned long long total = 0;
+    size_t n;
+    while ((n = fread(records, sizeof(Trace_Record), READ_BLOCK, f)) > 0) {
+        for (size_t i = 0; i < n; ++i) {
+            const Trace_Record *prec = &records[i];
+            Instruction instr = { ._raw = prec->_raw };
+            if (prec->_pc < lo || prec->_pc > hi)
+                continue;
+            if (copfilter && !cops[instr.instr_generic._cop])
+                continue;
+            print_record(prec, verbose);
+        }
+        total += n;
+    }
+    if (ferror(f)) {
+        perror(tracefile);
+        exit(EXIT_FAILURE);
+    }
+    fclose(f);
+
+    fprintf(stderr, "%llu records\n", total);
+    return 0;
+}
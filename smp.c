@@ -0,0 +1,120 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <assert.h>
+#include <pthread.h>
+#include "smp.h"
+#include "decode.h"
+
+//! Travail du processus léger d'un processeur
+typedef struct
+{
+	Machine *_pcpu;		//!< Le processeur
+	Stats _stats;		//!< Ses statistiques
+	Stats *_pstats;		//!< Statistiques à tenir (\c &_stats ou NULL)
+} Smp_Worker;
+
+//! Démarrage des processeurs d'une configuration multiprocesseur
+/*!
+ * \param pmach la machine chargée
+ * \param ncpus le nombre de processeurs
+ * \param cpus les processeurs à initialiser
+ * \return vrai en cas de succès
+ */
+bool smp_start(const Machine *pmach, unsigned ncpus, Machine cpus[ncpus]) {
+	assert(ncpus >= 1 && ncpus <= SMP_MAXCPUS);
+
+	// Tranches de pile : [_dataend, _sp] partagé en ncpus
+	Word top = pmach->_sp;
+	Word slice = top >= pmach->_dataend ? (top + 1 - pmach->_dataend) / ncpus : 0;
+	if (slice < MINSTACKSIZE) {
+		fprintf(stderr, "smp: stack too small for %u processors\n", ncpus);
+		return false;
+	}
+
+	size_t size = (pmach->_textsize + 1) * sizeof(Decoded);
+	for (unsigned i = 0; i < ncpus; ++i) {
+		Machine *pcpu = &cpus[i];
+		*pcpu = *pmach;
+		pcpu->_decoded = malloc(size);
+		if (pcpu->_decoded == NULL) {
+			perror("smp");
+			smp_release(i, cpus);
+			return false;
+		}
+		memcpy(pcpu->_decoded, pmach->_decoded, size);
+		pcpu->_dispatch = NULL;
+		pcpu->_tracebuf = NULL;
+		pcpu->_allocated = false;
+		pcpu->_map = NULL;
+		pcpu->_snapshot = NULL;
+		pcpu->_debugger = NULL;
+		pcpu->_fault = ERR_NOERROR;
+		pcpu->_registers[0] = i;
+		pcpu->_registers[1] = ncpus;
+		pcpu->_sp = top - i * slice;
+	}
+	return true;
+}
+
+//! Exécution d'un processeur
+/*!
+ * \param arg le travail (Smp_Worker)
+ */
+static void *run_cpu(void *arg) {
+	Smp_Worker *pw = arg;
+	try_simul(pw->_pcpu, TRACE_NONE, pw->_pstats);
+	return NULL;
+}
+
+//! Exécution parallèle des processeurs
+/*!
+ * \param ncpus le nombre de processeurs
+ * \param cpus les processeurs
+ * \param pstats statistiques à mettre à jour (NULL si aucune)
+ * \return l'erreur du premier processeur fautif, ou ERR_NOERROR
+ */
+Error smp_run(unsigned ncpus, Machine cpus[ncpus], Stats *pstats) {
+	assert(pstats == NULL || pstats->_profile == NULL);
+	Smp_Worker workers[SMP_MAXCPUS];
+	pthread_t threads[SMP_MAXCPUS];
+	unsigned nthreads;
+
+	for (unsigned i = 0; i < ncpus; ++i) {
+		Smp_Worker *pw = &workers[i];
+		*pw = (Smp_Worker) { &cpus[i], { 0 }, pstats != NULL ? &pw->_stats : NULL };
+	}
+	for (nthreads = 0; nthreads < ncpus; ++nthreads)
+		if (pthread_create(&threads[nthreads], NULL, run_cpu, &workers[nthreads]) != 0) {
+			perror("smp");
+			break;
+		}
+	// Faute de processus léger, les processeurs restants s'exécutent ici
+	for (unsigned i = nthreads; i < ncpus; ++i)
+		run_cpu(&workers[i]);
+
+	Error err = ERR_NOERROR;
+	for (unsigned i = 0; i < ncpus; ++i) {
+		if (i < nthreads)
+			pthread_join(threads[i], NULL);
+		if (err == ERR_NOERROR)
+			err = cpus[i]._fault;
+		if (pstats != NULL) {
+			pstats->_instructions += workers[i]._stats._instructions;
+			pstats->_jumps += workers[i]._stats._jumps;
+		}
+	}
+	return err;
+}
+
+//! Libération des processeurs
+/*!
+ * \param ncpus le nombre de processeurs
+ * \param cpus les processeurs
+ */
+void smp_release(unsigned ncpus, Machine cpus[ncpus]) {
+	for (unsigned i = 0; i < ncpus; ++i) {
+		free(cpus[i]._decoded);
+		cpus[i]._decoded = NULL;
+	}
+}
@@ -0,0 +1,77 @@
+#ifndef _SMP_H_
+#define _SMP_H_
+
+/*!
+ * \file smp.h
+ * \brief Machine multiprocesseur à mémoire partagée.
+ *
+ * Une configuration multiprocesseur comporte plusieurs processeurs, décrits
+ * chacun par une Machine : chacun a son compteur ordinal, son code condition
+ * et ses registres, et tous partagent les segments de texte et de données
+ * d'une même machine chargée. Chaque processeur est simulé par son propre
+ * processus léger, avec la boucle d'exécution ordinaire (voir try_simul()) :
+ * les processeurs de l'hôte exécutent réellement le programme en parallèle.
+ *
+ * Au démarrage, chaque processeur reçoit les registres de la machine chargée,
+ * sauf \c R00, qui contient son numéro (de 0 à \c n - 1), et \c R01, qui
+ * contient le nombre \c n de processeurs : le programme s'en sert pour se
+ * partager le travail. La zone de pile (de \c _dataend au sommet de pile de
+ * la machine) est découpée en \c n tranches égales, une par processeur ;
+ * seul le processeur 0 démarre avec le sommet de pile de la machine. Le
+ * débordement d'une pile dans sa voisine n'est pas détecté.
+ *
+ * Les accès ordinaires aux données ne sont pas ordonnés entre processeurs :
+ * la synchronisation passe par les instructions atomiques \c CAS et \c XADD
+ * et par la barrière \c FENCE (voir cop_is_atomic()), qui sont exécutées par
+ * les opérations de \c stdatomic.h sur le segment partagé, dans l'ordre
+ * séquentiellement cohérent.
+ *
+ * Un processeur s'arrête sur \c HALT ou sur une erreur, qui est rangée dans
+ * ses champs \c _fault et \c _faultaddr sans arrêter les autres. Les
+ * processeurs ne sont ni tracés, ni mis au point, ni profilés.
+ */
+
+#include "machine.h"
+
+//! Nombre maximal de processeurs
+#define SMP_MAXCPUS 64
+
+//! Démarrage des processeurs d'une configuration multiprocesseur
+/*!
+ * Chaque processeur partage le texte, les blocs de base et les données de la
+ * machine ; seul le texte pré-décodé, où la boucle d'exécution inscrit les
+ * adresses de ses traitements, est recopié. La machine doit rester chargée
+ * tant que les processeurs existent.
+ *
+ * \param pmach la machine chargée
+ * \param ncpus le nombre de processeurs (de 1 à \c SMP_MAXCPUS)
+ * \param cpus les processeurs à initialiser
+ * \return vrai en cas de succès, faux (avec un message) si la pile ne peut
+ * être partagée ou en cas d'échec d'allocation
+ */
+bool smp_start(const Machine *pmach, unsigned ncpus, Machine cpus[ncpus]);
+
+//! Exécution parallèle des processeurs
+/*!
+ * Un processus léger par processeur ; la fonction rend la main lorsque tous
+ * se sont arrêtés.
+ *
+ * \param ncpus le nombre de processeurs
+ * \param cpus les processeurs (initialisés par smp_start())
+ * \param pstats statistiques à mettre à jour, cumulées sur tous les
+ * processeurs (NULL si aucune ; sans profil)
+ * \return l'erreur du premier processeur fautif, ou ERR_NOERROR si tous se
+ * sont arrêtés sur \c HALT
+ */
+Error smp_run(unsigned ncpus, Machine cpus[ncpus], Stats *pstats);
+
+//! Libération des processeurs
+/*!
+ * La machine dont ils partagent les segments n'est pas modifiée.
+ *
+ * \param ncpus le nombre de processeurs
+ * \param cpus les processeurs
+ */
+void smp_release(unsigned ncpus, Machine cpus[ncpus]);
+
+#endif
@@ -0,0 +1,205 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include "snapshot.h"
+#include "decode.h"
+#include "guard.h"
+
+//! Instantané d'une machine
+/*!
+ * \c _state contient l'état de la machine au moment de la prise, avec des
+ * copies du texte, du texte pré-décodé et des blocs de base appartenant à
+ * l'instantané ; son champ \c _data est inutilisé, les données étant dans le
+ * fichier \c _fd.
+ *
+ * Le compteur de références compte l'instantané lui-même (jusqu'à
+ * snapshot_release()) et chacune de ses copies.
+ */
+struct Snapshot
+{
+	Machine _state;		//!< État de la machine
+	int _fd;		//!< Fichier anonyme contenant le segment de données
+	size_t _mapsize;	//!< Taille projetée du segment de données (en octets)
+	atomic_uint _refs;	//!< Nombre de références
+};
+
+//! Création d'un fichier anonyme en mémoire
+/*!
+ * \return le descripteur, ou -1
+ */
+static int anonymous_file(void) {
+#ifdef __linux__
+	return memfd_create("simul-snapshot", MFD_CLOEXEC);
+#else
+	FILE *file = tmpfile();
+	if (file == NULL)
+		return -1;
+	int fd = dup(fileno(file));
+	fclose(file);
+	return fd;
+#endif
+}
+
+//! Duplication d'une zone de mémoire
+/*!
+ * \param p la zone
+ * \param size sa taille
+ * \return la copie, ou NULL
+ */
+static void *duplicate(const void *p, size_t size) {
+	void *copy = malloc(size == 0 ? 1 : size);
+	if (copy != NULL)
+		memcpy(copy, p, size);
+	return copy;
+}
+
+//! Prise d'un instantané
+/*!
+ * \param pmach la machine
+ * \return l'instantané, ou NULL en cas d'échec
+ */
+Snapshot *snapshot_take(const Machine *pmach) {
+	Snapshot *ps = malloc(sizeof(Snapshot));
+	if (ps == NULL) {
+		perror("snapshot");
+		return NULL;
+	}
+
+	ps->_state = *pmach;
+	ps->_state._text = duplicate(pmach->_text, pmach->_textsize * sizeof(Instruction));
+	ps->_state._decoded = duplicate(pmach->_decoded, (pmach->_textsize + 1) * sizeof(Decoded));
+	ps->_state._blocks = duplicate(pmach->_blocks, pmach->_nblocks * sizeof(Block));
+	ps->_state._data = NULL;
+	ps->_state._tracebuf = NULL;
+	ps->_state._allocated = false;
+	ps->_state._map = NULL;
+	ps->_state._snapshot = ps;
+	ps->_state._symbols = NULL;
+	ps->_state._nsymbols = 0;
+	ps->_state._debugger = NULL;
+	ps->_mapsize = guard_mapsize(pmach->_datasize);
+	atomic_init(&ps->_refs, 1);
+
+	ps->_fd = anonymous_file();
+	bool ok = ps->_state._text != NULL && ps->_state._decoded != NULL
+	    && ps->_state._blocks != NULL && ps->_fd >= 0
+	    && ftruncate(ps->_fd, ps->_mapsize) == 0;
+
+	// Écriture du segment de données dans le fichier, à la position qu'il
+	// occupe dans sa projection (voir guard_offset())
+	const char *p = (const char *) pmach->_data;
+	size_t left = (size_t) pmach->_datasize * sizeof(Word);
+	off_t start = guard_offset(pmach->_datasize);
+	for (off_t off = 0; ok && left > 0; ) {
+		ssize_t n = pwrite(ps->_fd, p + off, left, start + off);
+		if (n <= 0)
+			ok = false;
+		else {
+			off += n;
+			left -= n;
+		}
+	}
+
+	if (!ok) {
+		perror("snapshot");
+		snapshot_release(ps);
+		return NULL;
+	}
+	return ps;
+}
+
+//! Projection privée du segment de données d'un instantané
+/*!
+ * \param ps l'instantané
+ * \param at adresse de la projection à remplacer (ou NULL)
+ * \param pguarded la nouvelle projection a-t-elle sa zone de garde ? (résultat)
+ * \return l'adresse de la projection, ou NULL en cas d'échec
+ */
+static Word *map_data(Snapshot *ps, Word *at, bool *pguarded) {
+	return guard_map(ps->_state._datasize, ps->_fd, 0, at, pguarded);
+}
+
+//! Lancement d'une copie de l'état d'un instantané
+/*!
+ * Le texte pré-décodé est recopié pour chaque copie : la boucle d'exécution y
+ * inscrit les adresses de ses traitements (voir exec_loop.h), qui diffèrent
+ * d'une variante à l'autre.
+ *
+ * \param ps l'instantané
+ * \param pchild la machine à initialiser
+ * \return vrai en cas de succès
+ */
+bool snapshot_fork(Snapshot *ps, Machine *pchild) {
+	*pchild = ps->_state;
+	pchild->_decoded = duplicate(ps->_state._decoded,
+				     (ps->_state._textsize + 1) * sizeof(Decoded));
+	if (pchild->_decoded == NULL) {
+		perror("snapshot");
+		return false;
+	}
+	if ((pchild->_data = map_data(ps, NULL, &pchild->_guarded)) == NULL) {
+		free(pchild->_decoded);
+		return false;
+	}
+	atomic_fetch_add(&ps->_refs, 1);
+	return true;
+}
+
+//! Retour d'une machine à l'état d'un instantané
+/*!
+ * \param ps l'instantané
+ * \param pmach la machine
+ * \return vrai en cas de succès
+ */
+bool snapshot_restore(Snapshot *ps, Machine *pmach) {
+	if (pmach->_snapshot != ps) {
+		unload_program(pmach);
+		return snapshot_fork(ps, pmach);
+	}
+
+	// Même instantané : on garde le texte pré-décodé, ainsi que ce que
+	// l'appelant a attaché à la machine, et on reprojette les données
+	// par-dessus l'ancienne projection
+	Machine kept = *pmach;
+
+	*pmach = ps->_state;
+	pmach->_decoded = kept._decoded;
+	pmach->_dispatch = kept._dispatch;
+	pmach->_data = kept._data;
+	pmach->_guarded = kept._guarded;
+	pmach->_tracebuf = kept._tracebuf;
+	pmach->_symbols = kept._symbols;
+	pmach->_nsymbols = kept._nsymbols;
+	pmach->_debugger = kept._debugger;
+	return map_data(ps, kept._data, NULL) != NULL;
+}
+
+//! Abandon d'un instantané
+/*!
+ * \param ps l'instantané
+ */
+void snapshot_release(Snapshot *ps) {
+	if (atomic_fetch_sub(&ps->_refs, 1) != 1)
+		return;
+	if (ps->_fd >= 0)
+		close(ps->_fd);
+	free(ps->_state._text);
+	free(ps->_state._decoded);
+	free(ps->_state._blocks);
+	free(ps);
+}
+
+//! Détachement d'une copie de son instantané
+/*!
+ * \param pmach la copie
+ */
+void snapshot_detach(Machine *pmach) {
+	Snapshot *ps = pmach->_snapshot;
+	guard_free(pmach->_data, pmach->_datasize, pmach->_guarded);
+	pmach->_snapshot = NULL;
+	snapshot_release(ps);
+}
@@ -0,0 +1,80 @@
+#ifndef _SNAPSHOT_H_
+#define _SNAPSHOT_H_
+
+/*!
+ * \file snapshot.h
+ * \brief Instantanés de la machine et exécutions divergentes.
+ *
+ * Un instantané fige l'état complet d'une machine (registres, compteur
+ * ordinal, code condition, segments de texte et de données). On peut ensuite
+ * en relancer autant de copies (<em>fork</em>) que l'on veut, chacune avec ses
+ * propres modifications des registres ou des données, sans réexécuter le
+ * préfixe commun.
+ *
+ * Le texte et les blocs de base sont partagés entre l'instantané et ses
+ * copies ; seul le texte pré-décodé, petit, est recopié. Le segment de
+ * données de l'instantané est rangé dans un fichier anonyme en mémoire ;
+ * chaque copie le projette en privé (\c mmap avec \c MAP_PRIVATE) : le
+ * système ne duplique, page par page, que ce que la copie modifie. Une copie ne coûte donc que les pages qu'elle
+ * écrit, quelle que soit la taille du segment de données.
+ */
+
+#include "machine.h"
+
+//! Instantané d'une machine (structure opaque, voir snapshot.c)
+typedef struct Snapshot Snapshot;
+
+//! Prise d'un instantané
+/*!
+ * Le segment de données est recopié une fois dans l'instantané ; la machine
+ * n'est pas modifiée et peut continuer son exécution.
+ *
+ * \param pmach la machine
+ * \return l'instantané, ou NULL (avec un message) en cas d'échec
+ */
+Snapshot *snapshot_take(const Machine *pmach);
+
+//! Lancement d'une copie de l'état d'un instantané
+/*!
+ * La machine \c pchild (non initialisée) reçoit l'état de l'instantané. Elle
+ * partage le texte de l'instantané et projette ses données en copie sur
+ * écriture. Elle se libère avec unload_program().
+ *
+ * \param ps l'instantané
+ * \param pchild la machine à initialiser
+ * \return vrai en cas de succès, faux (avec un message) sinon
+ */
+bool snapshot_fork(Snapshot *ps, Machine *pchild);
+
+//! Retour d'une machine à l'état d'un instantané
+/*!
+ * Le programme actuellement chargé dans la machine est d'abord libéré (voir
+ * unload_program()). Si la machine est déjà une copie de cet instantané, seul
+ * son segment de données est reprojeté : les pages qu'elle a modifiées sont
+ * abandonnées, mais la trace binaire, la table des symboles et l'état de mise
+ * au point attachés à la machine sont conservés.
+ *
+ * \param ps l'instantané
+ * \param pmach la machine
+ * \return vrai en cas de succès, faux (avec un message) sinon
+ */
+bool snapshot_restore(Snapshot *ps, Machine *pmach);
+
+//! Abandon d'un instantané
+/*!
+ * L'instantané est libéré lorsque sa dernière copie est elle-même libérée.
+ *
+ * \param ps l'instantané
+ */
+void snapshot_release(Snapshot *ps);
+
+//! Détachement d'une copie de son instantané
+/*!
+ * Réservée à unload_program() : le segment de données de la copie est
+ * libéré et la référence à l'instantané abandonnée.
+ *
+ * \param pmach la copie
+ */
+void snapshot_detach(Machine *pmach);
+
+#endif
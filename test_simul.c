@@ -5,9 +5,19 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <limits.h>
+#include <string.h>
+#include <setjmp.h>
 
 #include "machine.h"
+#include "decode.h"
 #include "debug.h"
+#include "jit.h"
+#include "tracebuf.h"
+#include "profile.h"
+#include "cache.h"
+#include "timing.h"
+#include "smp.h"
 
 //! Segment de texte
 extern Instruction text[];
@@ -35,11 +45,84 @@ static void usage()
            "\t-d\tDebug mode (interactive execution)\n"
            "\t-b\tA binary file is provided\n"
            "\t-l\tDo not execute; just display the listing\n"
+           "\t-m\tMap the binary file instead of reading it (validated at load)\n"
+           "\t-j\tCompile hot code to native code (no trace)\n"
+           "\t-c n\tRun n processors sharing the data segment (at most %u;\n"
+           "\t\tno trace; excludes -d, -j, -T, -P, -C and -K)\n"
+           "\t-t<n>\tTrace level: 0 none, 1 jumps only, 2 every instruction (default)\n"
+           "\t-T file\tWrite a binary trace of every instruction into file\n"
+           "\t\t(see simul_tracedump)\n"
+           "\t-s\tPrint execution statistics\n"
+           "\t-P file\tWrite an execution profile into file (\"-\": standard output)\n"
+           "\t-C spec\tSimulate a data cache hierarchy and print its report; spec is\n"
+           "\t\t\"default\" or size:line:ways[:lru|plru][:wb|wt][:latency],...[,memlatency]\n"
+           "\t-K spec\tEstimate cycles on an in-order pipeline and print the report;\n"
+           "\t\tspec is \"default\" or static|bimodal|gshare[:bits[:ras[:mispredict\n"
+           "\t\t[:load-use[:mul[:div]]]]]] (with -C, memory stalls are included)\n"
+           "\t-q\tQuiet: no trace, no initial state nor dump; only the final state\n"
+           "\t-p lo:hi\tOnly list the instructions whose address is in [lo, hi]\n"
+           "\t-r lo:hi\tOnly display the data words whose address is in [lo, hi]\n"
+           "\t-z\tOnly display the non-zero data words\n"
+           "\t-V\tDo not run the program if it has reachable invalid instructions\n"
+           "\t\t(they are always reported at load)\n"
            "\t-h\tprint this help message\n"
            "If -b is given, the next argument must be a file name containing\n"
            "a valid program in binary format. Otherwise an internally defined\n"
            "example program is used; the program is also dumped in binary into\n"
-           "the file dump.bin\n");
+           "the file dump.bin\n", SMP_MAXCPUS);
+}
+
+//! Lecture d'un intervalle d'adresses <i>lo</i>:<i>hi</i>
+/*!
+ * \param arg le texte de l'intervalle
+ * \param plo la première adresse (résultat)
+ * \param phi la dernière adresse (résultat)
+ * \return vrai si l'intervalle est correct
+ */
+static bool parse_range(const char *arg, unsigned *plo, unsigned *phi)
+{
+    char *end;
+    unsigned long lo = strtoul(arg, &end, 0);
+    if (*end != ':')
+        return false;
+    unsigned long hi = strtoul(end + 1, &end, 0);
+    if (*end != '\0' || hi < lo || hi > UINT_MAX)
+        return false;
+    *plo = lo;
+    *phi = hi;
+    return true;
+}
+
+//! Écriture du profil d'exécution et des rapports des modèles de cache et de temps
+/*!
+ * \param pmach la machine
+ * \param pprof le profil (libéré, avec ses modèles)
+ * \param profilefile le fichier ("-" pour la sortie standard ; NULL si
+ * seuls les rapports des modèles sont demandés)
+ */
+static void write_profile(Machine *pmach, Profile *pprof, const char *profilefile)
+{
+    if (profilefile != NULL) {
+        bool to_stdout = strcmp(profilefile, "-") == 0;
+        FILE *out = to_stdout ? stdout : fopen(profilefile, "w");
+        if (out == NULL)
+            perror(profilefile);
+        else {
+            profile_print(out, pmach, pprof);
+            if (!to_stdout)
+                fclose(out);
+        }
+    }
+    if (pprof->_cache != NULL) {
+        cache_print(stdout, pmach, pprof->_cache);
+        cache_free(pprof->_cache);
+    }
+    if (pprof->_timing != NULL) {
+        timing_end(pprof->_timing);
+        timing_print(stdout, pmach, pprof->_timing);
+        timing_free(pprof->_timing);
+    }
+    profile_free(pprof);
 }
 
 //! Programme de test
@@ -49,6 +132,57 @@ static void usage()
  * <dl>
  *   <dt>-d</dt><dd>mode pas à pas (mise au point)</dd>
  *
+ *   <dt>-m</dt><dd>le fichier binaire est projeté en mémoire par
+ *   map_program() au lieu d'être lu par read_program()</dd>
+ *
+ *   <dt>-j</dt><dd>compilation à la volée du code fréquemment exécuté (sans
+ *   trace ; ignoré avec \c -d, \c -T et \c -P)</dd>
+ *
+ *   <dt>-c <i>n</i></dt><dd>exécution par \c n processeurs qui partagent le
+ *   segment de données (voir smp.h), sans trace ; incompatible avec \c -d,
+ *   \c -j, \c -T, \c -P, \c -C et \c -K</dd>
+ *
+ *   <dt>-t<i>n</i></dt><dd>niveau de trace : 0 aucune, 1 ruptures de séquence
+ *   seulement, 2 chaque instruction (par défaut)</dd>
+ *
+ *   <dt>-T <i>fichier</i></dt><dd>trace binaire de chaque instruction dans
+ *   le fichier indiqué, à relire avec \c simul_tracedump (remplace l'option
+ *   \c -t)</dd>
+ *
+ *   <dt>-s</dt><dd>affichage des statistiques d'exécution</dd>
+ *
+ *   <dt>-P <i>fichier</i></dt><dd>profil de l'exécution (voir profile.h),
+ *   écrit dans le fichier indiqué (\c - pour la sortie standard) à la fin
+ *   de l'exécution, même en cas d'erreur</dd>
+ *
+ *   <dt>-C <i>description</i></dt><dd>simulation d'une hiérarchie de caches
+ *   de données (voir cache.h et cache_parse() pour la description, ou \c
+ *   default) ; son rapport est affiché à la fin de l'exécution, même en cas
+ *   d'erreur. L'exécution est profilée, donc sans compilation à la
+ *   volée</dd>
+ *
+ *   <dt>-K <i>description</i></dt><dd>estimation du nombre de cycles sur un
+ *   pipeline dans l'ordre (voir timing.h et timing_parse() pour la
+ *   description, ou \c default) ; le rapport (CPI, mauvaises prédictions
+ *   par branchement, cycles par fonction) est affiché à la fin de
+ *   l'exécution, même en cas d'erreur. Avec \c -C, les attentes de la
+ *   mémoire sont comptées. L'exécution est profilée</dd>
+ *
+ *   <dt>-q</dt><dd>mode silencieux : ni trace, ni affichage de l'état initial,
+ *   ni sauvegarde binaire ; seul l'état final est affiché</dd>
+ *
+ *   <dt>-p <i>lo</i>:<i>hi</i></dt><dd>n'afficher que les instructions dont
+ *   l'adresse est dans l'intervalle [lo, hi]</dd>
+ *
+ *   <dt>-r <i>lo</i>:<i>hi</i></dt><dd>n'afficher que les mots de données
+ *   dont l'adresse est dans l'intervalle [lo, hi]</dd>
+ *
+ *   <dt>-z</dt><dd>n'afficher que les mots de données non nuls</dd>
+ *
+ *   <dt>-V</dt><dd>vérification stricte du programme au chargement : les
+ *   instructions erronées accessibles, toujours signalées au chargement (voir
+ *   verify_program()), empêchent l'exécution du programme</dd>
+ *
  *   <dt>-f</dt><dd>le programme est dans un fichier binaire ; le nom de ce
  *   fichier doit être fourni également en paramètre de la ligne de
  *   commande ; sans cette option, on exécute un programme de test prédéfini.</dd>
@@ -59,8 +193,27 @@ int main(int argc, char *argv[])
 {
     bool debug = false;
     bool binfile = false;
+    bool mapfile = false;
     bool no_exec = false;
+    bool jit = false;
+    bool quiet = false;
+    int trace = -1;
+    Stats stats = { 0 };
+    Stats *pstats = NULL;
     char *programfile = NULL;
+    char *tracefile = NULL;
+    char *profilefile = NULL;
+    bool use_cache = false;
+    Cache_Config cache_config;
+    bool use_timing = false;
+    Timing_Config timing_config;
+    bool show_stats = false;
+    unsigned textlo = 0, texthi = UINT_MAX;
+    unsigned datalo = 0, datahi = UINT_MAX;
+    bool nonzero = false;
+    bool verify = false;
+    unsigned ncpus = 0;
+    Machine cpus[SMP_MAXCPUS];
 
     if (argc > 1) 
     {
@@ -78,6 +231,105 @@ int main(int argc, char *argv[])
                  case 'l': 
                     no_exec = true;
                     break;
+                 case 'm': 
+                    mapfile = true;
+                    break;
+                 case 'j': 
+                    jit = true;
+                    break;
+                 case 'c': {
+                    char *end;
+                    unsigned long n = iarg + 1 < argc ? strtoul(argv[iarg + 1], &end, 0) : 0;
+                    if (n == 0 || n > SMP_MAXCPUS || *end != '\0') {
+                        fprintf(stderr, "Bad number of processors: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ncpus = n;
+                    ++iarg;
+                    break;
+                 }
+                 case 't': 
+                    if (argv[iarg][2] >= '0' && argv[iarg][2] <= '0' + TRACE_ALL 
+                        && argv[iarg][3] == '\0')
+                        trace = argv[iarg][2] - '0';
+                    else if (argv[iarg][2] == '\0')
+                        trace = TRACE_ALL;
+                    else {
+                        fprintf(stderr, "Bad trace level: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    break;
+                 case 'T': 
+                    if (iarg + 1 >= argc) {
+                        fprintf(stderr, "Missing trace file name: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    tracefile = argv[++iarg];
+                    break;
+                 case 's': 
+                    pstats = &stats;
+                    show_stats = true;
+                    break;
+                 case 'P': 
+                    if (iarg + 1 >= argc) {
+                        fprintf(stderr, "Missing profile file name: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    profilefile = argv[++iarg];
+                    pstats = &stats;
+                    break;
+                 case 'C': 
+                    if (iarg + 1 >= argc) {
+                        fprintf(stderr, "Missing cache description: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    if (!cache_parse(argv[iarg + 1], &cache_config)) {
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    use_cache = true;
+                    pstats = &stats;
+                    ++iarg;
+                    break;
+                 case 'K': 
+                    if (iarg + 1 >= argc) {
+                        fprintf(stderr, "Missing pipeline description: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    if (!timing_parse(argv[iarg + 1], &timing_config)) {
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    use_timing = true;
+                    pstats = &stats;
+                    ++iarg;
+                    break;
+                 case 'q': 
+                    quiet = true;
+                    break;
+                 case 'p': 
+                 case 'r': 
+                    if (iarg + 1 >= argc
+                        || !(argv[iarg][1] == 'p' ? parse_range(argv[iarg + 1], &textlo, &texthi)
+                             : parse_range(argv[iarg + 1], &datalo, &datahi))) {
+                        fprintf(stderr, "Bad address range: %s\n", argv[iarg]);
+                        usage();
+                        exit(EXIT_FAILURE);
+                    }
+                    ++iarg;
+                    break;
+                 case 'z': 
+                    nonzero = true;
+                    break;
+                 case 'V': 
+                    verify = true;
+                    break;
                   case 'h':
                     usage();
                     exit(EXIT_SUCCESS);
@@ -93,30 +345,122 @@ int main(int argc, char *argv[])
         }
     }
 
+    if (ncpus > 0
+        && (debug || jit || tracefile != NULL || profilefile != NULL || use_cache || use_timing)) {
+        fprintf(stderr, "Option -c excludes -d, -j, -T, -P, -C and -K\n");
+        usage();
+        exit(EXIT_FAILURE);
+    }
+
+    if (ncpus > 0)
+        trace = TRACE_NONE;
+    else if (tracefile != NULL)
+        trace = TRACE_BINARY;
+    else if (trace < 0)
+        trace = quiet ? TRACE_NONE : TRACE_ALL;
+
     Machine mach;
 
-    if (!binfile) 
-        load_program(&mach, textsize, text, datasize, data, dataend);
+    if (!binfile) {
+        if (!load_program(&mach, textsize, text, datasize, data, dataend)) {
+            fprintf(stderr, "Cannot allocate data segment\n");
+            exit(1);
+        }
+    }
+    else if (mapfile)
+        map_program(&mach, programfile);
     else 
         read_program(&mach, programfile);   
 
-    printf("\n*** Sauvegarde des programmes et données initiales en format binaire ***\n\n");
-    dump_memory(&mach);
+    // Les instructions erronées accessibles sont signalées une fois, au
+    // chargement ; avec -V, le programme n'est alors pas exécuté
+    unsigned nfaults = verify_program(&mach, stderr);
+    if (nfaults > 0 && verify) {
+        fprintf(stderr, "%u invalid instruction(s) reachable: program not run\n", nfaults);
+        exit(EXIT_FAILURE);
+    }
+    else if (nfaults > 0)
+        fprintf(stderr, "%u invalid instruction(s) reachable: the program faults if it "
+                "reaches one\n", nfaults);
+
+    if (tracefile != NULL && !no_exec
+        && (mach._tracebuf = tracebuf_open(tracefile)) == NULL)
+        exit(EXIT_FAILURE);
 
-    printf("\n*** Machine state before execution ***\n");
-    print_program(&mach);
-    print_data(&mach);
-    print_cpu(&mach);
+    if (!quiet || no_exec) {
+        printf("\n*** Sauvegarde des programmes et données initiales en format binaire ***\n\n");
+        dump_memory(&mach);
+
+        printf("\n*** Machine state before execution ***\n");
+        print_program_range(&mach, textlo, texthi);
+        print_data_range(&mach, datalo, datahi, nonzero);
+        print_cpu(&mach);
+    }
 
     if (no_exec) 
         return 0;
 
-    printf("\n*** Execution trace ***\n\n");
-    simul(&mach, debug);
+    if (trace != TRACE_NONE && trace != TRACE_BINARY)
+        printf("\n*** Execution trace ***\n\n");
+    // Le profil et les rapports des modèles sont écrits même si
+    // l'exécution s'arrête sur une erreur
+    Error_Trap trap = { ._silent = false };
+    bool profile = profilefile != NULL || use_cache || use_timing;
+    if (profile) {
+        if ((stats._profile = profile_new(&mach)) == NULL)
+            exit(EXIT_FAILURE);
+        if (use_cache
+            && (stats._profile->_cache = cache_new(&cache_config, &mach)) == NULL)
+            exit(EXIT_FAILURE);
+        if (use_timing
+            && (stats._profile->_timing = timing_new(&timing_config, &mach)) == NULL)
+            exit(EXIT_FAILURE);
+        error_trap(&trap);
+        if (setjmp(trap._env) != 0) {
+            write_profile(&mach, stats._profile, profilefile);
+            error(trap._err, trap._addr);
+        }
+    }
+
+    bool use_jit = jit && !debug && trace != TRACE_BINARY && !profile;
+    bool halted = true;
+    if (ncpus > 0) {
+        if (!smp_start(&mach, ncpus, cpus))
+            exit(EXIT_FAILURE);
+        halted = smp_run(ncpus, cpus, pstats) == ERR_NOERROR;
+        for (unsigned i = 0; i < ncpus; ++i)
+            if (cpus[i]._fault != ERR_NOERROR)
+                fprintf(stderr, "ERROR: %s at address 0x%x (processor %u)\n",
+                        error_names[cpus[i]._fault], cpus[i]._faultaddr, i);
+    }
+    else if (use_jit)
+        exec_jit(&mach);
+    else
+        simul_mode(&mach, trace, debug, pstats);
+
+    if (profile) {
+        error_untrap(&trap);
+        write_profile(&mach, stats._profile, profilefile);
+    }
+
+    if (mach._tracebuf != NULL)
+        printf("\n*** Binary trace: %llu records written to %s ***\n",
+               (unsigned long long) tracebuf_close(mach._tracebuf), tracefile);
+
+    if (show_stats && !use_jit)
+        printf("\n*** Statistics ***\n\n%llu instructions, %llu jumps\n",
+               (unsigned long long) stats._instructions,
+               (unsigned long long) stats._jumps);
 
     printf("\n*** Machine state after execution ***\n");
-    print_cpu(&mach);
-    print_data(&mach);
+    if (ncpus == 0)
+        print_cpu(&mach);
+    for (unsigned i = 0; i < ncpus; ++i) {
+        printf("\n*** Processor %u ***\n", i);
+        print_cpu(&cpus[i]);
+    }
+    smp_release(ncpus, cpus);
+    print_data_range(&mach, datalo, datahi, nonzero);
 
-    return 0; 
+    return halted ? 0 : EXIT_FAILURE; 
 }
@@ -0,0 +1,574 @@
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include "timing.h"
+#include "decode.h"
+#include "image.h"
+#include "format.h"
+
+//! Nombre maximal de bits d'index du prédicteur
+#define TIMING_MAXBITS 20
+
+//! Profondeur maximale de la pile d'adresses de retour
+#define TIMING_MAXRAS 1024
+
+//! Nature d'une instruction pour le modèle
+enum
+{
+	CLASS_PLAIN = 0,	//!< En séquence
+	CLASS_DIRECT,		//!< BRANCH ou CALL absolu
+	CLASS_INDEXED,		//!< BRANCH ou CALL indexé
+	CLASS_RET,		//!< RET
+};
+
+//! Latence d'exécution d'une instruction
+enum
+{
+	LATENCY_NONE = 0,	//!< Un cycle
+	LATENCY_MUL,		//!< Latence de MUL
+	LATENCY_DIV,		//!< Latence de DIV et MOD
+	LATENCY_BLOCK,		//!< Un cycle par mot de la plage
+};
+
+//! Instruction pré-décodée pour le modèle
+typedef struct
+{
+	uint16_t _reads;	//!< Registres lus (masque)
+	uint16_t _late;		//!< Registres chargés depuis la mémoire (masque)
+	uint8_t _class;		//!< Nature (CLASS_...)
+	uint8_t _latency;	//!< Latence (LATENCY_...)
+	uint8_t _cond;		//!< Condition (BRANCH et CALL)
+	bool _call;		//!< CALL ?
+	uint8_t _countreg;	//!< Registre du nombre de mots (plages de données)
+	unsigned _target;	//!< Cible (BRANCH et CALL absolus)
+} Timing_Op;
+
+//! Modèle du pipeline
+struct Timing
+{
+	Timing_Config _config;		//!< Description
+	unsigned _textsize;		//!< Taille du segment de texte
+	unsigned _entry;		//!< Adresse de la première instruction
+	const Word *_registers;		//!< Registres de la machine
+	Timing_Op *_ops;		//!< Instructions pré-décodées (\c _textsize + 1)
+
+	// Instruction en cours
+	bool _started;			//!< Une instruction est-elle en cours ?
+	unsigned _pc;			//!< Son adresse
+	bool _taken;			//!< A-t-elle pris son branchement ?
+	uint64_t _issue;		//!< Ses cycles hors attente de la mémoire et prédiction
+	uint64_t _pending;		//!< Ses cycles d'attente de la mémoire
+	uint16_t _late;			//!< Registres qu'elle charge depuis la mémoire
+
+	// Prédiction
+	uint8_t *_counters;		//!< Compteurs à 2 bits (bimodal, gshare)
+	unsigned _history;		//!< Historique global (gshare)
+	unsigned *_ras;			//!< Pile d'adresses de retour (circulaire)
+	unsigned _rastop;		//!< Indice du prochain empilement
+	unsigned _rasdepth;		//!< Nombre d'adresses dans la pile
+	uint32_t *_targets;		//!< Dernière cible + 1 par adresse (0 : inconnue)
+
+	// Résultats
+	uint64_t _instructions;		//!< Instructions
+	uint64_t _cycles;		//!< Cycles
+	uint64_t _loaduse;		//!< Cycles de bulles de dépendance de chargement
+	uint64_t _exec;			//!< Cycles de latence d'exécution au-delà du premier
+	uint64_t _penalties;		//!< Cycles de pénalité de mauvaise prédiction
+	uint64_t _memory;		//!< Cycles d'attente de la mémoire
+	uint64_t *_counts;		//!< Exécutions par adresse
+	uint64_t *_pccycles;		//!< Cycles par adresse
+	uint64_t *_branches;		//!< Ruptures de séquence exécutées par adresse
+	uint64_t *_mispredicts;		//!< Mauvaises prédictions par adresse
+	uint64_t *_calls;		//!< Appels reçus par adresse
+};
+
+//! Description par défaut
+static const Timing_Config default_config = { TIMING_GSHARE, 12, 16, 3, 1, 3, 20 };
+
+//! Noms des prédicteurs
+static const char *predictor_names[] = { "static", "bimodal", "gshare" };
+
+//! Lecture de la description d'un pipeline
+/*!
+ * \param spec la description
+ * \param pconfig le pipeline (résultat)
+ * \return vrai si la description est correcte
+ */
+bool timing_parse(const char *spec, Timing_Config *pconfig) {
+	*pconfig = default_config;
+	if (strcmp(spec, "default") == 0)
+		return true;
+
+	size_t len = strcspn(spec, ":");
+	unsigned p;
+	for (p = 0; p <= TIMING_GSHARE; ++p)
+		if (strlen(predictor_names[p]) == len && strncmp(spec, predictor_names[p], len) == 0)
+			break;
+	bool ok = p <= TIMING_GSHARE;
+	pconfig->_predictor = p;
+
+	unsigned *fields[] = { &pconfig->_bits, &pconfig->_ras, &pconfig->_mispredict,
+			       &pconfig->_loaduse, &pconfig->_mul, &pconfig->_div };
+	const char *s = spec + len;
+	for (unsigned i = 0; ok && *s == ':'; ++i) {
+		char *end;
+		unsigned long n = strtoul(s + 1, &end, 0);
+		ok = i < sizeof(fields) / sizeof(fields[0]) && end != s + 1 && n <= 1000000;
+		if (ok)
+			*fields[i] = n;
+		s = end;
+	}
+	ok = ok && *s == '\0' && pconfig->_bits <= TIMING_MAXBITS
+	    && pconfig->_ras <= TIMING_MAXRAS && pconfig->_mul >= 1 && pconfig->_div >= 1;
+
+	if (!ok)
+		fprintf(stderr, "Bad pipeline description: %s\n", spec);
+	return ok;
+}
+
+//! Analyse d'une instruction pré-décodée
+/*!
+ * \param pd l'instruction pré-décodée
+ * \param pop l'instruction pour le modèle (résultat)
+ */
+static void classify(const Decoded *pd, Timing_Op *pop) {
+	uint16_t r = 1u << pd->_reg, x = 1u << pd->_rindex, sp = 1u << (NREGISTERS - 1);
+
+	*pop = (Timing_Op) { 0 };
+	switch (pd->_base) {
+	case OP_LOAD_A:
+		pop->_late = r;
+		break;
+	case OP_LOAD_X:
+		pop->_reads = x;
+		pop->_late = r;
+		break;
+	case OP_LOAD_R:
+		pop->_reads = x;
+		break;
+	case OP_STORE_A:
+		pop->_reads = r;
+		break;
+	case OP_STORE_X:
+		pop->_reads = r | x;
+		break;
+	case OP_PUSH_I:
+	case OP_PUSH_A:
+	case OP_POP_A:
+		pop->_reads = sp;
+		break;
+	case OP_PUSH_X:
+	case OP_POP_X:
+		pop->_reads = sp | x;
+		break;
+	case OP_BRANCH_A:
+	case OP_CALL_A:
+		pop->_class = CLASS_DIRECT;
+		pop->_cond = pd->_reg;
+		pop->_target = pd->_operand;
+		pop->_call = pd->_base == OP_CALL_A;
+		pop->_reads = pop->_call ? sp : 0;
+		break;
+	case OP_BRANCH_X:
+	case OP_CALL_X:
+		pop->_class = CLASS_INDEXED;
+		pop->_cond = pd->_reg;
+		pop->_call = pd->_base == OP_CALL_X;
+		pop->_reads = pop->_call ? sp | x : x;
+		break;
+	case OP_RET:
+		pop->_class = CLASS_RET;
+		pop->_reads = sp;
+		break;
+	case OP_BCOPY:
+	case OP_BFILL:
+	case OP_BCMP:
+		pop->_reads = r | x | 1u << pd->_operand;
+		pop->_latency = LATENCY_BLOCK;
+		pop->_countreg = pd->_operand;
+		break;
+	case OP_CAS_A:
+	case OP_CAS_X:
+		pop->_reads = r | 1u << (pd->_reg + 1) % NREGISTERS | (pd->_base == OP_CAS_X ? x : 0);
+		pop->_late = r;
+		break;
+	case OP_XADD_A:
+	case OP_XADD_X:
+		pop->_reads = r | (pd->_base == OP_XADD_X ? x : 0);
+		pop->_late = r;
+		break;
+
+	// Instructions de calcul : le registre est lu, et chargé depuis la
+	// mémoire si l'opérande y est (sauf CMP, qui ne le modifie pas)
+	case OP_ADD_I: case OP_SUB_I: case OP_MUL_I: case OP_DIV_I: case OP_MOD_I:
+	case OP_AND_I: case OP_OR_I: case OP_XOR_I: case OP_SHL_I: case OP_SHR_I:
+	case OP_SAR_I: case OP_CMP_I:
+		pop->_reads = r;
+		break;
+	case OP_ADD_A: case OP_SUB_A: case OP_MUL_A: case OP_DIV_A: case OP_MOD_A:
+	case OP_AND_A: case OP_OR_A: case OP_XOR_A: case OP_SHL_A: case OP_SHR_A:
+	case OP_SAR_A: case OP_CMP_A:
+		pop->_reads = r;
+		pop->_late = pd->_base == OP_CMP_A ? 0 : r;
+		break;
+	case OP_ADD_X: case OP_SUB_X: case OP_MUL_X: case OP_DIV_X: case OP_MOD_X:
+	case OP_AND_X: case OP_OR_X: case OP_XOR_X: case OP_SHL_X: case OP_SHR_X:
+	case OP_SAR_X: case OP_CMP_X:
+		pop->_reads = r | x;
+		pop->_late = pd->_base == OP_CMP_X ? 0 : r;
+		break;
+	case OP_ADD_R: case OP_SUB_R: case OP_MUL_R: case OP_DIV_R: case OP_MOD_R:
+	case OP_AND_R: case OP_OR_R: case OP_XOR_R: case OP_SHL_R: case OP_SHR_R:
+	case OP_SAR_R: case OP_CMP_R:
+		pop->_reads = r | x;
+		break;
+	default:
+		break;
+	}
+
+	if (pd->_base >= OP_MUL_I && pd->_base <= OP_MUL_R)
+		pop->_latency = LATENCY_MUL;
+	else if (pd->_base >= OP_DIV_I && pd->_base <= OP_MOD_R)
+		pop->_latency = LATENCY_DIV;
+}
+
+//! Création d'un modèle
+/*!
+ * \param pconfig le pipeline
+ * \param pmach la machine
+ * \return le modèle, ou NULL
+ */
+Timing *timing_new(const Timing_Config *pconfig, const Machine *pmach) {
+	Timing *pt = calloc(1, sizeof(Timing));
+	if (pt == NULL) {
+		perror("timing");
+		return NULL;
+	}
+	unsigned n = pmach->_textsize + 1;
+	pt->_config = *pconfig;
+	pt->_textsize = pmach->_textsize;
+	pt->_entry = pmach->_pc;
+	pt->_registers = pmach->_registers;
+	pt->_ops = malloc(n * sizeof(Timing_Op));
+	pt->_counters = malloc((size_t) 1 << pconfig->_bits);
+	pt->_ras = malloc((pconfig->_ras + 1) * sizeof(unsigned));
+	pt->_targets = calloc(n, sizeof(uint32_t));
+	pt->_counts = calloc(n, sizeof(uint64_t));
+	pt->_pccycles = calloc(n, sizeof(uint64_t));
+	pt->_branches = calloc(n, sizeof(uint64_t));
+	pt->_mispredicts = calloc(n, sizeof(uint64_t));
+	pt->_calls = calloc(n, sizeof(uint64_t));
+	if (pt->_ops == NULL || pt->_counters == NULL || pt->_ras == NULL
+	    || pt->_targets == NULL || pt->_counts == NULL || pt->_pccycles == NULL
+	    || pt->_branches == NULL || pt->_mispredicts == NULL || pt->_calls == NULL) {
+		perror("timing");
+		timing_free(pt);
+		return NULL;
+	}
+
+	for (unsigned a = 0; a < n; ++a)
+		classify(&pmach->_decoded[a], &pt->_ops[a]);
+	// Compteurs initialement faiblement non pris
+	memset(pt->_counters, 1, (size_t) 1 << pconfig->_bits);
+	return pt;
+}
+
+//! Libération d'un modèle
+/*!
+ * \param ptiming le modèle
+ */
+void timing_free(Timing *ptiming) {
+	free(ptiming->_ops);
+	free(ptiming->_counters);
+	free(ptiming->_ras);
+	free(ptiming->_targets);
+	free(ptiming->_counts);
+	free(ptiming->_pccycles);
+	free(ptiming->_branches);
+	free(ptiming->_mispredicts);
+	free(ptiming->_calls);
+	free(ptiming);
+}
+
+//! Compteur du prédicteur associé à une adresse
+static uint8_t *counter(Timing *pt, unsigned pc) {
+	unsigned mask = (1u << pt->_config._bits) - 1;
+	if (pt->_config._predictor == TIMING_GSHARE)
+		pc ^= pt->_history;
+	return &pt->_counters[pc & mask];
+}
+
+//! Prédiction de la direction d'un branchement conditionnel
+/*!
+ * \param pt le modèle
+ * \param pc l'adresse du branchement
+ * \param backward la cible (si elle est connue) précède-t-elle le branchement ?
+ * \return vrai si le branchement est prédit pris
+ */
+static bool predict(Timing *pt, unsigned pc, bool backward) {
+	if (pt->_config._predictor == TIMING_STATIC)
+		return backward;
+	return *counter(pt, pc) >= 2;
+}
+
+//! Mise à jour du prédicteur avec la direction effective
+static void train(Timing *pt, unsigned pc, bool taken) {
+	if (pt->_config._predictor == TIMING_STATIC)
+		return;
+	uint8_t *pc2 = counter(pt, pc);
+	if (taken && *pc2 < 3)
+		++*pc2;
+	else if (!taken && *pc2 > 0)
+		--*pc2;
+	pt->_history = (pt->_history << 1 | taken) & ((1u << pt->_config._bits) - 1);
+}
+
+//! Fin de l'instruction en cours
+/*!
+ * \param pt le modèle
+ * \param next l'adresse de l'instruction suivante
+ * \param known l'instruction suivante est-elle connue ?
+ */
+static void retire(Timing *pt, unsigned next, bool known) {
+	unsigned pc = pt->_pc;
+	const Timing_Op *pop = &pt->_ops[pc];
+	uint64_t cycles = pt->_issue + pt->_pending;
+	pt->_memory += pt->_pending;
+
+	if (pop->_class != CLASS_PLAIN && known) {
+		bool taken = pop->_class == CLASS_RET || pt->_taken;
+		bool mispredicted = false;
+		if (pop->_cond != NC) {
+			bool backward = pop->_class == CLASS_DIRECT ? pop->_target <= pc
+				: pt->_targets[pc] != 0 && pt->_targets[pc] - 1 <= pc;
+			mispredicted = predict(pt, pc, backward) != taken;
+			train(pt, pc, taken);
+		}
+		if (pop->_class == CLASS_RET && pt->_config._ras > 0) {
+			// Pile vide : pas de prédiction
+			if (pt->_rasdepth == 0)
+				mispredicted = true;
+			else {
+				pt->_rastop = (pt->_rastop + pt->_config._ras - 1) % pt->_config._ras;
+				--pt->_rasdepth;
+				mispredicted = pt->_ras[pt->_rastop] != next;
+			}
+		} else if (pop->_class != CLASS_DIRECT && taken) {
+			mispredicted = mispredicted || pt->_targets[pc] != next + 1;
+			pt->_targets[pc] = next + 1;
+		}
+		if (pop->_call && taken) {
+			if (pt->_config._ras > 0) {
+				pt->_ras[pt->_rastop] = pc + 1;
+				pt->_rastop = (pt->_rastop + 1) % pt->_config._ras;
+				if (pt->_rasdepth < pt->_config._ras)
+					++pt->_rasdepth;
+			}
+			++pt->_calls[next];
+		}
+
+		++pt->_branches[pc];
+		if (mispredicted) {
+			++pt->_mispredicts[pc];
+			cycles += pt->_config._mispredict;
+			pt->_penalties += pt->_config._mispredict;
+		}
+	}
+
+	++pt->_counts[pc];
+	pt->_pccycles[pc] += cycles;
+	++pt->_instructions;
+	pt->_cycles += cycles;
+	pt->_started = false;
+}
+
+//! Exécution d'une instruction
+/*!
+ * \param ptiming le modèle
+ * \param pc l'adresse de l'instruction
+ */
+void timing_step(Timing *ptiming, unsigned pc) {
+	Timing *const pt = ptiming;
+	if (pt->_started)
+		retire(pt, pc, true);
+
+	const Timing_Op *pop = &pt->_ops[pc];
+	uint64_t issue = 1;
+	if (pop->_reads & pt->_late) {
+		issue += pt->_config._loaduse;
+		pt->_loaduse += pt->_config._loaduse;
+	}
+	uint64_t extra = 0;
+	if (pop->_latency == LATENCY_MUL)
+		extra = pt->_config._mul - 1;
+	else if (pop->_latency == LATENCY_DIV)
+		extra = pt->_config._div - 1;
+	else if (pop->_latency == LATENCY_BLOCK)
+		extra = pt->_registers[pop->_countreg];
+	pt->_exec += extra;
+
+	pt->_started = true;
+	pt->_pc = pc;
+	pt->_taken = false;
+	pt->_issue = issue + extra;
+	pt->_pending = 0;
+	pt->_late = pop->_late;
+}
+
+//! Branchement pris par l'instruction en cours
+/*!
+ * \param ptiming le modèle
+ */
+void timing_taken(Timing *ptiming) {
+	ptiming->_taken = true;
+}
+
+//! Attente de la mémoire pour l'instruction en cours
+/*!
+ * \param ptiming le modèle
+ * \param cycles les cycles d'attente
+ */
+void timing_stall(Timing *ptiming, unsigned cycles) {
+	ptiming->_pending += cycles;
+}
+
+//! Fin de l'exécution
+/*!
+ * \param ptiming le modèle
+ */
+void timing_end(Timing *ptiming) {
+	if (ptiming->_started)
+		retire(ptiming, 0, false);
+}
+
+//! Pourcentage
+static double percent(uint64_t n, uint64_t total) {
+	return total == 0 ? 0 : 100.0 * n / total;
+}
+
+//! Entrée d'un classement
+typedef struct
+{
+	uint64_t _key;		//!< Critère (décroissant)
+	uint64_t _count;	//!< Second critère (décroissant)
+	unsigned _addr;		//!< Adresse
+} Rank_Entry;
+
+//! Comparaison de deux entrées : la plus coûteuse d'abord, puis par adresse
+static int compare_rank(const void *a, const void *b) {
+	const Rank_Entry *pa = a, *pb = b;
+	if (pa->_key != pb->_key)
+		return pa->_key > pb->_key ? -1 : 1;
+	if (pa->_count != pb->_count)
+		return pa->_count > pb->_count ? -1 : 1;
+	return pa->_addr < pb->_addr ? -1 : pa->_addr > pb->_addr;
+}
+
+//! Nom du symbole du texte associé à une adresse
+/*!
+ * \param pmach la machine
+ * \param addr l'adresse dans le texte
+ * \return le nom du symbole, ou NULL s'il n'y en a pas
+ */
+static const char *symbol_at(const Machine *pmach, unsigned addr) {
+	for (unsigned i = 0; i < pmach->_nsymbols; ++i)
+		if (!pmach->_symbols[i]._data && pmach->_symbols[i]._value == addr)
+			return pmach->_symbols[i]._name;
+	return NULL;
+}
+
+//! Affichage des résultats
+/*!
+ * \param out le fichier de sortie
+ * \param pmach la machine
+ * \param ptiming le modèle
+ */
+void timing_print(FILE *out, const Machine *pmach, const Timing *ptiming) {
+	const Timing *const pt = ptiming;
+	const Timing_Config *pconf = &pt->_config;
+
+	fprintf(out, "\n*** TIMING ***\n\n");
+	fprintf(out, "In-order pipeline: %s predictor", predictor_names[pconf->_predictor]);
+	if (pconf->_predictor != TIMING_STATIC)
+		fprintf(out, " (%u counters)", 1u << pconf->_bits);
+	if (pconf->_ras > 0)
+		fprintf(out, ", %u-entry return stack", pconf->_ras);
+	else
+		fprintf(out, ", no return stack");
+	fprintf(out, "\nmispredict %u cycles, load-use %u, MUL %u, DIV/MOD %u\n",
+		pconf->_mispredict, pconf->_loaduse, pconf->_mul, pconf->_div);
+
+	fprintf(out, "\n  %-20s %14llu\n  %-20s %14llu\n  %-20s %14.3f\n",
+		"instructions", (unsigned long long) pt->_instructions,
+		"cycles", (unsigned long long) pt->_cycles,
+		"CPI", pt->_instructions == 0 ? 0.0 : (double) pt->_cycles / pt->_instructions);
+	fprintf(out, "\nCycles:\n");
+	const char *names[] = { "issue", "load-use stalls", "execution latency",
+				"mispredictions", "memory stalls" };
+	uint64_t parts[] = { pt->_instructions, pt->_loaduse, pt->_exec, pt->_penalties,
+			     pt->_memory };
+	for (unsigned i = 0; i < sizeof(parts) / sizeof(parts[0]); ++i)
+		fprintf(out, "  %-20s %14llu %7.2f%%\n", names[i], (unsigned long long) parts[i],
+			percent(parts[i], pt->_cycles));
+
+	Rank_Entry *rank = malloc((pt->_textsize + 1) * sizeof(Rank_Entry));
+	if (rank == NULL) {
+		perror("timing");
+		return;
+	}
+
+	// Ruptures de séquence, par mauvaises prédictions décroissantes
+	uint64_t branches = 0, mispredicts = 0;
+	unsigned n = 0;
+	for (unsigned a = 0; a < pt->_textsize; ++a)
+		if (pt->_branches[a] != 0) {
+			rank[n++] = (Rank_Entry) { pt->_mispredicts[a], pt->_branches[a], a };
+			branches += pt->_branches[a];
+			mispredicts += pt->_mispredicts[a];
+		}
+	qsort(rank, n, sizeof(Rank_Entry), compare_rank);
+	fprintf(out, "\nBranches: %llu executed, %llu mispredicted (%.2f%%)\n",
+		(unsigned long long) branches, (unsigned long long) mispredicts,
+		percent(mispredicts, branches));
+	fprintf(out, "  %14s %14s %8s  %-6s  %s\n", "mispredicts", "executions", "rate", "addr",
+		"instruction");
+	for (unsigned i = 0; i < n; ++i) {
+		unsigned a = rank[i]._addr;
+		Instruction instr = pmach->_text[a];
+		char text[FORMAT_INSTRUCTION_MAX + 1] = "(invalid)";
+		if ((instr.instr_generic._cop != BRANCH && instr.instr_generic._cop != CALL)
+		    || instr.instr_generic._regcond <= LAST_CONDITION)
+			*format_instruction(text, instr, a) = '\0';
+		fprintf(out, "  %14llu %14llu %7.2f%%  0x%04x  %s\n",
+			(unsigned long long) rank[i]._key, (unsigned long long) rank[i]._count,
+			percent(rank[i]._key, rank[i]._count), a, text);
+	}
+
+	// Fonctions : chaque adresse appartient à la dernière entrée qui la
+	// précède (l'adresse 0, celle de départ et les cibles des appels)
+	n = 0;
+	for (unsigned a = 0; a < pt->_textsize; ++a) {
+		if (a == 0 || a == pt->_entry || pt->_calls[a] != 0)
+			rank[n++] = (Rank_Entry) { 0, 0, a };
+		rank[n - 1]._key += pt->_pccycles[a];
+		rank[n - 1]._count += pt->_counts[a];
+	}
+	unsigned nfunctions = 0;
+	for (unsigned i = 0; i < n; ++i)
+		if (rank[i]._count != 0)
+			rank[nfunctions++] = rank[i];
+	qsort(rank, nfunctions, sizeof(Rank_Entry), compare_rank);
+	fprintf(out, "\nFunctions by cycles:\n");
+	fprintf(out, "  %14s %8s %10s %14s %8s  %-6s  %s\n", "cycles", "%", "calls",
+		"instructions", "CPI", "addr", "function");
+	for (unsigned i = 0; i < nfunctions; ++i) {
+		unsigned a = rank[i]._addr;
+		const char *name = symbol_at(pmach, a);
+		fprintf(out, "  %14llu %7.2f%% %10llu %14llu %8.3f  0x%04x  %s\n",
+			(unsigned long long) rank[i]._key, percent(rank[i]._key, pt->_cycles),
+			(unsigned long long) pt->_calls[a], (unsigned long long) rank[i]._count,
+			(double) rank[i]._key / rank[i]._count, a,
+			name != NULL ? name : a == pt->_entry ? "(entry)" : "");
+	}
+	free(rank);
+}
@@ -0,0 +1,151 @@
+#ifndef _TIMING_H_
+#define _TIMING_H_
+
+/*!
+ * \file timing.h
+ * \brief Modèle approché du temps d'exécution sur un pipeline.
+ *
+ * Le modèle estime le nombre de cycles qu'un processeur à pipeline classique,
+ * dans l'ordre et à un seul pipeline (lecture, décodage, exécution, accès
+ * mémoire, écriture), mettrait à exécuter le programme. Il ne simule pas le
+ * pipeline étage par étage : chaque instruction coûte un cycle, plus :
+ *
+ * - une bulle de dépendance de chargement (\e load-use) si elle lit un
+ *   registre que l'instruction précédente charge depuis la mémoire (\c LOAD
+ *   absolu ou indexé, calcul dont l'opérande est en mémoire, \c CAS, \c
+ *   XADD) ; les autres résultats sont supposés transmis par court-circuit ;
+ *
+ * - la latence de son unité d'exécution, non pipelinée, au-delà d'un cycle :
+ *   \c MUL, \c DIV et \c MOD, et un cycle par mot pour les instructions sur
+ *   des plages de données ;
+ *
+ * - la pénalité d'une mauvaise prédiction si c'est une rupture de séquence
+ *   mal prédite ; les cibles des branchements et appels absolus sont
+ *   supposées connues dès la lecture, une bonne prédiction ne coûte rien ;
+ *
+ * - les cycles d'attente de la mémoire, si un modèle de cache (voir cache.h)
+ *   les lui reporte (timing_stall()).
+ *
+ * La direction des branchements conditionnels est prédite par un
+ * prédicteur statique (en arrière pris, en avant non pris), bimodal (table
+ * de compteurs à 2 bits indexée par l'adresse) ou \e gshare (même table
+ * indexée par l'adresse combinée à l'historique global des branchements) ;
+ * l'adresse de retour d'un \c RET par une pile d'adresses de retour, et la
+ * cible des branchements indexés (et des \c RET sans pile de retour) par la
+ * dernière cible de la même instruction.
+ *
+ * Le modèle est tenu par les variantes de la boucle d'exécution qui tiennent
+ * le profil (voir profile.h) lorsque son champ \c _timing n'est pas nul : il
+ * observe l'exécution sans la modifier. Il ne voit que l'adresse de chaque
+ * instruction exécutée, les branchements pris (timing_taken()) et les
+ * attentes de la mémoire ; le reste est pré-décodé à sa création.
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+#include "machine.h"
+
+//! Prédicteur de la direction des branchements conditionnels
+typedef enum
+{
+    TIMING_STATIC = 0,	//!< Statique : en arrière pris, en avant non pris
+    TIMING_BIMODAL,	//!< Compteurs à 2 bits indexés par l'adresse
+    TIMING_GSHARE,	//!< Compteurs à 2 bits indexés par l'adresse et l'historique
+} Timing_Predictor;
+
+//! Description du pipeline
+typedef struct
+{
+    uint8_t _predictor;		//!< Prédicteur (Timing_Predictor)
+    unsigned _bits;		//!< log2 du nombre de compteurs (et bits d'historique de gshare)
+    unsigned _ras;		//!< Profondeur de la pile d'adresses de retour (0 : aucune)
+    unsigned _mispredict;	//!< Pénalité d'une mauvaise prédiction (en cycles)
+    unsigned _loaduse;		//!< Bulle d'une dépendance de chargement (en cycles)
+    unsigned _mul;		//!< Latence de MUL (en cycles)
+    unsigned _div;		//!< Latence de DIV et MOD (en cycles)
+} Timing_Config;
+
+//! État du modèle (structure opaque, voir timing.c)
+typedef struct Timing Timing;
+
+//! Lecture de la description d'un pipeline
+/*!
+ * La description s'écrit
+ * <tt>prédicteur[:bits[:pile[:pénalité[:load-use[:mul[:div]]]]]]</tt>, le
+ * prédicteur étant \c static, \c bimodal ou \c gshare ; les champs omis
+ * prennent les valeurs de la description \c default, qui est
+ * <tt>gshare:12:16:3:1:3:20</tt>.
+ *
+ * \param spec la description
+ * \param pconfig le pipeline (résultat)
+ * \return vrai si la description est correcte, faux (avec un message) sinon
+ */
+bool timing_parse(const char *spec, Timing_Config *pconfig);
+
+//! Création d'un modèle
+/*!
+ * Le texte pré-décodé de la machine est analysé une fois pour toutes ; les
+ * registres de la machine sont consultés pendant l'exécution (longueur des
+ * plages de données) : la machine doit rester en place tant que le modèle
+ * existe.
+ *
+ * \param pconfig le pipeline
+ * \param pmach la machine chargée
+ * \return le modèle, ou NULL (avec un message) en cas d'échec
+ */
+Timing *timing_new(const Timing_Config *pconfig, const Machine *pmach);
+
+//! Libération d'un modèle
+/*!
+ * \param ptiming le modèle
+ */
+void timing_free(Timing *ptiming);
+
+//! Exécution d'une instruction
+/*!
+ * Appelée avant l'exécution de chaque instruction : l'instruction
+ * précédente, dont on connaît maintenant le successeur, est comptée.
+ *
+ * \param ptiming le modèle
+ * \param pc l'adresse de l'instruction
+ */
+void timing_step(Timing *ptiming, unsigned pc);
+
+//! Branchement pris par l'instruction en cours
+/*!
+ * \param ptiming le modèle
+ */
+void timing_taken(Timing *ptiming);
+
+//! Attente de la mémoire pour l'instruction en cours
+/*!
+ * \param ptiming le modèle
+ * \param cycles les cycles d'attente
+ */
+void timing_stall(Timing *ptiming, unsigned cycles);
+
+//! Fin de l'exécution : la dernière instruction est comptée
+/*!
+ * \param ptiming le modèle
+ */
+void timing_end(Timing *ptiming);
+
+//! Affichage des résultats
+/*!
+ * On affiche la description du pipeline, le nombre d'instructions et de
+ * cycles, le nombre moyen de cycles par instruction (CPI) et la répartition
+ * des cycles ; puis les instructions de rupture de séquence, de la plus
+ * souvent à la moins souvent mal prédite, avec leur taux d'erreur ; enfin
+ * les fonctions (adresse de départ et cibles des \c CALL exécutés), de la
+ * plus à la moins coûteuse, chaque instruction étant comptée dans la
+ * fonction qui la précède de plus près dans le texte.
+ *
+ * \param out le fichier de sortie
+ * \param pmach la machine (pour le texte et les symboles du programme)
+ * \param ptiming le modèle (voir timing_end())
+ */
+void timing_print(FILE *out, const Machine *pmach, const Timing *ptiming);
+
+#endif
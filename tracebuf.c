@@ -0,0 +1,168 @@
+#define _DEFAULT_SOURCE
+#include <stdlib.h>
+#include <stdio.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <time.h>
+#include "tracebuf.h"
+
+//! Tampon de trace binaire
+/*!
+ * Le premier champ doit rester le curseur public utilisé par
+ * tracebuf_reserve().
+ *
+ * Le producteur (la simulation) publie les blocs en incrémentant \c _head ;
+ * le consommateur (le processus léger d'écriture) les libère en incrémentant
+ * \c _tail. Le bloc de rang \c n occupe l'emplacement \c n % \c
+ * TRACEBUF_NCHUNKS.
+ */
+struct Trace_Buffer
+{
+	struct Trace_Cursor _cursor;	//!< Curseur dans le bloc courant
+	Trace_Record *_records;		//!< Les blocs du tampon circulaire
+	unsigned _fill[TRACEBUF_NCHUNKS];	//!< Nombre d'enregistrements de chaque bloc publié
+	atomic_ulong _head;		//!< Nombre de blocs publiés
+	atomic_ulong _tail;		//!< Nombre de blocs écrits
+	atomic_bool _closing;		//!< Fin de la production
+	FILE *_file;			//!< Fichier de trace
+	pthread_t _writer;		//!< Processus léger d'écriture
+	uint64_t _written;		//!< Nombre d'enregistrements écrits
+};
+
+//! Courte attente active (tampon plein ou vide)
+static void pause_briefly(void) {
+	struct timespec ts = { 0, 50000 };
+	nanosleep(&ts, NULL);
+}
+
+//! Premier enregistrement d'un bloc
+/*!
+ * \param ptb le tampon de trace
+ * \param n le rang du bloc
+ */
+static Trace_Record *chunk(Trace_Buffer *ptb, unsigned long n) {
+	return ptb->_records + (n % TRACEBUF_NCHUNKS) * TRACEBUF_CHUNK;
+}
+
+//! Processus léger d'écriture des blocs publiés
+/*!
+ * \param arg le tampon de trace
+ */
+static void *writer(void *arg) {
+	Trace_Buffer *ptb = arg;
+	unsigned long tail = atomic_load_explicit(&ptb->_tail, memory_order_relaxed);
+
+	while (true) {
+		unsigned long head = atomic_load_explicit(&ptb->_head, memory_order_acquire);
+		if (tail == head) {
+			if (atomic_load_explicit(&ptb->_closing, memory_order_acquire)
+			    && tail == atomic_load_explicit(&ptb->_head, memory_order_acquire))
+				break;
+			pause_briefly();
+			continue;
+		}
+		unsigned fill = ptb->_fill[tail % TRACEBUF_NCHUNKS];
+		if (fwrite(chunk(ptb, tail), sizeof(Trace_Record), fill, ptb->_file) < fill)
+			perror("trace");
+		ptb->_written += fill;
+		atomic_store_explicit(&ptb->_tail, ++tail, memory_order_release);
+	}
+	return NULL;
+}
+
+//! Ouverture d'un fichier de trace binaire
+/*!
+ * \param filename le nom du fichier à créer
+ * \return le tampon, ou NULL (avec un message) si le fichier ne peut être créé
+ */
+Trace_Buffer *tracebuf_open(const char *filename) {
+	Trace_Buffer *ptb = calloc(1, sizeof(Trace_Buffer));
+	if (ptb == NULL)
+		return NULL;
+	ptb->_records = malloc(TRACEBUF_NCHUNKS * TRACEBUF_CHUNK * sizeof(Trace_Record));
+	if (ptb->_records == NULL) {
+		free(ptb);
+		return NULL;
+	}
+	if ((ptb->_file = fopen(filename, "wb")) == NULL) {
+		perror(filename);
+		free(ptb->_records);
+		free(ptb);
+		return NULL;
+	}
+
+	Trace_Header header = { TRACE_MAGIC, TRACE_VERSION, sizeof(Trace_Record) };
+	fwrite(&header, sizeof(header), 1, ptb->_file);
+
+	atomic_init(&ptb->_head, 0);
+	atomic_init(&ptb->_tail, 0);
+	atomic_init(&ptb->_closing, false);
+	ptb->_cursor._cur = chunk(ptb, 0);
+	ptb->_cursor._end = ptb->_cursor._cur + TRACEBUF_CHUNK;
+
+	if (pthread_create(&ptb->_writer, NULL, writer, ptb) != 0) {
+		perror("trace");
+		fclose(ptb->_file);
+		free(ptb->_records);
+		free(ptb);
+		return NULL;
+	}
+	return ptb;
+}
+
+//! Publication du bloc courant et passage au suivant
+/*!
+ * \param ptb le tampon de trace
+ */
+static void publish(Trace_Buffer *ptb) {
+	unsigned long head = atomic_load_explicit(&ptb->_head, memory_order_relaxed);
+	ptb->_fill[head % TRACEBUF_NCHUNKS] = ptb->_cursor._cur - chunk(ptb, head);
+	atomic_store_explicit(&ptb->_head, ++head, memory_order_release);
+
+	// Attente d'un emplacement libre
+	while (head - atomic_load_explicit(&ptb->_tail, memory_order_acquire) >= TRACEBUF_NCHUNKS)
+		pause_briefly();
+
+	ptb->_cursor._cur = chunk(ptb, head);
+	ptb->_cursor._end = ptb->_cursor._cur + TRACEBUF_CHUNK;
+}
+
+//! Publication du bloc courant (tampon plein)
+/*!
+ * \param ptb le tampon de trace
+ */
+void tracebuf_advance(Trace_Buffer *ptb) {
+	publish(ptb);
+}
+
+//! Écriture de tous les enregistrements produits jusqu'ici
+/*!
+ * \param ptb le tampon de trace
+ */
+void tracebuf_flush(Trace_Buffer *ptb) {
+	unsigned long head = atomic_load_explicit(&ptb->_head, memory_order_relaxed);
+	if (ptb->_cursor._cur != chunk(ptb, head))
+		publish(ptb);
+	head = atomic_load_explicit(&ptb->_head, memory_order_relaxed);
+	while (atomic_load_explicit(&ptb->_tail, memory_order_acquire) != head)
+		pause_briefly();
+	fflush(ptb->_file);
+}
+
+//! Fermeture du fichier de trace et libération du tampon
+/*!
+ * \param ptb le tampon de trace
+ * \return le nombre total d'enregistrements écrits
+ */
+uint64_t tracebuf_close(Trace_Buffer *ptb) {
+	tracebuf_flush(ptb);
+	atomic_store_explicit(&ptb->_closing, true, memory_order_release);
+	pthread_join(ptb->_writer, NULL);
+
+	uint64_t written = ptb->_written;
+	fclose(ptb->_file);
+	free(ptb->_records);
+	free(ptb);
+	return written;
+}
@@ -0,0 +1,124 @@
+#ifndef _TRACEBUF_H_
+#define _TRACEBUF_H_
+
+/*!
+ * \file tracebuf.h
+ * \brief Trace binaire de l'exécution.
+ *
+ * La trace binaire remplace les lignes \c TRACE: de trace() pour les
+ * exécutions longues : chaque instruction exécutée produit un enregistrement
+ * de taille fixe, rangé dans un tampon circulaire en mémoire. Un processus
+ * léger d'écriture vide ce tampon dans le fichier de trace par gros blocs,
+ * pendant que la simulation continue. L'outil \c simul_tracedump relit le
+ * fichier et le restitue sous forme lisible.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+
+//! Marqueur du fichier de trace ("STRC" en petit boutiste)
+#define TRACE_MAGIC 0x43525453
+
+//! Version du format du fichier de trace
+#define TRACE_VERSION 1
+
+//! Nombre d'enregistrements d'un bloc du tampon circulaire
+#define TRACEBUF_CHUNK (1 << 16)
+
+//! Nombre de blocs du tampon circulaire
+#define TRACEBUF_NCHUNKS 8
+
+//! Valeur de \c _reg lorsqu'aucun registre n'est modifié
+#define TRACE_NOREG 0xff
+
+//! Valeur de \c _address lorsqu'aucun mot de donnée n'est écrit
+#define TRACE_NOADDR 0xffffffff
+
+//! Enregistrement de trace d'une instruction
+/*!
+ * Une instruction modifie au plus un registre (le registre destination, ou
+ * \c SP pour les instructions de pile) et écrit au plus un mot de donnée.
+ */
+typedef struct
+{
+    uint32_t _pc;		//!< Adresse de l'instruction
+    uint32_t _raw;		//!< Instruction (format brut)
+    uint32_t _regvalue;		//!< Nouvelle valeur du registre modifié
+    uint32_t _address;		//!< Adresse du mot de donnée écrit (ou TRACE_NOADDR)
+    uint32_t _memvalue;		//!< Valeur écrite dans ce mot
+    uint8_t _reg;		//!< Numéro du registre modifié (ou TRACE_NOREG)
+    uint8_t _pad[3];		//!< Inutilisé
+} Trace_Record;
+
+//! Entête du fichier de trace
+typedef struct
+{
+    uint32_t _magic;		//!< TRACE_MAGIC
+    uint16_t _version;		//!< TRACE_VERSION
+    uint16_t _recsize;		//!< sizeof(Trace_Record)
+} Trace_Header;
+
+//! Tampon de trace binaire (structure opaque, voir tracebuf.c)
+typedef struct Trace_Buffer Trace_Buffer;
+
+//! Ouverture d'un fichier de trace binaire
+/*!
+ * Le tampon circulaire est découpé en \c TRACEBUF_NCHUNKS blocs de \c
+ * TRACEBUF_CHUNK enregistrements. La simulation remplit un bloc puis le
+ * publie ; le processus léger d'écriture écrit chaque bloc publié en un seul
+ * appel. Producteur et consommateur ne se synchronisent qu'à travers deux
+ * compteurs atomiques : il n'y a pas de verrou. Si le tampon est plein, la
+ * simulation attend que le bloc le plus ancien soit écrit.
+ *
+ * \param filename le nom du fichier à créer
+ * \return le tampon, ou NULL (avec un message) si le fichier ne peut être créé
+ */
+Trace_Buffer *tracebuf_open(const char *filename);
+
+//! Publication du bloc courant (tampon plein)
+/*!
+ * Réservée à tracebuf_reserve().
+ *
+ * \param ptb le tampon de trace
+ */
+void tracebuf_advance(Trace_Buffer *ptb);
+
+//! Écriture de tous les enregistrements produits jusqu'ici
+/*!
+ * On attend que le processus léger ait écrit tous les blocs publiés, y compris
+ * le bloc courant (partiellement rempli).
+ *
+ * \param ptb le tampon de trace
+ */
+void tracebuf_flush(Trace_Buffer *ptb);
+
+//! Fermeture du fichier de trace et libération du tampon
+/*!
+ * \param ptb le tampon de trace
+ * \return le nombre total d'enregistrements écrits
+ */
+uint64_t tracebuf_close(Trace_Buffer *ptb);
+
+//! Partie publique du tampon, utilisée par tracebuf_reserve()
+struct Trace_Cursor
+{
+    Trace_Record *_cur;		//!< Prochain enregistrement libre du bloc courant
+    Trace_Record *_end;		//!< Fin du bloc courant
+};
+
+//! Réservation de l'enregistrement de la prochaine instruction
+/*!
+ * L'enregistrement reste accessible en écriture jusqu'à la réservation
+ * suivante.
+ *
+ * \param ptb le tampon de trace
+ * \return l'enregistrement à remplir
+ */
+static inline Trace_Record *tracebuf_reserve(Trace_Buffer *ptb) {
+    struct Trace_Cursor *pc = (struct Trace_Cursor *) ptb;
+    if (pc->_cur == pc->_end)
+        tracebuf_advance(ptb);
+    return pc->_cur++;
+}
+
+#endif